@@ -0,0 +1,68 @@
+#ifndef BOUNDED_QUEUE_H
+#define BOUNDED_QUEUE_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+
+// Multi producer, multi consumer FIFO with a fixed capacity, the hand-off between pipeline stages.
+// push blocks while the queue is full, so a slow consumer throttles its producers instead of
+// letting decoded images pile up in memory. close() wakes everyone: pushes fail from then on,
+// pops keep returning what is left and fail once the queue is empty.
+template <typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity)
+        : m_capacity(capacity ? capacity : 1)
+    {
+    }
+
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+    bool push(T&& item) {
+        std::unique_lock<std::mutex> guard(m_lock);
+        m_notFull.wait(guard, [this] { return m_closed || m_items.size() < m_capacity; });
+        if (m_closed) {
+            return false;
+        }
+        m_items.push_back(std::move(item));
+        guard.unlock();
+        m_notEmpty.notify_one();
+        return true;
+    }
+
+    bool pop(T* item) {
+        std::unique_lock<std::mutex> guard(m_lock);
+        m_notEmpty.wait(guard, [this] { return m_closed || !m_items.empty(); });
+        if (m_items.empty()) {
+            return false;
+        }
+        *item = std::move(m_items.front());
+        m_items.pop_front();
+        guard.unlock();
+        m_notFull.notify_one();
+        return true;
+    }
+
+    void close() {
+        {
+            std::lock_guard<std::mutex> guard(m_lock);
+            m_closed = true;
+        }
+        m_notFull.notify_all();
+        m_notEmpty.notify_all();
+    }
+
+private:
+    size_t m_capacity;
+    std::deque<T> m_items;
+    bool m_closed = false;
+
+    std::mutex m_lock;
+    std::condition_variable m_notFull;
+    std::condition_variable m_notEmpty;
+};
+
+#endif /* BOUNDED_QUEUE_H */
@@ -0,0 +1,144 @@
+#include <glad/glad.h>
+
+#include "dirty_tiles.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "trace.h"
+
+// the workgroup regions of the compute programs, see main() in fsr_easu.compute.base.glsl
+static const uint32_t regionDim = 16;
+
+// Clamped output range [begin, end) of one axis, from the EASU source position
+// pp = p * scale + offset and the taps at floor(pp) - 1 .. floor(pp) + 2.
+static void footprintAxis(float scale, float offset, uint32_t inputBegin, uint32_t inputEnd, uint32_t outputSize,
+                          uint32_t* begin, uint32_t* end) {
+    // floor(pp) in [inputBegin - 2, inputEnd], plus a pixel for the float math
+    const double first = std::floor(((double)inputBegin - 2.0 - offset) / scale) - 1.0;
+    const double last = std::ceil(((double)inputEnd + 1.0 - offset) / scale) + 1.0;
+    *begin = (uint32_t)std::min(std::max(first, 0.0), (double)outputSize);
+    *end = (uint32_t)std::min(std::max(last, 0.0), (double)outputSize);
+}
+
+Rect getEASUOutputFootprint(const FSRConstants& fsrData, const Rect& inputRect) {
+    // con0: the input/output ratio and the offset of the pixel centers, see FsrEasuCon
+    float con0[4];
+    memcpy(con0, fsrData.const0, sizeof(con0));
+
+    const uint32_t x1 = std::min(inputRect.x + inputRect.width, fsrData.input.width);
+    const uint32_t y1 = std::min(inputRect.y + inputRect.height, fsrData.input.height);
+    if (inputRect.x >= x1 || inputRect.y >= y1) {
+        return Rect{ 0, 0, 0, 0 };
+    }
+
+    uint32_t beginX, endX, beginY, endY;
+    footprintAxis(con0[0], con0[2], inputRect.x, x1, fsrData.output.width, &beginX, &endX);
+    footprintAxis(con0[1], con0[3], inputRect.y, y1, fsrData.output.height, &beginY, &endY);
+    return Rect{ beginX, beginY, endX - beginX, endY - beginY };
+}
+
+// Flags the workgroups of regionWidth x regionHeight pixels overlapping 'rect' grown by 'apron' and clipped to 'output'.
+static void markWorkgroups(const Rect& rect, uint32_t apron, const Extent& output, uint32_t regionWidth, uint32_t regionHeight,
+                           uint32_t groupsX, std::vector<uint8_t>* marks) {
+    if (rect.width == 0 || rect.height == 0) {
+        return;
+    }
+    const uint32_t x0 = rect.x > apron ? rect.x - apron : 0;
+    const uint32_t y0 = rect.y > apron ? rect.y - apron : 0;
+    const uint32_t x1 = std::min(rect.x + rect.width + apron, output.width);
+    const uint32_t y1 = std::min(rect.y + rect.height + apron, output.height);
+    for (uint32_t gy = y0 / regionHeight; gy <= (y1 - 1) / regionHeight; gy++) {
+        for (uint32_t gx = x0 / regionWidth; gx <= (x1 - 1) / regionWidth; gx++) {
+            (*marks)[gy * groupsX + gx] = 1;
+        }
+    }
+}
+
+// The flagged workgroups in raster order, the flags are cleared.
+static void collectWorkgroups(uint32_t groupsX, std::vector<uint8_t>* marks, std::vector<uint32_t>* workgroups) {
+    workgroups->clear();
+    for (uint32_t idx = 0; idx < marks->size(); idx++) {
+        if ((*marks)[idx]) {
+            workgroups->push_back((idx % groupsX) | (idx / groupsX) << 16);
+            (*marks)[idx] = 0;
+        }
+    }
+}
+
+void getTileListDispatch(uint32_t count, uint32_t* groupsX, uint32_t* groupsY) {
+    static const uint32_t maxGroups = 65535;
+    *groupsX = std::min(count, maxGroups);
+    *groupsY = count ? (count + maxGroups - 1) / maxGroups : 0;
+}
+
+DirtyTiles::DirtyTiles() {
+    glGenBuffers(3, m_buffers);
+}
+
+DirtyTiles::~DirtyTiles() {
+    glDeleteBuffers(3, m_buffers);
+}
+
+void DirtyTiles::update(const FSRConstants& fsrData, const std::vector<Rect>& dirty, bool rcasX2) {
+    TRACE_ZONE("DirtyTiles::update");
+    const Extent& output = fsrData.output;
+    std::vector<Rect> footprints;
+    footprints.reserve(dirty.size());
+    for (const Rect& rect : dirty) {
+        footprints.push_back(getEASUOutputFootprint(fsrData, rect));
+    }
+
+    const uint32_t groupsX = (output.width + regionDim - 1) / regionDim;
+    const uint32_t groupsY = (output.height + regionDim - 1) / regionDim;
+    m_marks.assign((size_t)groupsX * groupsY, 0);
+    for (const Rect& rect : footprints) {
+        markWorkgroups(rect, 0, output, regionDim, regionDim, groupsX, &m_marks);
+    }
+    collectWorkgroups(groupsX, &m_marks, &m_easu);
+
+    for (const Rect& rect : footprints) {
+        markWorkgroups(rect, 1, output, regionDim, regionDim, groupsX, &m_marks);
+    }
+    collectWorkgroups(groupsX, &m_marks, &m_fused);
+
+    if (rcasX2) {
+        const uint32_t groupsX2 = (output.width + regionDim * 2 - 1) / (regionDim * 2);
+        m_marks.assign((size_t)groupsX2 * groupsY, 0);
+        for (const Rect& rect : footprints) {
+            markWorkgroups(rect, 1, output, regionDim * 2, regionDim, groupsX2, &m_marks);
+        }
+        collectWorkgroups(groupsX2, &m_marks, &m_rcas);
+    } else {
+        m_rcas = m_fused;
+    }
+
+    const uint32_t groups = groupsX * groupsY;
+    m_coverage = groups ? (float)m_fused.size() / groups : 0.0f;
+    m_output = output;
+    m_uploaded = false;
+}
+
+void DirtyTiles::upload() {
+    if (m_uploaded) {
+        return;
+    }
+    const std::vector<uint32_t>* lists[3] = { &m_easu, &m_rcas, &m_fused };
+    for (uint32_t idx = 0; idx < 3; idx++) {
+        const std::vector<uint32_t>* list = lists[idx];
+        uint32_t groupsX, groupsY;
+        getTileListDispatch((uint32_t)list->size(), &groupsX, &groupsY);
+        if ((size_t)groupsX * groupsY > list->size()) {
+            m_padded = *list;
+            m_padded.resize((size_t)groupsX * groupsY, list->back());
+            list = &m_padded;
+        }
+        // a buffer of size 0 can't be bound, the empty lists aren't dispatched anyway
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_buffers[idx]);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, std::max(list->size(), (size_t)1) * sizeof(uint32_t),
+                     list->empty() ? nullptr : list->data(), GL_STREAM_DRAW);
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    m_uploaded = true;
+}
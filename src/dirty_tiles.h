@@ -0,0 +1,71 @@
+#ifndef DIRTY_TILES_H
+#define DIRTY_TILES_H
+
+#include <cstdint>
+#include <vector>
+
+#include "image_utils.h"
+
+// The workgroups of the FSR dispatches which have to run again after parts of the input changed,
+// for runFSRTiles and runFSRFusedTiles (fsr_gl.h). Everything else of the intermediate and the
+// output image is still valid from the previous run and is not touched.
+//
+// An input pixel reaches the output through the EASU 12 tap footprint (the 4x4 around the source
+// position, without its corners) and then the RCAS cross, one output pixel in each direction:
+//   EASU: the output pixels whose footprint overlaps a changed input pixel
+//   RCAS: those grown by 1, they read an EASU result which changed
+//   Fused: the same as RCAS, each workgroup recomputes the EASU of its region and apron itself
+// Each list holds the workgroup positions (x | y << 16) of the full dispatch covering those pixels,
+// in raster order and without duplicates, the same workgroups compute the same pixels.
+//
+// Needs the GL context current on the calling thread for upload() and the destructor.
+class DirtyTiles {
+public:
+    DirtyTiles();
+    ~DirtyTiles();
+
+    DirtyTiles(const DirtyTiles&) = delete;
+    DirtyTiles& operator=(const DirtyTiles&) = delete;
+
+    // Finds the workgroups for 'dirty' (input pixels, clipped to the input). rcasX2 is the layout of the
+    // RCAS program, 32x16 pixels per workgroup instead of 16x16. No GL calls, any thread.
+    void update(const FSRConstants& fsrData, const std::vector<Rect>& dirty, bool rcasX2 = false);
+
+    // Copies the lists into the shader storage buffers, the run functions call it.
+    void upload();
+
+    const std::vector<uint32_t>& easu() const { return m_easu; }
+    const std::vector<uint32_t>& rcas() const { return m_rcas; }
+    const std::vector<uint32_t>& fused() const { return m_fused; }
+
+    uint32_t easuBuffer() const { return m_buffers[0]; }
+    uint32_t rcasBuffer() const { return m_buffers[1]; }
+    uint32_t fusedBuffer() const { return m_buffers[2]; }
+
+    // Fraction of the full RCAS (or Fused) dispatch in the lists, 1 for everything.
+    float coverage() const { return m_coverage; }
+    // Output size of the fsrData of the last update().
+    const Extent& output() const { return m_output; }
+
+private:
+    std::vector<uint32_t> m_easu;
+    std::vector<uint32_t> m_rcas;
+    std::vector<uint32_t> m_fused;
+    std::vector<uint8_t> m_marks;    // scratch, a flag per workgroup
+    std::vector<uint32_t> m_padded; // scratch of upload()
+    uint32_t m_buffers[3] = {};
+    bool m_uploaded = false;
+    float m_coverage = 0.0f;
+    Extent m_output = {};
+};
+
+// A list of 'count' workgroups runs as a groupsX x groupsY grid, GL only guarantees 65535 workgroups
+// per dimension. upload() pads the lists to the full grid by repeating their last entry, which
+// writes the same values again.
+void getTileListDispatch(uint32_t count, uint32_t* groupsX, uint32_t* groupsY);
+
+// The output pixels whose EASU result reads a pixel of 'inputRect', clipped to the output.
+// Conservative by a pixel on each side for the rounding of the float constants in the shader.
+Rect getEASUOutputFootprint(const FSRConstants& fsrData, const Rect& inputRect);
+
+#endif /* DIRTY_TILES_H */
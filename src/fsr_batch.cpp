@@ -0,0 +1,670 @@
+#include <glad/glad.h>
+
+#include "bounded_queue.h"
+#include "fsr_batch.h"
+#include "fsr_cpu.h"
+#include "fsr_gl.h"
+#include "gl_headless.h"
+#include "gpu_pass_timer.h"
+#include "image_ingest.h"
+#include "image_utils.h"
+#include "image_writer.h"
+#include "fsr_programs.h"
+#include "program_cache.h"
+#include "readback_ring.h"
+#include "startup_timeline.h"
+#include "texture_pool.h"
+#include "thread_pool.h"
+#include "trace.h"
+#include "upload_ring.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <thread>
+
+static void printBatchUsage() {
+    printf("Usage: gles_fsr --batch [options] <image|directory|->...\n"
+           "  --out <dir>         output directory, default is next to the input\n"
+           "  --scale <s>         resolution multiplier, default 2.0\n"
+           "  --sharpness <a>     RCAS attenuation, default 0.25\n"
+           "  --fused             single dispatch EASU+RCAS\n"
+           "  --cpu               upscale on the CPU instead of GL\n"
+           "  --half              FP16 shaders and RGBA16F images where supported\n"
+           "  --output-format <f> rgba8 (default), rgb10_a2, rgba16f or rgba32f GL output image\n"
+           "  --decode-threads N  default 2\n"
+           "  --decode-budget M  MiB of images being decoded or waiting for the upscaler, default 512\n"
+           "  --encode-threads N  default 2\n"
+           "  --format <f>        ppm (default), pam, raw, qoi or png file written\n"
+           "  --png-level <l>     0 stored, 1 (default) filtered and deflated\n"
+           "  --queue N           images between two stages, default 4\n"
+           "  --gpu-timings <f>   write the GPU time of each pass as JSON, they are printed in any case\n"
+           "  --trace <f>         write a Chrome trace (chrome://tracing, ui.perfetto.dev) of the run\n"
+           "A directory adds the images directly inside of it, - reads paths from stdin.\n"
+           "Each image is written as <name>_fsr.<format extension>, raw is .rgba\n");
+}
+
+bool parseBatchOptions(int argc, char** argv, BatchOptions* options) {
+    for (int idx = 0; idx < argc; idx++) {
+        const char* arg = argv[idx];
+        if (strcmp(arg, "--out") == 0 && idx + 1 < argc) {
+            options->outputDir = argv[++idx];
+        } else if (strcmp(arg, "--scale") == 0 && idx + 1 < argc) {
+            options->resMultiplier = (float)atof(argv[++idx]);
+        } else if (strcmp(arg, "--sharpness") == 0 && idx + 1 < argc) {
+            options->rcasAttenuation = (float)atof(argv[++idx]);
+        } else if (strcmp(arg, "--fused") == 0) {
+            options->fused = true;
+        } else if (strcmp(arg, "--cpu") == 0) {
+            options->cpu = true;
+        } else if (strcmp(arg, "--half") == 0) {
+            options->half = true;
+        } else if (strcmp(arg, "--output-format") == 0 && idx + 1 < argc) {
+            if (!parseFSROutputFormat(argv[++idx], &options->outputFormat)) {
+                printf("Unknown output format: %s\n", argv[idx]);
+                printBatchUsage();
+                return false;
+            }
+        } else if (strcmp(arg, "--decode-threads") == 0 && idx + 1 < argc) {
+            options->decodeThreads = (uint32_t)atoi(argv[++idx]);
+        } else if (strcmp(arg, "--decode-budget") == 0 && idx + 1 < argc) {
+            options->decodeBudgetMiB = (uint32_t)atoi(argv[++idx]);
+        } else if (strcmp(arg, "--encode-threads") == 0 && idx + 1 < argc) {
+            options->encodeThreads = (uint32_t)atoi(argv[++idx]);
+        } else if (strcmp(arg, "--format") == 0 && idx + 1 < argc) {
+            if (!parseImageFileFormat(argv[++idx], &options->fileFormat)) {
+                printf("Unknown file format: %s\n", argv[idx]);
+                printBatchUsage();
+                return false;
+            }
+        } else if (strcmp(arg, "--png-level") == 0 && idx + 1 < argc) {
+            options->pngLevel = (uint32_t)atoi(argv[++idx]);
+        } else if (strcmp(arg, "--gpu-timings") == 0 && idx + 1 < argc) {
+            options->gpuTimingsPath = argv[++idx];
+        } else if (strcmp(arg, "--trace") == 0 && idx + 1 < argc) {
+            options->tracePath = argv[++idx];
+        } else if (strcmp(arg, "--queue") == 0 && idx + 1 < argc) {
+            options->queueDepth = (uint32_t)atoi(argv[++idx]);
+        } else if (arg[0] == '-' && arg[1] != '\0') {
+            printf("Unknown option: %s\n", arg);
+            printBatchUsage();
+            return false;
+        } else {
+            options->inputs.push_back(arg);
+        }
+    }
+
+    if (options->inputs.empty() || options->resMultiplier <= 0.0f) {
+        printBatchUsage();
+        return false;
+    }
+    options->decodeThreads = std::max(options->decodeThreads, 1u);
+    options->encodeThreads = std::max(options->encodeThreads, 1u);
+    options->pngLevel = std::min(options->pngLevel, 1u);
+    return true;
+}
+
+static std::string outputPath(const BatchOptions& options, const std::string& input) {
+    size_t slash = input.find_last_of("/\\");
+    std::string dir = slash == std::string::npos ? "" : input.substr(0, slash + 1);
+    std::string name = slash == std::string::npos ? input : input.substr(slash + 1);
+
+    size_t dot = name.find_last_of('.');
+    if (dot != std::string::npos && dot > 0) {
+        name = name.substr(0, dot);
+    }
+
+    if (!options.outputDir.empty()) {
+        dir = options.outputDir;
+        if (dir.back() != '/' && dir.back() != '\\') {
+            dir += '/';
+        }
+    }
+    return dir + name + "_fsr." + getImageFileFormatExtension(options.fileFormat);
+}
+
+// Extensions stb_image decodes, for the directory inputs.
+static bool isImagePath(const std::filesystem::path& path) {
+    static const char* extensions[] = { ".png", ".jpg", ".jpeg", ".bmp", ".tga", ".gif", ".psd", ".hdr", ".pic", ".ppm", ".pgm", ".pnm" };
+
+    std::string ext = path.extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return (char)tolower(c); });
+    for (const char* candidate : extensions) {
+        if (ext == candidate) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static double msSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+namespace {
+
+// Counters of one pipeline stage, updated from all of its threads.
+struct StageCounters {
+    std::atomic<uint64_t> images{0};
+    std::atomic<uint64_t> failed{0};
+    std::atomic<uint64_t> busyUs{0}; // doing the work, summed over the threads of the stage
+    std::atomic<uint64_t> waitUs{0}; // blocked on the input or output queue
+
+    void addBusy(std::chrono::steady_clock::time_point start) { busyUs += elapsedUs(start); }
+    void addWait(std::chrono::steady_clock::time_point start) { waitUs += elapsedUs(start); }
+
+    static uint64_t elapsedUs(std::chrono::steady_clock::time_point start) {
+        return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+    }
+};
+
+// decoded by ImageIngest, then replaced by the upscaled result on the way to the encoders
+typedef DecodedImage BatchImage;
+
+// The GL or CPU upscaler, living on the thread which calls runBatch.
+class BatchUpscaler {
+public:
+    explicit BatchUpscaler(const BatchOptions& options)
+        : m_options(options)
+    {
+    }
+
+    ~BatchUpscaler() {
+        if (m_cpuPool) {
+            return;
+        }
+        if (m_fsrTargets.output.id) {
+            m_texturePool.release(m_fsrTargets.intermediate.id);
+            m_texturePool.release(m_fsrTargets.output.id);
+            m_texturePool.trim();
+        }
+        if (m_gl.context) {
+            glDeleteBuffers(1, &m_fsrData_vbo);
+            m_programs.reset();
+            m_readback.reset();
+            m_upload.reset();
+            m_passTimer.reset();
+        }
+        destroyHeadlessGL(&m_gl);
+    }
+
+    // Creates the context and hands the programs to the driver without waiting for them.
+    bool init(StartupTimeline& timeline) {
+        if (m_options.cpu) {
+            m_cpuPool.reset(new ThreadPool());
+            printf("CPU upscaling: %s kernels, %u threads\n", getFSRCpuKernelName(getFSRCpuKernel()), m_cpuPool->threadCount());
+            return true;
+        }
+
+        const auto start = StartupTimeline::now();
+        if (!createHeadlessGL(&m_gl)) {
+            return false;
+        }
+        timeline.add("context", start);
+
+        m_programs.reset(new FSRProgramRegistry("src/"));
+        const FSRPrecision precision = m_programs->supportedPrecision(m_options.half ? FSRPrecision::Half : FSRPrecision::Float);
+        const FSROutputFormat format = precision == FSRPrecision::Half ? FSROutputFormat::RGBA16F : FSROutputFormat::RGBA32F;
+        m_imageFormat = getFSROutputGLFormat(format);
+        m_outputFormat = getFSROutputGLFormat(m_options.outputFormat);
+        m_easuPermutation = FSRPermutation(FSRPass::EASU, precision, format);
+        m_rcasPermutation = FSRPermutation(FSRPass::RCAS, precision, m_options.outputFormat);
+        m_fusedPermutation = FSRPermutation(FSRPass::Fused, precision, m_options.outputFormat);
+        if (m_options.fused) {
+            m_programs->prefetch({ m_fusedPermutation });
+        } else {
+            m_programs->prefetch({ m_easuPermutation, m_rcasPermutation });
+        }
+
+        glGenBuffers(1, &m_fsrData_vbo);
+        m_readback.reset(new ReadbackRing(readbackSlots));
+        m_upload.reset(new UploadRing(uploadSlots));
+        m_passTimer.reset(new GpuPassTimer(passQueries));
+        return true;
+    }
+
+    // Waits for the programs submitted by init, before the first upscale.
+    bool finishPrograms(StartupTimeline& timeline) {
+        if (!m_programs) {
+            return true;
+        }
+
+        const auto start = StartupTimeline::now();
+        bool ok = m_programs->finishPending(&timeline);
+        timeline.add("wait for programs", start);
+
+        if (m_options.fused) {
+            m_fsrProgramFused = m_programs->get(m_fusedPermutation);
+        } else {
+            m_fsrProgramEASU = m_programs->get(m_easuPermutation);
+            m_fsrProgramRCAS = m_programs->get(m_rcasPermutation);
+        }
+
+        const ProgramCacheStats cacheStats = getProgramCacheStats();
+        printf("Programs: %u from cache, %u compiled%s\n", cacheStats.hits, cacheStats.misses,
+               ok ? "" : ", failed");
+        return ok;
+    }
+
+    // Starts upscaling an image, the result comes out of collect(). On the GPU the readback of an
+    // image overlaps with the upload and the passes of the next one.
+    bool submit(BatchImage&& image) {
+        TRACE_ZONE("upscaleImage");
+        if (!prepare(image)) {
+            return false;
+        }
+        if (m_cpuPool) {
+            upscaleCpu(&image);
+            m_pending.push_back(std::move(image));
+            return true;
+        }
+        return upscaleGL(std::move(image));
+    }
+
+    // The oldest submitted image with image.rgba and image.size replaced by the upscaled result.
+    // Returns false if there is none, or without 'wait' if its readback is not done yet.
+    bool collect(BatchImage* image, bool wait, bool* ok) {
+        if (m_pending.empty()) {
+            return false;
+        }
+        *ok = true;
+        if (!m_cpuPool) {
+            uint64_t tag;
+            uint32_t format;
+            if (!m_readback->collect(&tag, &m_pending.front().rgba, &m_pending.front().size, &format, wait)) {
+                return false;
+            }
+            *ok = !m_pending.front().rgba.empty();
+        }
+        *image = std::move(m_pending.front());
+        m_pending.pop_front();
+        return true;
+    }
+
+    // Every readback slot is taken, collect() has to wait before the next submit.
+    bool full() const {
+        return m_readback && m_readback->full();
+    }
+
+    size_t pending() const { return m_pending.size(); }
+
+    const ReadbackRing* readback() const { return m_readback.get(); }
+    const UploadRing* upload() const { return m_upload.get(); }
+
+    // Waits for the outstanding pass timings, null on the CPU.
+    const GpuPassTimer* finishPassTimer() {
+        if (m_passTimer) {
+            m_passTimer->drain();
+        }
+        return m_passTimer.get();
+    }
+
+private:
+    // GL_PIXEL_PACK_BUFFERs in flight
+    static const uint32_t readbackSlots = 3;
+    // GL_PIXEL_UNPACK_BUFFERs the inputs are uploaded from
+    static const uint32_t uploadSlots = 2;
+    // timestamp query pairs in flight, two passes per image plus the readbacks ahead
+    static const uint32_t passQueries = 16;
+
+    bool prepare(const BatchImage& image) {
+        // the constants only depend on the sizes, a bulk job usually has a single input size
+        if (image.size.width != m_fsrData.input.width || image.size.height != m_fsrData.input.height) {
+            m_fsrData = {};
+            m_fsrData.input = image.size;
+            m_fsrData.output = { (uint32_t)(image.size.width * m_options.resMultiplier), (uint32_t)(image.size.height * m_options.resMultiplier) };
+            if (m_fsrData.output.width == 0 || m_fsrData.output.height == 0) {
+                printf("Output of %s would be empty\n", image.path.c_str());
+                m_fsrData.input = {};
+                return false;
+            }
+            prepareFSR(&m_fsrData, m_options.rcasAttenuation);
+
+            if (!m_cpuPool) {
+                glBindBuffer(GL_UNIFORM_BUFFER, m_fsrData_vbo);
+                glBufferData(GL_UNIFORM_BUFFER, sizeof(m_fsrData), &m_fsrData, GL_DYNAMIC_DRAW);
+                glBindBuffer(GL_UNIFORM_BUFFER, 0);
+            }
+        }
+
+        return true;
+    }
+
+    bool upscaleGL(BatchImage&& image) {
+        uint32_t inputTexture = 0;
+        if (!m_upload->upload(image.rgba.data(), image.size.width, image.size.height, &inputTexture)) {
+            return false;
+        }
+
+        acquireFSRTargets(m_texturePool, m_fsrData.output, m_imageFormat, m_outputFormat, &m_fsrTargets);
+        if (m_options.fused) {
+            runFSRFused(m_fsrData, m_fsrProgramFused, m_fsrData_vbo, inputTexture, m_fsrTargets.output.id, m_outputFormat,
+                        m_passTimer.get());
+        } else {
+            runFSR(m_fsrData, m_fsrProgramEASU, m_fsrProgramRCAS, m_fsrData_vbo, inputTexture,
+                   m_fsrTargets.intermediate.id, m_imageFormat, m_fsrTargets.output.id, m_outputFormat, false, m_passTimer.get());
+        }
+        m_passTimer->collect();
+
+        // the input buffer is reused for the result in collect(), the decoded pixels are on the GPU by now
+        bool ok = m_readback->submit(m_fsrTargets.output.id, m_outputFormat, m_fsrData.output, m_submitted++);
+        glDeleteTextures(1, &inputTexture);
+        if (ok) {
+            m_pending.push_back(std::move(image));
+        }
+        return ok;
+    }
+
+    bool upscaleCpu(BatchImage* image) {
+        const Extent output = m_fsrData.output;
+        m_cpuOutput.resize((size_t)output.width * output.height * 4);
+        runFSRCpuFused(*m_cpuPool, m_fsrData, image->rgba.data(), m_cpuOutput.data(), 0);
+
+        image->rgba.resize(m_cpuOutput.size());
+        for (size_t idx = 0; idx < m_cpuOutput.size(); idx++) {
+            float value = m_cpuOutput[idx] * 255.0f + 0.5f;
+            image->rgba[idx] = (uint8_t)(value < 0.0f ? 0.0f : (value > 255.0f ? 255.0f : value));
+        }
+        image->size = output;
+        return true;
+    }
+
+    const BatchOptions& m_options;
+    FSRConstants m_fsrData = {};
+
+    std::unique_ptr<ThreadPool> m_cpuPool;
+    std::vector<float> m_cpuOutput;
+
+    HeadlessGL m_gl = {};
+    std::unique_ptr<FSRProgramRegistry> m_programs;
+    FSRPermutation m_easuPermutation;
+    FSRPermutation m_rcasPermutation;
+    FSRPermutation m_fusedPermutation;
+    uint32_t m_imageFormat = 0;  // of the intermediate target, GL_RGBA32F or GL_RGBA16F
+    uint32_t m_outputFormat = 0; // of the output target, see BatchOptions::outputFormat
+    uint32_t m_fsrProgramEASU = 0;
+    uint32_t m_fsrProgramRCAS = 0;
+    uint32_t m_fsrProgramFused = 0;
+    uint32_t m_fsrData_vbo = 0;
+    TexturePool m_texturePool;
+    FSRTargets m_fsrTargets = {};
+
+    // submitted images in order, on the GPU each one has a readback in the ring
+    std::deque<BatchImage> m_pending;
+    std::unique_ptr<ReadbackRing> m_readback;
+    std::unique_ptr<UploadRing> m_upload;
+    std::unique_ptr<GpuPassTimer> m_passTimer;
+    uint64_t m_submitted = 0;
+};
+
+} // namespace
+
+// Stage 0, on its own thread: expands the inputs into image paths. Stdin is read lazily,
+// so a producer piping in paths keeps the pipeline busy without a file list up front.
+static void listInputs(const BatchOptions& options, BoundedQueue<std::string>& paths, StageCounters& counters) {
+    traceThreadName("list");
+    auto emit = [&](std::string path) {
+        counters.images++;
+        const auto waitStart = std::chrono::steady_clock::now();
+        paths.push(std::move(path));
+        counters.addWait(waitStart);
+    };
+
+    for (const std::string& input : options.inputs) {
+        if (input == "-") {
+            std::string line;
+            while (std::getline(std::cin, line)) {
+                if (!line.empty() && line.back() == '\r') {
+                    line.pop_back();
+                }
+                if (!line.empty()) {
+                    emit(line);
+                }
+            }
+            continue;
+        }
+
+        std::error_code error;
+        if (!std::filesystem::is_directory(input, error)) {
+            emit(input);
+            continue;
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        std::vector<std::string> entries;
+        for (const auto& entry : std::filesystem::directory_iterator(input, error)) {
+            if (entry.is_regular_file(error) && isImagePath(entry.path())) {
+                entries.push_back(entry.path().string());
+            }
+        }
+        if (error) {
+            printf("Unable to list %s: %s\n", input.c_str(), error.message().c_str());
+            counters.failed++;
+        }
+        std::sort(entries.begin(), entries.end());
+        counters.addBusy(start);
+
+        for (std::string& entry : entries) {
+            emit(std::move(entry));
+        }
+    }
+    paths.close();
+}
+
+int runBatch(const BatchOptions& options) {
+    const auto start = std::chrono::steady_clock::now();
+    if (!options.tracePath.empty()) {
+        traceStart();
+        traceThreadName("upscale");
+    }
+
+    StartupTimeline timeline;
+    StageCounters listCounters, decodeCounters, upscaleCounters, encodeCounters;
+    BoundedQueue<std::string> paths(options.queueDepth * options.decodeThreads);
+    BoundedQueue<BatchImage> decoded(options.queueDepth);
+    BoundedQueue<BatchImage> upscaled(options.queueDepth);
+
+    const auto pipelineStart = std::chrono::steady_clock::now();
+
+    std::thread lister(listInputs, std::cref(options), std::ref(paths), std::ref(listCounters));
+
+    ImageIngest ingest(options.decodeThreads, options.decodeBudgetMiB * 1024 * 1024);
+    ingest.start(paths, decoded, &timeline);
+
+    std::vector<std::thread> encoders;
+    for (uint32_t idx = 0; idx < options.encodeThreads; idx++) {
+        encoders.emplace_back([&] {
+            traceThreadName("encode");
+            // The strips of an image are encoded in parallel. parallelFor can't be shared between
+            // the encoders, each one gets its part of the hardware threads.
+            const uint32_t hardwareThreads = std::max(std::thread::hardware_concurrency(), 1u);
+            ThreadPool stripPool(std::max(hardwareThreads / options.encodeThreads, 1u));
+            ImageWriteOptions writeOptions;
+            writeOptions.format = options.fileFormat;
+            writeOptions.pngLevel = options.pngLevel;
+            writeOptions.pool = &stripPool;
+
+            BatchImage image;
+            auto waitStart = std::chrono::steady_clock::now();
+            while (upscaled.pop(&image)) {
+                encodeCounters.addWait(waitStart);
+
+                const auto busyStart = std::chrono::steady_clock::now();
+                const std::string output = outputPath(options, image.path);
+                bool ok = writeImageFile(output, image.rgba.data(), image.size, writeOptions);
+                encodeCounters.addBusy(busyStart);
+
+                if (ok) {
+                    encodeCounters.images++;
+                    printf("%s -> %s (%ux%u)\n", image.path.c_str(), output.c_str(), image.size.width, image.size.height);
+                } else {
+                    encodeCounters.failed++;
+                }
+                waitStart = std::chrono::steady_clock::now();
+            }
+            encodeCounters.addWait(waitStart);
+        });
+    }
+
+    // The upscaler owns the GL context, so it runs right here. It starts after the other stages
+    // so the first images are decoded while the context is created and the programs compile.
+    BatchUpscaler upscaler(options);
+    const bool programsOk = upscaler.init(timeline) && upscaler.finishPrograms(timeline);
+    if (!programsOk) {
+        // stops the decoders, what they already decoded is drained below and counted as failed
+        paths.close();
+        decoded.close();
+    }
+    bool firstImage = true;
+    {
+        BatchImage image;
+        auto firstStart = std::chrono::steady_clock::now();
+        // Hands on the finished images. With 'wait' it blocks for the oldest one, otherwise the
+        // next image is uploaded and upscaled while the readbacks are in flight.
+        auto collect = [&](bool wait) {
+            BatchImage result;
+            bool ok;
+            while (true) {
+                const auto busyStart = std::chrono::steady_clock::now();
+                const bool collected = upscaler.collect(&result, wait, &ok);
+                upscaleCounters.addBusy(busyStart);
+                if (!collected) {
+                    break;
+                }
+                wait = false;
+                if (!ok) {
+                    upscaleCounters.failed++;
+                    continue;
+                }
+                upscaleCounters.images++;
+                if (firstImage) {
+                    timeline.add("upscale first image", firstStart);
+                    firstImage = false;
+                }
+                const auto waitStart = std::chrono::steady_clock::now();
+                upscaled.push(std::move(result));
+                upscaleCounters.addWait(waitStart);
+            }
+        };
+
+        auto waitStart = std::chrono::steady_clock::now();
+        while (decoded.pop(&image)) {
+            upscaleCounters.addWait(waitStart);
+            // submit uploads the pixels (or upscales them on the CPU) right away
+            ingest.release(image);
+            if (!programsOk) {
+                // decoded before the programs failed, nothing to run them with
+                upscaleCounters.failed++;
+                waitStart = std::chrono::steady_clock::now();
+                continue;
+            }
+
+            const auto busyStart = std::chrono::steady_clock::now();
+            if (firstImage) {
+                firstStart = busyStart;
+            }
+            if (upscaler.full()) {
+                collect(true);
+            }
+            bool ok = upscaler.submit(std::move(image));
+            upscaleCounters.addBusy(busyStart);
+            if (!ok) {
+                upscaleCounters.failed++;
+            }
+            collect(false);
+
+            waitStart = std::chrono::steady_clock::now();
+        }
+        upscaleCounters.addWait(waitStart);
+        while (upscaler.pending()) {
+            collect(true);
+        }
+        upscaled.close();
+    }
+
+    if (const ReadbackRing* readback = upscaler.readback()) {
+        const ReadbackRing::Stats& stats = readback->stats();
+        const double count = stats.completed ? (double)stats.completed : 1.0;
+        printf("Readback: %llu images, %.1f MiB, %.2f ms latency, %.2f ms blocked, %.2f ms copy per image (%s mapping)\n",
+               (unsigned long long)stats.completed, stats.bytes / (1024.0 * 1024.0), stats.latencyMs / count, stats.waitMs / count,
+               stats.copyMs / count, readback->persistent() ? "persistent" : "per readback");
+    }
+    if (const UploadRing* upload = upscaler.upload()) {
+        const UploadRing::Stats& stats = upload->stats();
+        printf("Upload: %llu images, %.1f MiB, %.2f ms blocked per image (%s mapping)\n",
+               (unsigned long long)stats.uploads, stats.bytes / (1024.0 * 1024.0),
+               stats.waitMs / (stats.uploads ? (double)stats.uploads : 1.0), upload->persistent() ? "persistent" : "per upload");
+    }
+    bool timingsOk = true;
+    if (const GpuPassTimer* passTimer = upscaler.finishPassTimer()) {
+        passTimer->print();
+        if (!options.gpuTimingsPath.empty()) {
+            timingsOk = passTimer->writeJson(options.gpuTimingsPath);
+        }
+    }
+
+    lister.join();
+    ingest.join();
+    ingest.printStats();
+    const ImageIngest::Stats ingestStats = ingest.stats();
+    decodeCounters.images = ingestStats.images;
+    decodeCounters.failed = ingestStats.failed;
+    decodeCounters.busyUs = ingestStats.busyUs;
+    decodeCounters.waitUs = ingestStats.waitUs;
+    for (std::thread& thread : encoders) {
+        thread.join();
+    }
+    // every thread is done, the pool workers of the encoders are gone with them
+    bool traceOk = true;
+    if (!options.tracePath.empty()) {
+        traceOk = traceStop(options.tracePath);
+    }
+
+    const double pipelineMs = msSince(pipelineStart);
+    timeline.print();
+
+    // Capacity is what a stage would sustain if it never had to wait: images per second of busy
+    // time per thread. The stage with the lowest capacity is the one holding the others back.
+    struct StageRow {
+        const char* name;
+        const StageCounters* counters;
+        uint32_t threads;
+        double capacity;
+    };
+    StageRow rows[] = {
+        { "decode", &decodeCounters, options.decodeThreads, 0.0 },
+        { "upscale", &upscaleCounters, 1, 0.0 },
+        { "encode", &encodeCounters, options.encodeThreads, 0.0 },
+    };
+
+    printf("%-8s %8s %8s %8s %12s %12s %12s\n", "stage", "threads", "images", "failed", "busy ms", "wait ms", "capacity/s");
+    const StageRow* bottleneck = NULL;
+    for (StageRow& row : rows) {
+        const double busyMs = row.counters->busyUs.load() / 1000.0;
+        const double waitMs = row.counters->waitUs.load() / 1000.0;
+        const uint64_t processed = row.counters->images.load() + row.counters->failed.load();
+        row.capacity = busyMs > 0.0 ? processed * 1000.0 * row.threads / busyMs : 0.0;
+        if (processed && (!bottleneck || row.capacity < bottleneck->capacity)) {
+            bottleneck = &row;
+        }
+        printf("%-8s %8u %8llu %8llu %12.1f %12.1f %12.1f\n", row.name, row.threads, (unsigned long long)row.counters->images.load(),
+               (unsigned long long)row.counters->failed.load(), busyMs, waitMs, row.capacity);
+    }
+    if (bottleneck) {
+        printf("Limited by: %s\n", bottleneck->name);
+    }
+
+    const uint64_t listed = listCounters.images.load();
+    const uint64_t written = encodeCounters.images.load();
+    printf("Done: %llu of %llu images in %.1f ms (%.1f images/s, %.1f ms total)\n", (unsigned long long)written, (unsigned long long)listed,
+           pipelineMs, pipelineMs > 0.0 ? written * 1000.0 / pipelineMs : 0.0, msSince(start));
+
+    return programsOk && timingsOk && traceOk && written == listed && listCounters.failed.load() == 0 ? 0 : 1;
+}
@@ -0,0 +1,46 @@
+#ifndef FSR_BATCH_H
+#define FSR_BATCH_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "fsr_programs.h"
+#include "image_writer.h"
+
+// Headless batch upscaling: no window, no ImGui, no fonts.
+//
+// The images go through three stages connected by bounded queues so they overlap:
+// decode threads (ImageIngest, memory mapped files and stb) -> upscale on the calling thread (GL on a surfaceless EGL context, or the
+// CPU kernels) -> encode threads. Each stage counts its images, the time it spent working and
+// the time it was blocked on a queue, the summary at the end names the stage that limited the run.
+struct BatchOptions {
+    // Image files, directories (the images directly inside of them) or "-" for paths read from stdin,
+    // one per line, which are picked up while the earlier ones are being processed.
+    std::vector<std::string> inputs;
+    std::string outputDir;       // empty writes next to each input
+    float resMultiplier = 2.0f;
+    float rcasAttenuation = 0.25f;
+    bool fused = false;          // single dispatch EASU+RCAS (runFSRFused)
+    bool cpu = false;            // upscale with runFSRCpuFused, no GL context at all
+    bool half = false;           // FP16 programs and RGBA16F images if the driver has them, GL only
+    // Of the final GL pass. The images are written as 8 bit, RGBA8 with dithering is a quarter of
+    // the readback of RGBA32F.
+    FSROutputFormat outputFormat = FSROutputFormat::RGBA8;
+    uint32_t decodeThreads = 2;
+    uint32_t decodeBudgetMiB = 512; // decoded images not yet taken by the upscaler, plus the files being decoded
+    uint32_t encodeThreads = 2;
+    ImageFileFormat fileFormat = ImageFileFormat::PPM;
+    uint32_t pngLevel = 1;       // ImageWriteOptions::pngLevel
+    uint32_t queueDepth = 4;     // images waiting between two stages
+    std::string gpuTimingsPath;  // GpuPassTimer::writeJson at the end, GL only
+    std::string tracePath;       // Chrome trace of the whole run, see trace.h
+};
+
+// Parses the arguments after "--batch", prints the usage and returns false on errors.
+bool parseBatchOptions(int argc, char** argv, BatchOptions* options);
+
+// Returns the process exit code, non zero if any input failed.
+int runBatch(const BatchOptions& options);
+
+#endif /* FSR_BATCH_H */
@@ -0,0 +1,920 @@
+// Throughput matrix of the upscalers: source resolution x scale factor x backend, on a headless
+// context so the GL backends run on llvmpipe in CI.
+//
+// Each case runs until it took --min-time and --min-iterations, the median frame is reported as
+// ms/frame, output Mpix/s, ns per output pixel and the bandwidth of a minimum traffic model (every
+// byte of the input, the intermediate and the output touched once, caches assumed perfect).
+// --json writes one result per line with a stable id ("gl/1080p/x2.00"), --compare reads such a
+// file back and fails when a case got slower than --threshold percent, so CI can gate on it.
+//
+// --quality also upscales a downscaled copy of the content made at the output size and compares the
+// result with it (PSNR, SSIM, MS-SSIM, see image_metrics.h), the quality side of the same matrix.
+//
+// gl-dirty is the incremental path (runFSRTiles, dirty_tiles.h): after a full first frame each frame
+// changes --dirty of the input in a few rects and only reruns the workgroups they reach. Its last
+// output is checked against a full run, a difference fails the run with exit code 3.
+//
+// --verify runs no timings: every CPU kernel (SSE4.1, AVX2, AVX-512, the tiled executors) and the
+// GL passes upscale a fixed image, the EASU and the final results are compared with the scalar CPU
+// kernels and a max abs difference over --tolerance fails the run with exit code 4.
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "dirty_tiles.h"
+#include "fsr_cpu.h"
+#include "fsr_gl.h"
+#include "fsr_programs.h"
+#include "gl_headless.h"
+#include "gpu_pass_timer.h"
+#include "image_metrics.h"
+#include "image_utils.h"
+#include "texture_pool.h"
+#include "thread_pool.h"
+
+enum class Backend {
+    GL,         // runFSR, EASU then RCAS
+    GLFused,    // runFSRFused
+    GLBilinear, // runBilinear
+    CpuScalar,  // runFSRCpu with the scalar kernels, one thread
+    CpuSimd,    // runFSRCpuFused with the CPUID kernels on every core
+    GLDirty,    // runFSRTiles after changing --dirty of the input
+    Count,
+};
+
+static const char* backendName(Backend backend) {
+    switch (backend) {
+        case Backend::GL: return "gl";
+        case Backend::GLFused: return "gl-fused";
+        case Backend::GLBilinear: return "gl-bilinear";
+        case Backend::CpuScalar: return "cpu-scalar";
+        case Backend::CpuSimd: return "cpu-simd";
+        case Backend::GLDirty: return "gl-dirty";
+        default: return "?";
+    }
+}
+
+static bool isGL(Backend backend) {
+    return backend == Backend::GL || backend == Backend::GLFused || backend == Backend::GLBilinear || backend == Backend::GLDirty;
+}
+
+struct Source {
+    const char* name;
+    Extent size;
+};
+
+static const Source sources[] = {
+    { "720p", { 1280, 720 } },
+    { "1080p", { 1920, 1080 } },
+    { "1440p", { 2560, 1440 } },
+    { "4k", { 3840, 2160 } },
+};
+
+struct BenchOptions {
+    std::vector<const Source*> sources;
+    std::vector<float> scales;
+    std::vector<Backend> backends;
+    double minTimeMs = 250.0;
+    uint32_t minIterations = 3;
+    uint32_t maxIterations = 1000;
+    double maxOutputMpix = 36.0; // 8K, larger outputs are skipped (4K x4 needs ~2 GiB per RGBA32F image)
+    bool half = false;           // FP16 GL programs and intermediate where supported
+    bool quality = false;
+    float dirtyFraction = 0.05f; // of the input pixels changed per gl-dirty frame
+    bool verify = false;
+    double tolerance = 1e-5;     // --verify, max abs difference of the float kernels and GL
+    std::string jsonPath;
+    std::string comparePath;
+    double threshold = 10.0;     // percent
+};
+
+struct BenchResult {
+    std::string id;
+    const Source* source = nullptr;
+    float scale = 0.0f;
+    Backend backend = Backend::GL;
+    Extent output = {};
+    std::string skipped; // the reason, empty if it ran
+    uint32_t iterations = 0;
+    double medianMs = 0.0;
+    double minMs = 0.0;
+    double bytesPerFrame = 0.0;
+    GpuPassStats passes[(uint32_t)GpuPass::Count];
+    bool hasQuality = false;
+    ImageQuality quality;
+    double dirtyCoverage = 0.0;    // gl-dirty: mean fraction of the RCAS workgroups dispatched
+    uint32_t dirtyMismatches = 0;  // gl-dirty: output pixels differing from a full run
+};
+
+// With --quality: the content at the output size and its area average at the input size.
+struct QualityCase {
+    ThreadPool* pool;
+    std::vector<uint8_t> reference;
+    std::vector<uint8_t> input;
+};
+
+// Deterministic content with flat areas, gradients, hard and diagonal edges, the same at every run
+// and every commit so the results stay comparable.
+static std::vector<uint8_t> makeSource(const Extent& size) {
+    std::vector<uint8_t> pixels((size_t)size.width * size.height * 4);
+    for (uint32_t y = 0; y < size.height; y++) {
+        for (uint32_t x = 0; x < size.width; x++) {
+            uint8_t* pixel = &pixels[((size_t)y * size.width + x) * 4];
+            pixel[0] = (uint8_t)(x * 255 / size.width);
+            pixel[1] = (uint8_t)(y * 255 / size.height);
+            pixel[2] = ((x / 8) ^ (y / 8)) & 1 ? 255 : 0;
+            if (((x + y) / 24) % 5 == 0) {
+                pixel[1] = 255 - pixel[1];
+            }
+            pixel[3] = 255;
+        }
+    }
+    return pixels;
+}
+
+// One gl-dirty frame: rects of the input and their new pixels, tightly packed one rect after another.
+struct DirtyFrame {
+    std::vector<Rect> rects;
+    std::vector<uint8_t> pixels;
+};
+
+// A fixed cycle of frames, each changing 'fraction' of the input in 8 square rects spread over it
+// (less where they overlap). Deterministic like makeSource.
+static std::vector<DirtyFrame> makeDirtyFrames(const Extent& input, float fraction) {
+    static const uint32_t frameCount = 8;
+    static const uint32_t rectsPerFrame = 8;
+    const double area = (double)input.width * input.height * fraction / rectsPerFrame;
+    const uint32_t side = std::max((uint32_t)std::sqrt(area), 1u);
+    const uint32_t width = std::min(side, input.width);
+    const uint32_t height = std::min(side, input.height);
+
+    std::vector<DirtyFrame> frames(frameCount);
+    uint32_t random = 12345;
+    for (uint32_t frameIdx = 0; frameIdx < frameCount; frameIdx++) {
+        DirtyFrame& frame = frames[frameIdx];
+        for (uint32_t rectIdx = 0; rectIdx < rectsPerFrame; rectIdx++) {
+            random = random * 1664525u + 1013904223u;
+            const uint32_t x = (random >> 8) % (input.width - width + 1);
+            random = random * 1664525u + 1013904223u;
+            const uint32_t y = (random >> 8) % (input.height - height + 1);
+            frame.rects.push_back(Rect{ x, y, width, height });
+
+            // text-like content, different in each frame
+            for (uint32_t py = 0; py < height; py++) {
+                for (uint32_t px = 0; px < width; px++) {
+                    const bool on = (((px + frameIdx) / 3) ^ (py / 5)) & 1;
+                    frame.pixels.push_back(on ? 240 : (uint8_t)(frameIdx * 30));
+                    frame.pixels.push_back(on ? 240 : 40);
+                    frame.pixels.push_back(on ? 255 : (uint8_t)(x & 0xff));
+                    frame.pixels.push_back(255);
+                }
+            }
+        }
+    }
+    return frames;
+}
+
+// Runs 'frame' until both minimums are met, returns the sorted frame times.
+template <typename Frame>
+static std::vector<double> timeFrames(const BenchOptions& options, Frame frame) {
+    // warm up, lazy shader compiles in the driver, first touch of the output memory
+    frame();
+
+    std::vector<double> times;
+    double totalMs = 0.0;
+    while (times.size() < options.maxIterations && (times.size() < options.minIterations || totalMs < options.minTimeMs)) {
+        const auto start = std::chrono::steady_clock::now();
+        frame();
+        const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        times.push_back(ms);
+        totalMs += ms;
+    }
+    std::sort(times.begin(), times.end());
+    return times;
+}
+
+class GLBackends {
+public:
+    ~GLBackends() {
+        if (!m_gl.context) {
+            return;
+        }
+        m_passTimer.reset();
+        m_tiles.reset();
+        glDeleteBuffers(1, &m_fsrData_vbo);
+        m_texturePool.trim();
+        m_programs.reset();
+        destroyHeadlessGL(&m_gl);
+    }
+
+    bool init(bool half) {
+        if (!createHeadlessGL(&m_gl)) {
+            return false;
+        }
+        m_programs.reset(new FSRProgramRegistry("src/"));
+        const FSRPrecision precision = m_programs->supportedPrecision(half ? FSRPrecision::Half : FSRPrecision::Float);
+        const FSROutputFormat intermediate = precision == FSRPrecision::Half ? FSROutputFormat::RGBA16F : FSROutputFormat::RGBA32F;
+        // what the batch writes, RGBA8 with dithering
+        const FSROutputFormat output = FSROutputFormat::RGBA8;
+        m_intermediateFormat = getFSROutputGLFormat(intermediate);
+        m_outputFormat = getFSROutputGLFormat(output);
+        m_intermediateBytes = intermediate == FSROutputFormat::RGBA16F ? 8 : 16;
+        m_half = precision == FSRPrecision::Half;
+
+        const FSRPermutation easu(FSRPass::EASU, precision, intermediate);
+        const FSRPermutation rcas(FSRPass::RCAS, precision, output);
+        const FSRPermutation fused(FSRPass::Fused, precision, output);
+        const FSRPermutation bilinear(FSRPass::Bilinear, FSRPrecision::Float, output);
+        m_programs->prefetch({ easu, rcas, fused, bilinear });
+        if (!m_programs->finishPending(nullptr)) {
+            return false;
+        }
+        m_easu = m_programs->get(easu);
+        m_rcas = m_programs->get(rcas);
+        m_fused = m_programs->get(fused);
+        m_bilinear = m_programs->get(bilinear);
+        if (m_easu == (uint32_t)-3 || m_rcas == (uint32_t)-3 || m_fused == (uint32_t)-3 || m_bilinear == (uint32_t)-3) {
+            return false;
+        }
+
+        // gl-dirty only, they need shader storage buffers (GL 4.3)
+        FSRPermutation easuTiles = easu, rcasTiles = rcas;
+        easuTiles.tileList = rcasTiles.tileList = true;
+        m_programs->prefetch({ easuTiles, rcasTiles });
+        if (m_programs->finishPending(nullptr)) {
+            m_easuTiles = m_programs->get(easuTiles);
+            m_rcasTiles = m_programs->get(rcasTiles);
+            m_hasTiles = m_easuTiles != (uint32_t)-3 && m_rcasTiles != (uint32_t)-3;
+        }
+        if (m_hasTiles) {
+            m_tiles.reset(new DirtyTiles());
+        }
+
+        glGenBuffers(1, &m_fsrData_vbo);
+        m_passTimer.reset(new GpuPassTimer());
+        return true;
+    }
+
+    const char* renderer() const { return (const char*)glGetString(GL_RENDERER); }
+    const char* version() const { return (const char*)glGetString(GL_VERSION); }
+    bool half() const { return m_half; }
+    bool hasTiles() const { return m_hasTiles; }
+
+    void run(const BenchOptions& options, const std::vector<uint8_t>& pixels, const FSRConstants& fsrData, const QualityCase* quality,
+             BenchResult* result) {
+        glBindBuffer(GL_UNIFORM_BUFFER, m_fsrData_vbo);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(fsrData), &fsrData, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+        uint32_t inputTexture = 0;
+        LoadTextureFromMemory(pixels.data(), fsrData.input.width, fsrData.input.height, &inputTexture);
+        // the single pass backends don't need the intermediate
+        FSRTargets targets = {};
+        if (result->backend == Backend::GL || result->backend == Backend::GLDirty) {
+            acquireFSRTargets(m_texturePool, fsrData.output, m_intermediateFormat, m_outputFormat, &targets);
+        } else {
+            targets.output = m_texturePool.acquire(fsrData.output, m_outputFormat);
+        }
+
+        GpuPassTimer* timer = m_passTimer.get();
+        auto dispatch = [&](uint32_t texture, GpuPassTimer* passTimer) {
+            switch (result->backend) {
+            case Backend::GL:
+            case Backend::GLDirty:
+                runFSR(fsrData, m_easu, m_rcas, m_fsrData_vbo, texture, targets.intermediate.id, m_intermediateFormat,
+                       targets.output.id, m_outputFormat, false, passTimer);
+                break;
+            case Backend::GLFused:
+                runFSRFused(fsrData, m_fused, m_fsrData_vbo, texture, targets.output.id, m_outputFormat, passTimer);
+                break;
+            default:
+                runBilinear(fsrData, m_bilinear, m_fsrData_vbo, texture, targets.output.id, m_outputFormat, passTimer);
+                break;
+            }
+        };
+        std::vector<double> times;
+        if (result->backend == Backend::GLDirty) {
+            times = runDirty(options, fsrData, inputTexture, targets, result);
+        } else {
+            times = timeFrames(options, [&] {
+                dispatch(inputTexture, timer);
+                glFinish();
+                timer->collect();
+            });
+        }
+        timer->drain();
+
+        result->iterations = (uint32_t)times.size();
+        result->medianMs = times[times.size() / 2];
+        result->minMs = times.front();
+        for (uint32_t pass = 0; pass < (uint32_t)GpuPass::Count; pass++) {
+            result->passes[pass] = timer->stats((GpuPass)pass);
+        }
+        timer->reset();
+
+        if (quality) {
+            uint32_t qualityTexture = 0;
+            LoadTextureFromMemory(quality->input.data(), fsrData.input.width, fsrData.input.height, &qualityTexture);
+            // untimed, the pass stats are of the timed frames only
+            dispatch(qualityTexture, nullptr);
+            std::vector<uint8_t> upscaled;
+            if (readTextureRGBA8(targets.output.id, fsrData.output, &upscaled)) {
+                result->quality = compareImages(*quality->pool, quality->reference.data(), upscaled.data(), fsrData.output);
+                result->hasQuality = true;
+            }
+            glDeleteTextures(1, &qualityTexture);
+        }
+
+        const double inputBytes = (double)fsrData.input.width * fsrData.input.height * 4;
+        const double outputPixels = (double)fsrData.output.width * fsrData.output.height;
+        result->bytesPerFrame = inputBytes + outputPixels * 4;
+        if (result->backend == Backend::GL) {
+            // written by EASU and read back by RCAS
+            result->bytesPerFrame += outputPixels * m_intermediateBytes * 2;
+        } else if (result->backend == Backend::GLDirty) {
+            // the dispatched part only, the input is read around the changed rects
+            result->bytesPerFrame = (inputBytes * options.dirtyFraction + outputPixels * (4 + m_intermediateBytes * 2)) * result->dirtyCoverage;
+        }
+
+        // the next case is usually a different size, don't keep both around
+        if (targets.intermediate.id) {
+            m_texturePool.release(targets.intermediate.id);
+        }
+        m_texturePool.release(targets.output.id);
+        m_texturePool.trim();
+        glDeleteTextures(1, &inputTexture);
+    }
+
+    // --verify: the float programs with RGBA32F images, EASU alone, EASU + RCAS and Fused.
+    bool runFloat(const std::vector<uint8_t>& pixels, const FSRConstants& fsrData, std::vector<float>* easu, std::vector<float>* fsr,
+                  std::vector<float>* fused) {
+        const FSROutputFormat format = FSROutputFormat::RGBA32F;
+        const uint32_t glFormat = getFSROutputGLFormat(format);
+        const uint32_t easuProgram = m_programs->get(FSRPermutation(FSRPass::EASU, FSRPrecision::Float, format));
+        const uint32_t rcasProgram = m_programs->get(FSRPermutation(FSRPass::RCAS, FSRPrecision::Float, format));
+        const uint32_t fusedProgram = m_programs->get(FSRPermutation(FSRPass::Fused, FSRPrecision::Float, format));
+        if (easuProgram == (uint32_t)-3 || rcasProgram == (uint32_t)-3 || fusedProgram == (uint32_t)-3) {
+            return false;
+        }
+
+        glBindBuffer(GL_UNIFORM_BUFFER, m_fsrData_vbo);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(fsrData), &fsrData, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        uint32_t inputTexture = 0;
+        LoadTextureFromMemory(pixels.data(), fsrData.input.width, fsrData.input.height, &inputTexture);
+        FSRTargets targets = {};
+        acquireFSRTargets(m_texturePool, fsrData.output, glFormat, glFormat, &targets);
+
+        runFSR(fsrData, easuProgram, rcasProgram, m_fsrData_vbo, inputTexture, targets.intermediate.id, glFormat, targets.output.id, glFormat);
+        bool ok = readTextureRGBA32F(targets.intermediate.id, fsrData.output, easu) &&
+                  readTextureRGBA32F(targets.output.id, fsrData.output, fsr);
+        runFSRFused(fsrData, fusedProgram, m_fsrData_vbo, inputTexture, targets.output.id, glFormat);
+        ok = ok && readTextureRGBA32F(targets.output.id, fsrData.output, fused);
+
+        m_texturePool.release(targets.intermediate.id);
+        m_texturePool.release(targets.output.id);
+        m_texturePool.trim();
+        glDeleteTextures(1, &inputTexture);
+        return ok;
+    }
+
+private:
+    // gl-dirty: a full run, then the timed frames update the rects of the next DirtyFrame in the input
+    // and rerun the tiles they reach. Returns the sorted frame times.
+    std::vector<double> runDirty(const BenchOptions& options, const FSRConstants& fsrData, uint32_t inputTexture,
+                                 const FSRTargets& targets, BenchResult* result) {
+        const std::vector<DirtyFrame> frames = makeDirtyFrames(fsrData.input, options.dirtyFraction);
+        runFSR(fsrData, m_easu, m_rcas, m_fsrData_vbo, inputTexture, targets.intermediate.id, m_intermediateFormat,
+               targets.output.id, m_outputFormat);
+
+        GpuPassTimer* timer = m_passTimer.get();
+        uint32_t frameIdx = 0;
+        double coverage = 0.0;
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        const std::vector<double> times = timeFrames(options, [&] {
+            const DirtyFrame& frame = frames[frameIdx++ % frames.size()];
+            const uint8_t* pixels = frame.pixels.data();
+            glBindTexture(GL_TEXTURE_2D, inputTexture);
+            for (const Rect& rect : frame.rects) {
+                glTexSubImage2D(GL_TEXTURE_2D, 0, rect.x, rect.y, rect.width, rect.height, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+                pixels += (size_t)rect.width * rect.height * 4;
+            }
+            m_tiles->update(fsrData, frame.rects);
+            coverage += m_tiles->coverage();
+            runFSRTiles(fsrData, m_easuTiles, m_rcasTiles, m_fsrData_vbo, inputTexture, targets.intermediate.id, m_intermediateFormat,
+                        targets.output.id, m_outputFormat, *m_tiles, timer);
+            glFinish();
+            timer->collect();
+        });
+        result->dirtyCoverage = coverage / frameIdx;
+
+        // every changed pixel has to be where a full run of the same input puts it
+        std::vector<uint8_t> incremental, full;
+        readTextureRGBA8(targets.output.id, fsrData.output, &incremental);
+        runFSR(fsrData, m_easu, m_rcas, m_fsrData_vbo, inputTexture, targets.intermediate.id, m_intermediateFormat,
+               targets.output.id, m_outputFormat);
+        readTextureRGBA8(targets.output.id, fsrData.output, &full);
+        if (full.size() != incremental.size()) {
+            result->dirtyMismatches = fsrData.output.width * fsrData.output.height;
+            return times;
+        }
+        for (size_t idx = 0; idx < full.size(); idx += 4) {
+            result->dirtyMismatches += memcmp(&full[idx], &incremental[idx], 4) != 0;
+        }
+        return times;
+    }
+
+    HeadlessGL m_gl = {};
+    std::unique_ptr<FSRProgramRegistry> m_programs;
+    std::unique_ptr<GpuPassTimer> m_passTimer;
+    std::unique_ptr<DirtyTiles> m_tiles;
+    TexturePool m_texturePool;
+    uint32_t m_easu = 0;
+    uint32_t m_rcas = 0;
+    uint32_t m_fused = 0;
+    uint32_t m_bilinear = 0;
+    uint32_t m_easuTiles = 0;
+    uint32_t m_rcasTiles = 0;
+    bool m_hasTiles = false;
+    uint32_t m_fsrData_vbo = 0;
+    uint32_t m_intermediateFormat = 0;
+    uint32_t m_outputFormat = 0;
+    uint32_t m_intermediateBytes = 16;
+    bool m_half = false;
+};
+
+static void runCpu(const BenchOptions& options, ThreadPool& pool, const std::vector<uint8_t>& pixels, const FSRConstants& fsrData,
+                   const QualityCase* quality, BenchResult* result) {
+    const double inputBytes = (double)fsrData.input.width * fsrData.input.height * 4;
+    const double outputPixels = (double)fsrData.output.width * fsrData.output.height;
+    std::vector<float> output((size_t)fsrData.output.width * fsrData.output.height * 4);
+
+    auto upscale = [&](const uint8_t* input) {
+        if (result->backend == Backend::CpuScalar) {
+            runFSRCpu(fsrData, input, output.data());
+        } else {
+            runFSRCpuFused(pool, fsrData, input, output.data(), 0);
+        }
+    };
+    setFSRCpuKernel(result->backend == Backend::CpuScalar ? FSRCpuKernel::Scalar : FSRCpuKernel::Auto);
+    const std::vector<double> times = timeFrames(options, [&] { upscale(pixels.data()); });
+    if (result->backend == Backend::CpuScalar) {
+        // the full resolution EASU result goes through memory
+        result->bytesPerFrame = inputBytes + outputPixels * 16 * 3;
+    } else {
+        result->bytesPerFrame = inputBytes + outputPixels * 16;
+    }
+    setFSRCpuKernel(FSRCpuKernel::Auto);
+
+    if (quality) {
+        upscale(quality->input.data());
+        result->quality = compareImages(*quality->pool, quality->reference.data(), output.data(), fsrData.output);
+        result->hasQuality = true;
+    }
+
+    result->iterations = (uint32_t)times.size();
+    result->medianMs = times[times.size() / 2];
+    result->minMs = times.front();
+}
+
+// Largest difference of two RGBA32F images, infinite for a NaN or a size mismatch.
+static double maxAbsDiff(const std::vector<float>& a, const std::vector<float>& b) {
+    if (a.size() != b.size()) {
+        return INFINITY;
+    }
+    double result = 0.0;
+    for (size_t idx = 0; idx < a.size(); idx++) {
+        const double diff = std::fabs((double)a[idx] - b[idx]);
+        if (!(diff <= result)) {
+            result = std::isnan(diff) ? INFINITY : diff;
+        }
+    }
+    return result;
+}
+
+// --verify: the scalar CPU kernels are the reference, everything else has to match them. Returns the
+// number of failed comparisons.
+static uint32_t runVerify(const BenchOptions& options, ThreadPool& pool, GLBackends* gl) {
+    // odd sizes, so the SIMD kernels run their tails and masked edges
+    static const Extent input = { 517, 291 };
+    // the packed half RCAS differs by a few LSB of a half float by design, and where a channel within
+    // a half LSB of 0 or 1 rounds to flat its lobe drops out (see rcasPixel), which moves a pixel by up to ~0.1
+    static const double toleranceFP16 = 0.125;
+    static const FSRCpuKernel kernels[] = { FSRCpuKernel::SSE41, FSRCpuKernel::AVX2, FSRCpuKernel::AVX512, FSRCpuKernel::AVX512FP16 };
+
+    const std::vector<uint8_t> pixels = makeSource(input);
+    uint32_t failures = 0, comparisons = 0;
+    printf("%-24s %-10s %14s %14s\n", "variant", "scale", "EASU max diff", "FSR max diff");
+    auto report = [&](const char* name, float scale, const std::vector<float>* easu, const std::vector<float>* fsr,
+                      const std::vector<float>& easuReference, const std::vector<float>& fsrReference, double tolerance) {
+        const double easuDiff = easu ? maxAbsDiff(*easu, easuReference) : 0.0;
+        const double fsrDiff = maxAbsDiff(*fsr, fsrReference);
+        char easuText[32] = "-";
+        if (easu) {
+            snprintf(easuText, sizeof(easuText), "%.3g", easuDiff);
+        }
+        const bool ok = easuDiff <= tolerance && fsrDiff <= tolerance;
+        printf("%-24s x%-9.2f %14s %14.3g %s\n", name, scale, easuText, fsrDiff, ok ? "ok" : "FAIL");
+        failures += ok ? 0 : 1;
+        comparisons++;
+    };
+
+    for (float scale : options.scales) {
+        FSRConstants fsrData = {};
+        fsrData.input = input;
+        fsrData.output = { (uint32_t)(input.width * scale), (uint32_t)(input.height * scale) };
+        prepareFSR(&fsrData, 0.25f);
+        const size_t values = (size_t)fsrData.output.width * fsrData.output.height * 4;
+
+        std::vector<float> easuReference(values), fsrReference(values);
+        setFSRCpuKernel(FSRCpuKernel::Scalar);
+        runEASUCpu(fsrData, pixels.data(), easuReference.data());
+        runFSRCpu(fsrData, pixels.data(), fsrReference.data());
+
+        std::vector<float> easu(values), fsr(values), fused(values);
+        for (FSRCpuKernel kernel : kernels) {
+            setFSRCpuKernel(kernel);
+            char name[32];
+            snprintf(name, sizeof(name), "cpu-%s", getFSRCpuKernelName(kernel));
+            if (getFSRCpuKernel() != kernel) {
+                printf("%-24s x%-9.2f skipped, not supported by this CPU\n", name, scale);
+                continue;
+            }
+            runEASUCpu(fsrData, pixels.data(), easu.data());
+            runFSRCpu(fsrData, pixels.data(), fsr.data());
+            report(name, scale, &easu, &fsr, easuReference, fsrReference,
+                   kernel == FSRCpuKernel::AVX512FP16 ? toleranceFP16 : options.tolerance);
+        }
+
+        // the executors with the kernels CPUID picks
+        setFSRCpuKernel(FSRCpuKernel::Auto);
+        runFSRCpuTiled(pool, fsrData, pixels.data(), fsr.data(), 0);
+        report("cpu-tiled", scale, nullptr, &fsr, easuReference, fsrReference, options.tolerance);
+        runFSRCpuFused(pool, fsrData, pixels.data(), fsr.data(), 0);
+        report("cpu-fused", scale, nullptr, &fsr, easuReference, fsrReference, options.tolerance);
+
+        if (!gl) {
+            printf("%-24s x%-9.2f skipped, no GL context\n", "gl", scale);
+        } else if (!gl->runFloat(pixels, fsrData, &easu, &fsr, &fused)) {
+            printf("%-24s x%-9.2f failed to run\n", "gl", scale);
+            failures++;
+            comparisons++;
+        } else {
+            report("gl", scale, &easu, &fsr, easuReference, fsrReference, options.tolerance);
+            report("gl-fused", scale, nullptr, &fused, easuReference, fsrReference, options.tolerance);
+        }
+    }
+    printf("Verify: %u of %u comparisons failed\n", failures, comparisons);
+    return failures;
+}
+
+static bool parseList(const char* list, const std::function<bool(const std::string&)>& add) {
+    std::string item;
+    for (const char* c = list;; c++) {
+        if (*c == ',' || *c == '\0') {
+            if (!item.empty() && !add(item)) {
+                printf("Unknown value: %s\n", item.c_str());
+                return false;
+            }
+            item.clear();
+            if (*c == '\0') {
+                return true;
+            }
+        } else {
+            item += *c;
+        }
+    }
+}
+
+static void printUsage(const char* name) {
+    printf("Usage: %s [options]\n"
+           "  --sources <list>    720p,1080p,1440p,4k (default all)\n"
+           "  --scales <list>     default 1.3,1.5,1.7,2,4\n"
+           "  --backends <list>   gl,gl-fused,gl-bilinear,cpu-scalar,cpu-simd,gl-dirty (default all)\n"
+           "  --min-time <ms>     per case, default 250\n"
+           "  --min-iterations N  per case, default 3\n"
+           "  --max-output <Mpix> larger outputs are skipped, default 36\n"
+           "  --half              FP16 GL programs where supported\n"
+           "  --quality           PSNR, SSIM and MS-SSIM against a downscale of content made at the output size\n"
+           "  --dirty <fraction>  of the input changed per gl-dirty frame, default 0.05\n"
+           "  --verify            compare every CPU kernel and GL with the scalar CPU kernels instead, exits with 4 on a difference\n"
+           "  --tolerance <diff>  max abs difference for --verify, default 1e-5 (0.125 for avx512fp16)\n"
+           "  --json <file>       write the results\n"
+           "  --compare <file>    results of an earlier --json, exits with 2 on a regression\n"
+           "  --threshold <pct>   slowdown counted as a regression, default 10\n", name);
+}
+
+static bool parseOptions(int argc, char** argv, BenchOptions* options) {
+    for (int idx = 1; idx < argc; idx++) {
+        const char* arg = argv[idx];
+        bool ok = true;
+        if (strcmp(arg, "--sources") == 0 && idx + 1 < argc) {
+            ok = parseList(argv[++idx], [&](const std::string& item) {
+                for (const Source& source : sources) {
+                    if (item == source.name) {
+                        options->sources.push_back(&source);
+                        return true;
+                    }
+                }
+                return false;
+            });
+        } else if (strcmp(arg, "--scales") == 0 && idx + 1 < argc) {
+            ok = parseList(argv[++idx], [&](const std::string& item) {
+                const float scale = (float)atof(item.c_str());
+                options->scales.push_back(scale);
+                return scale > 0.0f;
+            });
+        } else if (strcmp(arg, "--backends") == 0 && idx + 1 < argc) {
+            ok = parseList(argv[++idx], [&](const std::string& item) {
+                for (uint32_t backend = 0; backend < (uint32_t)Backend::Count; backend++) {
+                    if (item == backendName((Backend)backend)) {
+                        options->backends.push_back((Backend)backend);
+                        return true;
+                    }
+                }
+                return false;
+            });
+        } else if (strcmp(arg, "--min-time") == 0 && idx + 1 < argc) {
+            options->minTimeMs = atof(argv[++idx]);
+        } else if (strcmp(arg, "--min-iterations") == 0 && idx + 1 < argc) {
+            options->minIterations = std::max((uint32_t)atoi(argv[++idx]), 1u);
+        } else if (strcmp(arg, "--max-output") == 0 && idx + 1 < argc) {
+            options->maxOutputMpix = atof(argv[++idx]);
+        } else if (strcmp(arg, "--half") == 0) {
+            options->half = true;
+        } else if (strcmp(arg, "--quality") == 0) {
+            options->quality = true;
+        } else if (strcmp(arg, "--dirty") == 0 && idx + 1 < argc) {
+            options->dirtyFraction = (float)atof(argv[++idx]);
+            ok = options->dirtyFraction > 0.0f && options->dirtyFraction <= 1.0f;
+        } else if (strcmp(arg, "--verify") == 0) {
+            options->verify = true;
+        } else if (strcmp(arg, "--tolerance") == 0 && idx + 1 < argc) {
+            options->tolerance = atof(argv[++idx]);
+        } else if (strcmp(arg, "--json") == 0 && idx + 1 < argc) {
+            options->jsonPath = argv[++idx];
+        } else if (strcmp(arg, "--compare") == 0 && idx + 1 < argc) {
+            options->comparePath = argv[++idx];
+        } else if (strcmp(arg, "--threshold") == 0 && idx + 1 < argc) {
+            options->threshold = atof(argv[++idx]);
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            printUsage(argv[0]);
+            return false;
+        }
+    }
+
+    if (options->sources.empty()) {
+        for (const Source& source : sources) {
+            options->sources.push_back(&source);
+        }
+    }
+    if (options->scales.empty()) {
+        options->scales = { 1.3f, 1.5f, 1.7f, 2.0f, 4.0f };
+    }
+    if (options->backends.empty()) {
+        for (uint32_t backend = 0; backend < (uint32_t)Backend::Count; backend++) {
+            options->backends.push_back((Backend)backend);
+        }
+    }
+    options->maxIterations = std::max(options->maxIterations, options->minIterations);
+    return true;
+}
+
+static double nsPerPixel(const BenchResult& result) {
+    return result.medianMs * 1e6 / ((double)result.output.width * result.output.height);
+}
+
+// JSON string contents, the GL strings could have anything in them.
+static std::string jsonEscape(const char* text) {
+    std::string out;
+    for (; text && *text; text++) {
+        if (*text == '"' || *text == '\\') {
+            out += '\\';
+        }
+        out += (unsigned char)*text < 0x20 ? ' ' : *text;
+    }
+    return out;
+}
+
+static bool writeJson(const std::string& filename, const std::vector<BenchResult>& results, const std::string& glRenderer,
+                      const std::string& glVersion, bool glHalf, uint32_t threads) {
+    FILE* fp = fopen(filename.c_str(), "w");
+    if (fp == NULL) {
+        printf("Unable to open: %s\n", filename.c_str());
+        return false;
+    }
+
+    fprintf(fp, "{\n  \"schema\": 1,\n");
+    fprintf(fp, "  \"machine\": {\"cpu_kernel\": \"%s\", \"threads\": %u, \"gl_renderer\": \"%s\", \"gl_version\": \"%s\", \"gl_half\": %s},\n",
+            getFSRCpuKernelName(getFSRCpuKernel()), threads, jsonEscape(glRenderer.c_str()).c_str(), jsonEscape(glVersion.c_str()).c_str(),
+            glHalf ? "true" : "false");
+    fprintf(fp, "  \"results\": [");
+    // one result per line, readBaseline relies on it
+    const char* separator = "\n";
+    for (const BenchResult& result : results) {
+        fprintf(fp, "%s    {\"id\": \"%s\", \"backend\": \"%s\", \"source\": \"%s\", \"scale\": %.2f, \"input\": [%u, %u], \"output\": [%u, %u]",
+                separator, result.id.c_str(), backendName(result.backend), result.source->name, result.scale,
+                result.source->size.width, result.source->size.height, result.output.width, result.output.height);
+        if (!result.skipped.empty()) {
+            fprintf(fp, ", \"skipped\": \"%s\"}", result.skipped.c_str());
+        } else {
+            const double seconds = result.medianMs / 1000.0;
+            const double outputPixels = (double)result.output.width * result.output.height;
+            fprintf(fp, ", \"iterations\": %u, \"median_ms\": %.4f, \"min_ms\": %.4f, \"mpix_per_s\": %.2f, \"ns_per_pixel\": %.4f, \"gb_per_s\": %.3f",
+                    result.iterations, result.medianMs, result.minMs, outputPixels / 1e6 / seconds, nsPerPixel(result),
+                    result.bytesPerFrame / 1e9 / seconds);
+            if (result.hasQuality) {
+                fprintf(fp, ", \"psnr\": %.4f, \"ssim\": %.6f, \"ms_ssim\": %.6f", result.quality.psnr, result.quality.ssim, result.quality.msssim);
+            }
+            if (result.backend == Backend::GLDirty) {
+                fprintf(fp, ", \"dirty_coverage\": %.4f, \"dirty_mismatches\": %u", result.dirtyCoverage, result.dirtyMismatches);
+            }
+            if (isGL(result.backend)) {
+                fprintf(fp, ", \"gpu_avg_ms\": {");
+                const char* passSeparator = "";
+                for (uint32_t pass = 0; pass < (uint32_t)GpuPass::Count; pass++) {
+                    if (result.passes[pass].samples) {
+                        fprintf(fp, "%s\"%s\": %.4f", passSeparator, getGpuPassName((GpuPass)pass), result.passes[pass].avgMs);
+                        passSeparator = ", ";
+                    }
+                }
+                fprintf(fp, "}");
+            }
+            fprintf(fp, "}");
+        }
+        separator = ",\n";
+    }
+    fprintf(fp, "\n  ]\n}\n");
+
+    if (fclose(fp) != 0) {
+        printf("Unable to write: %s\n", filename.c_str());
+        return false;
+    }
+    return true;
+}
+
+// id -> ns_per_pixel of the cases which ran, from a file written by writeJson.
+static bool readBaseline(const std::string& filename, std::map<std::string, double>* baseline) {
+    FILE* fp = fopen(filename.c_str(), "r");
+    if (fp == NULL) {
+        printf("Unable to open: %s\n", filename.c_str());
+        return false;
+    }
+    char line[4096];
+    while (fgets(line, sizeof(line), fp)) {
+        const char* id = strstr(line, "\"id\": \"");
+        const char* ns = strstr(line, "\"ns_per_pixel\": ");
+        if (!id || !ns) {
+            continue;
+        }
+        id += strlen("\"id\": \"");
+        const char* idEnd = strchr(id, '"');
+        if (idEnd) {
+            (*baseline)[std::string(id, idEnd)] = atof(ns + strlen("\"ns_per_pixel\": "));
+        }
+    }
+    fclose(fp);
+    return true;
+}
+
+int main(int argc, char** argv) {
+    BenchOptions options;
+    if (!parseOptions(argc, argv, &options)) {
+        return -1;
+    }
+
+    bool wantGL = options.verify;
+    for (Backend backend : options.backends) {
+        wantGL |= isGL(backend);
+    }
+    GLBackends gl;
+    bool glOk = false;
+    std::string glRenderer, glVersion;
+    if (wantGL) {
+        glOk = gl.init(options.half);
+        if (glOk) {
+            glRenderer = gl.renderer();
+            glVersion = gl.version();
+        }
+    }
+    ThreadPool pool;
+    printf("GL: %s, CPU: %s kernels, %u threads\n", glOk ? glRenderer.c_str() : "not used", getFSRCpuKernelName(getFSRCpuKernel()),
+           pool.threadCount());
+    if (options.verify) {
+        return runVerify(options, pool, glOk ? &gl : nullptr) ? 4 : 0;
+    }
+
+    std::vector<BenchResult> results;
+    uint32_t mismatches = 0;
+    printf("%-28s %12s %8s %10s %10s %10s %10s", "case", "output", "iters", "ms/frame", "Mpix/s", "ns/pixel", "GB/s");
+    printf(options.quality ? " %8s %8s %8s\n" : "\n", "PSNR", "SSIM", "MS-SSIM");
+    for (const Source* source : options.sources) {
+        const std::vector<uint8_t> pixels = makeSource(source->size);
+        for (float scale : options.scales) {
+            FSRConstants fsrData = {};
+            fsrData.input = source->size;
+            fsrData.output = { (uint32_t)(source->size.width * scale), (uint32_t)(source->size.height * scale) };
+            prepareFSR(&fsrData, 0.25f);
+
+            const double outputMpix = (double)fsrData.output.width * fsrData.output.height / 1e6;
+            std::unique_ptr<QualityCase> quality;
+            if (options.quality && outputMpix <= options.maxOutputMpix) {
+                quality.reset(new QualityCase());
+                quality->pool = &pool;
+                quality->reference = makeSource(fsrData.output);
+                quality->input.resize(pixels.size());
+                downscaleRGBA8(pool, quality->reference.data(), fsrData.output, quality->input.data(), fsrData.input);
+            }
+
+            for (Backend backend : options.backends) {
+                BenchResult result;
+                char id[64];
+                snprintf(id, sizeof(id), "%s/%s/x%.2f", backendName(backend), source->name, scale);
+                result.id = id;
+                result.source = source;
+                result.scale = scale;
+                result.backend = backend;
+                result.output = fsrData.output;
+
+                if (outputMpix > options.maxOutputMpix) {
+                    result.skipped = "output over --max-output";
+                } else if (isGL(backend) && !glOk) {
+                    result.skipped = "no GL context";
+                } else if (backend == Backend::GLDirty && !gl.hasTiles()) {
+                    result.skipped = "no tile list programs";
+                } else if (isGL(backend)) {
+                    gl.run(options, pixels, fsrData, quality.get(), &result);
+                } else {
+                    runCpu(options, pool, pixels, fsrData, quality.get(), &result);
+                }
+
+                char output[32];
+                snprintf(output, sizeof(output), "%ux%u", result.output.width, result.output.height);
+                if (!result.skipped.empty()) {
+                    printf("%-28s %12s skipped, %s\n", id, output, result.skipped.c_str());
+                } else {
+                    const double seconds = result.medianMs / 1000.0;
+                    printf("%-28s %12s %8u %10.3f %10.1f %10.3f %10.2f", id, output, result.iterations, result.medianMs,
+                           outputMpix / seconds, nsPerPixel(result), result.bytesPerFrame / 1e9 / seconds);
+                    if (result.hasQuality) {
+                        printf(" %8.2f %8.4f %8.4f", result.quality.psnr, result.quality.ssim, result.quality.msssim);
+                    }
+                    if (backend == Backend::GLDirty) {
+                        printf("  %.1f%% of the tiles", result.dirtyCoverage * 100.0);
+                    }
+                    printf("\n");
+                    if (result.dirtyMismatches) {
+                        printf("Mismatch: %s differs from a full run in %u pixels\n", id, result.dirtyMismatches);
+                        mismatches++;
+                    }
+                }
+                results.push_back(result);
+            }
+        }
+    }
+
+    if (!options.jsonPath.empty() &&
+        !writeJson(options.jsonPath, results, glRenderer, glVersion, glOk && gl.half(), pool.threadCount())) {
+        return 1;
+    }
+    if (mismatches) {
+        return 3;
+    }
+
+    if (options.comparePath.empty()) {
+        return 0;
+    }
+    std::map<std::string, double> baseline;
+    if (!readBaseline(options.comparePath, &baseline)) {
+        return 1;
+    }
+    uint32_t regressions = 0, compared = 0;
+    for (const BenchResult& result : results) {
+        auto found = baseline.find(result.id);
+        if (!result.skipped.empty() || found == baseline.end() || found->second <= 0.0) {
+            continue;
+        }
+        compared++;
+        const double change = (nsPerPixel(result) / found->second - 1.0) * 100.0;
+        if (change > options.threshold) {
+            printf("Regression: %s %.3f -> %.3f ns/pixel (%+.1f%%)\n", result.id.c_str(), found->second, nsPerPixel(result), change);
+            regressions++;
+        }
+    }
+    printf("Compared %u cases with %s: %u slower by more than %.1f%%\n", compared, options.comparePath.c_str(), regressions,
+           options.threshold);
+    return regressions ? 2 : 0;
+}
@@ -0,0 +1,475 @@
+#include "fsr_cpu.h"
+#include "fsr_cpu_internal.h"
+
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#if FSR_CPU_X86
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+#define A_CPU
+#include "ffx_a.h"
+#include "ffx_fsr1.h"
+
+// ffx_a.h only provides these approximations for the GPU, these are the same bit tricks on the CPU.
+A_STATIC AF1 AF1_AU1(AU1 a){union{AU1 u;AF1 f;}bits;bits.u=a;return bits.f;}
+A_STATIC AF1 APrxLoRcpF1(AF1 a){return AF1_AU1(AU1_(0x7ef07ebb)-AU1_AF1(a));}
+A_STATIC AF1 APrxLoRsqF1(AF1 a){return AF1_AU1(AU1_(0x5f347d74)-(AU1_AF1(a)>>AU1_(1)));}
+A_STATIC AF1 APrxMedRcpF1(AF1 a){AF1 b=AF1_AU1(AU1_(0x7ef19fff)-AU1_AF1(a));return b*(-b*a+AF1_(2.0));}
+A_STATIC AF1 AMax3F1(AF1 x,AF1 y,AF1 z){return AMaxF1(x,AMaxF1(y,z));}
+A_STATIC AF1 AMin3F1(AF1 x,AF1 y,AF1 z){return AMinF1(x,AMinF1(y,z));}
+
+namespace {
+
+// UNORM to float conversion as done by Mesa when sampling the GL_RGBA8 input texture (multiply by 1/255).
+// The vector kernels do the same, EASU turns 1 ulp luma differences into edges so this has to match.
+struct Unorm8Table {
+    AF1 value[256];
+
+    Unorm8Table() {
+        for (int i = 0; i < 256; i++) {
+            value[i] = AF1_(i) * AF1_(1.0 / 255.0);
+        }
+    }
+};
+
+static const Unorm8Table unorm8;
+
+// Texel fetch with GL_CLAMP_TO_EDGE addressing, the same as the textureGather in the shader.
+static inline void loadTexel(const uint8_t* input, const Extent& extent, ASU1 x, ASU1 y, AF1 rgb[3]) {
+    x = x < 0 ? 0 : (x >= (ASU1)extent.width ? (ASU1)extent.width - 1 : x);
+    y = y < 0 ? 0 : (y >= (ASU1)extent.height ? (ASU1)extent.height - 1 : y);
+
+    const uint8_t* texel = input + ((size_t)y * extent.width + (size_t)x) * 4;
+    rgb[0] = unorm8.value[texel[0]];
+    rgb[1] = unorm8.value[texel[1]];
+    rgb[2] = unorm8.value[texel[2]];
+}
+
+// Filtering for a given tap, port of FsrEasuTapF.
+static inline void easuTap(
+    AF1 aC[3], AF1& aW,
+    AF1 offX, AF1 offY,
+    const AF1 dir[2],
+    const AF1 len[2],
+    AF1 lob,
+    AF1 clp,
+    const AF1 c[3]) {
+    // Rotate offset by direction.
+    AF1 vX = (offX * (dir[0])) + (offY * dir[1]);
+    AF1 vY = (offX * (-dir[1])) + (offY * dir[0]);
+    // Anisotropy.
+    vX *= len[0];
+    vY *= len[1];
+    // Compute distance^2.
+    AF1 d2 = vX * vX + vY * vY;
+    // Limit to the window as at corner, 2 taps can easily be outside.
+    d2 = AMinF1(d2, clp);
+    // Approximation of lancos2 without sin() or rcp(), or sqrt() to get x.
+    AF1 wB = AF1_(2.0 / 5.0) * d2 + AF1_(-1.0);
+    AF1 wA = lob * d2 + AF1_(-1.0);
+    wB *= wB;
+    wA *= wA;
+    wB = AF1_(25.0 / 16.0) * wB + AF1_(-(25.0 / 16.0 - 1.0));
+    AF1 w = wB * wA;
+    // Do weighted average.
+    aC[0] += c[0] * w;
+    aC[1] += c[1] * w;
+    aC[2] += c[2] * w;
+    aW += w;
+}
+
+// Accumulate direction and length, port of FsrEasuSetF with the bilinear weight passed in.
+static inline void easuSet(
+    AF1 dir[2], AF1& len,
+    AF1 w,
+    AF1 lA, AF1 lB, AF1 lC, AF1 lD, AF1 lE) {
+    AF1 dc = lD - lC;
+    AF1 cb = lC - lB;
+    AF1 lenX = AMaxF1(AAbsF1(dc), AAbsF1(cb));
+    lenX = APrxLoRcpF1(lenX);
+    AF1 dirX = lD - lB;
+    dir[0] += dirX * w;
+    lenX = ASatF1(AAbsF1(dirX) * lenX);
+    lenX *= lenX;
+    len += lenX * w;
+    // Repeat for the y axis.
+    AF1 ec = lE - lC;
+    AF1 ca = lC - lA;
+    AF1 lenY = AMaxF1(AAbsF1(ec), AAbsF1(ca));
+    lenY = APrxLoRcpF1(lenY);
+    AF1 dirY = lE - lA;
+    dir[1] += dirY * w;
+    lenY = ASatF1(AAbsF1(dirY) * lenY);
+    lenY *= lenY;
+    len += lenY * w;
+}
+
+static inline AF1 easuLuma(const AF1 c[3]) {
+    // Simplest multi-channel approximate luma possible (luma times 2, in 2 FMA/MAD).
+    return c[2] * AF1_(0.5) + (c[0] * AF1_(0.5) + c[1]);
+}
+
+// Port of FsrEasuF, the gathers are replaced by direct texel fetches of the 12-tap kernel:
+//    b c
+//  e f g h
+//  i j k l
+//    n o
+static void easuPixel(const EasuCpuConstants& con, const uint8_t* input, const Extent& extent, AU1 ipX, AU1 ipY, AF1 pix[3]) {
+    // Get position of 'f'.
+    AF1 ppX = AF1_(ipX) * con.con0[0] + con.con0[2];
+    AF1 ppY = AF1_(ipY) * con.con0[1] + con.con0[3];
+    AF1 fpX = AFloorF1(ppX);
+    AF1 fpY = AFloorF1(ppY);
+    ppX -= fpX;
+    ppY -= fpY;
+
+    ASU1 fx = (ASU1)fpX;
+    ASU1 fy = (ASU1)fpY;
+
+    AF1 b[3], c[3], e[3], f[3], g[3], h[3], i[3], j[3], k[3], l[3], n[3], o[3];
+    loadTexel(input, extent, fx    , fy - 1, b);
+    loadTexel(input, extent, fx + 1, fy - 1, c);
+    loadTexel(input, extent, fx - 1, fy    , e);
+    loadTexel(input, extent, fx    , fy    , f);
+    loadTexel(input, extent, fx + 1, fy    , g);
+    loadTexel(input, extent, fx + 2, fy    , h);
+    loadTexel(input, extent, fx - 1, fy + 1, i);
+    loadTexel(input, extent, fx    , fy + 1, j);
+    loadTexel(input, extent, fx + 1, fy + 1, k);
+    loadTexel(input, extent, fx + 2, fy + 1, l);
+    loadTexel(input, extent, fx    , fy + 2, n);
+    loadTexel(input, extent, fx + 1, fy + 2, o);
+
+    AF1 bL = easuLuma(b);
+    AF1 cL = easuLuma(c);
+    AF1 iL = easuLuma(i);
+    AF1 jL = easuLuma(j);
+    AF1 fL = easuLuma(f);
+    AF1 eL = easuLuma(e);
+    AF1 kL = easuLuma(k);
+    AF1 lL = easuLuma(l);
+    AF1 hL = easuLuma(h);
+    AF1 gL = easuLuma(g);
+    AF1 oL = easuLuma(o);
+    AF1 nL = easuLuma(n);
+
+    // Accumulate for bilinear interpolation.
+    //  s t
+    //  u v
+    AF1 dir[2] = { AF1_(0.0), AF1_(0.0) };
+    AF1 len = AF1_(0.0);
+    easuSet(dir, len, (AF1_(1.0) - ppX) * (AF1_(1.0) - ppY), bL, eL, fL, gL, jL);
+    easuSet(dir, len,              ppX  * (AF1_(1.0) - ppY), cL, fL, gL, hL, kL);
+    easuSet(dir, len, (AF1_(1.0) - ppX) *              ppY , fL, iL, jL, kL, nL);
+    easuSet(dir, len,              ppX  *              ppY , gL, jL, kL, lL, oL);
+
+    // Normalize with approximation, and cleanup close to zero.
+    AF1 dirR = dir[0] * dir[0] + dir[1] * dir[1];
+    AP1 zro = dirR < AF1_(1.0 / 32768.0);
+    dirR = APrxLoRsqF1(dirR);
+    dirR = zro ? AF1_(1.0) : dirR;
+    dir[0] = zro ? AF1_(1.0) : dir[0];
+    dir[0] *= dirR;
+    dir[1] *= dirR;
+    // Transform from {0 to 2} to {0 to 1} range, and shape with square.
+    len = len * AF1_(0.5);
+    len *= len;
+    // Stretch kernel {1.0 vert|horz, to sqrt(2.0) on diagonal}.
+    AF1 stretch = (dir[0] * dir[0] + dir[1] * dir[1]) * APrxLoRcpF1(AMaxF1(AAbsF1(dir[0]), AAbsF1(dir[1])));
+    // Anisotropic length after rotation,
+    //  x := 1.0 lerp to 'stretch' on edges
+    //  y := 1.0 lerp to 2x on edges
+    AF1 len2[2] = { AF1_(1.0) + (stretch - AF1_(1.0)) * len, AF1_(1.0) + AF1_(-0.5) * len };
+    // Based on the amount of 'edge',
+    // the window shifts from +/-{sqrt(2.0) to slightly beyond 2.0}.
+    AF1 lob = AF1_(0.5) + AF1_((1.0 / 4.0 - 0.04) - 0.5) * len;
+    // Set distance^2 clipping point to the end of the adjustable window.
+    AF1 clp = APrxLoRcpF1(lob);
+
+    // Accumulation mixed with min/max of 4 nearest.
+    AF1 min4[3], max4[3];
+    for (int ch = 0; ch < 3; ch++) {
+        min4[ch] = AMinF1(AMinF1(f[ch], AMinF1(g[ch], j[ch])), k[ch]);
+        max4[ch] = AMaxF1(AMaxF1(f[ch], AMaxF1(g[ch], j[ch])), k[ch]);
+    }
+
+    // Accumulation.
+    AF1 aC[3] = { AF1_(0.0), AF1_(0.0), AF1_(0.0) };
+    AF1 aW = AF1_(0.0);
+    easuTap(aC, aW, AF1_( 0.0) - ppX, AF1_(-1.0) - ppY, dir, len2, lob, clp, b);
+    easuTap(aC, aW, AF1_( 1.0) - ppX, AF1_(-1.0) - ppY, dir, len2, lob, clp, c);
+    easuTap(aC, aW, AF1_(-1.0) - ppX, AF1_( 1.0) - ppY, dir, len2, lob, clp, i);
+    easuTap(aC, aW, AF1_( 0.0) - ppX, AF1_( 1.0) - ppY, dir, len2, lob, clp, j);
+    easuTap(aC, aW, AF1_( 0.0) - ppX, AF1_( 0.0) - ppY, dir, len2, lob, clp, f);
+    easuTap(aC, aW, AF1_(-1.0) - ppX, AF1_( 0.0) - ppY, dir, len2, lob, clp, e);
+    easuTap(aC, aW, AF1_( 1.0) - ppX, AF1_( 1.0) - ppY, dir, len2, lob, clp, k);
+    easuTap(aC, aW, AF1_( 2.0) - ppX, AF1_( 1.0) - ppY, dir, len2, lob, clp, l);
+    easuTap(aC, aW, AF1_( 2.0) - ppX, AF1_( 0.0) - ppY, dir, len2, lob, clp, h);
+    easuTap(aC, aW, AF1_( 1.0) - ppX, AF1_( 0.0) - ppY, dir, len2, lob, clp, g);
+    easuTap(aC, aW, AF1_( 1.0) - ppX, AF1_( 2.0) - ppY, dir, len2, lob, clp, o);
+    easuTap(aC, aW, AF1_( 0.0) - ppX, AF1_( 2.0) - ppY, dir, len2, lob, clp, n);
+
+    // Normalize and dering.
+    AF1 rcpW = ARcpF1(aW);
+    for (int ch = 0; ch < 3; ch++) {
+        pix[ch] = AMinF1(max4[ch], AMaxF1(min4[ch], aC[ch] * rcpW));
+    }
+}
+
+// Pixel fetch of the RGBA32F EASU output. texelFetch outside of the image is undefined in GL, clamp to the edge.
+static inline const AF1* loadPixel(const float* input, const Extent& extent, ASU1 x, ASU1 y) {
+    x = x < 0 ? 0 : (x >= (ASU1)extent.width ? (ASU1)extent.width - 1 : x);
+    y = y < 0 ? 0 : (y >= (ASU1)extent.height ? (ASU1)extent.height - 1 : y);
+
+    return input + ((size_t)y * extent.width + (size_t)x) * 4;
+}
+
+// Port of FsrRcasF, without the optional denoise and passthrough alpha.
+// Algorithm uses minimal 3x3 pixel neighborhood.
+//    b
+//  d e f
+//    h
+static void rcasPixel(const RcasCpuConstants& con, const float* input, const Extent& extent, ASU1 x, ASU1 y, AF1 pix[3]) {
+    const AF1* b = loadPixel(input, extent, x, y - 1);
+    const AF1* d = loadPixel(input, extent, x - 1, y);
+    const AF1* e = loadPixel(input, extent, x, y);
+    const AF1* f = loadPixel(input, extent, x + 1, y);
+    const AF1* h = loadPixel(input, extent, x, y + 1);
+
+    // Min and max of ring.
+    AF1 mn4[3], mx4[3];
+    for (int ch = 0; ch < 3; ch++) {
+        mn4[ch] = AMinF1(AMin3F1(b[ch], d[ch], f[ch]), h[ch]);
+        mx4[ch] = AMaxF1(AMax3F1(b[ch], d[ch], f[ch]), h[ch]);
+    }
+    // Immediate constants for peak range.
+    const AF1 peakC[2] = { AF1_(1.0), AF1_(-1.0 * 4.0) };
+    // Limiters, these need to be high precision RCPs.
+    AF1 lobeC[3];
+    for (int ch = 0; ch < 3; ch++) {
+        AF1 hitMin = AMinF1(mn4[ch], e[ch]) * ARcpF1(AF1_(4.0) * mx4[ch]);
+        AF1 hitMax = (peakC[0] - AMaxF1(mx4[ch], e[ch])) * ARcpF1(AF1_(4.0) * mn4[ch] + peakC[1]);
+        // A channel flat at 0 or 1 makes hitMin or hitMax 0 * rcp(0), a NaN. GPU max() returns the other
+        // operand then, AMaxF1 the second one: drop the NaN like the shader does on the GPU.
+        lobeC[ch] = hitMax == hitMax ? AMaxF1(-hitMin, hitMax) : -hitMin;
+    }
+    AF1 lobe = AMaxF1(AF1_(-FSR_RCAS_LIMIT), AMinF1(AMax3F1(lobeC[0], lobeC[1], lobeC[2]), AF1_(0.0))) * con.sharpness;
+    // Resolve, which needs the medium precision rcp approximation to avoid visible tonality changes.
+    AF1 rcpL = APrxMedRcpF1(AF1_(4.0) * lobe + AF1_(1.0));
+    for (int ch = 0; ch < 3; ch++) {
+        pix[ch] = (lobe * b[ch] + lobe * d[ch] + lobe * h[ch] + lobe * f[ch] + e[ch]) * rcpL;
+    }
+}
+
+} // namespace
+
+void easuSpanScalar(const EasuCpuConstants& con, const uint8_t* input, const Extent& extent,
+                    uint32_t y, uint32_t x0, uint32_t x1, float* output) {
+    for (uint32_t x = x0; x < x1; x++) {
+        float* pixel = output + (size_t)(x - x0) * 4;
+        easuPixel(con, input, extent, x, y, pixel);
+        pixel[3] = 1.0f;
+    }
+}
+
+void rcasSpanScalar(const RcasCpuConstants& con, const float* input, const Extent& extent,
+                    uint32_t y, uint32_t x0, uint32_t x1, float* output) {
+    for (uint32_t x = x0; x < x1; x++) {
+        float* pixel = output + (size_t)(x - x0) * 4;
+        rcasPixel(con, input, extent, x, y, pixel);
+        pixel[3] = 1.0f;
+    }
+}
+
+#if FSR_CPU_X86
+static void cpuid(uint32_t leaf, uint32_t subleaf, uint32_t regs[4]) {
+#if defined(_MSC_VER)
+    __cpuidex((int*)regs, (int)leaf, (int)subleaf);
+#else
+    __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+static uint64_t xgetbv0() {
+#if defined(_MSC_VER)
+    return _xgetbv(0);
+#else
+    uint32_t eax, edx;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return ((uint64_t)edx << 32) | eax;
+#endif
+}
+#endif
+
+static bool isKernelSupported(FSRCpuKernel kernel) {
+    if (kernel == FSRCpuKernel::Scalar) {
+        return true;
+    }
+#if FSR_CPU_X86
+    uint32_t regs[4];
+    cpuid(0, 0, regs);
+    const uint32_t maxLeaf = regs[0];
+
+    cpuid(1, 0, regs);
+    const bool sse41 = (regs[2] & (1u << 19)) != 0;
+    const bool fma = (regs[2] & (1u << 12)) != 0;
+    const bool osxsave = (regs[2] & (1u << 27)) != 0;
+    // The OS has to save the YMM registers on context switches.
+    const bool osAVX = osxsave && (xgetbv0() & 0x6) == 0x6;
+
+    // And the opmask and upper ZMM state for AVX-512.
+    const bool osAVX512 = osAVX && (xgetbv0() & 0xe0) == 0xe0;
+
+    bool avx2 = false;
+    bool avx512 = false;
+    bool avx512fp16 = false;
+    if (maxLeaf >= 7) {
+        cpuid(7, 0, regs);
+        avx2 = (regs[1] & (1u << 5)) != 0;
+        avx512 = (regs[1] & (1u << 16)) != 0 && (regs[1] & (1u << 30)) != 0; // F and BW
+        // FP16 (EDX 23) with the DQ and VL it is built with
+        avx512fp16 = avx512 && (regs[3] & (1u << 23)) != 0 && (regs[1] & (1u << 17)) != 0 && (regs[1] & (1u << 31)) != 0;
+    }
+
+    switch (kernel) {
+        case FSRCpuKernel::SSE41: return sse41;
+        case FSRCpuKernel::AVX2: return osAVX && avx2 && fma;
+        case FSRCpuKernel::AVX512: return osAVX512 && avx512;
+        case FSRCpuKernel::AVX512FP16: return osAVX512 && avx512fp16;
+        default: return false;
+    }
+#else
+    return false;
+#endif
+}
+
+static FSRCpuKernel detectKernel() {
+    const FSRCpuKernel candidates[] = { FSRCpuKernel::AVX512, FSRCpuKernel::AVX2, FSRCpuKernel::SSE41 };
+    for (FSRCpuKernel kernel : candidates) {
+        if (isKernelSupported(kernel)) {
+            return kernel;
+        }
+    }
+    return FSRCpuKernel::Scalar;
+}
+
+static EasuSpanFn easuSpanFor(FSRCpuKernel kernel) {
+    switch (kernel) {
+#if FSR_CPU_X86
+        case FSRCpuKernel::SSE41: return easuSpanSSE41;
+        case FSRCpuKernel::AVX2: return easuSpanAVX2;
+        case FSRCpuKernel::AVX512: return easuSpanAVX512;
+        case FSRCpuKernel::AVX512FP16: return easuSpanAVX512;
+#endif
+        default: return easuSpanScalar;
+    }
+}
+
+static RcasSpanFn rcasSpanFor(FSRCpuKernel kernel) {
+    switch (kernel) {
+#if FSR_CPU_X86
+        case FSRCpuKernel::SSE41: return rcasSpanSSE41;
+        case FSRCpuKernel::AVX2: return rcasSpanAVX2;
+        case FSRCpuKernel::AVX512: return rcasSpanAVX512;
+        case FSRCpuKernel::AVX512FP16: return rcasSpanAVX512FP16;
+#endif
+        default: return rcasSpanScalar;
+    }
+}
+
+static std::atomic<FSRCpuKernel> activeKernel(detectKernel());
+
+void setFSRCpuKernel(FSRCpuKernel kernel) {
+    if (kernel == FSRCpuKernel::Auto) {
+        kernel = detectKernel();
+    } else if (!isKernelSupported(kernel)) {
+        printf("CPU kernel %s is not supported, using %s\n", getFSRCpuKernelName(kernel), getFSRCpuKernelName(detectKernel()));
+        kernel = detectKernel();
+    }
+    activeKernel = kernel;
+}
+
+FSRCpuKernel getFSRCpuKernel() {
+    return activeKernel;
+}
+
+EasuSpanFn activeEasuSpan() {
+    return easuSpanFor(activeKernel);
+}
+
+RcasSpanFn activeRcasSpan() {
+    return rcasSpanFor(activeKernel);
+}
+
+size_t getFSRCpuL2CacheSize() {
+#if FSR_CPU_X86
+    // Extended leaf 0x80000006 reports the per core L2 in KiB on both Intel and AMD.
+    uint32_t regs[4];
+    cpuid(0x80000000, 0, regs);
+    if (regs[0] >= 0x80000006) {
+        cpuid(0x80000006, 0, regs);
+        const size_t size = (size_t)(regs[2] >> 16) * 1024;
+        if (size != 0) {
+            return size;
+        }
+    }
+#endif
+    return 256 * 1024;
+}
+
+const char* getFSRCpuKernelName(FSRCpuKernel kernel) {
+    switch (kernel) {
+        case FSRCpuKernel::Auto: return "auto";
+        case FSRCpuKernel::Scalar: return "scalar";
+        case FSRCpuKernel::SSE41: return "sse4.1";
+        case FSRCpuKernel::AVX2: return "avx2";
+        case FSRCpuKernel::AVX512: return "avx512";
+        case FSRCpuKernel::AVX512FP16: return "avx512fp16";
+    }
+    return "unknown";
+}
+
+
+void runEASUCpuSpan(const FSRConstants& fsrData, const uint8_t* input, uint32_t y, uint32_t x0, uint32_t x1, float* output) {
+    const EasuCpuConstants con = unpackEasuConstants(fsrData);
+    easuSpanFor(activeKernel)(con, input, fsrData.input, y, x0, x1, output);
+}
+
+void runEASUCpu(const FSRConstants& fsrData, const uint8_t* input, float* output) {
+    const EasuCpuConstants con = unpackEasuConstants(fsrData);
+    const EasuSpanFn span = easuSpanFor(activeKernel);
+
+    for (uint32_t y = 0; y < fsrData.output.height; y++) {
+        float* row = output + (size_t)y * fsrData.output.width * 4;
+        span(con, input, fsrData.input, y, 0, fsrData.output.width, row);
+    }
+}
+
+void runRCASCpuSpan(const FSRConstants& fsrData, const float* input, uint32_t y, uint32_t x0, uint32_t x1, float* output) {
+    const RcasCpuConstants con = unpackRcasConstants(fsrData);
+    rcasSpanFor(activeKernel)(con, input, fsrData.output, y, x0, x1, output);
+}
+
+void runRCASCpu(const FSRConstants& fsrData, const float* input, float* output) {
+    const RcasCpuConstants con = unpackRcasConstants(fsrData);
+    const RcasSpanFn span = rcasSpanFor(activeKernel);
+
+    for (uint32_t y = 0; y < fsrData.output.height; y++) {
+        float* row = output + (size_t)y * fsrData.output.width * 4;
+        span(con, input, fsrData.output, y, 0, fsrData.output.width, row);
+    }
+}
+
+void runFSRCpu(const FSRConstants& fsrData, const uint8_t* input, float* output) {
+    std::vector<float> easuOutput((size_t)fsrData.output.width * fsrData.output.height * 4);
+    runEASUCpu(fsrData, input, easuOutput.data());
+    runRCASCpu(fsrData, easuOutput.data(), output);
+}
@@ -0,0 +1,94 @@
+#ifndef FSR_CPU_H
+#define FSR_CPU_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "image_utils.h"
+
+class ThreadPool;
+
+// CPU implementation of the FSR passes, usable without any GL context.
+//
+// Images are tightly packed, row-major with the top row first:
+//  - the input is RGBA8, the same data LoadTextureFromFile uploads (stbi_load with 4 components),
+//  - the output is RGBA32F, the same format as the outputImage used by runFSR.
+// The constants are the ones filled in by prepareFSR, so the GL and CPU paths share a single FSRConstants.
+
+// Instruction set used by the CPU kernels. The default is picked at startup from CPUID,
+// Auto goes back to that choice, forcing an unsupported kernel falls back to it as well.
+enum class FSRCpuKernel {
+    Auto,
+    Scalar,
+    SSE41,  // 4 pixels per iteration
+    AVX2,   // 8 pixels per iteration, with FMA
+    AVX512, // 16 pixels per iteration, F and BW, masked edges and tails
+    // AVX512 EASU, RCAS in packed half precision with 32 pixels per iteration (FsrRcasHx2 on the CPU).
+    // Never picked by Auto as the result differs from the float kernels by up to a few LSB.
+    AVX512FP16,
+};
+
+void setFSRCpuKernel(FSRCpuKernel kernel);
+FSRCpuKernel getFSRCpuKernel();
+const char* getFSRCpuKernelName(FSRCpuKernel kernel);
+
+// Run EASU over the whole output extent.
+void runEASUCpu(const FSRConstants& fsrData, const uint8_t* input, float* output);
+
+// Run EASU for the output pixels [x0, x1) of row y, 'output' points to the RGBA32F pixel of x0.
+void runEASUCpuSpan(const FSRConstants& fsrData, const uint8_t* input, uint32_t y, uint32_t x0, uint32_t x1, float* output);
+
+// Run RCAS over the whole output extent, 'input' is the RGBA32F EASU result and must not alias 'output'.
+void runRCASCpu(const FSRConstants& fsrData, const float* input, float* output);
+
+// Run RCAS for the pixels [x0, x1) of row y, 'output' points to the RGBA32F pixel of x0.
+void runRCASCpuSpan(const FSRConstants& fsrData, const float* input, uint32_t y, uint32_t x0, uint32_t x1, float* output);
+
+// EASU followed by RCAS, the CPU equivalent of runFSR.
+void runFSRCpu(const FSRConstants& fsrData, const uint8_t* input, float* output);
+
+// Timing of one tile of runFSRCpuTiled.
+struct FSRCpuTileTiming {
+    uint32_t x;          // top left output pixel
+    uint32_t y;
+    uint32_t easuWorker; // ThreadPool worker which ran the tile in each pass
+    uint32_t rcasWorker;
+    float easuMs;
+    float rcasMs;
+};
+
+struct FSRCpuTileStats {
+    uint32_t tileSize;
+    uint32_t tilesX;
+    uint32_t tilesY;
+    uint32_t threads;
+    uint32_t steals;       // ranges stolen between workers, both passes
+    size_t footprintBytes; // working set of a single tile, see getFSRCpuTileFootprint
+    double easuMs;         // wall time of each pass, 0 for runFSRCpuFused which has a single one
+    double rcasMs;
+    double totalMs;        // wall time of the whole call
+    std::vector<FSRCpuTileTiming> tiles; // row-major, tilesX * tilesY entries
+};
+
+// EASU followed by RCAS on a thread pool, one task per tileSize x tileSize output tile.
+// The default of 16 is the threadGroupWorkRegionDim of the compute dispatch in runFSR.
+// A tileSize of 0 picks the largest of 16, 32, 64 and 128 whose footprint fits in half of the L2.
+// 'stats' is optional, the per tile timing is only measured when it is given.
+void runFSRCpuTiled(ThreadPool& pool, const FSRConstants& fsrData, const uint8_t* input, float* output,
+                    uint32_t tileSize = 16, FSRCpuTileStats* stats = nullptr);
+
+// Same as runFSRCpuTiled but EASU and RCAS run back to back per tile: EASU fills a per worker buffer
+// with the tile plus a 1 pixel apron and RCAS reads from there, so the full resolution EASU result is
+// never written to memory. The apron costs an extra 4 * (tileSize + 1) EASU pixels per tile.
+void runFSRCpuFused(ThreadPool& pool, const FSRConstants& fsrData, const uint8_t* input, float* output,
+                    uint32_t tileSize = 16, FSRCpuTileStats* stats = nullptr);
+
+// Bytes read and written by one tile in the larger of the two passes: the EASU input texels
+// (with the 12 tap apron) plus the RGBA32F output, or the RCAS input with its 1 pixel apron plus output.
+size_t getFSRCpuTileFootprint(const FSRConstants& fsrData, uint32_t tileSize);
+
+// Per core L2 size, 256 KiB when it can't be queried.
+size_t getFSRCpuL2CacheSize();
+
+#endif /* FSR_CPU_H */
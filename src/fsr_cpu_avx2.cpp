@@ -0,0 +1,133 @@
+// AVX2 + FMA kernels, this file is built with -mavx2 -mfma (/arch:AVX2) and only called after a CPUID check.
+#include "fsr_cpu_internal.h"
+
+#if FSR_CPU_X86
+
+#include <immintrin.h>
+
+#include "fsr_cpu_simd.h"
+
+namespace {
+
+struct AVX2 {
+    typedef __m256 F;
+    typedef __m256i I;
+    typedef __m256 M;
+    static const int width = 8;
+
+    static inline F set1(float a) { return _mm256_set1_ps(a); }
+    static inline I seti1(int32_t a) { return _mm256_set1_epi32(a); }
+    static inline F laneIndex() { return _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f); }
+
+    static inline F add(F a, F b) { return _mm256_add_ps(a, b); }
+    static inline F sub(F a, F b) { return _mm256_sub_ps(a, b); }
+    static inline F mul(F a, F b) { return _mm256_mul_ps(a, b); }
+    static inline F div(F a, F b) { return _mm256_div_ps(a, b); }
+    static inline F min(F a, F b) { return _mm256_min_ps(a, b); }
+    static inline F max(F a, F b) { return _mm256_max_ps(a, b); }
+    static inline F abs(F a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+    static inline F fmadd(F a, F b, F c) { return _mm256_fmadd_ps(a, b, c); }
+    static inline F fnmadd(F a, F b, F c) { return _mm256_fnmadd_ps(a, b, c); }
+
+    static inline F floor(F a) { return _mm256_floor_ps(a); }
+    static inline I toInt(F a) { return _mm256_cvttps_epi32(a); }
+    static inline I addi(I a, int32_t b) { return _mm256_add_epi32(a, _mm256_set1_epi32(b)); }
+    static inline I clampi(I a, I hi) { return _mm256_min_epi32(_mm256_max_epi32(a, _mm256_setzero_si256()), hi); }
+
+    // APrxLoRcpF1, APrxLoRsqF1 and APrxMedRcpF1.
+    static inline F rcpLo(F a) {
+        return _mm256_castsi256_ps(_mm256_sub_epi32(_mm256_set1_epi32(0x7ef07ebb), _mm256_castps_si256(a)));
+    }
+    static inline F rsqLo(F a) {
+        return _mm256_castsi256_ps(_mm256_sub_epi32(_mm256_set1_epi32(0x5f347d74), _mm256_srli_epi32(_mm256_castps_si256(a), 1)));
+    }
+    static inline F rcpMed(F a) {
+        F b = _mm256_castsi256_ps(_mm256_sub_epi32(_mm256_set1_epi32(0x7ef19fff), _mm256_castps_si256(a)));
+        return _mm256_mul_ps(b, _mm256_fnmadd_ps(b, a, _mm256_set1_ps(2.0f)));
+    }
+
+    static inline M lt(F a, F b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+    static inline F select(M m, F a, F b) { return _mm256_blendv_ps(b, a, m); }
+
+    static inline void loadRGB(const uint8_t* row, I x, F& r, F& g, F& b) {
+        const __m256i texels = _mm256_i32gather_epi32((const int*)row, x, 4);
+        const __m256i mask = _mm256_set1_epi32(0xff);
+        const __m256 scale = _mm256_set1_ps(1.0f / 255.0f);
+        r = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(texels, mask)), scale);
+        g = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(texels, 8), mask)), scale);
+        b = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(texels, 16), mask)), scale);
+    }
+
+    static inline const float* pixelAt(const float* row, int32_t x, int32_t width) {
+        return row + (size_t)(x < 0 ? 0 : (x >= width ? width - 1 : x)) * 4;
+    }
+
+    static inline void loadPixels(const float* row, int32_t x, int32_t width, F& r, F& g, F& b) {
+        // Pixels i and i + 4 share a vector, so the 4x4 transpose of each 128-bit half gives the channels in order.
+        __m256 p[4];
+        if (x >= 0 && x + 8 <= width) {
+            const float* src = row + (size_t)x * 4;
+            for (int i = 0; i < 4; i++) {
+                p[i] = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(src + i * 4)), _mm_loadu_ps(src + i * 4 + 16), 1);
+            }
+        } else {
+            for (int32_t i = 0; i < 4; i++) {
+                p[i] = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(pixelAt(row, x + i, width))),
+                                            _mm_loadu_ps(pixelAt(row, x + i + 4, width)), 1);
+            }
+        }
+        __m256 t0 = _mm256_unpacklo_ps(p[0], p[1]);
+        __m256 t1 = _mm256_unpacklo_ps(p[2], p[3]);
+        __m256 t2 = _mm256_unpackhi_ps(p[0], p[1]);
+        __m256 t3 = _mm256_unpackhi_ps(p[2], p[3]);
+        r = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(1, 0, 1, 0));
+        g = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(3, 2, 3, 2));
+        b = _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(1, 0, 1, 0));
+    }
+
+    static inline void storeRGBA(float* dst, F r, F g, F b, F a, uint32_t count) {
+        // 4x8 transpose into 8 RGBA pixels.
+        __m256 t0 = _mm256_unpacklo_ps(r, g);
+        __m256 t1 = _mm256_unpackhi_ps(r, g);
+        __m256 t2 = _mm256_unpacklo_ps(b, a);
+        __m256 t3 = _mm256_unpackhi_ps(b, a);
+        __m256 p04 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+        __m256 p15 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+        __m256 p26 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+        __m256 p37 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+        __m256 pixels[4] = {
+            _mm256_permute2f128_ps(p04, p15, 0x20),
+            _mm256_permute2f128_ps(p26, p37, 0x20),
+            _mm256_permute2f128_ps(p04, p15, 0x31),
+            _mm256_permute2f128_ps(p26, p37, 0x31),
+        };
+
+        if (count == 8) {
+            for (int i = 0; i < 4; i++) {
+                _mm256_storeu_ps(dst + i * 8, pixels[i]);
+            }
+            return;
+        }
+
+        // Tail of the row, every pixel is 4 floats so one 32-bit mask lane per float.
+        for (uint32_t i = 0; i < 4 && i * 2 < count; i++) {
+            const int32_t lanes = (int32_t)(count - i * 2) * 4;
+            const __m256i mask = _mm256_cmpgt_epi32(_mm256_set1_epi32(lanes), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+            _mm256_maskstore_ps(dst + i * 8, mask, pixels[i]);
+        }
+    }
+};
+
+} // namespace
+
+void easuSpanAVX2(const EasuCpuConstants& con, const uint8_t* input, const Extent& extent,
+                  uint32_t y, uint32_t x0, uint32_t x1, float* output) {
+    EasuKernel<AVX2>::span(con, input, extent, y, x0, x1, output);
+}
+
+void rcasSpanAVX2(const RcasCpuConstants& con, const float* input, const Extent& extent,
+                  uint32_t y, uint32_t x0, uint32_t x1, float* output) {
+    RcasKernel<AVX2>::span(con, input, extent, y, x0, x1, output);
+}
+
+#endif /* FSR_CPU_X86 */
@@ -0,0 +1,169 @@
+// AVX-512 F + BW kernels, this file is built with -mavx512f -mavx512bw (/arch:AVX512) and only called after a CPUID check.
+#include "fsr_cpu_internal.h"
+
+#if FSR_CPU_X86
+
+#include <immintrin.h>
+
+#include "fsr_cpu_simd.h"
+
+namespace {
+
+struct AVX512 {
+    typedef __m512 F;
+    typedef __m512i I;
+    typedef __mmask16 M;
+    static const int width = 16;
+
+    static inline F set1(float a) { return _mm512_set1_ps(a); }
+    static inline I seti1(int32_t a) { return _mm512_set1_epi32(a); }
+    static inline F laneIndex() {
+        return _mm512_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f,
+                              8.0f, 9.0f, 10.0f, 11.0f, 12.0f, 13.0f, 14.0f, 15.0f);
+    }
+
+    static inline F add(F a, F b) { return _mm512_add_ps(a, b); }
+    static inline F sub(F a, F b) { return _mm512_sub_ps(a, b); }
+    static inline F mul(F a, F b) { return _mm512_mul_ps(a, b); }
+    static inline F div(F a, F b) { return _mm512_div_ps(a, b); }
+    static inline F min(F a, F b) { return _mm512_min_ps(a, b); }
+    static inline F max(F a, F b) { return _mm512_max_ps(a, b); }
+    static inline F abs(F a) { return _mm512_castsi512_ps(_mm512_andnot_si512(_mm512_set1_epi32(0x80000000), _mm512_castps_si512(a))); }
+    static inline F fmadd(F a, F b, F c) { return _mm512_fmadd_ps(a, b, c); }
+    static inline F fnmadd(F a, F b, F c) { return _mm512_fnmadd_ps(a, b, c); }
+
+    static inline F floor(F a) { return _mm512_roundscale_ps(a, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC); }
+    static inline I toInt(F a) { return _mm512_cvttps_epi32(a); }
+    static inline I addi(I a, int32_t b) { return _mm512_add_epi32(a, _mm512_set1_epi32(b)); }
+    static inline I clampi(I a, I hi) { return _mm512_min_epi32(_mm512_max_epi32(a, _mm512_setzero_si512()), hi); }
+
+    // APrxLoRcpF1, APrxLoRsqF1 and APrxMedRcpF1.
+    static inline F rcpLo(F a) {
+        return _mm512_castsi512_ps(_mm512_sub_epi32(_mm512_set1_epi32(0x7ef07ebb), _mm512_castps_si512(a)));
+    }
+    static inline F rsqLo(F a) {
+        return _mm512_castsi512_ps(_mm512_sub_epi32(_mm512_set1_epi32(0x5f347d74), _mm512_srli_epi32(_mm512_castps_si512(a), 1)));
+    }
+    static inline F rcpMed(F a) {
+        F b = _mm512_castsi512_ps(_mm512_sub_epi32(_mm512_set1_epi32(0x7ef19fff), _mm512_castps_si512(a)));
+        return _mm512_mul_ps(b, _mm512_fnmadd_ps(b, a, _mm512_set1_ps(2.0f)));
+    }
+
+    static inline M lt(F a, F b) { return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ); }
+    static inline F select(M m, F a, F b) { return _mm512_mask_blend_ps(m, b, a); }
+
+    static inline void loadRGB(const uint8_t* row, I x, F& r, F& g, F& b) {
+        const __m512i texels = _mm512_i32gather_epi32(x, (const void*)row, 4);
+        const __m512i mask = _mm512_set1_epi32(0xff);
+        const __m512 scale = _mm512_set1_ps(1.0f / 255.0f);
+        r = _mm512_mul_ps(_mm512_cvtepi32_ps(_mm512_and_si512(texels, mask)), scale);
+        g = _mm512_mul_ps(_mm512_cvtepi32_ps(_mm512_and_si512(_mm512_srli_epi32(texels, 8), mask)), scale);
+        b = _mm512_mul_ps(_mm512_cvtepi32_ps(_mm512_and_si512(_mm512_srli_epi32(texels, 16), mask)), scale);
+    }
+
+    static inline void loadPixels(const float* row, int32_t x, int32_t width, F& r, F& g, F& b) {
+        __m512 p[4];
+        __mmask16 before = 0;
+        __mmask16 after = 0;
+        if (x >= 0 && x + 16 <= width) {
+            const float* src = row + (size_t)x * 4;
+            for (int i = 0; i < 4; i++) {
+                p[i] = _mm512_loadu_ps(src + i * 16);
+            }
+        } else {
+            // Image edge, only the pixels [first, last) are inside the row. Those are expanded into
+            // their lanes with masked loads (nothing outside of the row is ever touched), the
+            // others are replaced by the edge pixels after the deinterleave.
+            const int32_t first = x < 0 ? (-x < 16 ? -x : 16) : 0;
+            const int32_t last = width - x < 16 ? (width - x > first ? width - x : first) : 16;
+            before = (__mmask16)((1u << first) - 1);
+            after = (__mmask16)~((1u << last) - 1);
+            const uint32_t inside = ((1u << last) - 1) & ~((1u << first) - 1);
+            const float* src = row + (size_t)(x + first) * 4;
+            for (int i = 0; i < 4; i++) {
+                // One pixel bit to 4 float lanes.
+                const uint32_t pixels = (inside >> (i * 4)) & 0xf;
+                uint32_t lanes = 0;
+                for (int j = 0; j < 4; j++) {
+                    lanes |= ((pixels >> j) & 1) * (0xfu << (j * 4));
+                }
+                p[i] = _mm512_maskz_expandloadu_ps((__mmask16)lanes, src);
+                src += _mm_popcnt_u32(pixels) * 4;
+            }
+        }
+
+        // 16 RGBA pixels to R, G, B.
+        const __m512i evenIdx = _mm512_setr_epi32(0, 4, 8, 12, 16, 20, 24, 28, 1, 5, 9, 13, 17, 21, 25, 29);
+        const __m512i oddIdx = _mm512_setr_epi32(2, 6, 10, 14, 18, 22, 26, 30, 3, 7, 11, 15, 19, 23, 27, 31);
+        const __m512i loIdx = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 16, 17, 18, 19, 20, 21, 22, 23);
+        const __m512i hiIdx = _mm512_setr_epi32(8, 9, 10, 11, 12, 13, 14, 15, 24, 25, 26, 27, 28, 29, 30, 31);
+        const __m512 rg01 = _mm512_permutex2var_ps(p[0], evenIdx, p[1]);
+        const __m512 rg23 = _mm512_permutex2var_ps(p[2], evenIdx, p[3]);
+        const __m512 ba01 = _mm512_permutex2var_ps(p[0], oddIdx, p[1]);
+        const __m512 ba23 = _mm512_permutex2var_ps(p[2], oddIdx, p[3]);
+        r = _mm512_permutex2var_ps(rg01, loIdx, rg23);
+        g = _mm512_permutex2var_ps(rg01, hiIdx, rg23);
+        b = _mm512_permutex2var_ps(ba01, loIdx, ba23);
+
+        if (before) {
+            r = _mm512_mask_blend_ps(before, r, _mm512_set1_ps(row[0]));
+            g = _mm512_mask_blend_ps(before, g, _mm512_set1_ps(row[1]));
+            b = _mm512_mask_blend_ps(before, b, _mm512_set1_ps(row[2]));
+        }
+        if (after) {
+            const float* edge = row + (size_t)(width - 1) * 4;
+            r = _mm512_mask_blend_ps(after, r, _mm512_set1_ps(edge[0]));
+            g = _mm512_mask_blend_ps(after, g, _mm512_set1_ps(edge[1]));
+            b = _mm512_mask_blend_ps(after, b, _mm512_set1_ps(edge[2]));
+        }
+    }
+
+    static inline void storeRGBA(float* dst, F r, F g, F b, F a, uint32_t count) {
+        // 4x16 transpose into 16 RGBA pixels: 4x4 within each 128-bit lane, then a 4x4 of the lanes.
+        __m512 t0 = _mm512_unpacklo_ps(r, g);
+        __m512 t1 = _mm512_unpackhi_ps(r, g);
+        __m512 t2 = _mm512_unpacklo_ps(b, a);
+        __m512 t3 = _mm512_unpackhi_ps(b, a);
+        __m512 q0 = _mm512_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0)); // pixels 0, 4, 8, 12
+        __m512 q1 = _mm512_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2)); // pixels 1, 5, 9, 13
+        __m512 q2 = _mm512_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0)); // pixels 2, 6, 10, 14
+        __m512 q3 = _mm512_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2)); // pixels 3, 7, 11, 15
+        __m512 s0 = _mm512_shuffle_f32x4(q0, q1, _MM_SHUFFLE(1, 0, 1, 0)); // pixels 0, 4, 1, 5
+        __m512 s1 = _mm512_shuffle_f32x4(q2, q3, _MM_SHUFFLE(1, 0, 1, 0)); // pixels 2, 6, 3, 7
+        __m512 s2 = _mm512_shuffle_f32x4(q0, q1, _MM_SHUFFLE(3, 2, 3, 2)); // pixels 8, 12, 9, 13
+        __m512 s3 = _mm512_shuffle_f32x4(q2, q3, _MM_SHUFFLE(3, 2, 3, 2)); // pixels 10, 14, 11, 15
+        const __m512 pixels[4] = {
+            _mm512_shuffle_f32x4(s0, s1, _MM_SHUFFLE(2, 0, 2, 0)),
+            _mm512_shuffle_f32x4(s0, s1, _MM_SHUFFLE(3, 1, 3, 1)),
+            _mm512_shuffle_f32x4(s2, s3, _MM_SHUFFLE(2, 0, 2, 0)),
+            _mm512_shuffle_f32x4(s2, s3, _MM_SHUFFLE(3, 1, 3, 1)),
+        };
+
+        if (count == 16) {
+            for (int i = 0; i < 4; i++) {
+                _mm512_storeu_ps(dst + i * 16, pixels[i]);
+            }
+            return;
+        }
+
+        // Tail of the row, 4 mask bits per pixel.
+        for (uint32_t i = 0; i < 4 && i * 4 < count; i++) {
+            const uint32_t n = count - i * 4 < 4 ? count - i * 4 : 4;
+            _mm512_mask_storeu_ps(dst + i * 16, (__mmask16)((1u << (n * 4)) - 1), pixels[i]);
+        }
+    }
+};
+
+} // namespace
+
+void easuSpanAVX512(const EasuCpuConstants& con, const uint8_t* input, const Extent& extent,
+                    uint32_t y, uint32_t x0, uint32_t x1, float* output) {
+    EasuKernel<AVX512>::span(con, input, extent, y, x0, x1, output);
+}
+
+void rcasSpanAVX512(const RcasCpuConstants& con, const float* input, const Extent& extent,
+                    uint32_t y, uint32_t x0, uint32_t x1, float* output) {
+    RcasKernel<AVX512>::span(con, input, extent, y, x0, x1, output);
+}
+
+#endif /* FSR_CPU_X86 */
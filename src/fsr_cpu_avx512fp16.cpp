@@ -0,0 +1,125 @@
+// AVX-512 FP16 RCAS, the CPU counterpart of FsrRcasHx2: the same math on packed halves, 32 pixels per
+// iteration instead of the 16 of the AVX512 float kernel. Built with -mavx512fp16 (/arch:AVX512) and only
+// called after a CPUID check. The images stay RGBA32F, the pixels are converted on load and store.
+#include "fsr_cpu_internal.h"
+
+#if FSR_CPU_X86
+
+#include <immintrin.h>
+
+#include "fsr_cpu_simd.h"
+
+namespace {
+
+// _mm512_permutex2var_epi16 indices, 0-31 pick from the first vector and 32-63 from the second.
+alignas(64) const uint16_t rgIndex[32] = { 0, 4, 8, 12, 16, 20, 24, 28, 32, 36, 40, 44, 48, 52, 56, 60,
+                                           1, 5, 9, 13, 17, 21, 25, 29, 33, 37, 41, 45, 49, 53, 57, 61 };
+alignas(64) const uint16_t baIndex[32] = { 2, 6, 10, 14, 18, 22, 26, 30, 34, 38, 42, 46, 50, 54, 58, 62,
+                                           3, 7, 11, 15, 19, 23, 27, 31, 35, 39, 43, 47, 51, 55, 59, 63 };
+alignas(64) const uint16_t loIndex[32] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+                                           32, 33, 34, 35, 36, 37, 38, 39, 40, 41, 42, 43, 44, 45, 46, 47 };
+alignas(64) const uint16_t hiIndex[32] = { 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31,
+                                           48, 49, 50, 51, 52, 53, 54, 55, 56, 57, 58, 59, 60, 61, 62, 63 };
+alignas(64) const uint16_t pairLoIndex[32] = { 0, 32, 1, 33, 2, 34, 3, 35, 4, 36, 5, 37, 6, 38, 7, 39,
+                                               8, 40, 9, 41, 10, 42, 11, 43, 12, 44, 13, 45, 14, 46, 15, 47 };
+alignas(64) const uint16_t pairHiIndex[32] = { 16, 48, 17, 49, 18, 50, 19, 51, 20, 52, 21, 53, 22, 54, 23, 55,
+                                               24, 56, 25, 57, 26, 58, 27, 59, 28, 60, 29, 61, 30, 62, 31, 63 };
+alignas(64) const uint16_t pixelLoIndex[32] = { 0, 1, 32, 33, 2, 3, 34, 35, 4, 5, 36, 37, 6, 7, 38, 39,
+                                                8, 9, 40, 41, 10, 11, 42, 43, 12, 13, 44, 45, 14, 15, 46, 47 };
+alignas(64) const uint16_t pixelHiIndex[32] = { 16, 17, 48, 49, 18, 19, 50, 51, 20, 21, 52, 53, 22, 23, 54, 55,
+                                                24, 25, 56, 57, 26, 27, 58, 59, 28, 29, 60, 61, 30, 31, 62, 63 };
+
+static inline __m512i permute16(__m512i a, const uint16_t* index, __m512i b) {
+    return _mm512_permutex2var_epi16(a, _mm512_load_si512((const void*)index), b);
+}
+
+// The subset of the V traits RcasKernel uses.
+struct AVX512FP16 {
+    typedef __m512h F;
+    typedef __mmask32 M;
+    static const int width = 32;
+
+    // F16C for the constants, _Float16 is not available everywhere.
+    static inline F set1(float a) { return _mm512_castsi512_ph(_mm512_set1_epi16((short)_cvtss_sh(a, 0))); }
+
+    static inline F add(F a, F b) { return _mm512_add_ph(a, b); }
+    static inline F sub(F a, F b) { return _mm512_sub_ph(a, b); }
+    static inline F mul(F a, F b) { return _mm512_mul_ph(a, b); }
+    static inline F div(F a, F b) { return _mm512_div_ph(a, b); }
+    static inline F min(F a, F b) { return _mm512_min_ph(a, b); }
+    static inline F max(F a, F b) { return _mm512_max_ph(a, b); }
+    static inline F fmadd(F a, F b, F c) { return _mm512_fmadd_ph(a, b, c); }
+
+    static inline M lt(F a, F b) { return _mm512_cmp_ph_mask(a, b, _CMP_LT_OQ); }
+    static inline F select(M m, F a, F b) { return _mm512_mask_blend_ph(m, b, a); }
+
+    // APrxMedRcpH1, the 16 bit version of the magic constant.
+    static inline F rcpMed(F a) {
+        F b = _mm512_castsi512_ph(_mm512_sub_epi16(_mm512_set1_epi16(0x778d), _mm512_castph_si512(a)));
+        return _mm512_mul_ph(b, _mm512_fnmadd_ph(b, a, set1(2.0f)));
+    }
+
+    static inline void loadPixels(const float* row, int32_t x, int32_t width, F& r, F& g, F& b) {
+        // Image edge: the clamped pixels are copied first, the deinterleave below always reads 32.
+        alignas(64) float edge[32 * 4];
+        const float* src = row + (size_t)x * 4;
+        if (x < 0 || x + 32 > width) {
+            for (int32_t i = 0; i < 32; i++) {
+                int32_t clamped = x + i < 0 ? 0 : (x + i >= width ? width - 1 : x + i);
+                memcpy(edge + i * 4, row + (size_t)clamped * 4, 4 * sizeof(float));
+            }
+            src = edge;
+        }
+
+        // 8 RGBA pixels per vector, as halves.
+        __m512i p[4];
+        for (int i = 0; i < 4; i++) {
+            __m256h lo = _mm512_cvtxps_ph(_mm512_loadu_ps(src + i * 32));
+            __m256h hi = _mm512_cvtxps_ph(_mm512_loadu_ps(src + i * 32 + 16));
+            p[i] = _mm512_inserti64x4(_mm512_castsi256_si512(_mm256_castph_si256(lo)), _mm256_castph_si256(hi), 1);
+        }
+
+        // 32 RGBA pixels to R, G, B.
+        const __m512i rg01 = permute16(p[0], rgIndex, p[1]);
+        const __m512i rg23 = permute16(p[2], rgIndex, p[3]);
+        const __m512i ba01 = permute16(p[0], baIndex, p[1]);
+        const __m512i ba23 = permute16(p[2], baIndex, p[3]);
+        r = _mm512_castsi512_ph(permute16(rg01, loIndex, rg23));
+        g = _mm512_castsi512_ph(permute16(rg01, hiIndex, rg23));
+        b = _mm512_castsi512_ph(permute16(ba01, loIndex, ba23));
+    }
+
+    static inline void storeRGBA(float* dst, F r, F g, F b, F a, uint32_t count) {
+        // R, G, B, A to 32 RGBA pixels, 8 per vector.
+        const __m512i rgLo = permute16(_mm512_castph_si512(r), pairLoIndex, _mm512_castph_si512(g));
+        const __m512i rgHi = permute16(_mm512_castph_si512(r), pairHiIndex, _mm512_castph_si512(g));
+        const __m512i baLo = permute16(_mm512_castph_si512(b), pairLoIndex, _mm512_castph_si512(a));
+        const __m512i baHi = permute16(_mm512_castph_si512(b), pairHiIndex, _mm512_castph_si512(a));
+        const __m512i pixels[4] = {
+            permute16(rgLo, pixelLoIndex, baLo),
+            permute16(rgLo, pixelHiIndex, baLo),
+            permute16(rgHi, pixelLoIndex, baHi),
+            permute16(rgHi, pixelHiIndex, baHi),
+        };
+
+        // Tail of the row, through a buffer as the float conversion works on 4 pixels at a time.
+        alignas(64) float tail[32 * 4];
+        float* out = count == 32 ? dst : tail;
+        for (int i = 0; i < 4; i++) {
+            _mm512_storeu_ps(out + i * 32, _mm512_cvtxph_ps(_mm256_castsi256_ph(_mm512_castsi512_si256(pixels[i]))));
+            _mm512_storeu_ps(out + i * 32 + 16, _mm512_cvtxph_ps(_mm256_castsi256_ph(_mm512_extracti64x4_epi64(pixels[i], 1))));
+        }
+        if (out == tail) {
+            memcpy(dst, tail, (size_t)count * 4 * sizeof(float));
+        }
+    }
+};
+
+} // namespace
+
+void rcasSpanAVX512FP16(const RcasCpuConstants& con, const float* input, const Extent& extent,
+                        uint32_t y, uint32_t x0, uint32_t x1, float* output) {
+    RcasKernel<AVX512FP16>::span(con, input, extent, y, x0, x1, output);
+}
+
+#endif /* FSR_CPU_X86 */
@@ -0,0 +1,79 @@
+#ifndef FSR_CPU_INTERNAL_H
+#define FSR_CPU_INTERNAL_H
+
+#include <cstdint>
+#include <cstring>
+
+#include "image_utils.h"
+
+// Shared between fsr_cpu.cpp and the per instruction set kernels (fsr_cpu_<isa>.cpp).
+// Only plain types are used here as the kernel files are built with different target flags.
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define FSR_CPU_X86 1
+#else
+#define FSR_CPU_X86 0
+#endif
+
+// The EASU constants with the floats unpacked from the uint bit patterns of FSRConstants.
+struct EasuCpuConstants {
+    float con0[4];
+    float con1[4];
+    float con2[4];
+    float con3[4];
+};
+
+static inline EasuCpuConstants unpackEasuConstants(const FSRConstants& fsrData) {
+    EasuCpuConstants con;
+    memcpy(con.con0, fsrData.const0, sizeof(con.con0));
+    memcpy(con.con1, fsrData.const1, sizeof(con.con1));
+    memcpy(con.con2, fsrData.const2, sizeof(con.con2));
+    memcpy(con.con3, fsrData.const3, sizeof(con.con3));
+    return con;
+}
+
+// The RCAS constant with the sharpness unpacked from const0RCAS.
+struct RcasCpuConstants {
+    float sharpness;
+};
+
+static inline RcasCpuConstants unpackRcasConstants(const FSRConstants& fsrData) {
+    RcasCpuConstants con;
+    memcpy(&con.sharpness, &fsrData.const0RCAS[0], sizeof(con.sharpness));
+    return con;
+}
+
+// Computes EASU for the output pixels [x0, x1) of row y into 'output' (RGBA32F, starting at x0).
+typedef void (*EasuSpanFn)(const EasuCpuConstants& con, const uint8_t* input, const Extent& extent,
+                           uint32_t y, uint32_t x0, uint32_t x1, float* output);
+
+void easuSpanScalar(const EasuCpuConstants& con, const uint8_t* input, const Extent& extent,
+                    uint32_t y, uint32_t x0, uint32_t x1, float* output);
+void easuSpanSSE41(const EasuCpuConstants& con, const uint8_t* input, const Extent& extent,
+                   uint32_t y, uint32_t x0, uint32_t x1, float* output);
+void easuSpanAVX2(const EasuCpuConstants& con, const uint8_t* input, const Extent& extent,
+                  uint32_t y, uint32_t x0, uint32_t x1, float* output);
+void easuSpanAVX512(const EasuCpuConstants& con, const uint8_t* input, const Extent& extent,
+                    uint32_t y, uint32_t x0, uint32_t x1, float* output);
+
+// Computes RCAS for the pixels [x0, x1) of row y into 'output' (RGBA32F, starting at x0).
+// 'input' is the full RGBA32F image of the given extent, reads outside of it are clamped to the edge.
+typedef void (*RcasSpanFn)(const RcasCpuConstants& con, const float* input, const Extent& extent,
+                           uint32_t y, uint32_t x0, uint32_t x1, float* output);
+
+void rcasSpanScalar(const RcasCpuConstants& con, const float* input, const Extent& extent,
+                    uint32_t y, uint32_t x0, uint32_t x1, float* output);
+void rcasSpanSSE41(const RcasCpuConstants& con, const float* input, const Extent& extent,
+                   uint32_t y, uint32_t x0, uint32_t x1, float* output);
+void rcasSpanAVX2(const RcasCpuConstants& con, const float* input, const Extent& extent,
+                  uint32_t y, uint32_t x0, uint32_t x1, float* output);
+void rcasSpanAVX512(const RcasCpuConstants& con, const float* input, const Extent& extent,
+                    uint32_t y, uint32_t x0, uint32_t x1, float* output);
+void rcasSpanAVX512FP16(const RcasCpuConstants& con, const float* input, const Extent& extent,
+                        uint32_t y, uint32_t x0, uint32_t x1, float* output);
+
+// Span functions of the kernel selected with setFSRCpuKernel.
+EasuSpanFn activeEasuSpan();
+RcasSpanFn activeRcasSpan();
+
+#endif /* FSR_CPU_INTERNAL_H */
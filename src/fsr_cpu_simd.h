@@ -0,0 +1,306 @@
+#ifndef FSR_CPU_SIMD_H
+#define FSR_CPU_SIMD_H
+
+#include <cmath>
+
+#include "fsr_cpu_internal.h"
+
+// FSR_RCAS_LIMIT of ffx_fsr1.h, which can't be included in the kernel files.
+#define FSR_CPU_RCAS_LIMIT (0.25 - (1.0 / 16.0))
+
+// Generic vector EASU and RCAS, instantiated once per instruction set by the fsr_cpu_<isa>.cpp files.
+//
+// Each lane computes one output pixel, a vector covers V::width horizontally adjacent pixels of a row.
+// For EASU the row (and so the vertical position in the input) is the same for every lane, only the
+// horizontal position differs, so the 12 taps are 12 gathers from 4 input rows.
+// For RCAS the 5 taps are contiguous loads from 3 rows, shifted by one pixel for the left and right taps.
+//
+// The 'V' traits wrap the intrinsics of one instruction set:
+//  F/I/M ............................ float vector, int32 vector, lane mask
+//  set1/seti1/laneIndex ............. broadcasts, {0, 1, .., width - 1}
+//  add/sub/mul/div/min/max/abs ...... float ops with the AMinF1/AMaxF1 operand order
+//  fmadd(a,b,c)/fnmadd(a,b,c) ....... a*b+c and c-a*b
+//  floor/toInt/addi/clampi .......... position math
+//  rcpLo/rsqLo/rcpMed ............... APrxLoRcpF1/APrxLoRsqF1/APrxMedRcpF1 as lane-wide integer ops
+//  lt/select ........................ compare and blend, lt is false for a NaN
+//  loadRGB(row,x,r,g,b) ............. gather of RGBA8 texels from a row, converted to {0 to 1}
+//  loadPixels(row,x,width,r,g,b) .... RGBA32F pixels [x, x + V::width) of a 'width' pixels row, clamped
+//  storeRGBA(dst,r,g,b,a,count) ..... interleaved store of the first 'count' lanes
+//
+// Everything is in an anonymous namespace, instantiations built with different target flags must
+// never be merged by the linker.
+namespace {
+
+template <class V>
+struct EasuKernel {
+    typedef typename V::F F;
+    typedef typename V::I I;
+    typedef typename V::M M;
+
+    struct Texels {
+        F r, g, b;
+    };
+
+    static inline Texels load(const uint8_t* row, I x) {
+        Texels t;
+        V::loadRGB(row, x, t.r, t.g, t.b);
+        return t;
+    }
+
+    static inline F luma(const Texels& t) {
+        // Simplest multi-channel approximate luma possible (luma times 2, in 2 FMA/MAD).
+        return V::fmadd(t.b, V::set1(0.5f), V::fmadd(t.r, V::set1(0.5f), t.g));
+    }
+
+    static inline F sat(F a) {
+        return V::min(V::set1(1.0f), V::max(V::set1(0.0f), a));
+    }
+
+    // FsrEasuTapF.
+    static inline void tap(F aC[3], F& aW, F offX, F offY, F dirX, F dirY, F lenX, F lenY, F lob, F clp, const Texels& c) {
+        // Rotate offset by direction.
+        F vX = V::fmadd(offX, dirX, V::mul(offY, dirY));
+        F vY = V::fnmadd(offX, dirY, V::mul(offY, dirX));
+        // Anisotropy.
+        vX = V::mul(vX, lenX);
+        vY = V::mul(vY, lenY);
+        // Compute distance^2, limited to the window.
+        F d2 = V::fmadd(vX, vX, V::mul(vY, vY));
+        d2 = V::min(d2, clp);
+        // Approximation of lancos2 without sin() or rcp(), or sqrt() to get x.
+        F wB = V::fmadd(V::set1(2.0f / 5.0f), d2, V::set1(-1.0f));
+        F wA = V::fmadd(lob, d2, V::set1(-1.0f));
+        wB = V::mul(wB, wB);
+        wA = V::mul(wA, wA);
+        wB = V::fmadd(V::set1(25.0f / 16.0f), wB, V::set1(-(25.0f / 16.0f - 1.0f)));
+        F w = V::mul(wB, wA);
+        // Do weighted average.
+        aC[0] = V::fmadd(c.r, w, aC[0]);
+        aC[1] = V::fmadd(c.g, w, aC[1]);
+        aC[2] = V::fmadd(c.b, w, aC[2]);
+        aW = V::add(aW, w);
+    }
+
+    // FsrEasuSetF with the bilinear weight passed in.
+    static inline void set(F& dirX, F& dirY, F& len, F w, F lA, F lB, F lC, F lD, F lE) {
+        F lenX = V::rcpLo(V::max(V::abs(V::sub(lD, lC)), V::abs(V::sub(lC, lB))));
+        F dX = V::sub(lD, lB);
+        dirX = V::fmadd(dX, w, dirX);
+        lenX = sat(V::mul(V::abs(dX), lenX));
+        lenX = V::mul(lenX, lenX);
+        len = V::fmadd(lenX, w, len);
+        // Repeat for the y axis.
+        F lenY = V::rcpLo(V::max(V::abs(V::sub(lE, lC)), V::abs(V::sub(lC, lA))));
+        F dY = V::sub(lE, lA);
+        dirY = V::fmadd(dY, w, dirY);
+        lenY = sat(V::mul(V::abs(dY), lenY));
+        lenY = V::mul(lenY, lenY);
+        len = V::fmadd(lenY, w, len);
+    }
+
+    static void span(const EasuCpuConstants& con, const uint8_t* input, const Extent& extent,
+                     uint32_t y, uint32_t x0, uint32_t x1, float* output) {
+        // The vertical position of 'f' is shared by all lanes.
+        float ppYs = (float)y * con.con0[1] + con.con0[3];
+        float fpYs = floorf(ppYs);
+        ppYs -= fpYs;
+
+        // Rows of b c, e f g h, i j k l and n o with GL_CLAMP_TO_EDGE addressing.
+        const uint8_t* rows[4];
+        for (int r = 0; r < 4; r++) {
+            int32_t row = (int32_t)fpYs - 1 + r;
+            row = row < 0 ? 0 : (row >= (int32_t)extent.height ? (int32_t)extent.height - 1 : row);
+            rows[r] = input + (size_t)row * extent.width * 4;
+        }
+
+        const F one = V::set1(1.0f);
+        const F ppY = V::set1(ppYs);
+        const F ppYInv = V::sub(one, ppY);
+        const I maxX = V::seti1((int32_t)extent.width - 1);
+
+        for (uint32_t x = x0; x < x1; x += V::width) {
+            // Get position of 'f'. Not fused, rounding must match the scalar code or floor() can pick another texel.
+            F ppX = V::add(V::mul(V::add(V::set1((float)x), V::laneIndex()), V::set1(con.con0[0])), V::set1(con.con0[2]));
+            F fpX = V::floor(ppX);
+            ppX = V::sub(ppX, fpX);
+            const F ppXInv = V::sub(one, ppX);
+
+            I fx = V::toInt(fpX);
+            I xm1 = V::clampi(V::addi(fx, -1), maxX);
+            I xp0 = V::clampi(fx, maxX);
+            I xp1 = V::clampi(V::addi(fx, 1), maxX);
+            I xp2 = V::clampi(V::addi(fx, 2), maxX);
+
+            // 12-tap kernel.
+            //    b c
+            //  e f g h
+            //  i j k l
+            //    n o
+            Texels b = load(rows[0], xp0);
+            Texels c = load(rows[0], xp1);
+            Texels e = load(rows[1], xm1);
+            Texels f = load(rows[1], xp0);
+            Texels g = load(rows[1], xp1);
+            Texels h = load(rows[1], xp2);
+            Texels i = load(rows[2], xm1);
+            Texels j = load(rows[2], xp0);
+            Texels k = load(rows[2], xp1);
+            Texels l = load(rows[2], xp2);
+            Texels n = load(rows[3], xp0);
+            Texels o = load(rows[3], xp1);
+
+            F bL = luma(b);
+            F cL = luma(c);
+            F eL = luma(e);
+            F fL = luma(f);
+            F gL = luma(g);
+            F hL = luma(h);
+            F iL = luma(i);
+            F jL = luma(j);
+            F kL = luma(k);
+            F lL = luma(l);
+            F nL = luma(n);
+            F oL = luma(o);
+
+            // Accumulate for bilinear interpolation.
+            F dirX = V::set1(0.0f);
+            F dirY = V::set1(0.0f);
+            F len = V::set1(0.0f);
+            set(dirX, dirY, len, V::mul(ppXInv, ppYInv), bL, eL, fL, gL, jL);
+            set(dirX, dirY, len, V::mul(ppX, ppYInv), cL, fL, gL, hL, kL);
+            set(dirX, dirY, len, V::mul(ppXInv, ppY), fL, iL, jL, kL, nL);
+            set(dirX, dirY, len, V::mul(ppX, ppY), gL, jL, kL, lL, oL);
+
+            // Normalize with approximation, and cleanup close to zero.
+            F dirR = V::fmadd(dirX, dirX, V::mul(dirY, dirY));
+            M zro = V::lt(dirR, V::set1(1.0f / 32768.0f));
+            dirR = V::rsqLo(dirR);
+            dirR = V::select(zro, one, dirR);
+            dirX = V::select(zro, one, dirX);
+            dirX = V::mul(dirX, dirR);
+            dirY = V::mul(dirY, dirR);
+            // Transform from {0 to 2} to {0 to 1} range, and shape with square.
+            len = V::mul(len, V::set1(0.5f));
+            len = V::mul(len, len);
+            // Stretch kernel {1.0 vert|horz, to sqrt(2.0) on diagonal}.
+            F stretch = V::mul(V::fmadd(dirX, dirX, V::mul(dirY, dirY)), V::rcpLo(V::max(V::abs(dirX), V::abs(dirY))));
+            // Anisotropic length after rotation.
+            F len2X = V::fmadd(V::sub(stretch, one), len, one);
+            F len2Y = V::fmadd(V::set1(-0.5f), len, one);
+            // Based on the amount of 'edge', the window shifts from +/-{sqrt(2.0) to slightly beyond 2.0}.
+            F lob = V::fmadd(V::set1((1.0f / 4.0f - 0.04f) - 0.5f), len, V::set1(0.5f));
+            // Set distance^2 clipping point to the end of the adjustable window.
+            F clp = V::rcpLo(lob);
+
+            // Accumulation mixed with min/max of 4 nearest.
+            F min4R = V::min(V::min(f.r, V::min(g.r, j.r)), k.r);
+            F min4G = V::min(V::min(f.g, V::min(g.g, j.g)), k.g);
+            F min4B = V::min(V::min(f.b, V::min(g.b, j.b)), k.b);
+            F max4R = V::max(V::max(f.r, V::max(g.r, j.r)), k.r);
+            F max4G = V::max(V::max(f.g, V::max(g.g, j.g)), k.g);
+            F max4B = V::max(V::max(f.b, V::max(g.b, j.b)), k.b);
+
+            F aC[3] = { V::set1(0.0f), V::set1(0.0f), V::set1(0.0f) };
+            F aW = V::set1(0.0f);
+            const F offY0 = V::sub(V::set1(-1.0f), ppY);
+            const F offY1 = V::sub(V::set1(0.0f), ppY);
+            const F offY2 = V::sub(V::set1(1.0f), ppY);
+            const F offY3 = V::sub(V::set1(2.0f), ppY);
+            const F offXm1 = V::sub(V::set1(-1.0f), ppX);
+            const F offX0 = V::sub(V::set1(0.0f), ppX);
+            const F offX1 = V::sub(V::set1(1.0f), ppX);
+            const F offX2 = V::sub(V::set1(2.0f), ppX);
+            tap(aC, aW, offX0,  offY0, dirX, dirY, len2X, len2Y, lob, clp, b);
+            tap(aC, aW, offX1,  offY0, dirX, dirY, len2X, len2Y, lob, clp, c);
+            tap(aC, aW, offXm1, offY2, dirX, dirY, len2X, len2Y, lob, clp, i);
+            tap(aC, aW, offX0,  offY2, dirX, dirY, len2X, len2Y, lob, clp, j);
+            tap(aC, aW, offX0,  offY1, dirX, dirY, len2X, len2Y, lob, clp, f);
+            tap(aC, aW, offXm1, offY1, dirX, dirY, len2X, len2Y, lob, clp, e);
+            tap(aC, aW, offX1,  offY2, dirX, dirY, len2X, len2Y, lob, clp, k);
+            tap(aC, aW, offX2,  offY2, dirX, dirY, len2X, len2Y, lob, clp, l);
+            tap(aC, aW, offX2,  offY1, dirX, dirY, len2X, len2Y, lob, clp, h);
+            tap(aC, aW, offX1,  offY1, dirX, dirY, len2X, len2Y, lob, clp, g);
+            tap(aC, aW, offX1,  offY3, dirX, dirY, len2X, len2Y, lob, clp, o);
+            tap(aC, aW, offX0,  offY3, dirX, dirY, len2X, len2Y, lob, clp, n);
+
+            // Normalize and dering.
+            F rcpW = V::div(one, aW);
+            F pixR = V::min(max4R, V::max(min4R, V::mul(aC[0], rcpW)));
+            F pixG = V::min(max4G, V::max(min4G, V::mul(aC[1], rcpW)));
+            F pixB = V::min(max4B, V::max(min4B, V::mul(aC[2], rcpW)));
+
+            uint32_t count = x1 - x < (uint32_t)V::width ? x1 - x : (uint32_t)V::width;
+            V::storeRGBA(output + (size_t)(x - x0) * 4, pixR, pixG, pixB, one, count);
+        }
+    }
+};
+
+template <class V>
+struct RcasKernel {
+    typedef typename V::F F;
+
+    // Per channel part of FsrRcasF, returns the lobe of the channel.
+    static inline F lobe(F b, F d, F e, F f, F h) {
+        // Min and max of ring.
+        F mn4 = V::min(V::min(b, V::min(d, f)), h);
+        F mx4 = V::max(V::max(b, V::max(d, f)), h);
+        // Limiters, these need to be high precision RCPs.
+        F hitMin = V::mul(V::min(mn4, e), V::div(V::set1(1.0f), V::mul(V::set1(4.0f), mx4)));
+        F hitMax = V::mul(V::sub(V::set1(1.0f), V::max(mx4, e)), V::div(V::set1(1.0f), V::fmadd(V::set1(4.0f), mn4, V::set1(-4.0f))));
+        // Flat at 0 or 1 makes hitMin or hitMax a NaN, dropped like GPU max() does (see rcasPixel). Both
+        // are <= 0 otherwise, so lt(hitMax, 1) is false only for the NaN.
+        F lobeMin = V::sub(V::set1(-0.0f), hitMin);
+        return V::select(V::lt(hitMax, V::set1(1.0f)), V::max(lobeMin, hitMax), lobeMin);
+    }
+
+    static inline F resolve(F lobe, F rcpL, F b, F d, F e, F f, F h) {
+        F c = V::mul(lobe, b);
+        c = V::fmadd(lobe, d, c);
+        c = V::fmadd(lobe, h, c);
+        c = V::fmadd(lobe, f, c);
+        return V::mul(V::add(c, e), rcpL);
+    }
+
+    static void span(const RcasCpuConstants& con, const float* input, const Extent& extent,
+                     uint32_t y, uint32_t x0, uint32_t x1, float* output) {
+        //    b
+        //  d e f
+        //    h
+        const float* rows[3];
+        for (int r = 0; r < 3; r++) {
+            int32_t row = (int32_t)y - 1 + r;
+            row = row < 0 ? 0 : (row >= (int32_t)extent.height ? (int32_t)extent.height - 1 : row);
+            rows[r] = input + (size_t)row * extent.width * 4;
+        }
+        const int32_t width = (int32_t)extent.width;
+        const F sharpness = V::set1(con.sharpness);
+
+        for (uint32_t x = x0; x < x1; x += V::width) {
+            F bR, bG, bB, dR, dG, dB, eR, eG, eB, fR, fG, fB, hR, hG, hB;
+            V::loadPixels(rows[0], (int32_t)x, width, bR, bG, bB);
+            V::loadPixels(rows[1], (int32_t)x - 1, width, dR, dG, dB);
+            V::loadPixels(rows[1], (int32_t)x, width, eR, eG, eB);
+            V::loadPixels(rows[1], (int32_t)x + 1, width, fR, fG, fB);
+            V::loadPixels(rows[2], (int32_t)x, width, hR, hG, hB);
+
+            F lobeR = lobe(bR, dR, eR, fR, hR);
+            F lobeG = lobe(bG, dG, eG, fG, hG);
+            F lobeB = lobe(bB, dB, eB, fB, hB);
+            F l = V::max(V::set1(-(float)FSR_CPU_RCAS_LIMIT), V::min(V::max(lobeR, V::max(lobeG, lobeB)), V::set1(0.0f)));
+            l = V::mul(l, sharpness);
+            // Resolve, which needs the medium precision rcp approximation to avoid visible tonality changes.
+            F rcpL = V::rcpMed(V::fmadd(V::set1(4.0f), l, V::set1(1.0f)));
+
+            uint32_t count = x1 - x < (uint32_t)V::width ? x1 - x : (uint32_t)V::width;
+            V::storeRGBA(output + (size_t)(x - x0) * 4,
+                         resolve(l, rcpL, bR, dR, eR, fR, hR),
+                         resolve(l, rcpL, bG, dG, eG, fG, hG),
+                         resolve(l, rcpL, bB, dB, eB, fB, hB),
+                         V::set1(1.0f), count);
+        }
+    }
+};
+
+} // namespace
+
+#endif /* FSR_CPU_SIMD_H */
@@ -0,0 +1,107 @@
+// SSE4.1 kernels, this file is built with -msse4.1 and only called after a CPUID check.
+#include "fsr_cpu_internal.h"
+
+#if FSR_CPU_X86
+
+#include <smmintrin.h>
+
+#include "fsr_cpu_simd.h"
+
+namespace {
+
+struct SSE41 {
+    typedef __m128 F;
+    typedef __m128i I;
+    typedef __m128 M;
+    static const int width = 4;
+
+    static inline F set1(float a) { return _mm_set1_ps(a); }
+    static inline I seti1(int32_t a) { return _mm_set1_epi32(a); }
+    static inline F laneIndex() { return _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f); }
+
+    static inline F add(F a, F b) { return _mm_add_ps(a, b); }
+    static inline F sub(F a, F b) { return _mm_sub_ps(a, b); }
+    static inline F mul(F a, F b) { return _mm_mul_ps(a, b); }
+    static inline F div(F a, F b) { return _mm_div_ps(a, b); }
+    static inline F min(F a, F b) { return _mm_min_ps(a, b); }
+    static inline F max(F a, F b) { return _mm_max_ps(a, b); }
+    static inline F abs(F a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+    // No FMA before AVX2, these are the same MADs as the scalar code.
+    static inline F fmadd(F a, F b, F c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+    static inline F fnmadd(F a, F b, F c) { return _mm_sub_ps(c, _mm_mul_ps(a, b)); }
+
+    static inline F floor(F a) { return _mm_floor_ps(a); }
+    static inline I toInt(F a) { return _mm_cvttps_epi32(a); }
+    static inline I addi(I a, int32_t b) { return _mm_add_epi32(a, _mm_set1_epi32(b)); }
+    static inline I clampi(I a, I hi) { return _mm_min_epi32(_mm_max_epi32(a, _mm_setzero_si128()), hi); }
+
+    // APrxLoRcpF1, APrxLoRsqF1 and APrxMedRcpF1.
+    static inline F rcpLo(F a) {
+        return _mm_castsi128_ps(_mm_sub_epi32(_mm_set1_epi32(0x7ef07ebb), _mm_castps_si128(a)));
+    }
+    static inline F rsqLo(F a) {
+        return _mm_castsi128_ps(_mm_sub_epi32(_mm_set1_epi32(0x5f347d74), _mm_srli_epi32(_mm_castps_si128(a), 1)));
+    }
+    static inline F rcpMed(F a) {
+        F b = _mm_castsi128_ps(_mm_sub_epi32(_mm_set1_epi32(0x7ef19fff), _mm_castps_si128(a)));
+        return mul(b, fnmadd(b, a, _mm_set1_ps(2.0f)));
+    }
+
+    static inline M lt(F a, F b) { return _mm_cmplt_ps(a, b); }
+    static inline F select(M m, F a, F b) { return _mm_blendv_ps(b, a, m); }
+
+    static inline int32_t loadTexel(const uint8_t* row, int32_t x) {
+        int32_t texel;
+        memcpy(&texel, row + (size_t)x * 4, sizeof(texel));
+        return texel;
+    }
+
+    static inline void loadRGB(const uint8_t* row, I x, F& r, F& g, F& b) {
+        // No gather instruction, insert the 4 texels one by one.
+        const __m128i texels = _mm_setr_epi32(
+            loadTexel(row, _mm_extract_epi32(x, 0)),
+            loadTexel(row, _mm_extract_epi32(x, 1)),
+            loadTexel(row, _mm_extract_epi32(x, 2)),
+            loadTexel(row, _mm_extract_epi32(x, 3)));
+        const __m128i mask = _mm_set1_epi32(0xff);
+        const __m128 scale = _mm_set1_ps(1.0f / 255.0f);
+        r = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(texels, mask)), scale);
+        g = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(texels, 8), mask)), scale);
+        b = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(texels, 16), mask)), scale);
+    }
+
+    static inline void loadPixels(const float* row, int32_t x, int32_t width, F& r, F& g, F& b) {
+        __m128 p[4];
+        for (int32_t i = 0; i < 4; i++) {
+            // Clamp to the row, only does something for the first and last vectors of a row.
+            const int32_t px = x + i < 0 ? 0 : (x + i >= width ? width - 1 : x + i);
+            p[i] = _mm_loadu_ps(row + (size_t)px * 4);
+        }
+        _MM_TRANSPOSE4_PS(p[0], p[1], p[2], p[3]);
+        r = p[0];
+        g = p[1];
+        b = p[2];
+    }
+
+    static inline void storeRGBA(float* dst, F r, F g, F b, F a, uint32_t count) {
+        _MM_TRANSPOSE4_PS(r, g, b, a);
+        const __m128 pixels[4] = { r, g, b, a };
+        for (uint32_t i = 0; i < count; i++) {
+            _mm_storeu_ps(dst + i * 4, pixels[i]);
+        }
+    }
+};
+
+} // namespace
+
+void easuSpanSSE41(const EasuCpuConstants& con, const uint8_t* input, const Extent& extent,
+                   uint32_t y, uint32_t x0, uint32_t x1, float* output) {
+    EasuKernel<SSE41>::span(con, input, extent, y, x0, x1, output);
+}
+
+void rcasSpanSSE41(const RcasCpuConstants& con, const float* input, const Extent& extent,
+                   uint32_t y, uint32_t x0, uint32_t x1, float* output) {
+    RcasKernel<SSE41>::span(con, input, extent, y, x0, x1, output);
+}
+
+#endif /* FSR_CPU_X86 */
@@ -0,0 +1,218 @@
+#include "fsr_cpu.h"
+#include "fsr_cpu_internal.h"
+#include "thread_pool.h"
+#include "trace.h"
+
+#include <chrono>
+#include <cstring>
+
+static double elapsedMs(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+size_t getFSRCpuTileFootprint(const FSRConstants& fsrData, uint32_t tileSize) {
+    // EASU: input texels under the tile plus the taps reaching 1 texel before and 2 after.
+    const double scaleX = (double)fsrData.input.width / fsrData.output.width;
+    const double scaleY = (double)fsrData.input.height / fsrData.output.height;
+    const size_t easuInput = (size_t)(tileSize * scaleX + 4.0) * (size_t)(tileSize * scaleY + 4.0) * 4;
+    // RCAS: RGBA32F cross around every pixel.
+    const size_t rcasInput = (size_t)(tileSize + 2) * (tileSize + 2) * 16;
+    const size_t output = (size_t)tileSize * tileSize * 16;
+
+    return (easuInput > rcasInput ? easuInput : rcasInput) + output;
+}
+
+namespace {
+
+// Output pixels [x0, x1) x [y0, y1) of one tile.
+struct TileRect {
+    uint32_t x0, y0, x1, y1;
+};
+
+} // namespace
+
+static TileRect tileRect(uint32_t tile, uint32_t tilesX, uint32_t tileSize, const Extent& extent) {
+    TileRect rect;
+    rect.x0 = (tile % tilesX) * tileSize;
+    rect.y0 = (tile / tilesX) * tileSize;
+    rect.x1 = rect.x0 + tileSize < extent.width ? rect.x0 + tileSize : extent.width;
+    rect.y1 = rect.y0 + tileSize < extent.height ? rect.y0 + tileSize : extent.height;
+    return rect;
+}
+
+static void initStats(FSRCpuTileStats* stats, const ThreadPool& pool, const FSRConstants& fsrData,
+                      uint32_t tileSize, uint32_t tilesX, uint32_t tilesY) {
+    stats->tileSize = tileSize;
+    stats->tilesX = tilesX;
+    stats->tilesY = tilesY;
+    stats->threads = pool.threadCount();
+    stats->steals = 0;
+    stats->footprintBytes = getFSRCpuTileFootprint(fsrData, tileSize);
+    stats->easuMs = 0.0;
+    stats->rcasMs = 0.0;
+    stats->totalMs = 0.0;
+    stats->tiles.assign((size_t)tilesX * tilesY, FSRCpuTileTiming());
+}
+
+static uint32_t pickTileSize(const FSRConstants& fsrData) {
+    const size_t budget = getFSRCpuL2CacheSize() / 2;
+    uint32_t tileSize = 16;
+    while (tileSize < 128 && getFSRCpuTileFootprint(fsrData, tileSize * 2) <= budget) {
+        tileSize *= 2;
+    }
+    return tileSize;
+}
+
+void runFSRCpuTiled(ThreadPool& pool, const FSRConstants& fsrData, const uint8_t* input, float* output,
+                    uint32_t tileSize, FSRCpuTileStats* stats) {
+    TRACE_ZONE("runFSRCpuTiled");
+    if (tileSize == 0) {
+        tileSize = pickTileSize(fsrData);
+    }
+
+    const uint32_t width = fsrData.output.width;
+    const uint32_t height = fsrData.output.height;
+    const uint32_t tilesX = (width + (tileSize - 1)) / tileSize;
+    const uint32_t tilesY = (height + (tileSize - 1)) / tileSize;
+
+    if (stats) {
+        initStats(stats, pool, fsrData, tileSize, tilesX, tilesY);
+    }
+
+    const EasuCpuConstants easuCon = unpackEasuConstants(fsrData);
+    const RcasCpuConstants rcasCon = unpackRcasConstants(fsrData);
+    const EasuSpanFn easuSpan = activeEasuSpan();
+    const RcasSpanFn rcasSpan = activeRcasSpan();
+
+    // RCAS reads the EASU result of the neighbouring tiles, so like the two dispatches of runFSR
+    // the passes are separated by a full barrier (the end of parallelFor).
+    std::vector<float> easuOutput((size_t)width * height * 4);
+
+    const auto start = std::chrono::steady_clock::now();
+    pool.parallelFor(tilesX * tilesY, [&](uint32_t tile, uint32_t worker) {
+        const TileRect rect = tileRect(tile, tilesX, tileSize, fsrData.output);
+
+        const auto tileStart = std::chrono::steady_clock::now();
+        for (uint32_t y = rect.y0; y < rect.y1; y++) {
+            easuSpan(easuCon, input, fsrData.input, y, rect.x0, rect.x1, easuOutput.data() + ((size_t)y * width + rect.x0) * 4);
+        }
+        if (stats) {
+            FSRCpuTileTiming& timing = stats->tiles[tile];
+            timing.x = rect.x0;
+            timing.y = rect.y0;
+            timing.easuWorker = worker;
+            timing.easuMs = (float)elapsedMs(tileStart);
+        }
+    });
+    if (stats) {
+        stats->easuMs = elapsedMs(start);
+        stats->steals = pool.lastStealCount();
+    }
+
+    const auto rcasStart = std::chrono::steady_clock::now();
+    pool.parallelFor(tilesX * tilesY, [&](uint32_t tile, uint32_t worker) {
+        const TileRect rect = tileRect(tile, tilesX, tileSize, fsrData.output);
+
+        const auto tileStart = std::chrono::steady_clock::now();
+        for (uint32_t y = rect.y0; y < rect.y1; y++) {
+            rcasSpan(rcasCon, easuOutput.data(), fsrData.output, y, rect.x0, rect.x1, output + ((size_t)y * width + rect.x0) * 4);
+        }
+        if (stats) {
+            FSRCpuTileTiming& timing = stats->tiles[tile];
+            timing.rcasWorker = worker;
+            timing.rcasMs = (float)elapsedMs(tileStart);
+        }
+    });
+    if (stats) {
+        stats->rcasMs = elapsedMs(rcasStart);
+        stats->totalMs = elapsedMs(start);
+        stats->steals += pool.lastStealCount();
+    }
+}
+
+void runFSRCpuFused(ThreadPool& pool, const FSRConstants& fsrData, const uint8_t* input, float* output,
+                    uint32_t tileSize, FSRCpuTileStats* stats) {
+    TRACE_ZONE("runFSRCpuFused");
+    if (tileSize == 0) {
+        tileSize = pickTileSize(fsrData);
+    }
+
+    const uint32_t width = fsrData.output.width;
+    const uint32_t height = fsrData.output.height;
+    const uint32_t tilesX = (width + (tileSize - 1)) / tileSize;
+    const uint32_t tilesY = (height + (tileSize - 1)) / tileSize;
+
+    if (stats) {
+        initStats(stats, pool, fsrData, tileSize, tilesX, tilesY);
+    }
+
+    const EasuCpuConstants easuCon = unpackEasuConstants(fsrData);
+    const RcasCpuConstants rcasCon = unpackRcasConstants(fsrData);
+    const EasuSpanFn easuSpan = activeEasuSpan();
+    const RcasSpanFn rcasSpan = activeRcasSpan();
+
+    // One EASU buffer of the tile plus a 1 pixel apron per worker, reused for all of its tiles.
+    const uint32_t bufferDim = tileSize + 2;
+    const size_t bufferFloats = (size_t)bufferDim * bufferDim * 4;
+    std::vector<float> buffers(bufferFloats * pool.threadCount());
+
+    const auto start = std::chrono::steady_clock::now();
+    pool.parallelFor(tilesX * tilesY, [&](uint32_t tile, uint32_t worker) {
+        const TileRect rect = tileRect(tile, tilesX, tileSize, fsrData.output);
+        float* buffer = buffers.data() + bufferFloats * worker;
+
+        // The buffer is a (w + 2) x (h + 2) image for the RCAS span functions, so the cross around
+        // every tile pixel is inside of it and the clamping in the kernels never kicks in.
+        const Extent bufferExtent = { rect.x1 - rect.x0 + 2, rect.y1 - rect.y0 + 2 };
+        const size_t bufferStride = (size_t)bufferExtent.width * 4;
+
+        const auto tileStart = std::chrono::steady_clock::now();
+
+        // EASU of the tile and the apron, the apron outside of the image repeats the edge pixels
+        // which is the same as the clamped reads of the unfused RCAS.
+        const uint32_t ex0 = rect.x0 > 0 ? rect.x0 - 1 : 0;
+        const uint32_t ex1 = rect.x1 < width ? rect.x1 + 1 : width;
+        const uint32_t bx = ex0 + 1 - rect.x0; // buffer column of ex0
+        for (uint32_t row = 0; row < bufferExtent.height; row++) {
+            int32_t y = (int32_t)rect.y0 - 1 + (int32_t)row;
+            float* dst = buffer + row * bufferStride;
+            if (y < 0 || y >= (int32_t)height) {
+                continue;
+            }
+            easuSpan(easuCon, input, fsrData.input, (uint32_t)y, ex0, ex1, dst + bx * 4);
+            if (rect.x0 == 0) {
+                memcpy(dst, dst + 4, 4 * sizeof(float));
+            }
+            if (rect.x1 == width) {
+                memcpy(dst + (bufferExtent.width - 1) * 4, dst + (bufferExtent.width - 2) * 4, 4 * sizeof(float));
+            }
+        }
+        if (rect.y0 == 0) {
+            memcpy(buffer, buffer + bufferStride, bufferStride * sizeof(float));
+        }
+        if (rect.y1 == height) {
+            float* last = buffer + (bufferExtent.height - 1) * bufferStride;
+            memcpy(last, last - bufferStride, bufferStride * sizeof(float));
+        }
+
+        const auto rcasStart = std::chrono::steady_clock::now();
+        for (uint32_t y = rect.y0; y < rect.y1; y++) {
+            rcasSpan(rcasCon, buffer, bufferExtent, y - rect.y0 + 1, 1, bufferExtent.width - 1,
+                     output + ((size_t)y * width + rect.x0) * 4);
+        }
+
+        if (stats) {
+            FSRCpuTileTiming& timing = stats->tiles[tile];
+            timing.x = rect.x0;
+            timing.y = rect.y0;
+            timing.easuWorker = worker;
+            timing.rcasWorker = worker;
+            timing.easuMs = (float)std::chrono::duration<double, std::milli>(rcasStart - tileStart).count();
+            timing.rcasMs = (float)elapsedMs(rcasStart);
+        }
+    });
+    if (stats) {
+        stats->totalMs = elapsedMs(start);
+        stats->steals = pool.lastStealCount();
+    }
+}
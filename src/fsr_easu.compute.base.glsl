@@ -34,13 +34,35 @@ layout(binding=0) uniform const_buffer
 #define A_GPU 1
 #define A_GLSL 1
 
-#define SAMPLE_SLOW_FALLBACK 1
+// elecro custom: with FSR_TILE_LIST the dispatch is one workgroup per entry of Tiles instead of a
+// grid over the output, each entry is the position (x | y << 16) of a workgroup of the full grid.
+// The list is dispatched in rows of up to 65535 workgroups, see getTileListDispatch.
+#ifdef FSR_TILE_LIST
+    layout(std430, binding=3) readonly buffer tile_list
+    {
+        uint Tiles[];
+    };
+    #define TILE_ENTRY Tiles[gl_WorkGroupID.y * gl_NumWorkGroups.x + gl_WorkGroupID.x]
+    #define WORKGROUP_ID uvec2(TILE_ENTRY & 0xffffu, TILE_ENTRY >> 16u)
+#else
+    #define WORKGROUP_ID gl_WorkGroupID.xy
+#endif
+
+// elecro custom: 0 for the FP16 permutations, which also define A_HALF, FSR_EASU_H and FSR_RCAS_H
+// (those have to be set before ffx_a.h and ffx_fsr1.h, so they come from the define map)
+#ifndef SAMPLE_SLOW_FALLBACK
+    #define SAMPLE_SLOW_FALLBACK 1
+#endif
 //#define SAMPLE_EASU 1
 
 #if SAMPLE_SLOW_FALLBACK
     // GL: removed sampler
     layout(binding=1) uniform sampler2D InputTexture;
-    layout(binding=2,rgba32f) uniform highp image2D OutputTexture;
+    // elecro custom: the format comes from the permutation, it has to match the bound image
+    #ifndef FSR_OUTPUT_FORMAT
+        #define FSR_OUTPUT_FORMAT rgba32f
+    #endif
+    layout(binding=2,FSR_OUTPUT_FORMAT) uniform highp image2D OutputTexture;
 
 
     //layout(binding=1) uniform texture2D InputTexture;
@@ -59,38 +81,77 @@ layout(binding=0) uniform const_buffer
     #endif
     #if SAMPLE_RCAS
         //#define FSR_RCAS_F
-        AF4 FsrRcasLoadF(ASU2 p) { return texelFetch(InputTexture, ASU2(p), 0); }
+        #if SAMPLE_FUSED
+            // elecro custom: fused EASU+RCAS, RCAS reads the EASU result of the 16x16 region
+            // of the workgroup plus a 1 pixel apron from shared memory instead of an image.
+            shared AF3 FusedTile[18 * 18];
+            AF4 FsrRcasLoadF(ASU2 p) {
+                ASU2 t = p - ASU2(WORKGROUP_ID << 4u) + ASU2(1);
+                return AF4(FusedTile[t.y * 18 + t.x], 1.0);
+            }
+        #else
+            // elecro custom: the input can be a pooled texture larger than the output, clamp to the used part
+            AF4 FsrRcasLoadF(ASU2 p) { return texelFetch(InputTexture, clamp(ASU2(p), ASU2(0), ASU2(Extents.zw) - ASU2(1)), 0); }
+        #endif
         //AF4 FsrRcasLoadF(ASU2 p) { return texelFetch(sampler2D(InputTexture,InputSampler), ASU2(p), 0); }
         void FsrRcasInputF(inout AF1 r, inout AF1 g, inout AF1 b) {}
     #endif
 #else
-    #define A_HALF
-    layout(binding=1) uniform texture2D InputTexture;
-    layout(binding=2,rgba16f) uniform image2D OutputTexture;
-    layout(binding=3) uniform sampler InputSampler;
+    // GL: removed sampler, the fetches stay 32 bit and are converted
+    layout(binding=1) uniform sampler2D InputTexture;
+    #ifndef FSR_OUTPUT_FORMAT
+        #define FSR_OUTPUT_FORMAT rgba16f
+    #endif
+    layout(binding=2,FSR_OUTPUT_FORMAT) uniform highp image2D OutputTexture;
     #if SAMPLE_EASU
-        #define FSR_EASU_H 1
-        AH4 FsrEasuRH(AF2 p) { AH4 res = AH4(textureGather(sampler2D(InputTexture,InputSampler), p, 0)); return res; }
-        AH4 FsrEasuGH(AF2 p) { AH4 res = AH4(textureGather(sampler2D(InputTexture,InputSampler), p, 1)); return res; }
-        AH4 FsrEasuBH(AF2 p) { AH4 res = AH4(textureGather(sampler2D(InputTexture,InputSampler), p, 2)); return res; }  
+        AH4 FsrEasuRH(AF2 p) { AH4 res = AH4(textureGather(InputTexture, p, 0)); return res; }
+        AH4 FsrEasuGH(AF2 p) { AH4 res = AH4(textureGather(InputTexture, p, 1)); return res; }
+        AH4 FsrEasuBH(AF2 p) { AH4 res = AH4(textureGather(InputTexture, p, 2)); return res; }
     #endif
     #if SAMPLE_RCAS
-        #define FSR_RCAS_H
-        AH4 FsrRcasLoadH(ASW2 p) { return AH4(texelFetch(sampler2D(InputTexture,InputSampler), ASU2(p), 0)); }
+        #if SAMPLE_FUSED
+            // same tile as the F path, 32 bit shared memory does not need GL_EXT_shader_16bit_storage
+            shared AF3 FusedTile[18 * 18];
+            AH4 FsrRcasLoadH(ASW2 p) {
+                ASU2 t = ASU2(p) - ASU2(WORKGROUP_ID << 4u) + ASU2(1);
+                return AH4(FusedTile[t.y * 18 + t.x], 1.0);
+            }
+        #else
+            AH4 FsrRcasLoadH(ASW2 p) { return AH4(texelFetch(InputTexture, clamp(ASU2(p), ASU2(0), ASU2(Extents.zw) - ASU2(1)), 0)); }
+        #endif
         void FsrRcasInputH(inout AH1 r,inout AH1 g,inout AH1 b){}
+        #ifdef FSR_RCAS_HX2
+            AH4 FsrRcasLoadHx2(ASW2 p) { return FsrRcasLoadH(p); }
+            void FsrRcasInputHx2(inout AH2 r,inout AH2 g,inout AH2 b){}
+        #endif
     #endif
 #endif
 
 //#include "ffx_fsr1.h"
 //#include "ffx_a.h"
 
+// elecro custom: store of the final passes. FSR_TEPD is 8 or 10 for an RGBA8 or RGB10A2 output, the
+// color is quantized with the energy preserving dither of ffx_fsr1.h instead of rounding to nearest.
+// TEPD works on linear color and returns gamma 2.0, squaring first keeps the values in their encoding.
+void FinalStore(ASU2 pos, AF4 c)
+{
+#if FSR_TEPD == 8
+    c.rgb *= c.rgb;
+    FsrTepdC8F(c.rgb, FsrTepdDitF(AU2(pos), 0u));
+#elif FSR_TEPD == 10
+    c.rgb *= c.rgb;
+    FsrTepdC10F(c.rgb, FsrTepdDitF(AU2(pos), 0u));
+#endif
+    imageStore(OutputTexture, pos, c);
+}
+
 void CurrFilter(AU2 pos)
 {
 #if SAMPLE_BILINEAR
     AF2 pp = (AF2(pos) * AF2_AU2(Const0.xy) + AF2_AU2(Const0.zw)) * AF2_AU2(Const1.xy) + AF2(0.5, -0.5) * AF2_AU2(Const1.zw);
-    imageStore(OutputTexture, ASU2(pos), textureLod(InputTexture, pp, 0.0));
+    FinalStore(ASU2(pos), textureLod(InputTexture, pp, 0.0));
 #endif
-#if SAMPLE_EASU
+#if SAMPLE_EASU && !SAMPLE_FUSED
     #if SAMPLE_SLOW_FALLBACK
         AF3 c;
         FsrEasuF(c, pos, Const0, Const1, Const2, Const3);
@@ -100,33 +161,113 @@ void CurrFilter(AU2 pos)
     #else
         AH3 c;
         FsrEasuH(c, pos, Const0, Const1, Const2, Const3);
-        if( Sample.x == 1 )
+        if( Sample.x == 1u )
             c *= c;
-        imageStore(OutputTexture, ASU2(pos), AH4(c, 1));
+        imageStore(OutputTexture, ASU2(pos), AF4(c, 1));
     #endif
 #endif
 #if SAMPLE_RCAS
     #if SAMPLE_SLOW_FALLBACK
+        #ifdef FSR_RCAS_PASSTHROUGH_ALPHA
+        AF4 c;
+        FsrRcasF(c.r, c.g, c.b, c.a, pos, Const0RCAS);
+        if( Sample.x == 1u )
+            c.rgb *= c.rgb;
+        FinalStore(ASU2(pos), c);
+        #else
         AF3 c;
         FsrRcasF(c.r, c.g, c.b, pos, Const0RCAS);
         if( Sample.x == 1u )
             c *= c;
-        imageStore(OutputTexture, ASU2(pos), AF4(c, 1));
-    #else
+        FinalStore(ASU2(pos), AF4(c, 1));
+        #endif
+    #elif !SAMPLE_RCAS_X2
+        #ifdef FSR_RCAS_PASSTHROUGH_ALPHA
+        AH4 c;
+        FsrRcasH(c.r, c.g, c.b, c.a, pos, Const0RCAS);
+        if( Sample.x == 1u )
+            c.rgb *= c.rgb;
+        FinalStore(ASU2(pos), AF4(c));
+        #else
         AH3 c;
-        FsrRcasH(c.r, c.g, c.b, pos, Const0);
-        if( Sample.x == 1 )
+        FsrRcasH(c.r, c.g, c.b, pos, Const0RCAS);
+        if( Sample.x == 1u )
             c *= c;
-        imageStore(OutputTexture, ASU2(pos), AH4(c, 1));
+        FinalStore(ASU2(pos), AF4(c, 1));
+        #endif
     #endif
 #endif
 }
 
+#if SAMPLE_RCAS_X2
+// elecro custom: RCAS of the pixel at pos and of the one 8 pixels to its right, the pixel pairs of FsrRcasHx2
+void CurrFilterX2(AU2 pos)
+{
+    #if SAMPLE_SLOW_FALLBACK
+        // no packed math in FP32, the same two pixels one after the other
+        CurrFilter(pos);
+        CurrFilter(pos + AU2(8u, 0u));
+    #else
+        AH2 r, g, b;
+        AH4 pix0, pix1;
+        #ifdef FSR_RCAS_PASSTHROUGH_ALPHA
+        AH2 a;
+        FsrRcasHx2(r, g, b, a, pos, Const0RCAS);
+        FsrRcasDepackHx2(pix0, pix1, r, g, b);
+        pix0.a = a.x;
+        pix1.a = a.y;
+        #else
+        FsrRcasHx2(r, g, b, pos, Const0RCAS);
+        FsrRcasDepackHx2(pix0, pix1, r, g, b);
+        pix0.a = AH1(1.0);
+        pix1.a = AH1(1.0);
+        #endif
+        if( Sample.x == 1u ) {
+            pix0.rgb *= pix0.rgb;
+            pix1.rgb *= pix1.rgb;
+        }
+        FinalStore(ASU2(pos), AF4(pix0));
+        FinalStore(ASU2(pos) + ASU2(8, 0), AF4(pix1));
+    #endif
+}
+#endif
+
 layout(local_size_x=64) in;
 void main()
 {
+#if SAMPLE_FUSED
+    // EASU for the 18x18 region around the 16x16 output region of the workgroup.
+    // The apron outside of the image repeats the edge pixels, the same as clamped fetches.
+    ASU2 tileOrigin = ASU2(WORKGROUP_ID << 4u) - ASU2(1);
+    for (AU1 i = gl_LocalInvocationID.x; i < 18u * 18u; i += 64u) {
+        ASU2 p = clamp(tileOrigin + ASU2(i % 18u, i / 18u), ASU2(0), ASU2(Extents.zw) - ASU2(1));
+        #if SAMPLE_SLOW_FALLBACK
+        AF3 c;
+        FsrEasuF(c, AU2(p), Const0, Const1, Const2, Const3);
+        #else
+        AH3 c;
+        FsrEasuH(c, AU2(p), Const0, Const1, Const2, Const3);
+        #endif
+        FusedTile[i] = AF3(c);
+    }
+    memoryBarrierShared();
+    barrier();
+#endif
+
+#if SAMPLE_RCAS_X2
+    // elecro custom: each call covers two 8x8 tiles, so a workgroup covers 32x16 pixels and
+    // the dispatch has half the invocations.
+    AU2 gxy = ARmp8x8(gl_LocalInvocationID.x) + AU2(WORKGROUP_ID.x << 5u, WORKGROUP_ID.y << 4u);
+    CurrFilterX2(gxy);
+    gxy.x += 16u;
+    CurrFilterX2(gxy);
+    gxy.y += 8u;
+    CurrFilterX2(gxy);
+    gxy.x -= 16u;
+    CurrFilterX2(gxy);
+#else
     // Do remapping of local xy in workgroup for a more PS-like swizzle pattern.
-    AU2 gxy = ARmp8x8(gl_LocalInvocationID.x) + AU2(gl_WorkGroupID.x << 4u, gl_WorkGroupID.y << 4u);
+    AU2 gxy = ARmp8x8(gl_LocalInvocationID.x) + AU2(WORKGROUP_ID.x << 4u, WORKGROUP_ID.y << 4u);
     CurrFilter(gxy);
     gxy.x += 8u;
     CurrFilter(gxy);
@@ -134,5 +275,6 @@ void main()
     CurrFilter(gxy);
     gxy.x -= 8u;
     CurrFilter(gxy);
+#endif
 }
 
@@ -0,0 +1,433 @@
+#include <glad/glad.h>
+
+#include "fsr_gl.h"
+#include "dirty_tiles.h"
+#include "gpu_pass_timer.h"
+#include "trace.h"
+
+#include <cstdio>
+#include <cstring>
+
+// GL 4.4 / GL_ARB_buffer_storage
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+
+static void beginPass(GpuPassTimer* timer, GpuPass pass) {
+    if (timer) {
+        timer->begin(pass);
+    }
+}
+
+static void endPass(GpuPassTimer* timer, GpuPass pass) {
+    if (timer) {
+        timer->end(pass);
+    }
+}
+
+void runFSR(struct FSRConstants fsrData, uint32_t fsrProgramEASU, uint32_t fsrProgramRCAS, uint32_t fsrData_vbo, uint32_t inputImage,
+            uint32_t intermediateImage, uint32_t intermediateFormat, uint32_t outputImage, uint32_t outputFormat, bool rcasX2,
+            GpuPassTimer* timer) {
+    TRACE_ZONE("runFSR");
+    uint32_t displayWidth = fsrData.output.width;
+    uint32_t displayHeight = fsrData.output.height;
+
+    static const int threadGroupWorkRegionDim = 16;
+    int dispatchX = (displayWidth + (threadGroupWorkRegionDim - 1)) / threadGroupWorkRegionDim;
+    int dispatchY = (displayHeight + (threadGroupWorkRegionDim - 1)) / threadGroupWorkRegionDim;
+
+
+    // binding point constants in the shaders
+    const int inFSRDataPos = 0;
+    const int inFSRInputTexture = 1;
+    const int inFSROutputTexture = 2;
+
+    { // run FSR EASU
+        glUseProgram(fsrProgramEASU);
+
+        // connect the input uniform data
+        glBindBufferBase(GL_UNIFORM_BUFFER, inFSRDataPos, fsrData_vbo);
+
+        // bind the input image to a texture unit
+        glActiveTexture(GL_TEXTURE0 + inFSRInputTexture);
+        glBindTexture(GL_TEXTURE_2D, inputImage);
+
+        // connect the intermediate image
+        glBindImageTexture(inFSROutputTexture, intermediateImage, 0, GL_FALSE, 0, GL_WRITE_ONLY, intermediateFormat);
+
+        beginPass(timer, GpuPass::EASU);
+        glDispatchCompute(dispatchX, dispatchY, 1);
+        endPass(timer, GpuPass::EASU);
+
+        // the image stores have to be visible to the texelFetch of RCAS, no need to stall the CPU for that
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+    }
+
+    {
+        // FSR RCAS
+        // connect the input uniform data
+        glBindBufferBase(GL_UNIFORM_BUFFER, inFSRDataPos, fsrData_vbo);
+
+        // connect the previous image's output as input
+        glActiveTexture(GL_TEXTURE0 + inFSRInputTexture);
+        glBindTexture(GL_TEXTURE_2D, intermediateImage);
+
+        // connect the output image
+        glBindImageTexture(inFSROutputTexture, outputImage, 0, GL_FALSE, 0, GL_WRITE_ONLY, outputFormat);
+
+        glUseProgram(fsrProgramRCAS);
+        // the x2 program does two 8x8 tiles per call, 32x16 pixels per workgroup
+        beginPass(timer, GpuPass::RCAS);
+        glDispatchCompute(rcasX2 ? (displayWidth + 31) / 32 : dispatchX, dispatchY, 1);
+        endPass(timer, GpuPass::RCAS);
+
+        // the output is sampled next (UI, readback, another pass)
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+    }
+}
+
+void runFSRFused(struct FSRConstants fsrData, uint32_t fsrProgramFused, uint32_t fsrData_vbo, uint32_t inputImage, uint32_t outputImage, uint32_t outputFormat,
+                 GpuPassTimer* timer) {
+    TRACE_ZONE("runFSRFused");
+    uint32_t displayWidth = fsrData.output.width;
+    uint32_t displayHeight = fsrData.output.height;
+
+    // must match the 16x16 region + apron of the shared memory tile in the shader
+    static const int threadGroupWorkRegionDim = 16;
+    int dispatchX = (displayWidth + (threadGroupWorkRegionDim - 1)) / threadGroupWorkRegionDim;
+    int dispatchY = (displayHeight + (threadGroupWorkRegionDim - 1)) / threadGroupWorkRegionDim;
+
+    // binding point constants in the shaders
+    const int inFSRDataPos = 0;
+    const int inFSRInputTexture = 1;
+    const int inFSROutputTexture = 2;
+
+    glUseProgram(fsrProgramFused);
+
+    // connect the input uniform data
+    glBindBufferBase(GL_UNIFORM_BUFFER, inFSRDataPos, fsrData_vbo);
+
+    // bind the input image to a texture unit
+    glActiveTexture(GL_TEXTURE0 + inFSRInputTexture);
+    glBindTexture(GL_TEXTURE_2D, inputImage);
+
+    // connect the output image
+    glBindImageTexture(inFSROutputTexture, outputImage, 0, GL_FALSE, 0, GL_WRITE_ONLY, outputFormat);
+
+    beginPass(timer, GpuPass::Fused);
+    glDispatchCompute(dispatchX, dispatchY, 1);
+    endPass(timer, GpuPass::Fused);
+
+    // the output is sampled next (UI, readback, another pass)
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+}
+
+// The tile lists index the workgroup grid of the output they were made for.
+static bool tilesMatch(const char* name, const FSRConstants& fsrData, const DirtyTiles& tiles) {
+    if (tiles.output().width != fsrData.output.width || tiles.output().height != fsrData.output.height) {
+        printf("%s: tiles of a %ux%u output for %ux%u\n", name, tiles.output().width, tiles.output().height,
+               fsrData.output.width, fsrData.output.height);
+        return false;
+    }
+    return true;
+}
+
+// One workgroup per entry of the tile list bound at 'buffer', nothing to do for an empty list.
+static void dispatchTileList(uint32_t buffer, uint32_t count) {
+    // binding point of the tile_list buffer in the shader
+    const int inFSRTileList = 3;
+
+    if (count == 0) {
+        return;
+    }
+    uint32_t groupsX, groupsY;
+    getTileListDispatch(count, &groupsX, &groupsY);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, inFSRTileList, buffer);
+    glDispatchCompute(groupsX, groupsY, 1);
+}
+
+void runFSRTiles(struct FSRConstants fsrData, uint32_t fsrProgramEASU, uint32_t fsrProgramRCAS, uint32_t fsrData_vbo, uint32_t inputImage,
+                 uint32_t intermediateImage, uint32_t intermediateFormat, uint32_t outputImage, uint32_t outputFormat, DirtyTiles& tiles,
+                 GpuPassTimer* timer) {
+    TRACE_ZONE("runFSRTiles");
+    if (!tilesMatch("runFSRTiles", fsrData, tiles)) {
+        return;
+    }
+    tiles.upload();
+
+    // binding point constants in the shaders
+    const int inFSRDataPos = 0;
+    const int inFSRInputTexture = 1;
+    const int inFSROutputTexture = 2;
+
+    { // run FSR EASU on the changed part of the intermediate image
+        glUseProgram(fsrProgramEASU);
+        glBindBufferBase(GL_UNIFORM_BUFFER, inFSRDataPos, fsrData_vbo);
+        glActiveTexture(GL_TEXTURE0 + inFSRInputTexture);
+        glBindTexture(GL_TEXTURE_2D, inputImage);
+        glBindImageTexture(inFSROutputTexture, intermediateImage, 0, GL_FALSE, 0, GL_WRITE_ONLY, intermediateFormat);
+
+        beginPass(timer, GpuPass::EASU);
+        dispatchTileList(tiles.easuBuffer(), (uint32_t)tiles.easu().size());
+        endPass(timer, GpuPass::EASU);
+
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+    }
+
+    { // FSR RCAS of everything reading a changed EASU pixel
+        glBindBufferBase(GL_UNIFORM_BUFFER, inFSRDataPos, fsrData_vbo);
+        glActiveTexture(GL_TEXTURE0 + inFSRInputTexture);
+        glBindTexture(GL_TEXTURE_2D, intermediateImage);
+        glBindImageTexture(inFSROutputTexture, outputImage, 0, GL_FALSE, 0, GL_WRITE_ONLY, outputFormat);
+
+        glUseProgram(fsrProgramRCAS);
+        beginPass(timer, GpuPass::RCAS);
+        dispatchTileList(tiles.rcasBuffer(), (uint32_t)tiles.rcas().size());
+        endPass(timer, GpuPass::RCAS);
+
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+    }
+}
+
+void runFSRFusedTiles(struct FSRConstants fsrData, uint32_t fsrProgramFused, uint32_t fsrData_vbo, uint32_t inputImage, uint32_t outputImage,
+                      uint32_t outputFormat, DirtyTiles& tiles, GpuPassTimer* timer) {
+    TRACE_ZONE("runFSRFusedTiles");
+    if (!tilesMatch("runFSRFusedTiles", fsrData, tiles)) {
+        return;
+    }
+    tiles.upload();
+
+    // binding point constants in the shaders
+    const int inFSRDataPos = 0;
+    const int inFSRInputTexture = 1;
+    const int inFSROutputTexture = 2;
+
+    glUseProgram(fsrProgramFused);
+    glBindBufferBase(GL_UNIFORM_BUFFER, inFSRDataPos, fsrData_vbo);
+    glActiveTexture(GL_TEXTURE0 + inFSRInputTexture);
+    glBindTexture(GL_TEXTURE_2D, inputImage);
+    glBindImageTexture(inFSROutputTexture, outputImage, 0, GL_FALSE, 0, GL_WRITE_ONLY, outputFormat);
+
+    beginPass(timer, GpuPass::Fused);
+    dispatchTileList(tiles.fusedBuffer(), (uint32_t)tiles.fused().size());
+    endPass(timer, GpuPass::Fused);
+
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+}
+
+void runBilinear(struct FSRConstants fsrData, uint32_t bilinearProgram, int32_t fsrData_vbo, uint32_t inputImage, uint32_t outputImage, uint32_t outputFormat,
+                 GpuPassTimer* timer) {
+    TRACE_ZONE("runBilinear");
+    uint32_t displayWidth = fsrData.output.width;
+    uint32_t displayHeight = fsrData.output.height;
+
+    static const int threadGroupWorkRegionDim = 16;
+    int dispatchX = (displayWidth + (threadGroupWorkRegionDim - 1)) / threadGroupWorkRegionDim;
+    int dispatchY = (displayHeight + (threadGroupWorkRegionDim - 1)) / threadGroupWorkRegionDim;
+
+
+    // binding point constants in the shaders
+    const int inFSRDataPos = 0;
+    const int inFSRInputTexture = 1;
+    const int inFSROutputTexture = 2;
+
+    { // run FSR EASU
+        glUseProgram(bilinearProgram);
+
+        // connect the input uniform data
+        glBindBufferBase(GL_UNIFORM_BUFFER, inFSRDataPos, fsrData_vbo);
+
+        // bind the input image to a texture unit
+        glActiveTexture(GL_TEXTURE0 + inFSRInputTexture);
+        glBindTexture(GL_TEXTURE_2D, inputImage);
+
+        // connect the output image
+        glBindImageTexture(inFSROutputTexture, outputImage, 0, GL_FALSE, 0, GL_WRITE_ONLY, outputFormat);
+
+        beginPass(timer, GpuPass::Bilinear);
+        glDispatchCompute(dispatchX, dispatchY, 1);
+        endPass(timer, GpuPass::Bilinear);
+
+        // the output is sampled next (UI, readback, another pass)
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+    }
+}
+
+// glReadPixels of the top left 'size' pixels as GL_RGBA of 'type' into 'pixels', which holds them.
+static bool readTexture(uint32_t texture, const Extent& size, uint32_t type, void* pixels) {
+    uint32_t fbo;
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+    glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+
+    bool ok = glCheckFramebufferStatus(GL_READ_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    if (ok) {
+        // the passes only put up texture fetch barriers
+        glMemoryBarrier(GL_FRAMEBUFFER_BARRIER_BIT);
+
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, size.width, size.height, GL_RGBA, type, pixels);
+    } else {
+        printf("Texture %u is not readable as a framebuffer\n", texture);
+    }
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    glDeleteFramebuffers(1, &fbo);
+    return ok;
+}
+
+bool readTextureRGBA8(uint32_t texture, const Extent& size, std::vector<uint8_t>* pixels) {
+    TRACE_ZONE("readTextureRGBA8");
+    pixels->resize((size_t)size.width * size.height * 4);
+    return readTexture(texture, size, GL_UNSIGNED_BYTE, pixels->data());
+}
+
+bool readTextureRGBA32F(uint32_t texture, const Extent& size, std::vector<float>* pixels) {
+    TRACE_ZONE("readTextureRGBA32F");
+    pixels->resize((size_t)size.width * size.height * 4);
+    return readTexture(texture, size, GL_FLOAT, pixels->data());
+}
+
+GpuFence::GpuFence(GpuFence&& other)
+    : m_sync(other.m_sync)
+{
+    other.m_sync = nullptr;
+}
+
+GpuFence& GpuFence::operator=(GpuFence&& other) {
+    if (this != &other) {
+        reset();
+        m_sync = other.m_sync;
+        other.m_sync = nullptr;
+    }
+    return *this;
+}
+
+GpuFence::~GpuFence() {
+    reset();
+}
+
+GpuFence GpuFence::insert() {
+    GpuFence fence;
+    fence.m_sync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    // Make sure the fence (and everything before it) reaches the GPU even if nobody waits on it.
+    glFlush();
+    return fence;
+}
+
+bool GpuFence::isSignaled() const {
+    if (!m_sync) {
+        return true;
+    }
+    GLint status = GL_UNSIGNALED;
+    glGetSynciv((GLsync)m_sync, GL_SYNC_STATUS, 1, NULL, &status);
+    return status == GL_SIGNALED;
+}
+
+bool GpuFence::wait(uint64_t timeoutNs) {
+    if (!m_sync) {
+        return true;
+    }
+    GLenum result = glClientWaitSync((GLsync)m_sync, GL_SYNC_FLUSH_COMMANDS_BIT, timeoutNs);
+    if (result == GL_WAIT_FAILED) {
+        printf("glClientWaitSync failed: 0x%x\n", glGetError());
+        return false;
+    }
+    if (result == GL_TIMEOUT_EXPIRED) {
+        return false;
+    }
+
+    reset();
+    return true;
+}
+
+void GpuFence::reset() {
+    if (m_sync) {
+        glDeleteSync((GLsync)m_sync);
+        m_sync = nullptr;
+    }
+}
+
+GpuSubmitQueue::GpuSubmitQueue(uint32_t maxInFlight)
+    : m_maxInFlight(maxInFlight > 0 ? maxInFlight : 1)
+{
+}
+
+GpuSubmitQueue::~GpuSubmitQueue() {
+    drain();
+}
+
+void GpuSubmitQueue::push(GpuFence&& fence) {
+    // Retire what already finished so isSignaled stays cheap for the caller.
+    while (!m_inFlight.empty() && m_inFlight.front().isSignaled()) {
+        m_inFlight.pop_front();
+        m_completed++;
+    }
+
+    while (m_inFlight.size() >= m_maxInFlight) {
+        m_inFlight.front().wait();
+        m_inFlight.pop_front();
+        m_completed++;
+    }
+
+    m_inFlight.push_back(std::move(fence));
+    m_submitted++;
+}
+
+void GpuSubmitQueue::drain() {
+    while (!m_inFlight.empty()) {
+        m_inFlight.front().wait();
+        m_inFlight.pop_front();
+        m_completed++;
+    }
+}
+
+// GL version major.minor or newer, or the extension.
+static bool hasGLVersionOrExtension(GLint requiredMajor, GLint requiredMinor, const char* extension) {
+    GLint major = 0, minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    if (major > requiredMajor || (major == requiredMajor && minor >= requiredMinor)) {
+        return true;
+    }
+
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint idx = 0; idx < count; idx++) {
+        const char* name = (const char*)glGetStringi(GL_EXTENSIONS, idx);
+        if (name && strcmp(name, extension) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool hasGLBufferStorage() {
+    return hasGLVersionOrExtension(4, 4, "GL_ARB_buffer_storage");
+}
+
+bool hasGLTimerQuery() {
+    return hasGLVersionOrExtension(3, 3, "GL_ARB_timer_query");
+}
+
+uint32_t createMappedBuffer(uint32_t target, size_t bytes, uint32_t access, void** mapped) {
+    uint32_t buffer;
+    glGenBuffers(1, &buffer);
+    glBindBuffer(target, buffer);
+    if (mapped) {
+        const GLbitfield flags = access | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(target, bytes, NULL, flags);
+        *mapped = glMapBufferRange(target, 0, bytes, flags);
+        if (*mapped) {
+            return buffer;
+        }
+        glDeleteBuffers(1, &buffer);
+        glGenBuffers(1, &buffer);
+        glBindBuffer(target, buffer);
+    }
+    glBufferData(target, bytes, NULL, (access & GL_MAP_READ_BIT) ? GL_STREAM_READ : GL_STREAM_DRAW);
+    return buffer;
+}
@@ -0,0 +1,113 @@
+#ifndef FSR_GL_H
+#define FSR_GL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include "image_utils.h"
+
+class DirtyTiles;
+class GpuPassTimer;
+
+// The GL passes. They only record commands: images written by a pass are made visible to
+// later texture fetches with glMemoryBarrier, nothing waits for the GPU here.
+// Use GpuFence/GpuSubmitQueue to know when the results are ready on the CPU side.
+
+// The *Format arguments are the sized internal formats of the written images (GL_RGBA32F, GL_RGBA16F, ...),
+// they have to match the FSROutputFormat of the program writing them.
+
+// EASU into intermediateImage, then RCAS from there into outputImage.
+// rcasX2 is for an RCAS program built with FSRPermutation::rcasHx2, its workgroups cover twice the width.
+// With a timer, each dispatch is timed as its GpuPass.
+void runFSR(struct FSRConstants fsrData, uint32_t fsrProgramEASU, uint32_t fsrProgramRCAS, uint32_t fsrData_vbo, uint32_t inputImage,
+            uint32_t intermediateImage, uint32_t intermediateFormat, uint32_t outputImage, uint32_t outputFormat, bool rcasX2 = false,
+            GpuPassTimer* timer = nullptr);
+
+// EASU and RCAS in a single dispatch, see SAMPLE_FUSED in the shader.
+// Saves writing and reading back the full resolution EASU result.
+void runFSRFused(struct FSRConstants fsrData, uint32_t fsrProgramFused, uint32_t fsrData_vbo, uint32_t inputImage, uint32_t outputImage, uint32_t outputFormat,
+                 GpuPassTimer* timer = nullptr);
+
+// runFSR and runFSRFused over the workgroups of 'tiles' only (DirtyTiles::update with the same fsrData),
+// with the FSRPermutation::tileList programs. The rest of intermediateImage and outputImage is what the
+// previous run wrote, so it has to be the same images, size and constants, otherwise do a full run.
+// The rcasHx2 permutation of fsrProgramRCAS has to match the rcasX2 given to DirtyTiles::update.
+// Nothing is dispatched when the tiles were made for another output size.
+void runFSRTiles(struct FSRConstants fsrData, uint32_t fsrProgramEASU, uint32_t fsrProgramRCAS, uint32_t fsrData_vbo, uint32_t inputImage,
+                 uint32_t intermediateImage, uint32_t intermediateFormat, uint32_t outputImage, uint32_t outputFormat, DirtyTiles& tiles,
+                 GpuPassTimer* timer = nullptr);
+void runFSRFusedTiles(struct FSRConstants fsrData, uint32_t fsrProgramFused, uint32_t fsrData_vbo, uint32_t inputImage, uint32_t outputImage,
+                      uint32_t outputFormat, DirtyTiles& tiles, GpuPassTimer* timer = nullptr);
+
+void runBilinear(struct FSRConstants fsrData, uint32_t bilinearProgram, int32_t fsrData_vbo, uint32_t inputImage, uint32_t outputImage, uint32_t outputFormat,
+                 GpuPassTimer* timer = nullptr);
+
+// Reads the top left 'size' pixels of a texture as tightly packed RGBA8, row-major with the top row first.
+// Blocks until the passes writing the texture are done. Returns false if the texture can't be attached to a framebuffer.
+bool readTextureRGBA8(uint32_t texture, const Extent& size, std::vector<uint8_t>* pixels);
+// Same as RGBA32F, for comparing float images without the 8 bit rounding.
+bool readTextureRGBA32F(uint32_t texture, const Extent& size, std::vector<float>* pixels);
+
+// GL 4.4 or GL_ARB_buffer_storage, for persistently mapped buffers.
+bool hasGLBufferStorage();
+// GL 3.3 or GL_ARB_timer_query, for glQueryCounter(GL_TIMESTAMP).
+bool hasGLTimerQuery();
+
+// A new buffer of 'bytes', left bound to 'target' (GL_PIXEL_PACK_BUFFER, GL_PIXEL_UNPACK_BUFFER, ...).
+// With 'mapped' (requires hasGLBufferStorage) it is immutable storage mapped once, persistent and coherent,
+// with 'access' (GL_MAP_READ_BIT or GL_MAP_WRITE_BIT); *mapped is null if that failed. Without it, or
+// when that failed, it is glBufferData storage to be mapped per use. Immutable storage can't grow, for
+// more bytes delete the buffer and create a new one.
+uint32_t createMappedBuffer(uint32_t target, size_t bytes, uint32_t access, void** mapped);
+
+// Completion handle of the GL commands submitted before it, a glFenceSync.
+// Move-only, the sync object is deleted once waited on or destroyed.
+class GpuFence {
+public:
+    GpuFence() = default;
+    GpuFence(GpuFence&& other);
+    GpuFence& operator=(GpuFence&& other);
+    ~GpuFence();
+
+    GpuFence(const GpuFence&) = delete;
+    GpuFence& operator=(const GpuFence&) = delete;
+
+    // Inserts a fence after everything submitted so far and flushes it to the GPU.
+    static GpuFence insert();
+
+    // Non blocking check, an empty fence is always signaled.
+    bool isSignaled() const;
+    // Blocks with glClientWaitSync until signaled or the timeout expired, returns false on timeout or error.
+    bool wait(uint64_t timeoutNs = UINT64_MAX);
+
+private:
+    void reset();
+
+    void* m_sync = nullptr; // GLsync
+};
+
+// Bounded number of frames in flight: push blocks only when 'maxInFlight' fences are pending,
+// waiting for the oldest one. With 1 in flight this is the old submit + glFinish behaviour.
+class GpuSubmitQueue {
+public:
+    explicit GpuSubmitQueue(uint32_t maxInFlight = 2);
+    ~GpuSubmitQueue();
+
+    void push(GpuFence&& fence);
+    // Waits for everything in flight.
+    void drain();
+
+    uint32_t inFlight() const { return (uint32_t)m_inFlight.size(); }
+    uint64_t submitted() const { return m_submitted; }
+    uint64_t completed() const { return m_completed; }
+
+private:
+    uint32_t m_maxInFlight;
+    std::deque<GpuFence> m_inFlight;
+    uint64_t m_submitted = 0;
+    uint64_t m_completed = 0;
+};
+
+#endif /* FSR_GL_H */
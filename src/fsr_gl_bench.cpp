@@ -0,0 +1,182 @@
+// Throughput of synchronous (glFinish per frame) vs pipelined (fences, N frames in flight) submission
+// of the GL FSR passes, on a headless context so it runs in CI on llvmpipe.
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "fsr_gl.h"
+#include "fsr_programs.h"
+#include "gl_headless.h"
+#include "image_utils.h"
+#include "texture_pool.h"
+
+struct BenchResult {
+    double msPerFrame;
+    double blockedMsPerFrame; // CPU time spent waiting for the GPU
+};
+
+// The per frame CPU work of the interactive tool: update the constants, record the passes.
+static void submitFrame(const FSRConstants& fsrData, uint32_t fsrData_vbo, uint32_t fsrProgramEASU, uint32_t fsrProgramRCAS,
+                        uint32_t inputTexture, const FSRTargets& targets) {
+    glBindBuffer(GL_UNIFORM_BUFFER, fsrData_vbo);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(fsrData), &fsrData);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    runFSR(fsrData, fsrProgramEASU, fsrProgramRCAS, fsrData_vbo, inputTexture, targets.intermediate.id, targets.intermediate.format,
+           targets.output.id, targets.output.format);
+}
+
+static BenchResult runSynchronous(uint32_t frames, const FSRConstants& fsrData, uint32_t fsrData_vbo, uint32_t fsrProgramEASU,
+                                  uint32_t fsrProgramRCAS, uint32_t inputTexture, const FSRTargets& targets) {
+    double blockedMs = 0.0;
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t frame = 0; frame < frames; frame++) {
+        submitFrame(fsrData, fsrData_vbo, fsrProgramEASU, fsrProgramRCAS, inputTexture, targets);
+
+        auto waitStart = std::chrono::steady_clock::now();
+        glFinish();
+        blockedMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - waitStart).count();
+    }
+    double totalMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    return { totalMs / frames, blockedMs / frames };
+}
+
+static BenchResult runPipelined(uint32_t frames, uint32_t inFlight, const FSRConstants& fsrData, uint32_t fsrData_vbo, uint32_t fsrProgramEASU,
+                                uint32_t fsrProgramRCAS, uint32_t inputTexture, const FSRTargets& targets) {
+    GpuSubmitQueue queue(inFlight);
+
+    double blockedMs = 0.0;
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t frame = 0; frame < frames; frame++) {
+        submitFrame(fsrData, fsrData_vbo, fsrProgramEASU, fsrProgramRCAS, inputTexture, targets);
+
+        auto waitStart = std::chrono::steady_clock::now();
+        queue.push(GpuFence::insert());
+        blockedMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - waitStart).count();
+    }
+    auto waitStart = std::chrono::steady_clock::now();
+    queue.drain();
+    auto end = std::chrono::steady_clock::now();
+    blockedMs += std::chrono::duration<double, std::milli>(end - waitStart).count();
+    double totalMs = std::chrono::duration<double, std::milli>(end - start).count();
+
+    return { totalMs / frames, blockedMs / frames };
+}
+
+int main(int argc, char** argv) {
+    const char* inputImage = NULL;
+    uint32_t frames = 100;
+    uint32_t inFlight = 3;
+    float resMultiplier = 2.0f;
+    bool half = false;
+
+    for (int idx = 1; idx < argc; idx++) {
+        if (strcmp(argv[idx], "--frames") == 0 && idx + 1 < argc) {
+            frames = (uint32_t)atoi(argv[++idx]);
+        } else if (strcmp(argv[idx], "--in-flight") == 0 && idx + 1 < argc) {
+            inFlight = (uint32_t)atoi(argv[++idx]);
+        } else if (strcmp(argv[idx], "--scale") == 0 && idx + 1 < argc) {
+            resMultiplier = (float)atof(argv[++idx]);
+        } else if (strcmp(argv[idx], "--half") == 0) {
+            half = true;
+        } else if (argv[idx][0] != '-') {
+            inputImage = argv[idx];
+        } else {
+            printf("Usage: %s [image] [--frames N] [--in-flight N] [--scale S] [--half]\n", argv[0]);
+            return -1;
+        }
+    }
+    if (frames == 0) {
+        frames = 1;
+    }
+
+    HeadlessGL gl;
+    if (!createHeadlessGL(&gl)) {
+        return 1;
+    }
+
+    struct FSRConstants fsrData = {};
+    uint32_t inputTexture = 0;
+    if (inputImage) {
+        if (!LoadTextureFromFile(inputImage, &inputTexture, &fsrData.input.width, &fsrData.input.height)) {
+            printf("Unable to load: %s\n", inputImage);
+            return 1;
+        }
+    } else {
+        // 960x540 gradient with some detail for the edge detection
+        fsrData.input = { 960, 540 };
+        std::vector<uint8_t> pixels((size_t)fsrData.input.width * fsrData.input.height * 4);
+        for (uint32_t y = 0; y < fsrData.input.height; y++) {
+            for (uint32_t x = 0; x < fsrData.input.width; x++) {
+                uint8_t* pixel = &pixels[((size_t)y * fsrData.input.width + x) * 4];
+                pixel[0] = (uint8_t)(x * 255 / fsrData.input.width);
+                pixel[1] = (uint8_t)(y * 255 / fsrData.input.height);
+                pixel[2] = ((x / 8) ^ (y / 8)) & 1 ? 255 : 0;
+                pixel[3] = 255;
+            }
+        }
+        LoadTextureFromMemory(pixels.data(), fsrData.input.width, fsrData.input.height, &inputTexture);
+    }
+
+    fsrData.output = { (uint32_t)(fsrData.input.width * resMultiplier), (uint32_t)(fsrData.input.height * resMultiplier) };
+    prepareFSR(&fsrData, 0.25f);
+
+    FSRProgramRegistry programs("src/");
+    const FSRPrecision precision = programs.supportedPrecision(half ? FSRPrecision::Half : FSRPrecision::Float);
+    const FSROutputFormat format = precision == FSRPrecision::Half ? FSROutputFormat::RGBA16F : FSROutputFormat::RGBA32F;
+    const FSRPermutation easuPermutation(FSRPass::EASU, precision, format);
+    const FSRPermutation rcasPermutation(FSRPass::RCAS, precision, format);
+    programs.prefetch({ easuPermutation, rcasPermutation });
+    uint32_t fsrProgramEASU = programs.get(easuPermutation);
+    uint32_t fsrProgramRCAS = programs.get(rcasPermutation);
+    if (fsrProgramEASU == (uint32_t)-3 || fsrProgramRCAS == (uint32_t)-3) {
+        return 1;
+    }
+
+    uint32_t fsrData_vbo;
+    glGenBuffers(1, &fsrData_vbo);
+    glBindBuffer(GL_UNIFORM_BUFFER, fsrData_vbo);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(fsrData), &fsrData, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    {
+        TexturePool texturePool;
+        FSRTargets targets = {};
+        acquireFSRTargets(texturePool, fsrData.output, getFSROutputGLFormat(format), getFSROutputGLFormat(format), &targets);
+
+        // warm up, shader compilation in the driver is lazy on some implementations
+        submitFrame(fsrData, fsrData_vbo, fsrProgramEASU, fsrProgramRCAS, inputTexture, targets);
+        glFinish();
+
+        printf("%ux%u -> %ux%u, %u frames, %s programs, %.1f MiB of targets\n", fsrData.input.width, fsrData.input.height,
+               fsrData.output.width, fsrData.output.height, frames, programs.supportedPrecision(precision) == FSRPrecision::Half ? "FP16" : "FP32",
+               texturePool.allocatedBytes() / (1024.0 * 1024.0));
+        printf("%-24s %10s %10s %14s\n", "mode", "ms/frame", "fps", "blocked ms/fr");
+
+        BenchResult sync = runSynchronous(frames, fsrData, fsrData_vbo, fsrProgramEASU, fsrProgramRCAS, inputTexture, targets);
+        printf("%-24s %10.3f %10.1f %14.3f\n", "sync (glFinish)", sync.msPerFrame, 1000.0 / sync.msPerFrame, sync.blockedMsPerFrame);
+
+        for (uint32_t depth = 1; depth <= inFlight; depth++) {
+            BenchResult pipelined = runPipelined(frames, depth, fsrData, fsrData_vbo, fsrProgramEASU, fsrProgramRCAS, inputTexture, targets);
+            char mode[32];
+            snprintf(mode, sizeof(mode), "pipelined (%u in flight)", depth);
+            printf("%-24s %10.3f %10.1f %14.3f\n", mode, pipelined.msPerFrame, 1000.0 / pipelined.msPerFrame, pipelined.blockedMsPerFrame);
+        }
+
+        texturePool.release(targets.intermediate.id);
+        texturePool.release(targets.output.id);
+    }
+
+    glDeleteBuffers(1, &fsrData_vbo);
+    glDeleteTextures(1, &inputTexture);
+    programs.clear();
+    destroyHeadlessGL(&gl);
+
+    return 0;
+}
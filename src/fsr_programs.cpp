@@ -0,0 +1,354 @@
+#include <glad/glad.h>
+
+#include "fsr_programs.h"
+#include "program_builder.h"
+#include "startup_timeline.h"
+#include "trace.h"
+
+#include <cstdio>
+#include <cstring>
+#include <map>
+
+uint32_t FSRPermutation::key() const {
+    const bool rcas = pass == FSRPass::RCAS || pass == FSRPass::Fused;
+    return (uint32_t)pass
+        | (uint32_t)precision << 2
+        | (uint32_t)output << 3
+        | (uint32_t)(rcas && rcasDenoise) << 5
+        | (uint32_t)(rcas && rcasPassthroughAlpha) << 6
+        | (uint32_t)(pass == FSRPass::RCAS && rcasHx2) << 7
+        | (uint32_t)tileList << 8;
+}
+
+FSRPermutation FSRPermutation::fromKey(uint32_t key) {
+    FSRPermutation permutation;
+    permutation.pass = (FSRPass)(key & 3u);
+    permutation.precision = (FSRPrecision)((key >> 2) & 1u);
+    permutation.output = (FSROutputFormat)((key >> 3) & 3u);
+    permutation.rcasDenoise = (key >> 5) & 1u;
+    permutation.rcasPassthroughAlpha = (key >> 6) & 1u;
+    permutation.rcasHx2 = (key >> 7) & 1u;
+    permutation.tileList = (key >> 8) & 1u;
+    return permutation;
+}
+
+static const char* passName(FSRPass pass) {
+    switch (pass) {
+    case FSRPass::EASU: return "EASU";
+    case FSRPass::RCAS: return "RCAS";
+    case FSRPass::Fused: return "Fused";
+    case FSRPass::Bilinear: return "Bilinear";
+    }
+    return "?";
+}
+
+// The image format layout qualifier.
+static const char* outputQualifier(FSROutputFormat format) {
+    switch (format) {
+    case FSROutputFormat::RGBA32F: return "rgba32f";
+    case FSROutputFormat::RGBA16F: return "rgba16f";
+    case FSROutputFormat::RGBA8: return "rgba8";
+    case FSROutputFormat::RGB10A2: return "rgb10_a2";
+    }
+    return "rgba32f";
+}
+
+const char* getFSROutputFormatName(FSROutputFormat format) {
+    return outputQualifier(format);
+}
+
+bool parseFSROutputFormat(const char* name, FSROutputFormat* format) {
+    const FSROutputFormat formats[] = { FSROutputFormat::RGBA32F, FSROutputFormat::RGBA16F, FSROutputFormat::RGBA8, FSROutputFormat::RGB10A2 };
+    for (FSROutputFormat candidate : formats) {
+        if (strcmp(name, outputQualifier(candidate)) == 0) {
+            *format = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+uint32_t getFSROutputGLFormat(FSROutputFormat format) {
+    switch (format) {
+    case FSROutputFormat::RGBA32F: return GL_RGBA32F;
+    case FSROutputFormat::RGBA16F: return GL_RGBA16F;
+    case FSROutputFormat::RGBA8: return GL_RGBA8;
+    case FSROutputFormat::RGB10A2: return GL_RGB10_A2;
+    }
+    return GL_RGBA32F;
+}
+
+std::string FSRPermutation::name() const {
+    std::string result = passName(pass);
+    result += precision == FSRPrecision::Half ? " H " : " F ";
+    result += outputQualifier(output);
+    if (pass == FSRPass::RCAS || pass == FSRPass::Fused) {
+        result += rcasDenoise ? " +denoise" : "";
+        result += rcasPassthroughAlpha ? " +alpha" : "";
+    }
+    if (pass == FSRPass::RCAS && rcasHx2) {
+        result += " x2";
+    }
+    if (tileList) {
+        result += " tiles";
+    }
+    return result;
+}
+
+static std::unique_ptr<uint8_t> readFile(const char* filename) {
+    FILE* fp = fopen(filename, "r");
+    if (fp == NULL) {
+        printf("Unable to open: %s\n", filename);
+        return 0;
+    }
+
+    fseek(fp, 0L, SEEK_END);
+    size_t fileSize = ftell(fp);
+    fseek(fp, 0L, SEEK_SET);
+
+    std::unique_ptr<uint8_t> buffer(new uint8_t[fileSize + 1]);
+    size_t readSize = fread(buffer.get(), 1, fileSize, fp);
+
+    buffer.get()[readSize] = 0;
+
+    return buffer;
+}
+
+#ifdef FSR_EMBEDDED_SHADERS
+// Generated at build time by shader_embed from the files below.
+#include "fsr_shaders.gen.h"
+
+static const EmbeddedShaderFile* findEmbeddedShader(const std::string& filename) {
+    size_t slash = filename.find_last_of("/\\");
+    const char* name = filename.c_str() + (slash == std::string::npos ? 0 : slash + 1);
+    for (const EmbeddedShaderFile& file : embeddedShaderFiles) {
+        if (strcmp(file.name, name) == 0) {
+            return &file;
+        }
+    }
+    return NULL;
+}
+#endif
+
+// The embedded copy of a file wins when there is one, the file under baseDir is only read otherwise.
+static std::string buildShader(const std::vector<std::string>& headers, const std::vector<std::string>& filenames, const std::map<std::string, std::string>& defines)
+{
+    TRACE_ZONE("buildShader");
+    std::string out;
+    out.reserve(64 * 1024);
+    for (const std::string& header : headers) {
+        out += header;
+        out += '\n';
+    }
+
+    out += "/* DEFINES */\n";
+    for (const auto& item : defines) {
+        out += "#define " + item.first + " " + item.second + "\n";
+    }
+    out += "/*  */\n";
+
+    for (const std::string& filename : filenames) {
+        out += "/* Input file: " + filename + " */\n";
+
+#ifdef FSR_EMBEDDED_SHADERS
+        if (const EmbeddedShaderFile* file = findEmbeddedShader(filename)) {
+            out.append(file->source, file->size);
+            out += '\n';
+            continue;
+        }
+#endif
+
+        std::unique_ptr<uint8_t> data = readFile(filename.c_str());
+        if (data) {
+            out += (const char*)data.get();
+        }
+        out += '\n';
+    }
+
+    return out;
+}
+
+std::string getFSRProgramSource(const FSRPermutation& permutation, const std::string& baseDir) {
+    const bool easu = permutation.pass == FSRPass::EASU || permutation.pass == FSRPass::Fused;
+    const bool rcas = permutation.pass == FSRPass::RCAS || permutation.pass == FSRPass::Fused;
+    const bool half = permutation.precision == FSRPrecision::Half;
+    const bool x2 = permutation.pass == FSRPass::RCAS && permutation.rcasHx2;
+    // the passes writing the final image dither into the compact formats, EASU only writes the intermediate
+    const bool final = permutation.pass != FSRPass::EASU;
+    const char* tepd = !final ? "0" : (permutation.output == FSROutputFormat::RGBA8 ? "8" : (permutation.output == FSROutputFormat::RGB10A2 ? "10" : "0"));
+
+    std::map<std::string, std::string> defines = {
+        { "A_GPU", "1" },
+        { "A_GLSL", "1" },
+        { "SAMPLE_SLOW_FALLBACK", half ? "0" : "1" },
+        { "SAMPLE_EASU", easu ? "1" : "0" },
+        { "SAMPLE_RCAS", rcas ? "1" : "0" },
+        { "SAMPLE_FUSED", permutation.pass == FSRPass::Fused ? "1" : "0" },
+        { "SAMPLE_BILINEAR", permutation.pass == FSRPass::Bilinear ? "1" : "0" },
+        { "SAMPLE_RCAS_X2", x2 ? "1" : "0" },
+        { "FSR_OUTPUT_FORMAT", outputQualifier(permutation.output) },
+        { "FSR_TEPD", tepd },
+    };
+    // ffx_fsr1.h tests these with #ifdef, they must only exist when used
+    if (easu) {
+        defines[half ? "FSR_EASU_H" : "FSR_EASU_F"] = "1";
+    }
+    if (rcas) {
+        defines[half ? (x2 ? "FSR_RCAS_HX2" : "FSR_RCAS_H") : "FSR_RCAS_F"] = "1";
+        if (permutation.rcasDenoise) {
+            defines["FSR_RCAS_DENOISE"] = "1";
+        }
+        if (permutation.rcasPassthroughAlpha) {
+            defines["FSR_RCAS_PASSTHROUGH_ALPHA"] = "1";
+        }
+    }
+    if (permutation.tileList) {
+        defines["FSR_TILE_LIST"] = "1";
+    }
+    if (half) {
+        defines["A_HALF"] = "1";
+        // ffx_a.h requires the Vulkan GLSL extensions, the header below asks for the GL ones as well
+        defines["A_SKIP_EXT"] = "1";
+    }
+
+    std::vector<std::string> files = { baseDir + "ffx_a.h" };
+    // Bilinear only needs it for the FsrTepd functions
+    if (permutation.pass != FSRPass::Bilinear || strcmp(tepd, "0") != 0) {
+        files.push_back(baseDir + "ffx_fsr1.h");
+    }
+    files.push_back(baseDir + "fsr_easu.compute.base.glsl");
+
+    std::vector<std::string> header = {
+        "#version " GLSL_VERION,
+        "#extension GL_ARB_compute_shader : enable",
+        "#extension GL_ARB_gpu_shader5 : enable",
+        "#extension GL_ARB_shader_image_load_store : enable",
+        "#extension GL_EXT_shader_image_load_store : enable",
+        "#extension GL_ARB_shading_language_420pack : enable",
+        "#extension GL_ARB_shading_language_packing : enable",
+    };
+    if (permutation.tileList) {
+        header.push_back("#extension GL_ARB_shader_storage_buffer_object : enable");
+    }
+    if (half) {
+        // enable instead of require, a driver has one of the two pairs at most, the AMD one on desktop GL
+        // (the EXT pair is the Vulkan GLSL one). supportedPrecision() tells by building a program.
+        header.push_back("#extension GL_AMD_gpu_shader_half_float : enable");
+        header.push_back("#extension GL_AMD_gpu_shader_int16 : enable");
+        header.push_back("#extension GL_EXT_shader_16bit_storage : enable");
+        header.push_back("#extension GL_EXT_shader_explicit_arithmetic_types : enable");
+    }
+
+    return buildShader(header, files, defines);
+}
+
+FSRProgramRegistry::FSRProgramRegistry(const std::string& baseDir)
+    : m_baseDir(baseDir)
+{
+}
+
+FSRProgramRegistry::~FSRProgramRegistry() {
+    clear();
+}
+
+void FSRProgramRegistry::clear() {
+    finishPending();
+    for (const auto& item : m_programs) {
+        if (item.second != (uint32_t)-3) {
+            glDeleteProgram(item.second);
+        }
+    }
+    m_programs.clear();
+    m_fallbacks.clear();
+}
+
+FSRPrecision FSRProgramRegistry::supportedPrecision(FSRPrecision requested) {
+    if (requested == FSRPrecision::Float || m_halfFailed) {
+        return FSRPrecision::Float;
+    }
+
+    if (!m_halfProbed) {
+        // GL_EXTENSIONS doesn't tell reliably, build the Half EASU program the callers use. It stays in
+        // the registry, if it fails finishPending() sets m_halfFailed and its Float version replaces it.
+        m_halfProbed = true;
+        prefetch({ FSRPermutation(FSRPass::EASU, FSRPrecision::Half, FSROutputFormat::RGBA16F) });
+        finishPending();
+        if (!m_halfFailed) {
+            printf("FP16 shaders: supported\n");
+        }
+    }
+    return m_halfFailed ? FSRPrecision::Float : FSRPrecision::Half;
+}
+
+void FSRProgramRegistry::prefetch(const std::vector<FSRPermutation>& permutations) {
+    for (const FSRPermutation& permutation : permutations) {
+        const uint32_t key = permutation.key();
+        if (m_programs.count(key) || m_pending.count(key)) {
+            continue;
+        }
+        if (!m_builder) {
+            m_builder.reset(new ProgramBuilder());
+        }
+        m_pending[key] = m_builder->submit(permutation.name(), getFSRProgramSource(permutation, m_baseDir));
+    }
+}
+
+bool FSRProgramRegistry::finishPending(StartupTimeline* timeline) {
+    if (!m_builder) {
+        return true;
+    }
+
+    bool ok = m_builder->finish();
+    if (timeline) {
+        m_builder->addToTimeline(*timeline);
+    }
+    bool othersOk = true;
+    std::vector<FSRPermutation> halfFailed;
+    for (const auto& item : m_pending) {
+        const uint32_t program = m_builder->program(item.second);
+        m_programs[item.first] = program;
+        if (program != (uint32_t)-3) {
+            continue;
+        }
+        if (FSRPermutation::fromKey(item.first).precision == FSRPrecision::Half) {
+            halfFailed.push_back(FSRPermutation::fromKey(item.first));
+        } else {
+            othersOk = false;
+        }
+    }
+    m_pending.clear();
+    m_builder.reset();
+
+    if (halfFailed.empty()) {
+        return ok;
+    }
+
+    // The extensions are there but the driver can't build FSR's half code: the float program of
+    // the same permutation takes its place, it reads and writes the same image formats.
+    if (!m_halfFailed) {
+        printf("FP16 programs failed to build, using FP32\n");
+        m_halfFailed = true;
+    }
+    std::vector<FSRPermutation> fallbacks;
+    for (const FSRPermutation& permutation : halfFailed) {
+        FSRPermutation fallback = permutation;
+        fallback.precision = FSRPrecision::Float;
+        m_fallbacks[permutation.key()] = fallback.key();
+        fallbacks.push_back(fallback);
+    }
+    prefetch(fallbacks);
+    return finishPending(timeline) && othersOk;
+}
+
+uint32_t FSRProgramRegistry::get(const FSRPermutation& permutation) {
+    const uint32_t key = permutation.key();
+    if (!m_programs.count(key)) {
+        if (!m_pending.count(key)) {
+            prefetch({ permutation });
+        }
+        finishPending();
+    }
+
+    auto fallback = m_fallbacks.find(key);
+    return m_programs[fallback != m_fallbacks.end() ? fallback->second : key];
+}
@@ -0,0 +1,120 @@
+#ifndef FSR_PROGRAMS_H
+#define FSR_PROGRAMS_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class ProgramBuilder;
+class StartupTimeline;
+
+// Every compute program is fsr_easu.compute.base.glsl with a different set of defines.
+// A permutation describes that set, key() packs it into a bitmask for the registry below.
+
+enum class FSRPass : uint32_t {
+    EASU,
+    RCAS,
+    Fused,    // EASU+RCAS in one dispatch, see SAMPLE_FUSED
+    Bilinear,
+};
+
+enum class FSRPrecision : uint32_t {
+    Float, // FsrEasuF / FsrRcasF, SAMPLE_SLOW_FALLBACK
+    Half,  // FsrEasuH / FsrRcasH, A_HALF
+};
+
+// Image format of the output image binding, has to match the texture bound to it.
+// RCAS, Fused and Bilinear quantize to RGBA8 and RGB10A2 with the FsrTepdC8F/C10F dither (FSR_TEPD),
+// those two are for the final image only.
+enum class FSROutputFormat : uint32_t {
+    RGBA32F,
+    RGBA16F,
+    RGBA8,
+    RGB10A2,
+};
+
+struct FSRPermutation {
+    FSRPass pass = FSRPass::EASU;
+    FSRPrecision precision = FSRPrecision::Float;
+    FSROutputFormat output = FSROutputFormat::RGBA32F;
+    bool rcasDenoise = false;          // FSR_RCAS_DENOISE, RCAS and Fused only
+    bool rcasPassthroughAlpha = false; // FSR_RCAS_PASSTHROUGH_ALPHA, RCAS and Fused only
+    // RCAS only: two pixels 8 apart per call, the workgroups cover 32x16 pixels (run with rcasX2 in runFSR).
+    // FsrRcasHx2 with packed 16 bit math for Half, FsrRcasF twice for Float.
+    bool rcasHx2 = false;
+    // FSR_TILE_LIST: the workgroups come from a list (DirtyTiles) instead of a grid, see runFSRTiles.
+    bool tileList = false;
+
+    FSRPermutation() = default;
+    explicit FSRPermutation(FSRPass pass_, FSRPrecision precision_ = FSRPrecision::Float,
+                            FSROutputFormat output_ = FSROutputFormat::RGBA32F)
+        : pass(pass_), precision(precision_), output(output_)
+    {
+    }
+
+    // bits 0-1 pass, 2 precision, 3-4 output format, 5 denoise, 6 passthrough alpha, 7 Hx2, 8 tile list.
+    // The RCAS options are dropped for the passes which don't use them, so equal programs share a key.
+    uint32_t key() const;
+    static FSRPermutation fromKey(uint32_t key);
+
+    // "RCAS F rgba32f +denoise x2 tiles", for logs and the startup timeline.
+    std::string name() const;
+};
+
+// GL_RGBA32F etc.
+uint32_t getFSROutputGLFormat(FSROutputFormat format);
+
+// The GLSL layout qualifier, "rgba32f", "rgba16f", "rgba8" or "rgb10_a2", also used on the command line.
+const char* getFSROutputFormatName(FSROutputFormat format);
+bool parseFSROutputFormat(const char* name, FSROutputFormat* format);
+
+// The assembled GLSL of a permutation.
+std::string getFSRProgramSource(const FSRPermutation& permutation, const std::string& baseDir);
+
+// Programs by permutation key, compiled the first time they are asked for and owned by the registry.
+// prefetch() hands a set of them to the driver at once so they compile in parallel (see ProgramBuilder);
+// get() of a prefetched program waits for the whole set.
+// A Half permutation which fails to build is replaced by its Float version, see supportedPrecision().
+class FSRProgramRegistry {
+public:
+    explicit FSRProgramRegistry(const std::string& baseDir);
+    ~FSRProgramRegistry();
+
+    FSRProgramRegistry(const FSRProgramRegistry&) = delete;
+    FSRProgramRegistry& operator=(const FSRProgramRegistry&) = delete;
+
+    // 'requested', unless that is Half and a Half program failed to build. The first call for Half
+    // builds the Half EASU program (RGBA16F) to find out, waiting for it and anything prefetched.
+    // Use it to pick the permutations and the image formats.
+    FSRPrecision supportedPrecision(FSRPrecision requested);
+
+    void prefetch(const std::vector<FSRPermutation>& permutations);
+
+    // Waits for everything prefetched, false if any of them failed.
+    // With a timeline, adds a span per program.
+    bool finishPending(StartupTimeline* timeline = nullptr);
+
+    // The linked program, (uint32_t)-3 if the permutation failed to build (it is not retried).
+    // For a Half permutation that failed, the program of its Float version.
+    uint32_t get(const FSRPermutation& permutation);
+
+    size_t programCount() const { return m_programs.size(); }
+
+    // Deletes all programs, while the context is still current.
+    void clear();
+
+private:
+    std::string m_baseDir;
+    std::unordered_map<uint32_t, uint32_t> m_programs;
+    std::unordered_map<uint32_t, uint32_t> m_fallbacks; // failed Half key -> Float key
+
+    bool m_halfProbed = false;
+    bool m_halfFailed = false;
+
+    std::unique_ptr<ProgramBuilder> m_builder;
+    std::unordered_map<uint32_t, uint32_t> m_pending; // key -> ProgramBuilder handle
+};
+
+#endif /* FSR_PROGRAMS_H */
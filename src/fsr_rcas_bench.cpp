@@ -0,0 +1,179 @@
+// RCAS alone: the FsrRcasF dispatch (one pixel per invocation) vs the x2 permutation (two pixels per
+// invocation, FsrRcasHx2 where FP16 shaders are supported, half the workgroups), on a headless context
+// so it runs on llvmpipe. Then the same on the CPU, the AVX512 float kernel vs the AVX-512 FP16 one.
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "fsr_cpu.h"
+#include "fsr_gl.h"
+#include "fsr_programs.h"
+#include "gl_headless.h"
+#include "image_utils.h"
+#include "texture_pool.h"
+
+// The RCAS half of runFSR, reading an intermediate image filled once by EASU.
+static void dispatchRCAS(const FSRConstants& fsrData, uint32_t fsrProgramRCAS, uint32_t fsrData_vbo, const FSRTargets& targets, bool x2) {
+    glBindBufferBase(GL_UNIFORM_BUFFER, 0, fsrData_vbo);
+    glActiveTexture(GL_TEXTURE0 + 1);
+    glBindTexture(GL_TEXTURE_2D, targets.intermediate.id);
+    glBindImageTexture(2, targets.output.id, 0, GL_FALSE, 0, GL_WRITE_ONLY, targets.output.format);
+
+    glUseProgram(fsrProgramRCAS);
+    glDispatchCompute(x2 ? (fsrData.output.width + 31) / 32 : (fsrData.output.width + 15) / 16, (fsrData.output.height + 15) / 16, 1);
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+}
+
+static double timeRCAS(uint32_t frames, const FSRConstants& fsrData, uint32_t fsrProgramRCAS, uint32_t fsrData_vbo,
+                       const FSRTargets& targets, bool x2) {
+    // warm up, shader compilation in the driver is lazy on some implementations
+    dispatchRCAS(fsrData, fsrProgramRCAS, fsrData_vbo, targets, x2);
+    glFinish();
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t frame = 0; frame < frames; frame++) {
+        dispatchRCAS(fsrData, fsrProgramRCAS, fsrData_vbo, targets, x2);
+        glFinish();
+    }
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / frames;
+}
+
+static double timeRCASCpu(uint32_t frames, const FSRConstants& fsrData, const std::vector<float>& input, std::vector<float>* output) {
+    runRCASCpu(fsrData, input.data(), output->data());
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t frame = 0; frame < frames; frame++) {
+        runRCASCpu(fsrData, input.data(), output->data());
+    }
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / frames;
+}
+
+static uint32_t maxDifference(const std::vector<uint8_t>& a, const std::vector<uint8_t>& b) {
+    uint32_t diff = 0;
+    for (size_t idx = 0; idx < a.size() && idx < b.size(); idx++) {
+        diff = std::max(diff, (uint32_t)std::abs((int)a[idx] - (int)b[idx]));
+    }
+    return diff;
+}
+
+int main(int argc, char** argv) {
+    uint32_t frames = 100;
+    float resMultiplier = 2.0f;
+
+    for (int idx = 1; idx < argc; idx++) {
+        if (strcmp(argv[idx], "--frames") == 0 && idx + 1 < argc) {
+            frames = (uint32_t)atoi(argv[++idx]);
+        } else if (strcmp(argv[idx], "--scale") == 0 && idx + 1 < argc) {
+            resMultiplier = (float)atof(argv[++idx]);
+        } else {
+            printf("Usage: %s [--frames N] [--scale S]\n", argv[0]);
+            return -1;
+        }
+    }
+    if (frames == 0) {
+        frames = 1;
+    }
+
+    // 960x540 gradient with some detail for the sharpening
+    struct FSRConstants fsrData = {};
+    fsrData.input = { 960, 540 };
+    std::vector<uint8_t> pixels((size_t)fsrData.input.width * fsrData.input.height * 4);
+    for (uint32_t y = 0; y < fsrData.input.height; y++) {
+        for (uint32_t x = 0; x < fsrData.input.width; x++) {
+            uint8_t* pixel = &pixels[((size_t)y * fsrData.input.width + x) * 4];
+            pixel[0] = (uint8_t)(x * 255 / fsrData.input.width);
+            pixel[1] = (uint8_t)(y * 255 / fsrData.input.height);
+            pixel[2] = ((x / 8) ^ (y / 8)) & 1 ? 255 : 0;
+            pixel[3] = 255;
+        }
+    }
+    fsrData.output = { (uint32_t)(fsrData.input.width * resMultiplier), (uint32_t)(fsrData.input.height * resMultiplier) };
+    prepareFSR(&fsrData, 0.25f);
+    printf("RCAS at %ux%u, %u frames\n", fsrData.output.width, fsrData.output.height, frames);
+    printf("%-28s %10s %14s\n", "", "ms/frame", "max diff");
+
+    HeadlessGL gl;
+    if (!createHeadlessGL(&gl)) {
+        return 1;
+    }
+
+    uint32_t inputTexture = 0;
+    LoadTextureFromMemory(pixels.data(), fsrData.input.width, fsrData.input.height, &inputTexture);
+
+    FSRProgramRegistry programs("src/");
+    // Hx2 needs the FP16 extensions, without them the x2 layout still runs with FsrRcasF
+    const FSRPrecision precision = programs.supportedPrecision(FSRPrecision::Half);
+    const FSROutputFormat format = precision == FSRPrecision::Half ? FSROutputFormat::RGBA16F : FSROutputFormat::RGBA32F;
+    const FSRPermutation easuPermutation(FSRPass::EASU, FSRPrecision::Float, format);
+    const FSRPermutation rcasPermutation(FSRPass::RCAS, FSRPrecision::Float, format);
+    FSRPermutation rcasX2Permutation(FSRPass::RCAS, precision, format);
+    rcasX2Permutation.rcasHx2 = true;
+    programs.prefetch({ easuPermutation, rcasPermutation, rcasX2Permutation });
+    uint32_t fsrProgramEASU = programs.get(easuPermutation);
+    uint32_t fsrProgramRCAS = programs.get(rcasPermutation);
+    uint32_t fsrProgramRCASX2 = programs.get(rcasX2Permutation);
+    if (fsrProgramEASU == (uint32_t)-3 || fsrProgramRCAS == (uint32_t)-3 || fsrProgramRCASX2 == (uint32_t)-3) {
+        return 1;
+    }
+
+    uint32_t fsrData_vbo;
+    glGenBuffers(1, &fsrData_vbo);
+    glBindBuffer(GL_UNIFORM_BUFFER, fsrData_vbo);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(fsrData), &fsrData, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    {
+        TexturePool texturePool;
+        FSRTargets targets = {};
+        acquireFSRTargets(texturePool, fsrData.output, getFSROutputGLFormat(format), getFSROutputGLFormat(format), &targets);
+
+        runFSR(fsrData, fsrProgramEASU, fsrProgramRCAS, fsrData_vbo, inputTexture, targets.intermediate.id, targets.intermediate.format,
+               targets.output.id, targets.output.format);
+
+        std::vector<uint8_t> reference, result;
+        double ms = timeRCAS(frames, fsrData, fsrProgramRCAS, fsrData_vbo, targets, false);
+        readTextureRGBA8(targets.output.id, fsrData.output, &reference);
+        printf("%-28s %10.3f %14s\n", "GL FsrRcasF", ms, "-");
+
+        ms = timeRCAS(frames, fsrData, fsrProgramRCASX2, fsrData_vbo, targets, true);
+        readTextureRGBA8(targets.output.id, fsrData.output, &result);
+        printf("%-28s %10.3f %14u\n", precision == FSRPrecision::Half ? "GL FsrRcasHx2" : "GL FsrRcasF x2 layout", ms,
+               maxDifference(reference, result));
+
+        texturePool.release(targets.intermediate.id);
+        texturePool.release(targets.output.id);
+    }
+
+    glDeleteBuffers(1, &fsrData_vbo);
+    glDeleteTextures(1, &inputTexture);
+    programs.clear();
+    destroyHeadlessGL(&gl);
+
+    // CPU, the same EASU result sharpened by both kernels
+    const size_t outputFloats = (size_t)fsrData.output.width * fsrData.output.height * 4;
+    std::vector<float> easu(outputFloats), reference(outputFloats), result(outputFloats);
+    runEASUCpu(fsrData, pixels.data(), easu.data());
+
+    setFSRCpuKernel(FSRCpuKernel::AVX512);
+    const FSRCpuKernel floatKernel = getFSRCpuKernel();
+    double ms = timeRCASCpu(frames, fsrData, easu, &reference);
+    printf("CPU %-24s %10.3f %14s\n", getFSRCpuKernelName(floatKernel), ms, "-");
+
+    setFSRCpuKernel(FSRCpuKernel::AVX512FP16);
+    if (getFSRCpuKernel() != FSRCpuKernel::AVX512FP16) {
+        return 0;
+    }
+    ms = timeRCASCpu(frames, fsrData, easu, &result);
+    float diff = 0.0f;
+    for (size_t idx = 0; idx < outputFloats; idx++) {
+        diff = std::max(diff, std::fabs(reference[idx] - result[idx]));
+    }
+    printf("CPU %-24s %10.3f %14.5f\n", getFSRCpuKernelName(FSRCpuKernel::AVX512FP16), ms, diff);
+
+    return 0;
+}
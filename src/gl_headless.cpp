@@ -0,0 +1,107 @@
+#include <glad/glad.h>
+
+#include "gl_headless.h"
+
+#include <cstdio>
+
+#if FSR_HAS_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include <cstring>
+
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
+
+static EGLDisplay getDisplay() {
+    const char* extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+
+    if (extensions && getPlatformDisplay && strstr(extensions, "EGL_MESA_platform_surfaceless")) {
+        EGLDisplay display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+        if (display != EGL_NO_DISPLAY) {
+            return display;
+        }
+    }
+    return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+bool createHeadlessGL(HeadlessGL* gl, int major, int minor) {
+    gl->display = NULL;
+    gl->context = NULL;
+
+    EGLDisplay display = getDisplay();
+    EGLint eglMajor, eglMinor;
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, &eglMajor, &eglMinor)) {
+        printf("Unable to initialize EGL\n");
+        return false;
+    }
+
+    if (!eglBindAPI(EGL_OPENGL_API)) {
+        printf("EGL has no desktop OpenGL\n");
+        eglTerminate(display);
+        return false;
+    }
+
+    // No surface at all: EGL_KHR_no_config_context + EGL_KHR_surfaceless_context (core in EGL 1.5).
+    const EGLint attribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION, major,
+        EGL_CONTEXT_MINOR_VERSION, minor,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE,
+    };
+    EGLContext context = eglCreateContext(display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, attribs);
+    if (context == EGL_NO_CONTEXT) {
+        printf("Unable to create a GL %d.%d core context: 0x%x\n", major, minor, eglGetError());
+        eglTerminate(display);
+        return false;
+    }
+
+    if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+        printf("Unable to make the surfaceless context current: 0x%x\n", eglGetError());
+        eglDestroyContext(display, context);
+        eglTerminate(display);
+        return false;
+    }
+
+    if (!gladLoadGLLoader((GLADloadproc)eglGetProcAddress)) {
+        printf("Failed to initialize GLAD\n");
+        eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        eglDestroyContext(display, context);
+        eglTerminate(display);
+        return false;
+    }
+
+    printf("GL: %s (%s)\n", glGetString(GL_RENDERER), glGetString(GL_VERSION));
+
+    gl->display = display;
+    gl->context = context;
+    return true;
+}
+
+void destroyHeadlessGL(HeadlessGL* gl) {
+    if (!gl->display) {
+        return;
+    }
+    eglMakeCurrent((EGLDisplay)gl->display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    eglDestroyContext((EGLDisplay)gl->display, (EGLContext)gl->context);
+    eglTerminate((EGLDisplay)gl->display);
+    gl->display = NULL;
+    gl->context = NULL;
+}
+
+#else
+
+bool createHeadlessGL(HeadlessGL* gl, int, int) {
+    gl->display = NULL;
+    gl->context = NULL;
+    printf("Headless GL needs EGL, which is not available in this build\n");
+    return false;
+}
+
+void destroyHeadlessGL(HeadlessGL*) {
+}
+
+#endif /* FSR_HAS_EGL */
@@ -0,0 +1,18 @@
+#ifndef GL_HEADLESS_H
+#define GL_HEADLESS_H
+
+// OpenGL context without a window or a display server, for batch processing and benchmarks.
+//
+// Uses EGL on the Mesa surfaceless platform when available (works with llvmpipe in CI),
+// otherwise the default EGL display. Nothing is rendered to a surface, all passes write to
+// textures. Only available where EGL is (FSR_HAS_EGL), createHeadlessGL fails elsewhere.
+struct HeadlessGL {
+    void* display; // EGLDisplay
+    void* context; // EGLContext
+};
+
+// Creates a core profile context of at least major.minor, makes it current and loads glad.
+bool createHeadlessGL(HeadlessGL* gl, int major = 4, int minor = 3);
+void destroyHeadlessGL(HeadlessGL* gl);
+
+#endif /* GL_HEADLESS_H */
@@ -0,0 +1,211 @@
+#include <glad/glad.h>
+
+#include "gpu_pass_timer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+#include "fsr_gl.h"
+#include "trace.h"
+
+const char* getGpuPassName(GpuPass pass) {
+    switch (pass) {
+        case GpuPass::EASU: return "EASU";
+        case GpuPass::RCAS: return "RCAS";
+        case GpuPass::Fused: return "Fused";
+        case GpuPass::Bilinear: return "Bilinear";
+        default: return "?";
+    }
+}
+
+GpuPassTimer::GpuPassTimer(uint32_t ringSize, uint32_t window)
+    : m_window(window > 0 ? window : 1)
+{
+    m_supported = hasGLTimerQuery();
+    if (!m_supported) {
+        printf("No GL timer queries, GPU pass times are not available\n");
+        return;
+    }
+
+    m_ring.resize(ringSize > 0 ? ringSize : 1);
+    for (Query& query : m_ring) {
+        glGenQueries(2, query.ids);
+    }
+    for (History& history : m_history) {
+        history.ms.reserve(m_window);
+    }
+
+    if (traceEnabled()) {
+        // GL_TIMESTAMP is the GPU's clock, read between two CPU reads. Good to the time the
+        // query takes, drift over a run is not corrected.
+        m_traceTrack = traceTrack("GPU");
+        const uint64_t cpuBefore = traceNowNs();
+        GLint64 gpuNow = 0;
+        glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+        const uint64_t cpuAfter = traceNowNs();
+        m_gpuToCpuNs = (int64_t)(cpuBefore + (cpuAfter - cpuBefore) / 2) - (int64_t)gpuNow;
+    }
+}
+
+GpuPassTimer::~GpuPassTimer() {
+    for (Query& query : m_ring) {
+        glDeleteQueries(2, query.ids);
+    }
+}
+
+void GpuPassTimer::begin(GpuPass pass) {
+    if (!m_supported || m_open) {
+        return;
+    }
+    if (m_pending == m_ring.size()) {
+        retire(false);
+    }
+    if (m_pending == m_ring.size()) {
+        // the GPU is more than a ring behind, better a missing sample than a stall
+        m_dropped++;
+        return;
+    }
+
+    Query& query = m_ring[(m_head + m_pending) % m_ring.size()];
+    query.pass = pass;
+    glQueryCounter(query.ids[0], GL_TIMESTAMP);
+    m_open = true;
+}
+
+void GpuPassTimer::end(GpuPass pass) {
+    if (!m_open) {
+        return;
+    }
+    Query& query = m_ring[(m_head + m_pending) % m_ring.size()];
+    if (query.pass == pass) {
+        glQueryCounter(query.ids[1], GL_TIMESTAMP);
+        m_pending++;
+    }
+    m_open = false;
+}
+
+void GpuPassTimer::collect() {
+    while (retire(false)) {
+    }
+}
+
+void GpuPassTimer::drain() {
+    while (retire(true)) {
+    }
+}
+
+// Reads the oldest pending pair, returns false if there is none or it is not done and !wait.
+bool GpuPassTimer::retire(bool wait) {
+    if (m_pending == 0) {
+        return false;
+    }
+    const Query& query = m_ring[m_head];
+    if (!wait) {
+        // the end timestamp comes after the begin one, once it is there both are
+        GLint available = GL_FALSE;
+        glGetQueryObjectiv(query.ids[1], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) {
+            return false;
+        }
+    }
+
+    GLuint64 beginNs = 0, endNs = 0;
+    glGetQueryObjectui64v(query.ids[0], GL_QUERY_RESULT, &beginNs);
+    glGetQueryObjectui64v(query.ids[1], GL_QUERY_RESULT, &endNs);
+    m_head = (m_head + 1) % m_ring.size();
+    m_pending--;
+
+    if (m_traceTrack) {
+        traceTrackSpan(m_traceTrack, getGpuPassName(query.pass), beginNs + m_gpuToCpuNs, endNs + m_gpuToCpuNs);
+    }
+
+    History& history = m_history[(uint32_t)query.pass];
+    history.lastMs = endNs > beginNs ? (endNs - beginNs) / 1e6 : 0.0;
+    if (history.ms.size() < m_window) {
+        history.ms.push_back((float)history.lastMs);
+    } else {
+        history.ms[history.next] = (float)history.lastMs;
+    }
+    history.next = (history.next + 1) % m_window;
+    history.samples++;
+    return true;
+}
+
+GpuPassStats GpuPassTimer::stats(GpuPass pass) const {
+    GpuPassStats stats;
+    const History& history = m_history[(uint32_t)pass];
+    if (history.ms.empty()) {
+        return stats;
+    }
+
+    std::vector<float> sorted = history.ms;
+    std::sort(sorted.begin(), sorted.end());
+    double sum = 0.0;
+    for (float ms : sorted) {
+        sum += ms;
+    }
+    // nearest rank
+    const size_t p99 = (size_t)std::ceil(sorted.size() * 0.99) - 1;
+
+    stats.samples = history.samples;
+    stats.window = (uint32_t)sorted.size();
+    stats.lastMs = history.lastMs;
+    stats.minMs = sorted.front();
+    stats.avgMs = sum / sorted.size();
+    stats.p99Ms = sorted[std::min(p99, sorted.size() - 1)];
+    return stats;
+}
+
+void GpuPassTimer::reset() {
+    for (History& history : m_history) {
+        history.ms.clear();
+        history.next = 0;
+        history.samples = 0;
+        history.lastMs = 0.0;
+    }
+}
+
+void GpuPassTimer::print() const {
+    printf("%-8s %8s %10s %10s %10s\n", "GPU pass", "samples", "min ms", "avg ms", "p99 ms");
+    for (uint32_t pass = 0; pass < (uint32_t)GpuPass::Count; pass++) {
+        const GpuPassStats stats = this->stats((GpuPass)pass);
+        if (stats.samples == 0) {
+            continue;
+        }
+        printf("%-8s %8llu %10.3f %10.3f %10.3f\n", getGpuPassName((GpuPass)pass), (unsigned long long)stats.samples,
+               stats.minMs, stats.avgMs, stats.p99Ms);
+    }
+    if (m_dropped) {
+        printf("%llu GPU pass samples dropped, the query ring was full\n", (unsigned long long)m_dropped);
+    }
+}
+
+bool GpuPassTimer::writeJson(const std::string& filename) const {
+    FILE* fp = fopen(filename.c_str(), "w");
+    if (fp == NULL) {
+        printf("Unable to open: %s\n", filename.c_str());
+        return false;
+    }
+
+    fprintf(fp, "{\n  \"supported\": %s,\n  \"dropped\": %llu,\n  \"passes\": {", m_supported ? "true" : "false",
+            (unsigned long long)m_dropped);
+    const char* separator = "\n";
+    for (uint32_t pass = 0; pass < (uint32_t)GpuPass::Count; pass++) {
+        const GpuPassStats stats = this->stats((GpuPass)pass);
+        if (stats.samples == 0) {
+            continue;
+        }
+        fprintf(fp, "%s    \"%s\": {\"samples\": %llu, \"window\": %u, \"last_ms\": %.6f, \"min_ms\": %.6f, \"avg_ms\": %.6f, \"p99_ms\": %.6f}",
+                separator, getGpuPassName((GpuPass)pass), (unsigned long long)stats.samples, stats.window, stats.lastMs,
+                stats.minMs, stats.avgMs, stats.p99Ms);
+        separator = ",\n";
+    }
+    fprintf(fp, "\n  }\n}\n");
+
+    if (fclose(fp) != 0) {
+        printf("Unable to write: %s\n", filename.c_str());
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,98 @@
+#ifndef GPU_PASS_TIMER_H
+#define GPU_PASS_TIMER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// The dispatches timed by GpuPassTimer, see runFSR, runFSRFused and runBilinear.
+enum class GpuPass : uint32_t {
+    EASU,
+    RCAS,
+    Fused,
+    Bilinear,
+    Count,
+};
+
+const char* getGpuPassName(GpuPass pass);
+
+// Over the samples in the rolling window of a pass.
+struct GpuPassStats {
+    uint64_t samples = 0; // since the start, the window only keeps the last ones
+    uint32_t window = 0;  // samples the min/avg/p99 are taken over
+    double lastMs = 0.0;
+    double minMs = 0.0;
+    double avgMs = 0.0;
+    double p99Ms = 0.0;
+};
+
+// GPU time of each pass from a pair of glQueryCounter(GL_TIMESTAMP) around its dispatch.
+//
+// The query pairs are a ring in submission order. collect() reads the results of the pairs the
+// GPU is done with and stops at the first one still pending, it never waits: the results arrive a
+// frame or two late. If the ring is full of pending pairs, begin() drops the sample instead of
+// stalling, dropped() counts them. Needs GL 3.3 or GL_ARB_timer_query, otherwise every call is a no-op.
+//
+// While a trace is recorded (trace.h) the passes also go to a "GPU" track, moved onto the CPU
+// timeline by the offset between GL_TIMESTAMP and steady_clock measured when the timer is made.
+//
+// Needs the GL context current on the calling thread, also in the destructor.
+class GpuPassTimer {
+public:
+    // 'ringSize' query pairs in flight, min/avg/p99 over the last 'window' samples of each pass.
+    explicit GpuPassTimer(uint32_t ringSize = 16, uint32_t window = 256);
+    ~GpuPassTimer();
+
+    GpuPassTimer(const GpuPassTimer&) = delete;
+    GpuPassTimer& operator=(const GpuPassTimer&) = delete;
+
+    bool supported() const { return m_supported; }
+
+    // Around the dispatch of a pass, passes don't nest.
+    void begin(GpuPass pass);
+    void end(GpuPass pass);
+
+    // Reads the finished pairs without blocking, call once per frame.
+    void collect();
+    // Blocks until every pair submitted so far has its result, for the end of a run.
+    void drain();
+
+    GpuPassStats stats(GpuPass pass) const;
+    uint64_t dropped() const { return m_dropped; }
+    // Forgets the samples, after the passes changed (other program, output size).
+    void reset();
+
+    // A line per pass which has samples.
+    void print() const;
+    // {"passes": {"EASU": {"samples": .., "min_ms": .., ...}, ...}, "dropped": ..}, prints and returns false on errors.
+    bool writeJson(const std::string& filename) const;
+
+private:
+    struct Query {
+        uint32_t ids[2] = {}; // begin and end timestamps
+        GpuPass pass = GpuPass::Count;
+    };
+
+    // Last 'window' samples of a pass, a circular buffer.
+    struct History {
+        std::vector<float> ms;
+        uint32_t next = 0;
+        uint64_t samples = 0;
+        double lastMs = 0.0;
+    };
+
+    bool retire(bool wait);
+
+    bool m_supported = false;
+    std::vector<Query> m_ring;
+    uint32_t m_head = 0;    // oldest pending pair
+    uint32_t m_pending = 0; // pairs submitted and not collected
+    bool m_open = false;    // begin() issued a query, end() closes it
+    uint64_t m_dropped = 0;
+    uint32_t m_window;
+    History m_history[(uint32_t)GpuPass::Count];
+    uint32_t m_traceTrack = 0;
+    int64_t m_gpuToCpuNs = 0; // added to a GL timestamp for steady_clock
+};
+
+#endif /* GPU_PASS_TIMER_H */
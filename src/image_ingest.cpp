@@ -0,0 +1,229 @@
+#include "image_ingest.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#include "mapped_file.h"
+#include "trace.h"
+
+static uint64_t elapsedUs(std::chrono::steady_clock::time_point start) {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+ImageIngest::ImageIngest(uint32_t threads, size_t memoryBudget)
+    : m_threadCount(threads ? threads : 1)
+    , m_budget(memoryBudget)
+{
+}
+
+ImageIngest::~ImageIngest() {
+    join();
+}
+
+void ImageIngest::start(BoundedQueue<std::string>& paths, BoundedQueue<DecodedImage>& decoded, StartupTimeline* timeline) {
+    m_running = m_threadCount;
+    for (uint32_t idx = 0; idx < m_threadCount; idx++) {
+        m_threads.emplace_back(&ImageIngest::workerMain, this, std::ref(paths), std::ref(decoded), timeline);
+    }
+}
+
+void ImageIngest::join() {
+    for (std::thread& thread : m_threads) {
+        thread.join();
+    }
+    m_threads.clear();
+}
+
+void ImageIngest::workerMain(BoundedQueue<std::string>& paths, BoundedQueue<DecodedImage>& decoded, StartupTimeline* timeline) {
+    traceThreadName("decode");
+    Stats local;
+    std::string path;
+    auto waitStart = std::chrono::steady_clock::now();
+    while (paths.pop(&path)) {
+        local.waitUs += elapsedUs(waitStart);
+
+        const auto busyStart = std::chrono::steady_clock::now();
+        DecodedImage image;
+        image.path = std::move(path);
+        if (!decode(image.path, &image, &local)) {
+            printf("Unable to load: %s\n", image.path.c_str());
+            local.failed++;
+            waitStart = std::chrono::steady_clock::now();
+            continue;
+        }
+        local.images++;
+        if (timeline) {
+            std::lock_guard<std::mutex> guard(m_lock);
+            if (!m_firstDecoded) {
+                m_firstDecoded = true;
+                timeline->add("decode first image", busyStart);
+            }
+        }
+
+        waitStart = std::chrono::steady_clock::now();
+        if (!decoded.push(std::move(image))) {
+            // the consumer gave up, nobody is going to release it
+            release(image);
+        }
+    }
+    local.waitUs += elapsedUs(waitStart);
+
+    std::lock_guard<std::mutex> guard(m_lock);
+    m_stats.images += local.images;
+    m_stats.failed += local.failed;
+    m_stats.busyUs += local.busyUs;
+    m_stats.waitUs += local.waitUs;
+    m_stats.budgetWaitUs += local.budgetWaitUs;
+    for (int format = 0; format < FormatCount; format++) {
+        m_stats.formats[format].images += local.formats[format].images;
+        m_stats.formats[format].inputBytes += local.formats[format].inputBytes;
+        m_stats.formats[format].outputBytes += local.formats[format].outputBytes;
+        m_stats.formats[format].decodeUs += local.formats[format].decodeUs;
+    }
+    // the last worker out closes the queue to the upscaler
+    if (--m_running == 0) {
+        decoded.close();
+    }
+}
+
+bool ImageIngest::decode(const std::string& path, DecodedImage* image, Stats* local) {
+    auto busyStart = std::chrono::steady_clock::now();
+    MappedFile file;
+    uint32_t width = 0, height = 0;
+    if (!file.open(path.c_str()) || !GetImageInfoFromMemory(file.data(), file.size(), &width, &height)) {
+        local->busyUs += elapsedUs(busyStart);
+        return false;
+    }
+    const Format format = detectFormat(file.data(), file.size());
+    const size_t fileBytes = file.size();
+    const size_t pixelBytes = (size_t)width * height * 4;
+    local->busyUs += elapsedUs(busyStart);
+
+    charge(fileBytes + pixelBytes, local);
+
+    busyStart = std::chrono::steady_clock::now();
+    image->rgba.resize(pixelBytes);
+    bool ok = LoadImageIntoMemory(file.data(), fileBytes, image->rgba.data(), width, height);
+    file.close();
+    const uint64_t decodeUs = elapsedUs(busyStart);
+    local->busyUs += decodeUs;
+
+    uncharge(fileBytes);
+    if (!ok) {
+        uncharge(pixelBytes);
+        image->rgba = std::vector<uint8_t>();
+        return false;
+    }
+    image->size = { width, height };
+    image->budget = pixelBytes;
+
+    FormatStats& formatStats = local->formats[format];
+    formatStats.images++;
+    formatStats.inputBytes += fileBytes;
+    formatStats.outputBytes += pixelBytes;
+    formatStats.decodeUs += decodeUs;
+    return true;
+}
+
+void ImageIngest::charge(size_t bytes, Stats* local) {
+    const auto waitStart = std::chrono::steady_clock::now();
+    std::unique_lock<std::mutex> guard(m_lock);
+    bool waited = false;
+    while (m_charged != 0 && m_charged + bytes > m_budget) {
+        waited = true;
+        m_budgetFreed.wait(guard);
+    }
+    m_charged += bytes;
+    m_stats.peakBytes = std::max(m_stats.peakBytes, m_charged);
+    guard.unlock();
+
+    if (waited) {
+        const uint64_t us = elapsedUs(waitStart);
+        local->waitUs += us;
+        local->budgetWaitUs += us;
+    }
+}
+
+void ImageIngest::uncharge(size_t bytes) {
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        m_charged -= std::min(bytes, m_charged);
+    }
+    m_budgetFreed.notify_all();
+}
+
+void ImageIngest::release(DecodedImage& image) {
+    if (image.budget) {
+        uncharge(image.budget);
+        image.budget = 0;
+    }
+}
+
+ImageIngest::Stats ImageIngest::stats() const {
+    std::lock_guard<std::mutex> guard(m_lock);
+    return m_stats;
+}
+
+void ImageIngest::printStats() const {
+    const Stats stats = this->stats();
+    printf("Decode: %u threads, %.1f MiB peak in flight of a %.1f MiB budget, %.2f ms blocked on the budget\n",
+           m_threadCount, stats.peakBytes / (1024.0 * 1024.0), m_budget / (1024.0 * 1024.0), stats.budgetWaitUs / 1000.0);
+
+    // per thread throughput, the decode time is summed over the workers
+    printf("%-8s %8s %10s %10s %10s %10s\n", "format", "images", "in MiB", "out MiB", "in MB/s", "out MB/s");
+    for (int format = 0; format < FormatCount; format++) {
+        const FormatStats& row = stats.formats[format];
+        if (row.images == 0) {
+            continue;
+        }
+        const double seconds = std::max(row.decodeUs, (uint64_t)1) / 1e6;
+        printf("%-8s %8llu %10.1f %10.1f %10.1f %10.1f\n", formatName((Format)format), (unsigned long long)row.images,
+               row.inputBytes / (1024.0 * 1024.0), row.outputBytes / (1024.0 * 1024.0),
+               row.inputBytes / 1e6 / seconds, row.outputBytes / 1e6 / seconds);
+    }
+}
+
+const char* ImageIngest::formatName(Format format) {
+    switch (format) {
+        case PNG: return "png";
+        case JPEG: return "jpeg";
+        case BMP: return "bmp";
+        case GIF: return "gif";
+        case PSD: return "psd";
+        case HDR: return "hdr";
+        case PNM: return "pnm";
+        default: return "other";
+    }
+}
+
+// The signatures stb_image checks, TGA and PIC have none worth testing.
+ImageIngest::Format ImageIngest::detectFormat(const uint8_t* data, size_t size) {
+    auto startsWith = [&](const char* magic, size_t length) {
+        return size >= length && memcmp(data, magic, length) == 0;
+    };
+
+    if (startsWith("\x89PNG\r\n\x1a\n", 8)) {
+        return PNG;
+    }
+    if (startsWith("\xff\xd8\xff", 3)) {
+        return JPEG;
+    }
+    if (startsWith("BM", 2)) {
+        return BMP;
+    }
+    if (startsWith("GIF8", 4)) {
+        return GIF;
+    }
+    if (startsWith("8BPS", 4)) {
+        return PSD;
+    }
+    if (startsWith("#?RADIANCE", 10) || startsWith("#?RGBE", 6)) {
+        return HDR;
+    }
+    if (size >= 2 && data[0] == 'P' && data[1] >= '1' && data[1] <= '6') {
+        return PNM;
+    }
+    return Other;
+}
@@ -0,0 +1,94 @@
+#ifndef IMAGE_INGEST_H
+#define IMAGE_INGEST_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bounded_queue.h"
+#include "image_utils.h"
+#include "startup_timeline.h"
+
+// One image decoded by ImageIngest.
+struct DecodedImage {
+    std::string path;
+    std::vector<uint8_t> rgba; // tightly packed RGBA8, top row first
+    Extent size = {};
+    size_t budget = 0;         // bytes charged to the memory budget until ImageIngest::release
+};
+
+// Decode front-end of the batch pipeline: a fixed set of worker threads pops paths, maps each file
+// (MappedFile) and decodes it with stbi_load_from_memory, no stdio buffering in between.
+//
+// Before decoding, a worker charges the file size plus the RGBA8 size to the in-flight memory budget
+// and blocks while that would go over it. The file part is returned as soon as the pixels are out,
+// the pixels stay charged until the consumer calls release(). An image bigger than the whole budget
+// still goes through, alone. Throughput is kept per format, from the file signature.
+class ImageIngest {
+public:
+    enum Format { PNG, JPEG, BMP, GIF, PSD, HDR, PNM, Other, FormatCount };
+
+    struct FormatStats {
+        uint64_t images = 0;
+        uint64_t inputBytes = 0;  // encoded, the file sizes
+        uint64_t outputBytes = 0; // decoded RGBA8
+        uint64_t decodeUs = 0;    // summed over the workers
+    };
+
+    // Summed over the workers, complete once join() returned.
+    struct Stats {
+        uint64_t images = 0;
+        uint64_t failed = 0;
+        uint64_t busyUs = 0;       // mapping and decoding
+        uint64_t waitUs = 0;       // blocked on the queues or the budget
+        uint64_t budgetWaitUs = 0; // the part of waitUs blocked on the budget
+        size_t peakBytes = 0;      // most bytes charged at once
+        FormatStats formats[FormatCount];
+    };
+
+    // 0 threads is one, a budget of 0 lets a single image in at a time.
+    ImageIngest(uint32_t threads, size_t memoryBudget);
+    // Joins the workers.
+    ~ImageIngest();
+
+    ImageIngest(const ImageIngest&) = delete;
+    ImageIngest& operator=(const ImageIngest&) = delete;
+
+    // Starts the workers: they decode the paths until 'paths' is closed and empty, the last one to
+    // finish closes 'decoded'. The first decoded image is added to 'timeline' if there is one.
+    void start(BoundedQueue<std::string>& paths, BoundedQueue<DecodedImage>& decoded, StartupTimeline* timeline);
+    void join();
+
+    // The consumer took over the pixels of 'image', returns its bytes to the budget. Thread safe.
+    void release(DecodedImage& image);
+
+    Stats stats() const;
+    // A line for the totals and one per format that was seen.
+    void printStats() const;
+
+    static const char* formatName(Format format);
+    static Format detectFormat(const uint8_t* data, size_t size);
+
+private:
+    void workerMain(BoundedQueue<std::string>& paths, BoundedQueue<DecodedImage>& decoded, StartupTimeline* timeline);
+    bool decode(const std::string& path, DecodedImage* image, Stats* local);
+
+    void charge(size_t bytes, Stats* local);
+    void uncharge(size_t bytes);
+
+    uint32_t m_threadCount;
+    size_t m_budget;
+    std::vector<std::thread> m_threads;
+    uint32_t m_running = 0; // workers still popping paths, under m_lock
+
+    mutable std::mutex m_lock;
+    std::condition_variable m_budgetFreed;
+    size_t m_charged = 0;
+    bool m_firstDecoded = false;
+    Stats m_stats; // merged from the workers as they finish
+};
+
+#endif /* IMAGE_INGEST_H */
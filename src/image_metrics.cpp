@@ -0,0 +1,355 @@
+#include "image_metrics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "fsr_cpu.h"
+#include "fsr_cpu_internal.h"
+#include "image_metrics_internal.h"
+#include "thread_pool.h"
+#include "trace.h"
+
+namespace {
+
+// Rows per task, the SSIM bands re-filter the 10 rows of the window below them.
+const uint32_t bandRows = 64;
+
+// Wang et al. 2003, finest scale first.
+const double msssimWeights[] = { 0.0448, 0.2856, 0.3001, 0.2363, 0.1333 };
+const uint32_t msssimMaxScales = 5;
+
+struct MetricKernels {
+    MetricUnpackFn unpack;
+    MetricErrorRowFn errorRow;
+    SsimHorizontalFn horizontal;
+    SsimVerticalFn vertical;
+};
+
+MetricKernels activeMetricKernels() {
+#if FSR_CPU_X86
+    switch (getFSRCpuKernel()) {
+        case FSRCpuKernel::AVX2:
+        case FSRCpuKernel::AVX512:
+        case FSRCpuKernel::AVX512FP16:
+            return { metricUnpackAVX2, metricErrorRowAVX2, ssimHorizontalAVX2, ssimVerticalAVX2 };
+        default:
+            break;
+    }
+#endif
+    return { metricUnpackScalar, metricErrorRowScalar, ssimHorizontalScalar, ssimVerticalScalar };
+}
+
+// 1D gaussian of the SSIM window, sigma 1.5, normalized.
+struct SsimWeights {
+    float taps[ssimTaps];
+
+    SsimWeights() {
+        double sum = 0.0;
+        double values[ssimTaps];
+        for (uint32_t tap = 0; tap < ssimTaps; tap++) {
+            const double x = (double)tap - (ssimTaps - 1) / 2.0;
+            values[tap] = std::exp(-x * x / (2.0 * 1.5 * 1.5));
+            sum += values[tap];
+        }
+        for (uint32_t tap = 0; tap < ssimTaps; tap++) {
+            taps[tap] = (float)(values[tap] / sum);
+        }
+    }
+};
+
+const SsimWeights s_ssimWeights;
+
+struct SsimResult {
+    double ssim;
+    double cs;
+};
+
+// Mean SSIM and contrast-structure term of two luma planes over the positions where the window fits.
+SsimResult ssimPlane(ThreadPool& pool, const MetricKernels& kernels, const float* a, const float* b, uint32_t width, uint32_t height) {
+    const uint32_t outWidth = width - (ssimTaps - 1);
+    const uint32_t outHeight = height - (ssimTaps - 1);
+    const uint32_t bands = (outHeight + bandRows - 1) / bandRows;
+
+    // per worker: the horizontal results of the last 'ssimTaps' rows of each quantity, a ring
+    std::vector<std::vector<float>> scratch(pool.threadCount());
+    std::vector<double> ssimSums(bands, 0.0), csSums(bands, 0.0);
+
+    pool.parallelFor(bands, [&](uint32_t band, uint32_t worker) {
+        std::vector<float>& ring = scratch[worker];
+        ring.resize((size_t)ssimMaps * ssimTaps * outWidth);
+        auto slot = [&](uint32_t map, uint32_t row) { return &ring[((size_t)map * ssimTaps + row % ssimTaps) * outWidth]; };
+
+        const uint32_t y0 = band * bandRows;
+        const uint32_t y1 = std::min(y0 + bandRows, outHeight);
+        double ssim = 0.0, cs = 0.0;
+        for (uint32_t row = y0; row < y1 + ssimTaps - 1; row++) {
+            float* output[ssimMaps];
+            for (uint32_t map = 0; map < ssimMaps; map++) {
+                output[map] = slot(map, row);
+            }
+            kernels.horizontal(s_ssimWeights.taps, a + (size_t)row * width, b + (size_t)row * width, outWidth, output);
+
+            if (row >= y0 + ssimTaps - 1) {
+                const uint32_t top = row - (ssimTaps - 1);
+                const float* rows[ssimMaps * ssimTaps];
+                for (uint32_t map = 0; map < ssimMaps; map++) {
+                    for (uint32_t tap = 0; tap < ssimTaps; tap++) {
+                        rows[map * ssimTaps + tap] = slot(map, top + tap);
+                    }
+                }
+                kernels.vertical(s_ssimWeights.taps, rows, outWidth, &ssim, &cs);
+            }
+        }
+        ssimSums[band] = ssim;
+        csSums[band] = cs;
+    });
+
+    SsimResult result = { 0.0, 0.0 };
+    for (uint32_t band = 0; band < bands; band++) {
+        result.ssim += ssimSums[band];
+        result.cs += csSums[band];
+    }
+    const double count = (double)outWidth * outHeight;
+    result.ssim /= count;
+    result.cs /= count;
+    return result;
+}
+
+// 2x2 average, the odd last row and column are dropped.
+void halvePlane(ThreadPool& pool, const float* input, uint32_t width, uint32_t height, std::vector<float>* output) {
+    const uint32_t outWidth = width / 2;
+    const uint32_t outHeight = height / 2;
+    output->resize((size_t)outWidth * outHeight);
+    float* out = output->data();
+    pool.parallelFor((outHeight + bandRows - 1) / bandRows, [&](uint32_t band, uint32_t) {
+        const uint32_t y1 = std::min((band + 1) * bandRows, outHeight);
+        for (uint32_t y = band * bandRows; y < y1; y++) {
+            const float* row0 = input + (size_t)y * 2 * width;
+            const float* row1 = row0 + width;
+            for (uint32_t x = 0; x < outWidth; x++) {
+                out[(size_t)y * outWidth + x] = (row0[x * 2] + row0[x * 2 + 1] + row1[x * 2] + row1[x * 2 + 1]) * 0.25f;
+            }
+        }
+    });
+}
+
+} // namespace
+
+ImageQuality compareImages(ThreadPool& pool, const MetricImage& reference, const MetricImage& test, const Extent& size) {
+    TRACE_ZONE("compareImages");
+    ImageQuality quality;
+    if (size.width == 0 || size.height == 0) {
+        return quality;
+    }
+    const MetricKernels kernels = activeMetricKernels();
+
+    // RGB error and the luma planes
+    std::vector<float> lumaA((size_t)size.width * size.height), lumaB((size_t)size.width * size.height);
+    const uint32_t bands = (size.height + bandRows - 1) / bandRows;
+    std::vector<std::vector<float>> scratch(pool.threadCount());
+    std::vector<double> errorSums(bands, 0.0);
+    pool.parallelFor(bands, [&](uint32_t band, uint32_t worker) {
+        std::vector<float>& rows = scratch[worker];
+        rows.resize((size_t)size.width * 8);
+        const uint32_t y1 = std::min((band + 1) * bandRows, size.height);
+        double error = 0.0;
+        for (uint32_t y = band * bandRows; y < y1; y++) {
+            const size_t offset = (size_t)y * size.width * 4;
+            const float* a = rows.data();
+            const float* b = rows.data() + (size_t)size.width * 4;
+            if (reference.rgba32f) {
+                a = (const float*)reference.pixels + offset;
+            } else {
+                kernels.unpack((const uint8_t*)reference.pixels + offset, size.width, rows.data());
+            }
+            if (test.rgba32f) {
+                b = (const float*)test.pixels + offset;
+            } else {
+                kernels.unpack((const uint8_t*)test.pixels + offset, size.width, rows.data() + (size_t)size.width * 4);
+            }
+            error += kernels.errorRow(a, b, size.width, &lumaA[(size_t)y * size.width], &lumaB[(size_t)y * size.width]);
+        }
+        errorSums[band] = error;
+    });
+    double error = 0.0;
+    for (double sum : errorSums) {
+        error += sum;
+    }
+    quality.mse = error / ((double)size.width * size.height * 3);
+    quality.psnr = quality.mse > 0.0 ? std::min(10.0 * std::log10(1.0 / quality.mse), 100.0) : 100.0;
+
+    if (size.width < ssimTaps || size.height < ssimTaps) {
+        return quality;
+    }
+
+    // MS-SSIM: the contrast-structure term at every scale, the full SSIM at the coarsest one
+    uint32_t scales = 1;
+    while (scales < msssimMaxScales && std::min(size.width >> scales, size.height >> scales) >= ssimTaps) {
+        scales++;
+    }
+    double weightSum = 0.0;
+    for (uint32_t scale = 0; scale < scales; scale++) {
+        weightSum += msssimWeights[scale];
+    }
+
+    std::vector<float> halfA, halfB;
+    const float* planeA = lumaA.data();
+    const float* planeB = lumaB.data();
+    uint32_t width = size.width, height = size.height;
+    double msssim = 1.0;
+    for (uint32_t scale = 0; scale < scales; scale++) {
+        const SsimResult result = ssimPlane(pool, kernels, planeA, planeB, width, height);
+        if (scale == 0) {
+            quality.ssim = result.ssim;
+        }
+        // negative terms (anti-correlated structure) would make the power undefined
+        const double term = scale + 1 == scales ? result.ssim : result.cs;
+        msssim *= std::pow(std::max(term, 0.0), msssimWeights[scale] / weightSum);
+
+        if (scale + 1 < scales) {
+            std::vector<float> nextA, nextB;
+            halvePlane(pool, planeA, width, height, &nextA);
+            halvePlane(pool, planeB, width, height, &nextB);
+            halfA.swap(nextA);
+            halfB.swap(nextB);
+            planeA = halfA.data();
+            planeB = halfB.data();
+            width /= 2;
+            height /= 2;
+        }
+    }
+    quality.msssim = msssim;
+    quality.msssimScales = scales;
+    return quality;
+}
+
+void downscaleRGBA8(ThreadPool& pool, const uint8_t* input, const Extent& inputSize, uint8_t* output, const Extent& outputSize) {
+    TRACE_ZONE("downscaleRGBA8");
+    if (outputSize.width == 0 || outputSize.height == 0) {
+        return;
+    }
+    const double scaleX = (double)inputSize.width / outputSize.width;
+    const double scaleY = (double)inputSize.height / outputSize.height;
+
+    // the input columns of each output column, with the coverage of the first and last one
+    struct Span {
+        uint32_t begin, end;
+        float firstWeight, lastWeight;
+    };
+    auto makeSpans = [](uint32_t count, double scale, uint32_t limit) {
+        std::vector<Span> spans(count);
+        for (uint32_t idx = 0; idx < count; idx++) {
+            const double x0 = idx * scale;
+            const double x1 = std::min((idx + 1) * scale, (double)limit);
+            Span& span = spans[idx];
+            span.begin = (uint32_t)x0;
+            span.end = std::min((uint32_t)std::ceil(x1), limit);
+            span.firstWeight = (float)(std::min(x1, span.begin + 1.0) - x0);
+            span.lastWeight = span.end - 1 > span.begin ? (float)(x1 - (span.end - 1)) : span.firstWeight;
+        }
+        return spans;
+    };
+    const std::vector<Span> columns = makeSpans(outputSize.width, scaleX, inputSize.width);
+    const std::vector<Span> rows = makeSpans(outputSize.height, scaleY, inputSize.height);
+    auto weight = [](const Span& span, uint32_t idx) {
+        return idx == span.begin ? span.firstWeight : idx + 1 == span.end ? span.lastWeight : 1.0f;
+    };
+
+    std::vector<std::vector<float>> scratch(pool.threadCount());
+    pool.parallelFor(outputSize.height, [&](uint32_t y, uint32_t worker) {
+        // the covered input rows summed, then the columns
+        std::vector<float>& sum = scratch[worker];
+        sum.assign((size_t)inputSize.width * 4, 0.0f);
+        const Span& row = rows[y];
+        float rowWeight = 0.0f;
+        for (uint32_t sy = row.begin; sy < row.end; sy++) {
+            const float w = weight(row, sy);
+            const uint8_t* src = input + (size_t)sy * inputSize.width * 4;
+            for (uint32_t idx = 0; idx < inputSize.width * 4; idx++) {
+                sum[idx] += w * src[idx];
+            }
+            rowWeight += w;
+        }
+
+        uint8_t* dst = output + (size_t)y * outputSize.width * 4;
+        for (uint32_t x = 0; x < outputSize.width; x++) {
+            const Span& column = columns[x];
+            float pixel[4] = {};
+            float columnWeight = 0.0f;
+            for (uint32_t sx = column.begin; sx < column.end; sx++) {
+                const float w = weight(column, sx);
+                for (uint32_t c = 0; c < 4; c++) {
+                    pixel[c] += w * sum[(size_t)sx * 4 + c];
+                }
+                columnWeight += w;
+            }
+            const float norm = 1.0f / (rowWeight * columnWeight);
+            for (uint32_t c = 0; c < 4; c++) {
+                dst[x * 4 + c] = (uint8_t)std::min(pixel[c] * norm + 0.5f, 255.0f);
+            }
+        }
+    });
+}
+
+void metricUnpackScalar(const uint8_t* input, uint32_t count, float* output) {
+    for (uint32_t idx = 0; idx < count * 4; idx++) {
+        output[idx] = input[idx] * (1.0f / 255.0f);
+    }
+}
+
+double metricErrorRowScalar(const float* a, const float* b, uint32_t count, float* lumaA, float* lumaB) {
+    double error = 0.0;
+    for (uint32_t x = 0; x < count; x++) {
+        float pa[3], pb[3];
+        for (uint32_t c = 0; c < 3; c++) {
+            pa[c] = std::min(std::max(a[x * 4 + c], 0.0f), 1.0f);
+            pb[c] = std::min(std::max(b[x * 4 + c], 0.0f), 1.0f);
+            const float d = pa[c] - pb[c];
+            error += d * d;
+        }
+        lumaA[x] = metricLumaR * pa[0] + metricLumaG * pa[1] + metricLumaB * pa[2];
+        lumaB[x] = metricLumaR * pb[0] + metricLumaG * pb[1] + metricLumaB * pb[2];
+    }
+    return error;
+}
+
+void ssimHorizontalScalar(const float* weights, const float* a, const float* b, uint32_t count, float* const* output) {
+    for (uint32_t x = 0; x < count; x++) {
+        float sums[ssimMaps] = {};
+        for (uint32_t tap = 0; tap < ssimTaps; tap++) {
+            const float va = a[x + tap];
+            const float vb = b[x + tap];
+            sums[0] += weights[tap] * va;
+            sums[1] += weights[tap] * vb;
+            sums[2] += weights[tap] * va * va;
+            sums[3] += weights[tap] * vb * vb;
+            sums[4] += weights[tap] * va * vb;
+        }
+        for (uint32_t map = 0; map < ssimMaps; map++) {
+            output[map][x] = sums[map];
+        }
+    }
+}
+
+void ssimVerticalScalar(const float* weights, const float* const* rows, uint32_t count, double* ssim, double* cs) {
+    double ssimSum = 0.0, csSum = 0.0;
+    for (uint32_t x = 0; x < count; x++) {
+        float sums[ssimMaps] = {};
+        for (uint32_t map = 0; map < ssimMaps; map++) {
+            for (uint32_t tap = 0; tap < ssimTaps; tap++) {
+                sums[map] += weights[tap] * rows[map * ssimTaps + tap][x];
+            }
+        }
+        const float muA = sums[0], muB = sums[1];
+        const float varA = sums[2] - muA * muA;
+        const float varB = sums[3] - muB * muB;
+        const float covar = sums[4] - muA * muB;
+        const float contrast = (2.0f * covar + ssimC2) / (varA + varB + ssimC2);
+        const float luminance = (2.0f * muA * muB + ssimC1) / (muA * muA + muB * muB + ssimC1);
+        ssimSum += luminance * contrast;
+        csSum += contrast;
+    }
+    *ssim += ssimSum;
+    *cs += csSum;
+}
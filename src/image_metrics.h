@@ -0,0 +1,41 @@
+#ifndef IMAGE_METRICS_H
+#define IMAGE_METRICS_H
+
+#include <cstdint>
+
+#include "image_utils.h"
+
+class ThreadPool;
+
+// RGBA8 or RGBA32F pixels, rows tightly packed, top row first. Float values are clamped to [0, 1],
+// the range every output format stores. Alpha is ignored.
+struct MetricImage {
+    MetricImage(const uint8_t* rgba8) : pixels(rgba8), rgba32f(false) {}
+    MetricImage(const float* rgba32f_) : pixels(rgba32f_), rgba32f(true) {}
+
+    const void* pixels;
+    bool rgba32f;
+};
+
+struct ImageQuality {
+    double mse = 0.0;       // over R, G and B in [0, 1]
+    double psnr = 0.0;      // dB, 100 for identical images
+    double ssim = 0.0;      // mean SSIM of the luma, 11x11 gaussian window (sigma 1.5), no padding
+    double msssim = 0.0;    // MS-SSIM of the luma
+    uint32_t msssimScales = 0; // 5, fewer when the image is too small for the coarse scales (the weights are renormalized)
+};
+
+// Compares 'test' against 'reference', both of 'size'. SSIM and MS-SSIM are on the BT.601 luma,
+// they are 0 when the image is smaller than the 11x11 window.
+//
+// Rows are split into bands on the pool. The filters run with the AVX2 kernels when the CPU kernel
+// picked for FSR (getFSRCpuKernel) is AVX2 or wider, with the scalar ones otherwise. Each band is
+// summed on its own and the bands in order, the result doesn't depend on the thread count.
+ImageQuality compareImages(ThreadPool& pool, const MetricImage& reference, const MetricImage& test, const Extent& size);
+
+// Area average of 'input' into the smaller 'outputSize', each output pixel is the mean of the input
+// pixels it covers (fractionally at its edges). Makes the low resolution input whose upscale is
+// compared against the original, the ground truth.
+void downscaleRGBA8(ThreadPool& pool, const uint8_t* input, const Extent& inputSize, uint8_t* output, const Extent& outputSize);
+
+#endif /* IMAGE_METRICS_H */
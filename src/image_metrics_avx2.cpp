@@ -0,0 +1,149 @@
+// AVX2 + FMA kernels of image_metrics.cpp, this file is built with -mavx2 -mfma (/arch:AVX2) and only
+// called when the FSR CPU kernel picked by CPUID is AVX2 or wider.
+#include "image_metrics_internal.h"
+
+#include "fsr_cpu_internal.h"
+
+#if FSR_CPU_X86
+
+#include <immintrin.h>
+
+namespace {
+
+// Lanes [0, count) set, count <= 8.
+inline __m256i tailMask(uint32_t count) {
+    return _mm256_cmpgt_epi32(_mm256_set1_epi32((int32_t)count), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+}
+
+inline __m256 clamp01(__m256 a) {
+    return _mm256_min_ps(_mm256_max_ps(a, _mm256_setzero_ps()), _mm256_set1_ps(1.0f));
+}
+
+inline double sumLanes(__m256 a) {
+    __m128 sum = _mm_add_ps(_mm256_castps256_ps128(a), _mm256_extractf128_ps(a, 1));
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_movehdup_ps(sum));
+    return _mm_cvtss_f32(sum);
+}
+
+// Sums of the five SSIM quantities over 'ssimTaps' of the rows, for 8 positions.
+struct SsimSums {
+    __m256 v[ssimMaps];
+};
+
+} // namespace
+
+void metricUnpackAVX2(const uint8_t* input, uint32_t count, float* output) {
+    const __m256 scale = _mm256_set1_ps(1.0f / 255.0f);
+    const uint32_t values = count * 4;
+    uint32_t idx = 0;
+    for (; idx + 8 <= values; idx += 8) {
+        const __m256i bytes = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(input + idx)));
+        _mm256_storeu_ps(output + idx, _mm256_mul_ps(_mm256_cvtepi32_ps(bytes), scale));
+    }
+    for (; idx < values; idx++) {
+        output[idx] = input[idx] * (1.0f / 255.0f);
+    }
+}
+
+double metricErrorRowAVX2(const float* a, const float* b, uint32_t count, float* lumaA, float* lumaB) {
+    // two RGBA pixels per register, alpha weighted out
+    const __m256 rgbMask = _mm256_setr_ps(1.0f, 1.0f, 1.0f, 0.0f, 1.0f, 1.0f, 1.0f, 0.0f);
+    const __m256 lumaWeights = _mm256_setr_ps(metricLumaR, metricLumaG, metricLumaB, 0.0f, metricLumaR, metricLumaG, metricLumaB, 0.0f);
+    // hadd leaves the pixels as 0 2 4 6 | 1 3 5 7
+    const __m256i pixelOrder = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+
+    __m256 error = _mm256_setzero_ps();
+    uint32_t x = 0;
+    for (; x + 8 <= count; x += 8) {
+        __m256 productsA[4], productsB[4];
+        for (uint32_t idx = 0; idx < 4; idx++) {
+            const __m256 pa = clamp01(_mm256_loadu_ps(a + (x + idx * 2) * 4));
+            const __m256 pb = clamp01(_mm256_loadu_ps(b + (x + idx * 2) * 4));
+            const __m256 d = _mm256_mul_ps(_mm256_sub_ps(pa, pb), rgbMask);
+            error = _mm256_fmadd_ps(d, d, error);
+            productsA[idx] = _mm256_mul_ps(pa, lumaWeights);
+            productsB[idx] = _mm256_mul_ps(pb, lumaWeights);
+        }
+        const __m256 sumA = _mm256_hadd_ps(_mm256_hadd_ps(productsA[0], productsA[1]), _mm256_hadd_ps(productsA[2], productsA[3]));
+        const __m256 sumB = _mm256_hadd_ps(_mm256_hadd_ps(productsB[0], productsB[1]), _mm256_hadd_ps(productsB[2], productsB[3]));
+        _mm256_storeu_ps(lumaA + x, _mm256_permutevar8x32_ps(sumA, pixelOrder));
+        _mm256_storeu_ps(lumaB + x, _mm256_permutevar8x32_ps(sumB, pixelOrder));
+    }
+
+    double total = sumLanes(error);
+    if (x < count) {
+        total += metricErrorRowScalar(a + x * 4, b + x * 4, count - x, lumaA + x, lumaB + x);
+    }
+    return total;
+}
+
+void ssimHorizontalAVX2(const float* weights, const float* a, const float* b, uint32_t count, float* const* output) {
+    __m256 taps[ssimTaps];
+    for (uint32_t tap = 0; tap < ssimTaps; tap++) {
+        taps[tap] = _mm256_set1_ps(weights[tap]);
+    }
+
+    // the last partial group is masked
+    for (uint32_t x = 0; x < count; x += 8) {
+        SsimSums sums;
+        for (__m256& v : sums.v) {
+            v = _mm256_setzero_ps();
+        }
+        const __m256i mask = tailMask(count - x < 8 ? count - x : 8);
+        for (uint32_t tap = 0; tap < ssimTaps; tap++) {
+            const __m256 va = _mm256_maskload_ps(a + x + tap, mask);
+            const __m256 vb = _mm256_maskload_ps(b + x + tap, mask);
+            sums.v[0] = _mm256_fmadd_ps(taps[tap], va, sums.v[0]);
+            sums.v[1] = _mm256_fmadd_ps(taps[tap], vb, sums.v[1]);
+            sums.v[2] = _mm256_fmadd_ps(_mm256_mul_ps(taps[tap], va), va, sums.v[2]);
+            sums.v[3] = _mm256_fmadd_ps(_mm256_mul_ps(taps[tap], vb), vb, sums.v[3]);
+            sums.v[4] = _mm256_fmadd_ps(_mm256_mul_ps(taps[tap], va), vb, sums.v[4]);
+        }
+        for (uint32_t map = 0; map < ssimMaps; map++) {
+            _mm256_maskstore_ps(output[map] + x, mask, sums.v[map]);
+        }
+    }
+}
+
+void ssimVerticalAVX2(const float* weights, const float* const* rows, uint32_t count, double* ssim, double* cs) {
+    __m256 taps[ssimTaps];
+    for (uint32_t tap = 0; tap < ssimTaps; tap++) {
+        taps[tap] = _mm256_set1_ps(weights[tap]);
+    }
+    const __m256 two = _mm256_set1_ps(2.0f);
+    const __m256 c1 = _mm256_set1_ps(ssimC1);
+    const __m256 c2 = _mm256_set1_ps(ssimC2);
+
+    // float lanes are fine within a row, the rows and bands are summed as double
+    __m256 ssimSum = _mm256_setzero_ps();
+    __m256 csSum = _mm256_setzero_ps();
+    for (uint32_t x = 0; x < count; x += 8) {
+        const __m256i mask = tailMask(count - x < 8 ? count - x : 8);
+        SsimSums sums;
+        for (uint32_t map = 0; map < ssimMaps; map++) {
+            __m256 sum = _mm256_setzero_ps();
+            for (uint32_t tap = 0; tap < ssimTaps; tap++) {
+                sum = _mm256_fmadd_ps(taps[tap], _mm256_maskload_ps(rows[map * ssimTaps + tap] + x, mask), sum);
+            }
+            sums.v[map] = sum;
+        }
+        const __m256 muA = sums.v[0], muB = sums.v[1];
+        const __m256 muAB = _mm256_mul_ps(muA, muB);
+        const __m256 muAA = _mm256_mul_ps(muA, muA);
+        const __m256 muBB = _mm256_mul_ps(muB, muB);
+        const __m256 varA = _mm256_sub_ps(sums.v[2], muAA);
+        const __m256 varB = _mm256_sub_ps(sums.v[3], muBB);
+        const __m256 covar = _mm256_sub_ps(sums.v[4], muAB);
+        const __m256 contrast = _mm256_div_ps(_mm256_fmadd_ps(two, covar, c2), _mm256_add_ps(_mm256_add_ps(varA, varB), c2));
+        const __m256 luminance = _mm256_div_ps(_mm256_fmadd_ps(two, muAB, c1), _mm256_add_ps(_mm256_add_ps(muAA, muBB), c1));
+        // the masked lanes are past the row, not part of the mean
+        const __m256 valid = _mm256_castsi256_ps(mask);
+        ssimSum = _mm256_add_ps(ssimSum, _mm256_and_ps(_mm256_mul_ps(luminance, contrast), valid));
+        csSum = _mm256_add_ps(csSum, _mm256_and_ps(contrast, valid));
+    }
+    *ssim += sumLanes(ssimSum);
+    *cs += sumLanes(csSum);
+}
+
+#endif /* FSR_CPU_X86 */
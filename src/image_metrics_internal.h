@@ -0,0 +1,46 @@
+#ifndef IMAGE_METRICS_INTERNAL_H
+#define IMAGE_METRICS_INTERNAL_H
+
+#include <cstdint>
+
+// Shared between image_metrics.cpp and the per instruction set kernels (image_metrics_<isa>.cpp).
+// Only plain types are used here as the kernel files are built with different target flags.
+
+// Taps of the SSIM window.
+static const uint32_t ssimTaps = 11;
+// Filtered quantities of the SSIM window: mean of a, mean of b, mean of a*a, b*b and a*b.
+static const uint32_t ssimMaps = 5;
+
+// 'count' RGBA8 pixels to RGBA32F in [0, 1].
+typedef void (*MetricUnpackFn)(const uint8_t* input, uint32_t count, float* output);
+
+// Squared error over R, G and B of 'count' RGBA32F pixels clamped to [0, 1], and the luma of both.
+typedef double (*MetricErrorRowFn)(const float* a, const float* b, uint32_t count, float* lumaA, float* lumaB);
+
+// Horizontal pass of the SSIM window: for x in [0, count), the 'ssimTaps' weighted sums starting at
+// a[x] and b[x] of the five quantities into output[0..4][x]. Reads count + ssimTaps - 1 values of each row.
+typedef void (*SsimHorizontalFn)(const float* weights, const float* a, const float* b, uint32_t count, float* const* output);
+
+// Vertical pass and the SSIM map of one output row. rows[map * ssimTaps + tap] are the horizontal
+// results of the 'ssimTaps' rows of the window, top first. Adds the sum of the SSIM and of its
+// contrast-structure term over the 'count' pixels to 'ssim' and 'cs'.
+typedef void (*SsimVerticalFn)(const float* weights, const float* const* rows, uint32_t count, double* ssim, double* cs);
+
+void metricUnpackScalar(const uint8_t* input, uint32_t count, float* output);
+double metricErrorRowScalar(const float* a, const float* b, uint32_t count, float* lumaA, float* lumaB);
+void ssimHorizontalScalar(const float* weights, const float* a, const float* b, uint32_t count, float* const* output);
+void ssimVerticalScalar(const float* weights, const float* const* rows, uint32_t count, double* ssim, double* cs);
+
+void metricUnpackAVX2(const uint8_t* input, uint32_t count, float* output);
+double metricErrorRowAVX2(const float* a, const float* b, uint32_t count, float* lumaA, float* lumaB);
+void ssimHorizontalAVX2(const float* weights, const float* a, const float* b, uint32_t count, float* const* output);
+void ssimVerticalAVX2(const float* weights, const float* const* rows, uint32_t count, double* ssim, double* cs);
+
+// BT.601 luma weights and the SSIM stabilizers for a dynamic range of 1.
+static const float metricLumaR = 0.299f;
+static const float metricLumaG = 0.587f;
+static const float metricLumaB = 0.114f;
+static const float ssimC1 = 0.01f * 0.01f;
+static const float ssimC2 = 0.03f * 0.03f;
+
+#endif /* IMAGE_METRICS_INTERNAL_H */
@@ -1,29 +1,127 @@
 
-#include <GLFW/glfw3.h>
 #include <glad/glad.h>
 
+#include <climits>
+#include <cstring>
+
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
 #include "image_utils.h"
+#include "mapped_file.h"
+#include "trace.h"
 
 #define A_CPU
 #include "ffx_a.h"
 #include "ffx_fsr1.h"
 
-#include <memory>
-#include <sstream>
+// stb takes the size as an int.
+static bool fitsStb(size_t size)
+{
+    return size > 0 && size <= (size_t)INT_MAX;
+}
 
-// Simple helper function to load an image into a OpenGL texture with common settings
-bool LoadTextureFromFile(const char* filename, GLuint* out_texture, uint32_t* out_width, uint32_t* out_height)
+bool GetImageInfoFromMemory(const uint8_t* data, size_t size, uint32_t* out_width, uint32_t* out_height)
 {
-    // Load from file
     int image_width = 0;
     int image_height = 0;
-    unsigned char* image_data = stbi_load(filename, &image_width, &image_height, NULL, 4);
+    if (!fitsStb(size) || !stbi_info_from_memory(data, (int)size, &image_width, &image_height, NULL) || image_width <= 0 || image_height <= 0)
+        return false;
+
+    *out_width = image_width;
+    *out_height = image_height;
+    return true;
+}
+
+// stb_image allocates the decoded image itself, 'width' x 'height' from GetImageInfoFromMemory or null.
+static unsigned char* decodeImage(const uint8_t* data, size_t size, uint32_t* out_width, uint32_t* out_height)
+{
+    if (!fitsStb(size))
+        return NULL;
+
+    TRACE_ZONE("decodeImage");
+    int image_width = 0;
+    int image_height = 0;
+    unsigned char* image_data = stbi_load_from_memory(data, (int)size, &image_width, &image_height, NULL, 4);
+    *out_width = image_width;
+    *out_height = image_height;
+    return image_data;
+}
+
+bool LoadImageIntoMemory(const uint8_t* data, size_t size, uint8_t* rgba, uint32_t width, uint32_t height)
+{
+    uint32_t image_width = 0;
+    uint32_t image_height = 0;
+    unsigned char* image_data = decodeImage(data, size, &image_width, &image_height);
+    if (image_data == NULL)
+        return false;
+
+    // not the size GetImageInfo returned, the file changed in between
+    bool ok = image_width == width && image_height == height;
+    if (ok)
+        memcpy(rgba, image_data, (size_t)width * height * 4);
+    stbi_image_free(image_data);
+    return ok;
+}
+
+bool LoadImageFromMemory(const uint8_t* data, size_t size, std::vector<uint8_t>* out_rgba, uint32_t* out_width, uint32_t* out_height)
+{
+    uint32_t image_width = 0;
+    uint32_t image_height = 0;
+    unsigned char* image_data = decodeImage(data, size, &image_width, &image_height);
     if (image_data == NULL)
         return false;
 
+    out_rgba->assign(image_data, image_data + (size_t)image_width * image_height * 4);
+    stbi_image_free(image_data);
+
+    *out_width = image_width;
+    *out_height = image_height;
+
+    return true;
+}
+
+bool GetImageInfo(const char* filename, uint32_t* out_width, uint32_t* out_height)
+{
+    MappedFile file;
+    return file.open(filename) && GetImageInfoFromMemory(file.data(), file.size(), out_width, out_height);
+}
+
+bool LoadImageIntoMemory(const char* filename, uint8_t* rgba, uint32_t width, uint32_t height)
+{
+    MappedFile file;
+    return file.open(filename) && LoadImageIntoMemory(file.data(), file.size(), rgba, width, height);
+}
+
+bool LoadImageFromFile(const char* filename, std::vector<uint8_t>* out_rgba, uint32_t* out_width, uint32_t* out_height)
+{
+    MappedFile file;
+    return file.open(filename) && LoadImageFromMemory(file.data(), file.size(), out_rgba, out_width, out_height);
+}
+
+// Simple helper function to load an image into a OpenGL texture with common settings
+bool LoadTextureFromFile(const char* filename, uint32_t* out_texture, uint32_t* out_width, uint32_t* out_height)
+{
+    TRACE_ZONE("LoadTextureFromFile");
+    // Load from file
+    std::vector<uint8_t> pixels;
+    uint32_t image_width = 0;
+    uint32_t image_height = 0;
+    if (!LoadImageFromFile(filename, &pixels, &image_width, &image_height))
+        return false;
+
+    if (!LoadTextureFromMemory(pixels.data(), image_width, image_height, out_texture))
+        return false;
+
+    *out_width = image_width;
+    *out_height = image_height;
+
+    return true;
+}
+
+bool LoadTextureFromMemory(const uint8_t* rgba, uint32_t width, uint32_t height, uint32_t* out_texture)
+{
+    TRACE_ZONE("uploadTexture");
     // Create a OpenGL texture identifier
     GLuint image_texture;
     glGenTextures(1, &image_texture);
@@ -35,38 +133,23 @@ bool LoadTextureFromFile(const char* filename, GLuint* out_texture, uint32_t* ou
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE); // This is required on WebGL for non power-of-two textures
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE); // Same
 
-    // Upload pixels into texture
+    // Immutable storage, filled in place. With a GL_PIXEL_UNPACK_BUFFER bound 'rgba' is an offset into it.
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, width, height);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
 #if defined(GL_UNPACK_ROW_LENGTH) && !defined(__EMSCRIPTEN__)
     glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
 #endif
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, image_width, image_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image_data);
-    stbi_image_free(image_data);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, rgba);
+    glBindTexture(GL_TEXTURE_2D, 0);
 
-    GLuint imm_image_texture;
-    glGenTextures(1, &imm_image_texture);
-    glBindTexture(GL_TEXTURE_2D, imm_image_texture);
-
-    // Setup filtering parameters for display
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE); // This is required on WebGL for non power-of-two textures
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE); // Same
-
-    glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, image_width, image_height);
-
-    glCopyImageSubData(image_texture, GL_TEXTURE_2D, 0, 0, 0, 0, imm_image_texture, GL_TEXTURE_2D, 0, 0, 0, 0, image_width, image_height, 1);
-
-    glDeleteTextures(1, &image_texture);
-    glFinish();
-    *out_texture = imm_image_texture;
-    *out_width = image_width;
-    *out_height = image_height;
+    *out_texture = image_texture;
 
     return true;
 }
 
 void prepareFSR(FSRConstants* fsrData, float rcasAttenuation)
 {
+    TRACE_ZONE("prepareFSR");
     FsrEasuCon(fsrData->const0, fsrData->const1, fsrData->const2, fsrData->const3,
                fsrData->input.width, fsrData->input.height, // frame render resolution
                fsrData->input.width, fsrData->input.height, // input container resolution
@@ -87,183 +170,3 @@ void prepareFSR(FSRConstants* fsrData, float rcasAttenuation)
     printf("RCAS: rcasAttenuation = %.3f\n", rcasAttenuation);
     printf("Const0: %d %d %d %d\n", fsrData->const0RCAS[0], fsrData->const0RCAS[1], fsrData->const0RCAS[2], fsrData->const0RCAS[3]);
 }
-
-
-
-static std::unique_ptr<uint8_t> readFile(const char* filename) {
-    FILE* fp = fopen(filename, "r");
-    if (fp == NULL) {
-        printf("Unable to open: %s\n", filename);
-        return 0;
-    }
-
-    fseek(fp, 0L, SEEK_END);
-    size_t fileSize = ftell(fp);
-    fseek(fp, 0L, SEEK_SET);
-
-    std::unique_ptr<uint8_t> buffer(new uint8_t[fileSize + 1]);
-    size_t readSize = fread(buffer.get(), 1, fileSize, fp);
-
-    buffer.get()[readSize] = 0;
-
-    return buffer;
-}
-
-static uint32_t compileProgram(const std::string& source) {
-    const char* src = source.c_str();
-
-    // C.1. Create the Compute shader
-    unsigned int compute_shader;
-    {
-        compute_shader = glCreateShader(GL_COMPUTE_SHADER);
-        glShaderSource(compute_shader, 1, &src, NULL);
-        glCompileShader(compute_shader);
-        int success;
-        glGetShaderiv(compute_shader, GL_COMPILE_STATUS, &success);
-        if (!success) {
-            char info[512];
-            glGetShaderInfoLog(compute_shader, 512, NULL, info);
-            printf("Compute shader error:\n%s\n", info);
-            // printf("Compute shader code:\n%s\n", src);
-            return -3;
-        }
-    }
-
-    // C.2. Create the Compute program
-    unsigned int compute_program;
-    {
-        compute_program = glCreateProgram();
-        glAttachShader(compute_program, compute_shader);
-        glLinkProgram(compute_program);
-
-        int success;
-        glGetProgramiv(compute_program, GL_LINK_STATUS, &success);
-        if(!success) {
-            char info[512];
-            glGetProgramInfoLog(compute_program, 512, NULL, info);
-            printf("Compute Program error:\n%s\n", info);
-            return -3;
-        }
-    }
-
-    return compute_program;
-}
-
-static std::string buildShader(const std::vector<std::string>& headers, const std::vector<std::string>& filenames, const std::map<std::string, std::string>& defines)
-{
-    std::stringstream out;
-    for (const std::string& header : headers) {
-        out << header << std::endl;
-    }
-
-    out << "/* DEFINES */" << std::endl;
-    for (const auto& item : defines) {
-        out << "#define " << item.first << " " << item.second << std::endl;
-    }
-    out << "/*  */" << std::endl;
-
-    for (const std::string& filename : filenames) {
-        out << "/* Input file: " << filename << " */"  << std::endl;
-
-        std::unique_ptr<uint8_t> data = readFile(filename.c_str());
-
-        out << (const char*)data.get() << std::endl;
-    }
-
-    return out.str();
-}
-
-uint32_t createFSRComputeProgramEAUS(const std::string& baseDir) {
-    std::map<std::string, std::string> defines = {
-        { "A_GPU", "1" },
-        { "A_GLSL", "1" },
-        { "SAMPLE_SLOW_FALLBACK", "1" },
-        { "SAMPLE_EASU", "1" },
-        { "FSR_EASU_F", "1" },
-
-        { "SAMPLE_RCAS", "0" },
-        { "SAMPLE_BILINEAR", "0" },
-    };
-    std::vector<std::string> files = {
-        baseDir + "ffx_a.h",
-        baseDir + "ffx_fsr1.h",
-        baseDir + "fsr_easu.compute.base.glsl"
-    };
-    std::vector<std::string> header = {
-        "#version " GLSL_VERION,
-        "#extension GL_ARB_compute_shader : enable",
-        "#extension GL_ARB_gpu_shader5 : enable",
-        "#extension GL_ARB_shader_image_load_store : enable",
-        "#extension GL_EXT_shader_image_load_store : enable",
-        "#extension GL_ARB_shading_language_420pack : enable",
-        "#extension GL_ARB_shading_language_packing : enable",
-    };
-
-    std::string shader = buildShader(header, files, defines);
-
-
-    return compileProgram(shader);
-}
-
-uint32_t createFSRComputeProgramRCAS(const std::string& baseDir) {
-    std::map<std::string, std::string> defines = {
-        { "A_GPU", "1" },
-        { "A_GLSL", "1" },
-        { "SAMPLE_SLOW_FALLBACK", "1" },
-        { "SAMPLE_RCAS", "1" },
-        { "FSR_RCAS_F", "1" },
-
-        { "SAMPLE_EASU", "0" },
-        { "SAMPLE_BILINEAR", "0" },
-    };
-    std::vector<std::string> files = {
-        baseDir + "ffx_a.h",
-        baseDir + "ffx_fsr1.h",
-        baseDir + "fsr_easu.compute.base.glsl"
-    };
-    std::vector<std::string> header = {
-        "#version " GLSL_VERION,
-        "#extension GL_ARB_compute_shader : enable",
-        "#extension GL_ARB_gpu_shader5 : enable",
-        "#extension GL_ARB_shader_image_load_store : enable",
-        "#extension GL_EXT_shader_image_load_store : enable",
-        "#extension GL_ARB_shading_language_420pack : enable",
-        "#extension GL_ARB_shading_language_packing : enable",
-    };
-
-    std::string shader = buildShader(header, files, defines);
-
-    return compileProgram(shader);
-}
-
-uint32_t createBilinearComputeProgram(const std::string& baseDir) {
-
-    std::map<std::string, std::string> defines = {
-        { "A_GPU", "1" },
-        { "A_GLSL", "1" },
-        { "SAMPLE_BILINEAR", "1"},
-        { "SAMPLE_SLOW_FALLBACK", "1" },
-
-        { "SAMPLE_RCAS", "0" },
-        { "FSR_RCAS_F", "0" },
-        { "SAMPLE_EASU", "0" },
-    };
-    std::vector<std::string> files = {
-        baseDir + "ffx_a.h",
-//        baseDir + "ffx_fsr1.h",
-        baseDir + "fsr_easu.compute.base.glsl"
-    };
-    std::vector<std::string> header = {
-        "#version " GLSL_VERION,
-        "#extension GL_ARB_compute_shader : enable",
-        "#extension GL_ARB_gpu_shader5 : enable",
-        "#extension GL_ARB_shader_image_load_store : enable",
-        "#extension GL_EXT_shader_image_load_store : enable",
-        "#extension GL_ARB_shading_language_420pack : enable",
-        "#extension GL_ARB_shading_language_packing : enable",
-    };
-
-    std::string shader = buildShader(header, files, defines);
-
-    return compileProgram(shader);
-}
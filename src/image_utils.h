@@ -1,11 +1,31 @@
 #ifndef IMAGE_UTILS_H
 #define IMAGE_UTILS_H
 
+#include <cstdint>
 #include <string>
 #include <map>
 #include <vector>
 
-bool LoadTextureFromFile(const char* filename, GLuint* out_texture, uint32_t* out_width, uint32_t* out_height);
+// The files are memory mapped (MappedFile) and decoded with stb_image from there, no GL involved,
+// so these run on any thread.
+
+// Size of an image file, from its header.
+bool GetImageInfo(const char* filename, uint32_t* out_width, uint32_t* out_height);
+// Decodes an image file of the size GetImageInfo returned into 'rgba', width * height * 4 bytes.
+// stb decodes into its own memory, 'rgba' is written once with a copy of the result.
+bool LoadImageIntoMemory(const char* filename, uint8_t* rgba, uint32_t width, uint32_t height);
+// Decodes an image file into tightly packed RGBA8 pixels.
+bool LoadImageFromFile(const char* filename, std::vector<uint8_t>* out_rgba, uint32_t* out_width, uint32_t* out_height);
+
+// Same for an encoded image which is already in memory.
+bool GetImageInfoFromMemory(const uint8_t* data, size_t size, uint32_t* out_width, uint32_t* out_height);
+bool LoadImageIntoMemory(const uint8_t* data, size_t size, uint8_t* rgba, uint32_t width, uint32_t height);
+bool LoadImageFromMemory(const uint8_t* data, size_t size, std::vector<uint8_t>* out_rgba, uint32_t* out_width, uint32_t* out_height);
+
+bool LoadTextureFromFile(const char* filename, uint32_t* out_texture, uint32_t* out_width, uint32_t* out_height);
+// Same for tightly packed RGBA8 pixels which are already in memory, or at offset 'rgba' of the bound
+// GL_PIXEL_UNPACK_BUFFER.
+bool LoadTextureFromMemory(const uint8_t* rgba, uint32_t width, uint32_t height, uint32_t* out_texture);
 
 typedef uint32_t AU1;
 
@@ -14,6 +34,14 @@ struct Extent {
     uint32_t height;
 };
 
+// [x, x + width) x [y, y + height) in pixels.
+struct Rect {
+    uint32_t x;
+    uint32_t y;
+    uint32_t width;
+    uint32_t height;
+};
+
 struct FSRConstants {
     AU1 const0[4];
     AU1 const1[4];
@@ -29,8 +57,4 @@ struct FSRConstants {
 
 void prepareFSR(FSRConstants* fsrData, float rcasAttenuation);
 
-uint32_t createFSRComputeProgramEAUS(const std::string& baseDir);
-uint32_t createFSRComputeProgramRCAS(const std::string& baseDir);
-uint32_t createBilinearComputeProgram(const std::string& baseDir);
-
 #endif /* IMAGE_UTILS_H */
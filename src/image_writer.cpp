@@ -0,0 +1,955 @@
+#include "image_writer.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+
+#include "thread_pool.h"
+#include "trace.h"
+
+// SSE2 is part of x86-64, the filter and checksum loops use it unconditionally there.
+#if defined(__SSE2__) || defined(_M_X64)
+#define IMAGE_WRITER_SSE2 1
+#include <emmintrin.h>
+#else
+#define IMAGE_WRITER_SSE2 0
+#endif
+
+// Raw bytes per strip, enough strips for every thread of a 1080p image, big enough that the
+// deflate of a strip still finds its matches.
+static const size_t stripBytes = 256 * 1024;
+
+static uint32_t stripRows(const Extent& size, size_t bytesPerPixel) {
+    const size_t rowBytes = std::max((size_t)size.width * bytesPerPixel, (size_t)1);
+    return (uint32_t)std::max(stripBytes / rowBytes, (size_t)1);
+}
+
+static void forEachStrip(ThreadPool* pool, uint32_t count, const std::function<void(uint32_t strip)>& fn) {
+    if (pool && count > 1) {
+        pool->parallelFor(count, [&](uint32_t index, uint32_t) {
+            TRACE_ZONE("encodeStrip");
+            fn(index);
+        });
+    } else {
+        for (uint32_t index = 0; index < count; index++) {
+            TRACE_ZONE("encodeStrip");
+            fn(index);
+        }
+    }
+}
+
+static void storeBE32(uint8_t* out, uint32_t value) {
+    out[0] = (uint8_t)(value >> 24);
+    out[1] = (uint8_t)(value >> 16);
+    out[2] = (uint8_t)(value >> 8);
+    out[3] = (uint8_t)value;
+}
+
+static void addText(EncodedImage* encoded, const char* text) {
+    encoded->buffers.emplace_back(text, text + strlen(text));
+}
+
+// ---- PPM, PAM, raw ----
+
+static void encodePPM(const uint8_t* rgba, const Extent& size, ThreadPool* pool, EncodedImage* encoded) {
+    char header[64];
+    snprintf(header, sizeof(header), "P6\n%u %u\n255\n", size.width, size.height);
+    addText(encoded, header);
+
+    const uint32_t rows = stripRows(size, 4);
+    const uint32_t strips = (size.height + rows - 1) / rows;
+    const size_t firstStrip = encoded->buffers.size();
+    encoded->buffers.resize(firstStrip + strips);
+    forEachStrip(pool, strips, [&](uint32_t strip) {
+        const uint32_t y0 = strip * rows;
+        const size_t pixels = (size_t)std::min(rows, size.height - y0) * size.width;
+        const uint8_t* src = rgba + (size_t)y0 * size.width * 4;
+        std::vector<uint8_t>& out = encoded->buffers[firstStrip + strip];
+        out.resize(pixels * 3);
+        for (size_t idx = 0; idx < pixels; idx++) {
+            out[idx * 3 + 0] = src[idx * 4 + 0];
+            out[idx * 3 + 1] = src[idx * 4 + 1];
+            out[idx * 3 + 2] = src[idx * 4 + 2];
+        }
+    });
+}
+
+static void encodePAM(const uint8_t* rgba, const Extent& size, EncodedImage* encoded) {
+    char header[128];
+    snprintf(header, sizeof(header), "P7\nWIDTH %u\nHEIGHT %u\nDEPTH 4\nMAXVAL 255\nTUPLTYPE RGB_ALPHA\nENDHDR\n", size.width, size.height);
+    addText(encoded, header);
+    encoded->pieces.push_back({ rgba, (size_t)size.width * size.height * 4 });
+}
+
+// ---- QOI ----
+
+namespace {
+
+struct QOIPixel {
+    uint8_t r, g, b, a;
+
+    bool operator==(const QOIPixel& other) const { return r == other.r && g == other.g && b == other.b && a == other.a; }
+    uint32_t hash() const { return (r * 3 + g * 5 + b * 7 + a * 11) % 64; }
+};
+
+} // namespace
+
+// One strip of the QOI stream, valid whatever the decoder state is when it gets there: the first
+// pixel is QOI_OP_RGBA and QOI_OP_INDEX only refers to colors this strip put into the index.
+// Returns the bytes written, at most 5 per pixel.
+static size_t encodeQOIStrip(const uint8_t* rgba, size_t pixels, uint8_t* out) {
+    QOIPixel index[64] = {};
+    uint64_t indexed = 0;
+    QOIPixel prev = {};
+    uint32_t run = 0;
+    uint8_t* dst = out;
+
+    for (size_t idx = 0; idx < pixels; idx++) {
+        const QOIPixel px = { rgba[idx * 4 + 0], rgba[idx * 4 + 1], rgba[idx * 4 + 2], rgba[idx * 4 + 3] };
+        if (idx > 0 && px == prev) {
+            if (++run == 62) {
+                *dst++ = 0xc0 | (run - 1); // QOI_OP_RUN
+                run = 0;
+            }
+            continue;
+        }
+        if (run) {
+            *dst++ = 0xc0 | (run - 1);
+            run = 0;
+        }
+
+        const uint32_t hash = px.hash();
+        if ((indexed >> hash & 1) && index[hash] == px) {
+            *dst++ = (uint8_t)hash; // QOI_OP_INDEX
+        } else {
+            index[hash] = px;
+            indexed |= (uint64_t)1 << hash;
+
+            if (idx > 0 && px.a == prev.a) {
+                const int8_t vr = (int8_t)(px.r - prev.r);
+                const int8_t vg = (int8_t)(px.g - prev.g);
+                const int8_t vb = (int8_t)(px.b - prev.b);
+                const int vgr = vr - vg;
+                const int vgb = vb - vg;
+                if (vr > -3 && vr < 2 && vg > -3 && vg < 2 && vb > -3 && vb < 2) {
+                    *dst++ = (uint8_t)(0x40 | (vr + 2) << 4 | (vg + 2) << 2 | (vb + 2)); // QOI_OP_DIFF
+                } else if (vgr > -9 && vgr < 8 && vg > -33 && vg < 32 && vgb > -9 && vgb < 8) {
+                    *dst++ = (uint8_t)(0x80 | (vg + 32)); // QOI_OP_LUMA
+                    *dst++ = (uint8_t)((vgr + 8) << 4 | (vgb + 8));
+                } else {
+                    *dst++ = 0xfe; // QOI_OP_RGB
+                    *dst++ = px.r;
+                    *dst++ = px.g;
+                    *dst++ = px.b;
+                }
+            } else {
+                *dst++ = 0xff; // QOI_OP_RGBA
+                *dst++ = px.r;
+                *dst++ = px.g;
+                *dst++ = px.b;
+                *dst++ = px.a;
+            }
+        }
+        prev = px;
+    }
+    if (run) {
+        *dst++ = 0xc0 | (run - 1);
+    }
+    return dst - out;
+}
+
+static void encodeQOI(const uint8_t* rgba, const Extent& size, ThreadPool* pool, EncodedImage* encoded) {
+    std::vector<uint8_t> header(14);
+    memcpy(header.data(), "qoif", 4);
+    storeBE32(&header[4], size.width);
+    storeBE32(&header[8], size.height);
+    header[12] = 4; // channels
+    header[13] = 0; // sRGB with linear alpha
+    encoded->buffers.push_back(std::move(header));
+
+    const uint32_t rows = stripRows(size, 4);
+    const uint32_t strips = (size.height + rows - 1) / rows;
+    const size_t firstStrip = encoded->buffers.size();
+    encoded->buffers.resize(firstStrip + strips);
+    forEachStrip(pool, strips, [&](uint32_t strip) {
+        const uint32_t y0 = strip * rows;
+        const size_t pixels = (size_t)std::min(rows, size.height - y0) * size.width;
+        std::vector<uint8_t>& out = encoded->buffers[firstStrip + strip];
+        out.resize(pixels * 5);
+        out.resize(encodeQOIStrip(rgba + (size_t)y0 * size.width * 4, pixels, out.data()));
+    });
+
+    const uint8_t end[8] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+    encoded->buffers.emplace_back(end, end + sizeof(end));
+}
+
+// ---- PNG ----
+
+namespace {
+
+// Slicing by 8, the PNG (zlib) polynomial.
+struct CRC32Table {
+    uint32_t table[8][256];
+
+    CRC32Table() {
+        for (uint32_t n = 0; n < 256; n++) {
+            uint32_t c = n;
+            for (int k = 0; k < 8; k++) {
+                c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            }
+            table[0][n] = c;
+        }
+        for (uint32_t n = 0; n < 256; n++) {
+            for (int slice = 1; slice < 8; slice++) {
+                table[slice][n] = (table[slice - 1][n] >> 8) ^ table[0][table[slice - 1][n] & 0xff];
+            }
+        }
+    }
+};
+
+// Length and distance codes of RFC 1951 3.2.5.
+const uint16_t lengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+const uint8_t lengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+const uint16_t distBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073,
+                                4097, 6145, 8193, 12289, 16385, 24577 };
+const uint8_t distExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+// Order the code length code lengths are sent in.
+const uint8_t codeLengthOrder[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+// Symbol of every match length and distance, distances above 256 by their top bits.
+struct DeflateTables {
+    uint8_t lengthSymbol[259]; // minus 257
+    uint8_t distSymbolLow[256];
+    uint8_t distSymbolHigh[256];
+
+    DeflateTables() {
+        for (int sym = 0; sym < 29; sym++) {
+            for (int len = lengthBase[sym]; len < lengthBase[sym] + (1 << lengthExtra[sym]) && len <= 258; len++) {
+                lengthSymbol[len] = (uint8_t)sym;
+            }
+        }
+        // 258 has its own code, 284 with all extra bits set would also be 258
+        lengthSymbol[258] = 28;
+        for (int sym = 0; sym < 30; sym++) {
+            for (int dist = distBase[sym]; dist < distBase[sym] + (1 << distExtra[sym]); dist++) {
+                if (dist <= 256) {
+                    distSymbolLow[dist - 1] = (uint8_t)sym;
+                } else {
+                    distSymbolHigh[(dist - 1) >> 7] = (uint8_t)sym;
+                }
+            }
+        }
+    }
+
+    uint32_t distSymbol(uint32_t dist) const { return dist <= 256 ? distSymbolLow[dist - 1] : distSymbolHigh[(dist - 1) >> 7]; }
+};
+
+const CRC32Table& crc32Table() {
+    static const CRC32Table table;
+    return table;
+}
+
+const DeflateTables& deflateTables() {
+    static const DeflateTables tables;
+    return tables;
+}
+
+// LSB first, the way deflate packs its bits. Needs 8 bytes of slack after the data.
+struct BitWriter {
+    uint8_t* out;
+    uint64_t bits = 0;
+    uint32_t count = 0;
+
+    explicit BitWriter(uint8_t* out_) : out(out_) {}
+
+    void put(uint32_t value, uint32_t length) {
+        bits |= (uint64_t)value << count;
+        count += length;
+        if (count >= 32) {
+            out[0] = (uint8_t)bits;
+            out[1] = (uint8_t)(bits >> 8);
+            out[2] = (uint8_t)(bits >> 16);
+            out[3] = (uint8_t)(bits >> 24);
+            out += 4;
+            bits >>= 32;
+            count -= 32;
+        }
+    }
+
+    // Pads to a byte boundary and writes out what is left.
+    uint8_t* finish() {
+        while (count > 0) {
+            *out++ = (uint8_t)bits;
+            bits >>= 8;
+            count = count > 8 ? count - 8 : 0;
+        }
+        return out;
+    }
+};
+
+// A match and the literals in front of it, the last token of a strip has length 0.
+struct Token {
+    uint32_t literals;
+    uint16_t length;
+    uint16_t dist;
+};
+
+struct HuffmanCode {
+    uint8_t lengths[286];
+    uint16_t codes[286]; // bit reversed for BitWriter
+};
+
+// Per thread, reused between strips.
+struct DeflateScratch {
+    std::vector<uint8_t> filtered;
+    std::vector<Token> tokens;
+    std::vector<uint32_t> head;
+};
+
+} // namespace
+
+static uint32_t crc32(uint32_t crc, const uint8_t* data, size_t size) {
+    const CRC32Table& crc32 = crc32Table();
+    crc = ~crc;
+    while (size >= 8) {
+        const uint32_t lo = crc ^ (data[0] | data[1] << 8 | data[2] << 16 | (uint32_t)data[3] << 24);
+        const uint32_t hi = data[4] | data[5] << 8 | data[6] << 16 | (uint32_t)data[7] << 24;
+        crc = crc32.table[7][lo & 0xff] ^ crc32.table[6][(lo >> 8) & 0xff] ^ crc32.table[5][(lo >> 16) & 0xff] ^ crc32.table[4][lo >> 24] ^
+              crc32.table[3][hi & 0xff] ^ crc32.table[2][(hi >> 8) & 0xff] ^ crc32.table[1][(hi >> 16) & 0xff] ^ crc32.table[0][hi >> 24];
+        data += 8;
+        size -= 8;
+    }
+    while (size--) {
+        crc = crc32.table[0][(crc ^ *data++) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+static const uint32_t adlerBase = 65521;
+
+static uint32_t adler32(const uint8_t* data, size_t size) {
+    uint32_t a = 1, b = 0;
+    while (size > 0) {
+        // the largest block which can't overflow b before the modulo
+        size_t block = std::min(size, (size_t)5552);
+        size -= block;
+#if IMAGE_WRITER_SSE2
+        // 16 bytes at a time: a gets their sum, b a + 16 * (the previous a) and the bytes weighted 16..1
+        const size_t vectors = block / 16;
+        if (vectors) {
+            const __m128i zero = _mm_setzero_si128();
+            const __m128i weightsLo = _mm_setr_epi16(16, 15, 14, 13, 12, 11, 10, 9);
+            const __m128i weightsHi = _mm_setr_epi16(8, 7, 6, 5, 4, 3, 2, 1);
+            __m128i sumA = zero, sumB = zero, prefixA = zero;
+            for (size_t idx = 0; idx < vectors; idx++) {
+                const __m128i bytes = _mm_loadu_si128((const __m128i*)(data + idx * 16));
+                prefixA = _mm_add_epi32(prefixA, sumA);
+                sumA = _mm_add_epi32(sumA, _mm_sad_epu8(bytes, zero));
+                sumB = _mm_add_epi32(sumB, _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi8(bytes, zero), weightsLo),
+                                                         _mm_madd_epi16(_mm_unpackhi_epi8(bytes, zero), weightsHi)));
+            }
+            uint32_t lanes[4];
+            _mm_storeu_si128((__m128i*)lanes, prefixA);
+            const uint64_t prefix = (uint64_t)lanes[0] + lanes[1] + lanes[2] + lanes[3];
+            _mm_storeu_si128((__m128i*)lanes, sumB);
+            const uint64_t weighted = (uint64_t)lanes[0] + lanes[1] + lanes[2] + lanes[3];
+            _mm_storeu_si128((__m128i*)lanes, sumA);
+            b = (uint32_t)((b + (uint64_t)a * vectors * 16 + prefix * 16 + weighted) % adlerBase);
+            a += lanes[0] + lanes[2];
+            data += vectors * 16;
+            block -= vectors * 16;
+        }
+#endif
+        for (size_t idx = 0; idx < block; idx++) {
+            a += data[idx];
+            b += a;
+        }
+        a %= adlerBase;
+        b %= adlerBase;
+        data += block;
+    }
+    return b << 16 | a;
+}
+
+// Adler-32 of two concatenated blocks from theirs, zlib's adler32_combine.
+static uint32_t adler32Combine(uint32_t adler1, uint32_t adler2, size_t size2) {
+    const uint32_t rem = (uint32_t)(size2 % adlerBase);
+    uint32_t sum1 = adler1 & 0xffff;
+    uint32_t sum2 = (uint32_t)(((uint64_t)rem * sum1) % adlerBase);
+    sum1 += (adler2 & 0xffff) + adlerBase - 1;
+    sum2 += (adler1 >> 16) + (adler2 >> 16) + adlerBase - rem;
+    if (sum1 >= adlerBase) sum1 -= adlerBase;
+    if (sum1 >= adlerBase) sum1 -= adlerBase;
+    if (sum2 >= (adlerBase << 1)) sum2 -= (adlerBase << 1);
+    if (sum2 >= adlerBase) sum2 -= adlerBase;
+    return sum2 << 16 | sum1;
+}
+
+// Code lengths of at most 'maxBits' for 'count' symbols: a Huffman tree from two sorted queues,
+// then the lengths over the limit are pushed back under it the way miniz does. Gives at least two
+// symbols a code, inflate implementations differ on incomplete codes.
+static void huffmanLengths(const uint32_t* freq, int count, int maxBits, uint8_t* lengths) {
+    struct Leaf {
+        uint32_t freq;
+        uint16_t symbol;
+    };
+    Leaf leaves[286];
+    int used = 0;
+    for (int sym = 0; sym < count; sym++) {
+        lengths[sym] = 0;
+        if (freq[sym]) {
+            leaves[used++] = { freq[sym], (uint16_t)sym };
+        }
+    }
+    for (int sym = 0; used < 2 && sym < count; sym++) {
+        if (!freq[sym]) {
+            leaves[used++] = { 1, (uint16_t)sym };
+        }
+    }
+    std::sort(leaves, leaves + used, [](const Leaf& a, const Leaf& b) { return a.freq < b.freq; });
+
+    // nodes 0..used-1 are the leaves, then the internal nodes in the order they are made
+    uint64_t weight[2 * 286];
+    uint16_t parent[2 * 286];
+    for (int idx = 0; idx < used; idx++) {
+        weight[idx] = leaves[idx].freq;
+    }
+    int nextLeaf = 0, nextNode = used, made = used;
+    auto smallest = [&]() {
+        if (nextLeaf < used && (nextNode >= made || weight[nextLeaf] <= weight[nextNode])) {
+            return nextLeaf++;
+        }
+        return nextNode++;
+    };
+    for (int step = 0; step < used - 1; step++) {
+        const int a = smallest();
+        const int b = smallest();
+        weight[made] = weight[a] + weight[b];
+        parent[a] = parent[b] = (uint16_t)made;
+        made++;
+    }
+
+    // parents come after their children, so one pass from the root down
+    uint16_t depth[2 * 286];
+    int numCodes[2 * 286] = {};
+    depth[made - 1] = 0;
+    for (int node = made - 2; node >= 0; node--) {
+        depth[node] = depth[parent[node]] + 1;
+        if (node < used) {
+            numCodes[depth[node]]++;
+        }
+    }
+
+    for (int bits = maxBits + 1; bits < made; bits++) {
+        numCodes[maxBits] += numCodes[bits];
+        numCodes[bits] = 0;
+    }
+    uint32_t total = 0;
+    for (int bits = maxBits; bits > 0; bits--) {
+        total += (uint32_t)numCodes[bits] << (maxBits - bits);
+    }
+    while (total != (1u << maxBits)) {
+        numCodes[maxBits]--;
+        for (int bits = maxBits - 1; bits > 0; bits--) {
+            if (numCodes[bits]) {
+                numCodes[bits]--;
+                numCodes[bits + 1] += 2;
+                break;
+            }
+        }
+        total--;
+    }
+
+    // the rarest symbols get the longest codes
+    int leaf = 0;
+    for (int bits = maxBits; bits > 0; bits--) {
+        for (int idx = 0; idx < numCodes[bits]; idx++) {
+            lengths[leaves[leaf++].symbol] = (uint8_t)bits;
+        }
+    }
+}
+
+// Canonical codes of RFC 1951 3.2.2, reversed.
+static void huffmanCodes(const uint8_t* lengths, int count, uint16_t* codes) {
+    uint32_t blCount[16] = {};
+    for (int sym = 0; sym < count; sym++) {
+        blCount[lengths[sym]]++;
+    }
+    blCount[0] = 0;
+    uint32_t next[16] = {};
+    uint32_t code = 0;
+    for (int bits = 1; bits < 16; bits++) {
+        code = (code + blCount[bits - 1]) << 1;
+        next[bits] = code;
+    }
+    for (int sym = 0; sym < count; sym++) {
+        const uint32_t length = lengths[sym];
+        if (length == 0) {
+            codes[sym] = 0;
+            continue;
+        }
+        uint32_t value = next[length]++;
+        uint32_t reversed = 0;
+        for (uint32_t bit = 0; bit < length; bit++) {
+            reversed = (reversed << 1) | (value & 1);
+            value >>= 1;
+        }
+        codes[sym] = (uint16_t)reversed;
+    }
+}
+
+static inline uint8_t paeth(int a, int b, int c) {
+    const int pa = std::abs(b - c), pb = std::abs(a - c), pc = std::abs(a + b - 2 * c);
+    return (uint8_t)(pa <= pb && pa <= pc ? a : (pb <= pc ? b : c));
+}
+
+// Paeth predictor of every byte of a row against the pixel on the left and the row above.
+static void filterPaeth(const uint8_t* row, const uint8_t* above, size_t bytes, uint8_t* out) {
+    for (size_t idx = 0; idx < 4 && idx < bytes; idx++) {
+        out[idx] = (uint8_t)(row[idx] - (above ? above[idx] : 0));
+    }
+    if (!above) {
+        // Paeth without a row above is the left pixel
+        for (size_t idx = 4; idx < bytes; idx++) {
+            out[idx] = (uint8_t)(row[idx] - row[idx - 4]);
+        }
+        return;
+    }
+
+    size_t idx = 4;
+#if IMAGE_WRITER_SSE2
+    // the predictor only depends on the input, 8 bytes per half in 16 bit lanes
+    const __m128i zero = _mm_setzero_si128();
+    auto predict = [&](__m128i a, __m128i b, __m128i c) {
+        const __m128i bc = _mm_sub_epi16(b, c), ac = _mm_sub_epi16(a, c);
+        const __m128i pa = _mm_max_epi16(bc, _mm_sub_epi16(zero, bc));
+        const __m128i pb = _mm_max_epi16(ac, _mm_sub_epi16(zero, ac));
+        const __m128i abc = _mm_add_epi16(bc, ac);
+        const __m128i pc = _mm_max_epi16(abc, _mm_sub_epi16(zero, abc));
+        const __m128i useA = _mm_andnot_si128(_mm_or_si128(_mm_cmpgt_epi16(pa, pb), _mm_cmpgt_epi16(pa, pc)), _mm_set1_epi16(-1));
+        const __m128i useB = _mm_andnot_si128(_mm_cmpgt_epi16(pb, pc), _mm_set1_epi16(-1));
+        const __m128i bOrC = _mm_or_si128(_mm_and_si128(useB, b), _mm_andnot_si128(useB, c));
+        return _mm_or_si128(_mm_and_si128(useA, a), _mm_andnot_si128(useA, bOrC));
+    };
+    for (; idx + 16 <= bytes; idx += 16) {
+        const __m128i a = _mm_loadu_si128((const __m128i*)(row + idx - 4));
+        const __m128i b = _mm_loadu_si128((const __m128i*)(above + idx));
+        const __m128i c = _mm_loadu_si128((const __m128i*)(above + idx - 4));
+        const __m128i lo = predict(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero), _mm_unpacklo_epi8(c, zero));
+        const __m128i hi = predict(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero), _mm_unpackhi_epi8(c, zero));
+        const __m128i x = _mm_loadu_si128((const __m128i*)(row + idx));
+        _mm_storeu_si128((__m128i*)(out + idx), _mm_sub_epi8(x, _mm_packus_epi16(lo, hi)));
+    }
+#endif
+    for (; idx < bytes; idx++) {
+        out[idx] = (uint8_t)(row[idx] - paeth(row[idx - 4], above[idx], above[idx - 4]));
+    }
+}
+
+// Stored blocks of RFC 1951 3.2.4, none final. Ends byte aligned.
+static uint8_t* deflateStored(const uint8_t* data, size_t size, uint8_t* out) {
+    do {
+        const uint32_t block = (uint32_t)std::min(size, (size_t)65535);
+        *out++ = 0; // BFINAL 0, BTYPE 00, padding
+        *out++ = (uint8_t)block;
+        *out++ = (uint8_t)(block >> 8);
+        *out++ = (uint8_t)~block;
+        *out++ = (uint8_t)(~block >> 8);
+        memcpy(out, data, block);
+        out += block;
+        data += block;
+        size -= block;
+    } while (size > 0);
+    return out;
+}
+
+static size_t storedBytes(size_t size) {
+    return size + 5 * std::max((size + 65534) / 65535, (size_t)1);
+}
+
+// One dynamic Huffman block of 'data' into 'out', followed by an empty stored block so it ends byte
+// aligned, or stored blocks if that is not smaller. 'out' has room for storedBytes(size) + 16.
+static uint8_t* deflateStrip(const uint8_t* data, size_t size, DeflateScratch& scratch, uint8_t* out) {
+    const DeflateTables& tables = deflateTables();
+    static const int hashBits = 15;
+
+    // LZ77, a single probe of the last position with the same 4 bytes. Like LZ4 the search steps over
+    // more bytes the longer it finds nothing, noisy data goes out as literals at close to memcpy speed.
+    scratch.tokens.resize(size / 4 + 1);
+    scratch.head.assign((size_t)1 << hashBits, 0);
+    Token* tokens = scratch.tokens.data();
+    uint32_t* head = scratch.head.data();
+    uint32_t litFreq[286] = {}, distFreq[30] = {};
+    size_t tokenCount = 0;
+    size_t pos = 0, literalStart = 0;
+    uint32_t misses = 0;
+    while (pos + 8 <= size) {
+        uint32_t word;
+        memcpy(&word, data + pos, 4);
+        const uint32_t hash = (word * 2654435761u) >> (32 - hashBits);
+        const uint32_t candidate = head[hash]; // position + 1
+        head[hash] = (uint32_t)pos + 1;
+        uint32_t candidateWord = 0;
+        if (candidate) {
+            memcpy(&candidateWord, data + candidate - 1, 4);
+        }
+        if (!candidate || pos - (candidate - 1) > 32768 || candidateWord != word) {
+            pos += 1 + (misses++ >> 5);
+            continue;
+        }
+        misses = 0;
+
+        const uint8_t* match = data + candidate - 1;
+        const size_t maxLength = std::min(size - pos, (size_t)258);
+        size_t length = 4;
+        while (length + 8 <= maxLength) {
+            uint64_t a, b;
+            memcpy(&a, match + length, 8);
+            memcpy(&b, data + pos + length, 8);
+            if (a != b) {
+                break;
+            }
+            length += 8;
+        }
+        while (length < maxLength && match[length] == data[pos + length]) {
+            length++;
+        }
+        const uint32_t dist = (uint32_t)(pos - (candidate - 1));
+        tokens[tokenCount++] = { (uint32_t)(pos - literalStart), (uint16_t)length, (uint16_t)dist };
+        litFreq[257 + tables.lengthSymbol[length]]++;
+        distFreq[tables.distSymbol(dist)]++;
+        pos += length;
+        literalStart = pos;
+    }
+    tokens[tokenCount++] = { (uint32_t)(size - literalStart), 0, 0 };
+
+    // the literals, four histograms so increments of the same byte value don't wait on each other
+    {
+        uint32_t partial[4][256] = {};
+        const uint8_t* literal = data;
+        for (size_t idx = 0; idx < tokenCount; idx++) {
+            const uint32_t count = tokens[idx].literals;
+            uint32_t n = 0;
+            for (; n + 4 <= count; n += 4) {
+                partial[0][literal[n]]++;
+                partial[1][literal[n + 1]]++;
+                partial[2][literal[n + 2]]++;
+                partial[3][literal[n + 3]]++;
+            }
+            for (; n < count; n++) {
+                partial[0][literal[n]]++;
+            }
+            literal += count + tokens[idx].length;
+        }
+        for (int value = 0; value < 256; value++) {
+            litFreq[value] = partial[0][value] + partial[1][value] + partial[2][value] + partial[3][value];
+        }
+    }
+    litFreq[256] = 1;
+
+    HuffmanCode lit, dist;
+    huffmanLengths(litFreq, 286, 15, lit.lengths);
+    huffmanLengths(distFreq, 30, 15, dist.lengths);
+    int numLit = 286, numDist = 30;
+    while (numLit > 257 && lit.lengths[numLit - 1] == 0) {
+        numLit--;
+    }
+    while (numDist > 1 && dist.lengths[numDist - 1] == 0) {
+        numDist--;
+    }
+
+    // run length coded code lengths, 16 repeats the previous length, 17 and 18 are runs of zeros
+    uint8_t allLengths[286 + 30];
+    memcpy(allLengths, lit.lengths, numLit);
+    memcpy(allLengths + numLit, dist.lengths, numDist);
+    const int lengthCount = numLit + numDist;
+    uint8_t clSymbols[286 + 30], clExtra[286 + 30];
+    int clCount = 0;
+    uint32_t clFreq[19] = {};
+    for (int idx = 0; idx < lengthCount;) {
+        const uint8_t length = allLengths[idx];
+        int run = 1;
+        while (idx + run < lengthCount && allLengths[idx + run] == length) {
+            run++;
+        }
+        idx += run;
+        if (length == 0) {
+            while (run >= 11) {
+                const int part = std::min(run, 138);
+                clSymbols[clCount] = 18;
+                clExtra[clCount++] = (uint8_t)(part - 11);
+                run -= part;
+            }
+            if (run >= 3) {
+                clSymbols[clCount] = 17;
+                clExtra[clCount++] = (uint8_t)(run - 3);
+                run = 0;
+            }
+        } else {
+            clSymbols[clCount++] = length;
+            run--;
+            while (run >= 3) {
+                const int part = std::min(run, 6);
+                clSymbols[clCount] = 16;
+                clExtra[clCount++] = (uint8_t)(part - 3);
+                run -= part;
+            }
+        }
+        while (run-- > 0) {
+            clSymbols[clCount++] = length;
+        }
+    }
+    for (int idx = 0; idx < clCount; idx++) {
+        clFreq[clSymbols[idx]]++;
+    }
+    uint8_t clLengths[19];
+    uint16_t clCodes[19];
+    huffmanLengths(clFreq, 19, 7, clLengths);
+    huffmanCodes(clLengths, 19, clCodes);
+    int numCL = 19;
+    while (numCL > 4 && clLengths[codeLengthOrder[numCL - 1]] == 0) {
+        numCL--;
+    }
+
+    // the block in bits, against storing
+    uint64_t bits = 3 + 5 + 5 + 4 + 3 * numCL;
+    static const uint8_t clExtraBits[19] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 3, 7 };
+    for (int idx = 0; idx < clCount; idx++) {
+        bits += clLengths[clSymbols[idx]] + clExtraBits[clSymbols[idx]];
+    }
+    for (int sym = 0; sym < 286; sym++) {
+        bits += (uint64_t)litFreq[sym] * (lit.lengths[sym] + (sym > 256 ? lengthExtra[sym - 257] : 0));
+    }
+    for (int sym = 0; sym < 30; sym++) {
+        bits += (uint64_t)distFreq[sym] * (dist.lengths[sym] + distExtra[sym]);
+    }
+    if (bits / 8 + 1 + 5 >= storedBytes(size)) {
+        return deflateStored(data, size, out);
+    }
+
+    huffmanCodes(lit.lengths, 286, lit.codes);
+    huffmanCodes(dist.lengths, 30, dist.codes);
+    BitWriter writer(out);
+    writer.put(0, 1); // BFINAL
+    writer.put(2, 2); // BTYPE dynamic
+    writer.put(numLit - 257, 5);
+    writer.put(numDist - 1, 5);
+    writer.put(numCL - 4, 4);
+    for (int idx = 0; idx < numCL; idx++) {
+        writer.put(clLengths[codeLengthOrder[idx]], 3);
+    }
+    for (int idx = 0; idx < clCount; idx++) {
+        const uint8_t sym = clSymbols[idx];
+        writer.put(clCodes[sym], clLengths[sym]);
+        if (clExtraBits[sym]) {
+            writer.put(clExtra[idx], clExtraBits[sym]);
+        }
+    }
+
+    const uint8_t* literal = data;
+    for (size_t idx = 0; idx < tokenCount; idx++) {
+        const Token token = tokens[idx];
+        // two literals per put, 15 bits at most each
+        uint32_t n = 0;
+        for (; n + 2 <= token.literals; n += 2) {
+            const uint8_t a = literal[n], b = literal[n + 1];
+            writer.put(lit.codes[a] | (uint32_t)lit.codes[b] << lit.lengths[a], lit.lengths[a] + lit.lengths[b]);
+        }
+        if (n < token.literals) {
+            writer.put(lit.codes[literal[n]], lit.lengths[literal[n]]);
+        }
+        literal += token.literals + token.length;
+        if (token.length == 0) {
+            continue;
+        }
+
+        const uint32_t lengthSym = tables.lengthSymbol[token.length];
+        writer.put(lit.codes[257 + lengthSym], lit.lengths[257 + lengthSym]);
+        writer.put(token.length - lengthBase[lengthSym], lengthExtra[lengthSym]);
+        const uint32_t distSym = tables.distSymbol(token.dist);
+        writer.put(dist.codes[distSym], dist.lengths[distSym]);
+        writer.put(token.dist - distBase[distSym], distExtra[distSym]);
+    }
+    writer.put(lit.codes[256], lit.lengths[256]);
+
+    // sync flush: an empty stored block, its LEN and NLEN start on a byte boundary
+    writer.put(0, 3);
+    out = writer.finish();
+    const uint8_t empty[4] = { 0x00, 0x00, 0xff, 0xff };
+    memcpy(out, empty, 4);
+    return out + 4;
+}
+
+// Chunk length and type go in the 8 bytes reserved in front of 'data', the CRC after it.
+static void finishChunk(std::vector<uint8_t>& chunk, size_t dataSize, const char* type) {
+    storeBE32(&chunk[0], (uint32_t)dataSize);
+    memcpy(&chunk[4], type, 4);
+    chunk.resize(8 + dataSize + 4);
+    storeBE32(&chunk[8 + dataSize], crc32(0, &chunk[4], 4 + dataSize));
+}
+
+static void encodePNG(const uint8_t* rgba, const Extent& size, uint32_t level, ThreadPool* pool, EncodedImage* encoded) {
+    std::vector<uint8_t> header(8 + 8 + 13 + 4);
+    memcpy(header.data(), "\x89PNG\r\n\x1a\n", 8);
+    {
+        std::vector<uint8_t> ihdr(8 + 13);
+        storeBE32(&ihdr[8], size.width);
+        storeBE32(&ihdr[12], size.height);
+        ihdr[16] = 8; // bit depth
+        ihdr[17] = 6; // RGBA
+        ihdr[18] = 0; // deflate
+        ihdr[19] = 0; // adaptive filtering
+        ihdr[20] = 0; // not interlaced
+        finishChunk(ihdr, 13, "IHDR");
+        memcpy(&header[8], ihdr.data(), ihdr.size());
+    }
+    encoded->buffers.push_back(std::move(header));
+
+    const size_t rowBytes = (size_t)size.width * 4;
+    const uint32_t rows = stripRows(size, 4);
+    const uint32_t strips = (size.height + rows - 1) / rows;
+    const size_t firstStrip = encoded->buffers.size();
+    encoded->buffers.resize(firstStrip + strips);
+    std::vector<uint32_t> adlers(strips);
+    std::vector<size_t> filteredSizes(strips);
+    forEachStrip(pool, strips, [&](uint32_t strip) {
+        static thread_local DeflateScratch scratch;
+        const uint32_t y0 = strip * rows;
+        const uint32_t stripHeight = std::min(rows, size.height - y0);
+
+        // the zlib data of the strip: a filter type byte in front of every row
+        const size_t filteredSize = stripHeight * (rowBytes + 1);
+        scratch.filtered.resize(filteredSize);
+        uint8_t* filtered = scratch.filtered.data();
+        for (uint32_t y = 0; y < stripHeight; y++) {
+            const uint8_t* row = rgba + (y0 + y) * rowBytes;
+            uint8_t* dst = filtered + y * (rowBytes + 1);
+            if (level == 0) {
+                dst[0] = 0; // None
+                memcpy(dst + 1, row, rowBytes);
+            } else {
+                dst[0] = 4; // Paeth
+                filterPaeth(row, y0 + y > 0 ? row - rowBytes : nullptr, rowBytes, dst + 1);
+            }
+        }
+        adlers[strip] = adler32(filtered, filteredSize);
+        filteredSizes[strip] = filteredSize;
+
+        std::vector<uint8_t>& chunk = encoded->buffers[firstStrip + strip];
+        chunk.resize(8 + 2 + storedBytes(filteredSize) + 16 + 4);
+        uint8_t* data = &chunk[8];
+        uint8_t* out = data;
+        if (strip == 0) {
+            // zlib header: deflate with a 32K window, fastest
+            *out++ = 0x78;
+            *out++ = 0x01;
+        }
+        out = level == 0 ? deflateStored(filtered, filteredSize, out) : deflateStrip(filtered, filteredSize, scratch, out);
+        finishChunk(chunk, out - data, "IDAT");
+    });
+
+    uint32_t adler = 1;
+    for (uint32_t strip = 0; strip < strips; strip++) {
+        adler = adler32Combine(adler, adlers[strip], filteredSizes[strip]);
+    }
+
+    // the final block is an empty stored one, then the Adler-32 of everything, then IEND
+    std::vector<uint8_t> trailer(8 + 5 + 4);
+    const uint8_t finalBlock[5] = { 0x01, 0x00, 0x00, 0xff, 0xff };
+    memcpy(&trailer[8], finalBlock, 5);
+    storeBE32(&trailer[13], adler);
+    finishChunk(trailer, 9, "IDAT");
+    std::vector<uint8_t> iend(8);
+    finishChunk(iend, 0, "IEND");
+    trailer.insert(trailer.end(), iend.begin(), iend.end());
+    encoded->buffers.push_back(std::move(trailer));
+}
+
+// ----
+
+size_t EncodedImage::bytes() const {
+    size_t total = 0;
+    for (const Piece& piece : pieces) {
+        total += piece.size;
+    }
+    return total;
+}
+
+const char* getImageFileFormatExtension(ImageFileFormat format) {
+    switch (format) {
+    case ImageFileFormat::PPM: return "ppm";
+    case ImageFileFormat::PAM: return "pam";
+    case ImageFileFormat::Raw: return "rgba";
+    case ImageFileFormat::QOI: return "qoi";
+    case ImageFileFormat::PNG: return "png";
+    }
+    return "ppm";
+}
+
+bool parseImageFileFormat(const char* name, ImageFileFormat* format) {
+    const ImageFileFormat formats[] = { ImageFileFormat::PPM, ImageFileFormat::PAM, ImageFileFormat::Raw, ImageFileFormat::QOI, ImageFileFormat::PNG };
+    for (ImageFileFormat candidate : formats) {
+        if (strcmp(name, getImageFileFormatExtension(candidate)) == 0) {
+            *format = candidate;
+            return true;
+        }
+    }
+    if (strcmp(name, "raw") == 0) {
+        *format = ImageFileFormat::Raw;
+        return true;
+    }
+    return false;
+}
+
+bool encodeImage(const uint8_t* rgba, const Extent& size, const ImageWriteOptions& options, EncodedImage* encoded) {
+    TRACE_ZONE("encodeImage");
+    encoded->pieces.clear();
+    encoded->buffers.clear();
+    if (size.width == 0 || size.height == 0) {
+        printf("Unable to encode an empty image\n");
+        return false;
+    }
+
+    switch (options.format) {
+    case ImageFileFormat::PPM: encodePPM(rgba, size, options.pool, encoded); break;
+    case ImageFileFormat::PAM: encodePAM(rgba, size, encoded); break;
+    case ImageFileFormat::Raw: encoded->pieces.push_back({ rgba, (size_t)size.width * size.height * 4 }); break;
+    case ImageFileFormat::QOI: encodeQOI(rgba, size, options.pool, encoded); break;
+    case ImageFileFormat::PNG: encodePNG(rgba, size, options.pngLevel, options.pool, encoded); break;
+    }
+
+    // the buffers in front, PAM has its pixels after the header buffer
+    std::vector<EncodedImage::Piece> pieces;
+    for (const std::vector<uint8_t>& buffer : encoded->buffers) {
+        pieces.push_back({ buffer.data(), buffer.size() });
+    }
+    pieces.insert(pieces.end(), encoded->pieces.begin(), encoded->pieces.end());
+    encoded->pieces = std::move(pieces);
+    return true;
+}
+
+bool writeImageFile(const std::string& filename, const uint8_t* rgba, const Extent& size, const ImageWriteOptions& options) {
+    EncodedImage encoded;
+    if (!encodeImage(rgba, size, options, &encoded)) {
+        return false;
+    }
+
+    TRACE_ZONE("writeImageFile");
+    FILE* fp = fopen(filename.c_str(), "wb");
+    if (fp == NULL) {
+        printf("Unable to open: %s\n", filename.c_str());
+        return false;
+    }
+
+    bool ok = true;
+    for (const EncodedImage::Piece& piece : encoded.pieces) {
+        ok = ok && fwrite(piece.data, 1, piece.size, fp) == piece.size;
+    }
+
+    ok &= fclose(fp) == 0;
+    if (!ok) {
+        printf("Unable to write: %s\n", filename.c_str());
+    }
+    return ok;
+}
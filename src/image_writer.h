@@ -0,0 +1,61 @@
+#ifndef IMAGE_WRITER_H
+#define IMAGE_WRITER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "image_utils.h"
+
+class ThreadPool;
+
+// Lossless writers for the upscaled RGBA8 images, tightly packed with the top row first.
+//
+// The image is encoded in strips of rows which are independent of each other, so a ThreadPool
+// encodes them in parallel and the file is the strips one after another:
+//  - PPM drops the alpha channel (FSR always writes 1), PAM and Raw keep it. Raw has no header,
+//    the size is up to the reader (ffmpeg -f rawvideo -pix_fmt rgba -s WxH).
+//  - QOI starts every strip with a full QOI_OP_RGBA pixel and only indexes colors seen in the
+//    same strip, the concatenated strips are a regular QOI stream.
+//  - PNG deflates every strip separately into its own IDAT chunk, ended by an empty stored block so
+//    the next one starts byte aligned (what zlib calls a sync flush), the Adler-32s are combined.
+enum class ImageFileFormat : uint32_t {
+    PPM,
+    PAM,
+    Raw,
+    QOI,
+    PNG,
+};
+
+struct ImageWriteOptions {
+    ImageFileFormat format = ImageFileFormat::PPM;
+    // PNG: 0 stores the rows as they are, 1 Paeth filter + LZ77 with a single probe hash and a
+    // dynamic Huffman block per strip (a strip which doesn't shrink is stored).
+    uint32_t pngLevel = 1;
+    ThreadPool* pool = nullptr; // strips are encoded serially without
+};
+
+// An encoded file as consecutive pieces, the strips don't have to be joined to be written.
+// Pieces point into 'buffers' or, for PAM and Raw, straight into the source pixels.
+struct EncodedImage {
+    struct Piece {
+        const uint8_t* data;
+        size_t size;
+    };
+    std::vector<Piece> pieces;
+    std::vector<std::vector<uint8_t>> buffers;
+
+    size_t bytes() const;
+};
+
+// "ppm", "pam", "rgba", "qoi" or "png", without the dot.
+const char* getImageFileFormatExtension(ImageFileFormat format);
+// Accepts the extensions above and "raw".
+bool parseImageFileFormat(const char* name, ImageFileFormat* format);
+
+bool encodeImage(const uint8_t* rgba, const Extent& size, const ImageWriteOptions& options, EncodedImage* encoded);
+// Encodes and writes, prints and returns false on errors.
+bool writeImageFile(const std::string& filename, const uint8_t* rgba, const Extent& size, const ImageWriteOptions& options);
+
+#endif /* IMAGE_WRITER_H */
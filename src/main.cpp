@@ -1,4 +1,8 @@
+#include <algorithm>
+#include <chrono>
 #include <cstdio>
+#include <cstring>
+#include <memory>
 #include <string>
 #include <vector>
 #include <iostream>
@@ -13,104 +17,26 @@
 #include <GLFW/glfw3.h>
 
 #include "image_utils.h"
-
-static void runFSR(struct FSRConstants fsrData, uint32_t fsrProgramEASU, uint32_t fsrProgramRCAS, uint32_t fsrData_vbo, uint32_t inputImage, uint32_t outputImage) {
-    uint32_t displayWidth = fsrData.output.width;
-    uint32_t displayHeight = fsrData.output.height;
-
-    static const int threadGroupWorkRegionDim = 16;
-    int dispatchX = (displayWidth + (threadGroupWorkRegionDim - 1)) / threadGroupWorkRegionDim;
-    int dispatchY = (displayHeight + (threadGroupWorkRegionDim - 1)) / threadGroupWorkRegionDim;
-
-
-    // binding point constants in the shaders
-    const int inFSRDataPos = 0;
-    const int inFSRInputTexture = 1;
-    const int inFSROutputTexture = 2;
-
-    { // run FSR EASU
-        glUseProgram(fsrProgramEASU);
-
-        // connect the input uniform data
-        glBindBufferBase(GL_UNIFORM_BUFFER, inFSRDataPos, fsrData_vbo);
-
-        // bind the input image to a texture unit
-        glActiveTexture(GL_TEXTURE0 + inFSRInputTexture);
-        glBindTexture(GL_TEXTURE_2D, inputImage);
-
-        // connect the output image
-        glBindImageTexture(inFSROutputTexture, outputImage, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
-
-        glDispatchCompute(dispatchX, dispatchY, 1);
-        glFinish();
-    }
-
-    {
-        // FSR RCAS
-        // connect the input uniform data
-        glBindBufferBase(GL_UNIFORM_BUFFER, inFSRDataPos, fsrData_vbo);
-
-        // connect the previous image's output as input
-        glActiveTexture(GL_TEXTURE0 + inFSRInputTexture);
-        glBindTexture(GL_TEXTURE_2D, outputImage);
-
-        // connect the output image which is the same as the input image
-        glBindImageTexture(inFSROutputTexture, outputImage, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
-
-        glUseProgram(fsrProgramRCAS);
-        glDispatchCompute(dispatchX, dispatchY, 1);
-        glFinish();
-    }
-}
-
-static void runBilinear(struct FSRConstants fsrData, uint32_t bilinearProgram, int32_t fsrData_vbo, uint32_t inputImage, uint32_t outputImage) {
-    uint32_t displayWidth = fsrData.output.width;
-    uint32_t displayHeight = fsrData.output.height;
-
-    static const int threadGroupWorkRegionDim = 16;
-    int dispatchX = (displayWidth + (threadGroupWorkRegionDim - 1)) / threadGroupWorkRegionDim;
-    int dispatchY = (displayHeight + (threadGroupWorkRegionDim - 1)) / threadGroupWorkRegionDim;
-
-
-    // binding point constants in the shaders
-    const int inFSRDataPos = 0;
-    const int inFSRInputTexture = 1;
-    const int inFSROutputTexture = 2;
-
-    { // run FSR EASU
-        glUseProgram(bilinearProgram);
-
-        // connect the input uniform data
-        glBindBufferBase(GL_UNIFORM_BUFFER, inFSRDataPos, fsrData_vbo);
-
-        // bind the input image to a texture unit
-        glActiveTexture(GL_TEXTURE0 + inFSRInputTexture);
-        glBindTexture(GL_TEXTURE_2D, inputImage);
-
-        // connect the output image
-        glBindImageTexture(inFSROutputTexture, outputImage, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
-
-        glDispatchCompute(dispatchX, dispatchY, 1);
-        glFinish();
-    }
-}
-
-uint32_t createOutputImage(struct FSRConstants fsrData) {
-    uint32_t outputImage = 0;
-    glGenTextures(1, &outputImage);
-    glBindTexture(GL_TEXTURE_2D, outputImage);
-
-    // Setup filtering parameters for display
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-    glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA32F, fsrData.output.width, fsrData.output.height);
-    glBindTexture(GL_TEXTURE_2D, 0);
-
-    return outputImage;
-}
+#include "fsr_batch.h"
+#include "fsr_gl.h"
+#include "fsr_programs.h"
+#include "gpu_pass_timer.h"
+#include "image_metrics.h"
+#include "startup_timeline.h"
+#include "texture_pool.h"
+#include "thread_pool.h"
+#include "trace.h"
+#include "upload_ring.h"
+
+// One "Measure quality" result: the input downscaled by the multiplier and upscaled back with the
+// settings of the time, against the input.
+struct QualitySample {
+    const char* mode;
+    float resMultiplier;
+    float rcasAtt;
+    double ms; // the upscale alone, waited for with glFinish
+    ImageQuality quality;
+};
 
 static void glfw_error_callback(int error, const char* description) {
         fprintf(stderr, "Glfw Error %d: %s\n", error, description);
@@ -190,11 +116,47 @@ static float GetDpiScale(GLFWwindow* window)
 
 int main(int argc, char** argv) {
     if (argc < 2) {
-        printf("Usage: %s <image>\n", argv[0]);
+        printf("Usage: %s <image> [--fp32] [--output rgba8|rgb10_a2|rgba16f|rgba32f] [--trace <file.json>]\n"
+               "       %s --batch [options] <image>...\n", argv[0], argv[0]);
         return -1;
     }
 
+    // no window, fonts or UI, straight to the shader compile
+    if (strcmp(argv[1], "--batch") == 0) {
+        BatchOptions options;
+        if (!parseBatchOptions(argc - 2, argv + 2, &options)) {
+            return -1;
+        }
+        return runBatch(options);
+    }
+
     const char* input_image = argv[1];
+    // FP16 programs and targets are used where the driver has them, unless asked not to
+    bool forceFP32 = false;
+    // the output is only displayed, RGBA8 with dithering is a quarter of RGBA32F
+    FSROutputFormat outputFormat = FSROutputFormat::RGBA8;
+    // Chrome trace from the start to the exit
+    std::string tracePath;
+    for (int idx = 2; idx < argc; idx++) {
+        if (strcmp(argv[idx], "--fp32") == 0) {
+            forceFP32 = true;
+        } else if (strcmp(argv[idx], "--trace") == 0 && idx + 1 < argc) {
+            tracePath = argv[++idx];
+        } else if (strcmp(argv[idx], "--output") == 0 && idx + 1 < argc && parseFSROutputFormat(argv[idx + 1], &outputFormat)) {
+            idx++;
+        } else {
+            printf("Unknown option: %s\n", argv[idx]);
+            return -1;
+        }
+    }
+
+    if (!tracePath.empty()) {
+        traceStart();
+        traceThreadName("main");
+    }
+
+    StartupTimeline timeline;
+    StartupTimeline::TimePoint stepStart = StartupTimeline::now();
 
     // Setup window
     glfwSetErrorCallback(glfw_error_callback);
@@ -226,32 +188,83 @@ int main(int argc, char** argv) {
 
     glfwSwapInterval(1);
 
+    timeline.add("window + context", stepStart);
+
+    // Hand all programs to the driver first, with parallel shader compile they build on the
+    // driver's threads while the image is decoded and the UI is set up below.
+    const std::string baseDir = "src/";
+    FSRProgramRegistry programs(baseDir);
+    const FSRPrecision precision = programs.supportedPrecision(forceFP32 ? FSRPrecision::Float : FSRPrecision::Half);
+    const FSROutputFormat imageFormat = precision == FSRPrecision::Half ? FSROutputFormat::RGBA16F : FSROutputFormat::RGBA32F;
+    const uint32_t glImageFormat = getFSROutputGLFormat(imageFormat);
+    const uint32_t glOutputFormat = getFSROutputGLFormat(outputFormat);
+    const FSRPermutation easuPermutation(FSRPass::EASU, precision, imageFormat);
+    const FSRPermutation rcasPermutation(FSRPass::RCAS, precision, outputFormat);
+    const FSRPermutation fusedPermutation(FSRPass::Fused, precision, outputFormat);
+    const FSRPermutation bilinearPermutation(FSRPass::Bilinear, FSRPrecision::Float, outputFormat);
+    programs.prefetch({ easuPermutation, rcasPermutation, fusedPermutation, bilinearPermutation });
+
     // GUI options:
     bool useFSR = true;
+    bool useFused = false;
+    bool upscaleEveryFrame = false; // keeps the pass timings coming while nothing changes
     float zoom = 1.0f;
     float moveX = 0.0f;
     float moveY = 1.0f;
     float resMultiplier = 4.0f;
     float rcasAtt = 0.25f;
 
+    // quality measurements, a curve over the settings
+    std::vector<QualitySample> qualitySamples;
+    std::unique_ptr<ThreadPool> metricsPool;
 
     struct FSRConstants fsrData = {};
 
     uint32_t inputTexture = 0;
-    bool ret = LoadTextureFromFile(input_image, &inputTexture, &fsrData.input.width, &fsrData.input.height);
-    IM_ASSERT(ret);
+    {
+        // decoded into memory first, stb reads back its output (PNG filters) and the mapped unpack
+        // buffer is write-only, then copied over like the batch does and filled from there on the GPU
+        UploadRing uploadRing(1);
+        stepStart = StartupTimeline::now();
+        std::vector<uint8_t> pixels;
+        bool ret = LoadImageFromFile(input_image, &pixels, &fsrData.input.width, &fsrData.input.height);
+        IM_ASSERT(ret);
+        timeline.add("decode", stepStart);
+
+        stepStart = StartupTimeline::now();
+        ret = uploadRing.upload(pixels.data(), fsrData.input.width, fsrData.input.height, &inputTexture);
+        IM_ASSERT(ret);
+        timeline.add("upload", stepStart);
+    }
 
     fsrData.output = { (uint32_t)(fsrData.input.width * resMultiplier), (uint32_t)(fsrData.input.height * resMultiplier) };
 
     prepareFSR(&fsrData, rcasAtt);
 
-    const std::string baseDir = "src/";
+    stepStart = StartupTimeline::now();
+    IMGUI_CHECKVERSION();
+    ImGui::CreateContext();
+    float dpiScale = GetDpiScale(window);
+    ImGuiIO& io = ImGui::GetIO();(void)io;
+    SetupDPIScale(dpiScale);
+
+    ImGui_ImplGlfw_InitForOpenGL(window, true);
+    ImGui_ImplOpenGL3_Init(glsl_version);
+    timeline.add("imgui + fonts", stepStart);
 
-    uint32_t fsrProgramEASU = createFSRComputeProgramEAUS(baseDir);
-    uint32_t fsrProgramRCAS = createFSRComputeProgramRCAS(baseDir);
-    uint32_t bilinearProgram = createBilinearComputeProgram(baseDir);
+    stepStart = StartupTimeline::now();
+    programs.finishPending(&timeline);
+    timeline.add("wait for programs", stepStart);
 
-    uint32_t outputImage = createOutputImage(fsrData);
+    uint32_t fsrProgramEASU = programs.get(easuPermutation);
+    uint32_t fsrProgramRCAS = programs.get(rcasPermutation);
+    uint32_t fsrProgramFused = programs.get(fusedPermutation);
+    uint32_t bilinearProgram = programs.get(bilinearPermutation);
+
+    // intermediate and output images, reused while the output size fits in them
+    TexturePool texturePool;
+    FSRTargets fsrTargets = {};
+    acquireFSRTargets(texturePool, fsrData.output, glImageFormat, glOutputFormat, &fsrTargets);
 
 
     // upload the FSR constants, this contains the EASU and RCAS constants in a single uniform
@@ -264,16 +277,15 @@ int main(int argc, char** argv) {
         glBindBuffer(GL_ARRAY_BUFFER, 0);
     }
 
-    runFSR(fsrData, fsrProgramEASU, fsrProgramRCAS, fsrData_vbo, inputTexture, outputImage);
+    // GPU time of the passes, deleted before the context
+    std::unique_ptr<GpuPassTimer> passTimer(new GpuPassTimer());
 
-    IMGUI_CHECKVERSION();
-    ImGui::CreateContext();
-    float dpiScale = GetDpiScale(window);
-    ImGuiIO& io = ImGui::GetIO();(void)io;
-    SetupDPIScale(dpiScale);
-
-    ImGui_ImplGlfw_InitForOpenGL(window, true);
-    ImGui_ImplOpenGL3_Init(glsl_version);
+    stepStart = StartupTimeline::now();
+    runFSR(fsrData, fsrProgramEASU, fsrProgramRCAS, fsrData_vbo, inputTexture, fsrTargets.intermediate.id, glImageFormat, fsrTargets.output.id, glOutputFormat,
+           false, passTimer.get());
+    glFinish(); // once, so the timeline shows when the first frame is really done
+    timeline.add("first FSR frame", stepStart);
+    timeline.print();
 
     ImVec4 clear_color{0.1f, 0.1f, 0.1f, 1.0f};
 
@@ -300,31 +312,52 @@ int main(int argc, char** argv) {
             ImGui::Begin("FSR RCAS config");
 
             changed |= ImGui::Checkbox("Enable FSR", &useFSR);
+            changed |= ImGui::Checkbox("Fused EASU+RCAS", &useFused);
             changed |= ImGui::SliderFloat("Resolution Multiplier", &resMultiplier, 0.0001, 10.0f);
             changed |= ImGui::SliderFloat("rcasAttenuation", &rcasAtt, 0.0f, 2.0f);
+            ImGui::Checkbox("Upscale every frame", &upscaleEveryFrame);
+            ImGui::Text("%s programs, %s intermediate, %s output", programs.supportedPrecision(precision) == FSRPrecision::Half ? "FP16" : "FP32",
+                        getFSROutputFormatName(imageFormat), getFSROutputFormatName(outputFormat));
 
             if (changed) {
-                Extent oldOutput = fsrData.output;
+                // the old samples are of other passes or another size
+                passTimer->reset();
+            }
+            if (changed || upscaleEveryFrame) {
                 fsrData.output = { (uint32_t)(fsrData.input.width * resMultiplier), (uint32_t)(fsrData.input.height * resMultiplier) };
 
-                if (oldOutput.width != fsrData.output.width) {
-                    glDeleteTextures(1, &outputImage);
-                    outputImage = createOutputImage(fsrData);
-                    printf("Recreated output image\n");
+                if (acquireFSRTargets(texturePool, fsrData.output, glImageFormat, glOutputFormat, &fsrTargets)) {
+                    printf("Switched output images\n");
                 }
+                uint32_t outputImage = fsrTargets.output.id;
 
                 if (!useFSR) {
-                    printf("Running Bilinear Program\n");
-                    runBilinear(fsrData, bilinearProgram, fsrData_vbo, inputTexture, outputImage);
+                    if (changed) {
+                        printf("Running Bilinear Program\n");
+                    }
+                    runBilinear(fsrData, bilinearProgram, fsrData_vbo, inputTexture, outputImage, glOutputFormat, passTimer.get());
                 } else {
-                    prepareFSR(&fsrData, rcasAtt);
-
-                    glBindBuffer(GL_ARRAY_BUFFER, fsrData_vbo);
-                    glBufferData(GL_ARRAY_BUFFER, sizeof(fsrData), &fsrData, GL_DYNAMIC_DRAW);
-                    glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-                    printf("Running FSR\n");
-                    runFSR(fsrData, fsrProgramEASU, fsrProgramRCAS, fsrData_vbo, inputTexture, outputImage);
+                    // the constants only change with the settings, enabling FSR is a change too
+                    if (changed) {
+                        prepareFSR(&fsrData, rcasAtt);
+
+                        glBindBuffer(GL_ARRAY_BUFFER, fsrData_vbo);
+                        glBufferData(GL_ARRAY_BUFFER, sizeof(fsrData), &fsrData, GL_DYNAMIC_DRAW);
+                        glBindBuffer(GL_ARRAY_BUFFER, 0);
+                    }
+
+                    if (useFused) {
+                        if (changed) {
+                            printf("Running fused FSR\n");
+                        }
+                        runFSRFused(fsrData, fsrProgramFused, fsrData_vbo, inputTexture, outputImage, glOutputFormat, passTimer.get());
+                    } else {
+                        if (changed) {
+                            printf("Running FSR\n");
+                        }
+                        runFSR(fsrData, fsrProgramEASU, fsrProgramRCAS, fsrData_vbo, inputTexture, fsrTargets.intermediate.id, glImageFormat, outputImage, glOutputFormat,
+                               false, passTimer.get());
+                    }
                 }
             }
 
@@ -336,6 +369,135 @@ int main(int argc, char** argv) {
             // Edit 3 floats representing a color
             ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
 
+            // results of earlier frames, never waits for the GPU
+            passTimer->collect();
+            if (!passTimer->supported()) {
+                ImGui::Text("No GL timer queries");
+            } else if (ImGui::BeginTable("GPU passes", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_SizingFixedFit)) {
+                ImGui::TableSetupColumn("GPU pass");
+                ImGui::TableSetupColumn("last ms");
+                ImGui::TableSetupColumn("min ms");
+                ImGui::TableSetupColumn("avg ms");
+                ImGui::TableSetupColumn("p99 ms");
+                ImGui::TableHeadersRow();
+                for (uint32_t pass = 0; pass < (uint32_t)GpuPass::Count; pass++) {
+                    const GpuPassStats stats = passTimer->stats((GpuPass)pass);
+                    if (stats.samples == 0) {
+                        continue;
+                    }
+                    ImGui::TableNextRow();
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%s", getGpuPassName((GpuPass)pass));
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%.3f", stats.lastMs);
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%.3f", stats.minMs);
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%.3f", stats.avgMs);
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%.3f", stats.p99Ms);
+                }
+                ImGui::EndTable();
+            }
+
+            // the input is the ground truth, its downscale is what gets upscaled, so only for an upscale
+            // which leaves at least a pixel
+            const Extent qualityInputSize = { (uint32_t)(fsrData.input.width / resMultiplier), (uint32_t)(fsrData.input.height / resMultiplier) };
+            const bool canMeasureQuality = resMultiplier > 1.0f && qualityInputSize.width > 0 && qualityInputSize.height > 0;
+            ImGui::BeginDisabled(!canMeasureQuality);
+            const bool measureQuality = ImGui::Button("Measure quality");
+            ImGui::EndDisabled();
+            if (!canMeasureQuality && ImGui::IsItemHovered(ImGuiHoveredFlags_AllowWhenDisabled)) {
+                ImGui::SetTooltip("Needs a Resolution Multiplier over 1");
+            }
+            if (measureQuality && canMeasureQuality) {
+                if (!metricsPool) {
+                    metricsPool.reset(new ThreadPool());
+                }
+                FSRConstants qualityData = {};
+                qualityData.output = fsrData.input;
+                qualityData.input = qualityInputSize;
+                prepareFSR(&qualityData, rcasAtt);
+
+                std::vector<uint8_t> reference, downscaled((size_t)qualityData.input.width * qualityData.input.height * 4), upscaled;
+                readTextureRGBA8(inputTexture, fsrData.input, &reference);
+                downscaleRGBA8(*metricsPool, reference.data(), qualityData.output, downscaled.data(), qualityData.input);
+
+                uint32_t qualityInput = 0;
+                LoadTextureFromMemory(downscaled.data(), qualityData.input.width, qualityData.input.height, &qualityInput);
+                FSRTargets qualityTargets = {};
+                acquireFSRTargets(texturePool, qualityData.output, glImageFormat, glOutputFormat, &qualityTargets);
+                uint32_t qualityData_vbo;
+                glGenBuffers(1, &qualityData_vbo);
+                glBindBuffer(GL_ARRAY_BUFFER, qualityData_vbo);
+                glBufferData(GL_ARRAY_BUFFER, sizeof(qualityData), &qualityData, GL_DYNAMIC_DRAW);
+                glBindBuffer(GL_ARRAY_BUFFER, 0);
+                // the texture and constant uploads above (and the frame before) are still queued, without
+                // this they would be part of the timed upscale
+                glFinish();
+
+                QualitySample sample = {};
+                const auto start = std::chrono::steady_clock::now();
+                if (!useFSR) {
+                    sample.mode = "bilinear";
+                    runBilinear(qualityData, bilinearProgram, qualityData_vbo, qualityInput, qualityTargets.output.id, glOutputFormat);
+                } else if (useFused) {
+                    sample.mode = "fused FSR";
+                    runFSRFused(qualityData, fsrProgramFused, qualityData_vbo, qualityInput, qualityTargets.output.id, glOutputFormat);
+                } else {
+                    sample.mode = "FSR";
+                    runFSR(qualityData, fsrProgramEASU, fsrProgramRCAS, qualityData_vbo, qualityInput, qualityTargets.intermediate.id, glImageFormat,
+                           qualityTargets.output.id, glOutputFormat);
+                }
+                glFinish();
+                sample.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+                sample.resMultiplier = resMultiplier;
+                sample.rcasAtt = rcasAtt;
+
+                if (readTextureRGBA8(qualityTargets.output.id, qualityData.output, &upscaled)) {
+                    sample.quality = compareImages(*metricsPool, reference.data(), upscaled.data(), qualityData.output);
+                    qualitySamples.push_back(sample);
+                }
+                texturePool.release(qualityTargets.intermediate.id);
+                texturePool.release(qualityTargets.output.id);
+                glDeleteBuffers(1, &qualityData_vbo);
+                glDeleteTextures(1, &qualityInput);
+            }
+            if (!qualitySamples.empty()) {
+                ImGui::SameLine();
+                if (ImGui::Button("Clear")) {
+                    qualitySamples.clear();
+                }
+            }
+            if (!qualitySamples.empty() && ImGui::BeginTable("Quality", 7, ImGuiTableFlags_Borders | ImGuiTableFlags_SizingFixedFit)) {
+                ImGui::TableSetupColumn("mode");
+                ImGui::TableSetupColumn("scale");
+                ImGui::TableSetupColumn("rcasAtt");
+                ImGui::TableSetupColumn("ms");
+                ImGui::TableSetupColumn("PSNR");
+                ImGui::TableSetupColumn("SSIM");
+                ImGui::TableSetupColumn("MS-SSIM");
+                ImGui::TableHeadersRow();
+                for (const QualitySample& sample : qualitySamples) {
+                    ImGui::TableNextRow();
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%s", sample.mode);
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%.2f", sample.resMultiplier);
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%.2f", sample.rcasAtt);
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%.3f", sample.ms);
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%.2f", sample.quality.psnr);
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%.4f", sample.quality.ssim);
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%.4f", sample.quality.msssim);
+                }
+                ImGui::EndTable();
+            }
+
             if (ImGui::Button("Exit")) {
                 break;
             }
@@ -357,20 +519,42 @@ int main(int argc, char** argv) {
 
         ImGui::SetNextWindowPos(ImVec2(400, 10), ImGuiCond_FirstUseEver);
         ImGui::Begin("OUTPUT Image");
-        ImGui::Text("pointer = %p", outputImage);
+        // the pooled output image can be larger than the output, only show the used part
+        ImVec2 outputUsed = ImVec2((float)fsrData.output.width / fsrTargets.output.allocated.width,
+                                   (float)fsrData.output.height / fsrTargets.output.allocated.height);
+        ImVec2 outputViewPosStart = ImVec2(viewPosStart.x * outputUsed.x, viewPosStart.y * outputUsed.y);
+        ImVec2 outputViewPosEnd = ImVec2(viewPosEnd.x * outputUsed.x, viewPosEnd.y * outputUsed.y);
+        ImGui::Text("pointer = %p", fsrTargets.output.id);
         ImGui::Text("size = %d x %d", fsrData.output.width, fsrData.output.height);
-        ImGui::Image((void*)(intptr_t)outputImage, outputDisplaySize, viewPosStart, viewPosEnd);
+        ImGui::Image((void*)(intptr_t)fsrTargets.output.id, outputDisplaySize, outputViewPosStart, outputViewPosEnd);
         ImGui::End();
 
         // Render ImGui
-        ImGui::Render();
-        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
-        glfwSwapBuffers(window);
+        {
+            TRACE_ZONE("ImGui render");
+            ImGui::Render();
+            ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        }
+        {
+            TRACE_ZONE("swapBuffers");
+            glfwSwapBuffers(window);
+        }
 
         glfwPollEvents();
     }
 
     // Cleanup
+    if (!tracePath.empty()) {
+        // the passes of the last frames are still on the GPU
+        passTimer->drain();
+        traceStop(tracePath);
+    }
+    passTimer.reset();
+    texturePool.release(fsrTargets.intermediate.id);
+    texturePool.release(fsrTargets.output.id);
+    texturePool.trim();
+    programs.clear();
+
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
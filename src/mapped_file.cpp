@@ -0,0 +1,122 @@
+#include "mapped_file.h"
+
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(MappedFile&& other)
+    : m_data(other.m_data)
+    , m_size(other.m_size)
+{
+    other.m_data = nullptr;
+    other.m_size = 0;
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) {
+    if (this != &other) {
+        close();
+        std::swap(m_data, other.m_data);
+        std::swap(m_size, other.m_size);
+    }
+    return *this;
+}
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const char* filename) {
+    close();
+
+    HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size)) {
+        CloseHandle(file);
+        return false;
+    }
+    if (size.QuadPart == 0) {
+        CloseHandle(file);
+        return true;
+    }
+
+    // the view keeps the mapping and the file alive
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if (mapping == NULL) {
+        return false;
+    }
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (view == NULL) {
+        return false;
+    }
+
+    m_data = (const uint8_t*)view;
+    m_size = (size_t)size.QuadPart;
+    return true;
+}
+
+void MappedFile::close() {
+    if (m_data) {
+        UnmapViewOfFile(m_data);
+    }
+    m_data = nullptr;
+    m_size = 0;
+}
+
+#else
+
+bool MappedFile::open(const char* filename) {
+    close();
+
+    int fd = ::open(filename, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+        ::close(fd);
+        return false;
+    }
+    if (info.st_size == 0) {
+        ::close(fd);
+        return true;
+    }
+
+    // the mapping stays valid after closing the descriptor
+    void* view = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (view == MAP_FAILED) {
+        return false;
+    }
+    // decoders read front to back, let the kernel read ahead
+    madvise(view, (size_t)info.st_size, MADV_SEQUENTIAL);
+
+    m_data = (const uint8_t*)view;
+    m_size = (size_t)info.st_size;
+    return true;
+}
+
+void MappedFile::close() {
+    if (m_data) {
+        munmap((void*)m_data, m_size);
+    }
+    m_data = nullptr;
+    m_size = 0;
+}
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Read only memory mapping of a whole file, so decoders read the page cache directly instead
+// of copying through stdio buffers. Move-only, unmapped on destruction.
+class MappedFile {
+public:
+    MappedFile() = default;
+    MappedFile(MappedFile&& other);
+    MappedFile& operator=(MappedFile&& other);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Maps 'filename', returns false (and stays empty) if it can't be opened or mapped.
+    // Empty files open fine with a null data().
+    bool open(const char* filename);
+    void close();
+
+    const uint8_t* data() const { return m_data; }
+    size_t size() const { return m_size; }
+
+private:
+    const uint8_t* m_data = nullptr;
+    size_t m_size = 0;
+};
+
+#endif /* MAPPED_FILE_H */
@@ -0,0 +1,150 @@
+#include <glad/glad.h>
+
+#include "program_builder.h"
+#include "program_cache.h"
+#include "startup_timeline.h"
+#include "trace.h"
+
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+// GL_KHR_parallel_shader_compile, the enum is shared with the ARB version
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+static bool hasParallelCompile() {
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint idx = 0; idx < count; idx++) {
+        const char* name = (const char*)glGetStringi(GL_EXTENSIONS, idx);
+        if (name && (strcmp(name, "GL_KHR_parallel_shader_compile") == 0 || strcmp(name, "GL_ARB_parallel_shader_compile") == 0)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+ProgramBuilder::ProgramBuilder()
+    : m_parallel(hasParallelCompile())
+{
+}
+
+ProgramBuilder::~ProgramBuilder() {
+    for (Entry& entry : m_entries) {
+        if (entry.shader) {
+            glDeleteShader(entry.shader);
+        }
+    }
+}
+
+uint32_t ProgramBuilder::submit(const std::string& name, const std::string& source) {
+    TRACE_ZONE("compileProgram");
+    Entry entry = {};
+    entry.name = name;
+    entry.submitted = std::chrono::steady_clock::now();
+
+    entry.program = loadCachedProgram(source);
+    if (entry.program) {
+        entry.done = true;
+        entry.cached = true;
+        entry.completed = std::chrono::steady_clock::now();
+        m_entries.push_back(entry);
+        return (uint32_t)m_entries.size() - 1;
+    }
+
+    const char* src = source.c_str();
+    entry.source = source;
+    entry.shader = glCreateShader(GL_COMPUTE_SHADER);
+    glShaderSource(entry.shader, 1, &src, NULL);
+    glCompileShader(entry.shader);
+
+    // linking right away is fine, it waits for the compile inside of the driver
+    entry.program = glCreateProgram();
+    glAttachShader(entry.program, entry.shader);
+    glProgramParameteri(entry.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    glLinkProgram(entry.program);
+
+    m_entries.push_back(entry);
+    return (uint32_t)m_entries.size() - 1;
+}
+
+void ProgramBuilder::complete(Entry& entry) {
+    TRACE_ZONE("completeProgram");
+    entry.done = true;
+    entry.completed = std::chrono::steady_clock::now();
+    if (traceEnabled()) {
+        // the compile itself runs on the driver's threads, from the submit to the completion poll
+        static const uint32_t compileTrack = traceTrack("shader compiles");
+        auto ns = [](std::chrono::steady_clock::time_point time) {
+            return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+        };
+        traceTrackSpan(compileTrack, "compileProgram", ns(entry.submitted), ns(entry.completed));
+    }
+
+    int success;
+    glGetShaderiv(entry.shader, GL_COMPILE_STATUS, &success);
+    if (!success) {
+        char info[512];
+        glGetShaderInfoLog(entry.shader, 512, NULL, info);
+        printf("Compute shader error (%s):\n%s\n", entry.name.c_str(), info);
+        glDeleteProgram(entry.program);
+        entry.program = -3;
+    } else {
+        glGetProgramiv(entry.program, GL_LINK_STATUS, &success);
+        if (!success) {
+            char info[512];
+            glGetProgramInfoLog(entry.program, 512, NULL, info);
+            printf("Compute Program error (%s):\n%s\n", entry.name.c_str(), info);
+            glDeleteProgram(entry.program);
+            entry.program = -3;
+        } else {
+            storeCachedProgram(entry.source, entry.program);
+        }
+    }
+
+    glDeleteShader(entry.shader);
+    entry.shader = 0;
+    entry.source.clear();
+}
+
+bool ProgramBuilder::poll() {
+    bool allDone = true;
+    for (Entry& entry : m_entries) {
+        if (entry.done) {
+            continue;
+        }
+        GLint completed = GL_TRUE;
+        if (m_parallel) {
+            glGetProgramiv(entry.program, GL_COMPLETION_STATUS_KHR, &completed);
+        }
+        if (completed) {
+            complete(entry);
+        } else {
+            allDone = false;
+        }
+    }
+    return allDone;
+}
+
+bool ProgramBuilder::finish() {
+    // polling instead of blocking on the first pending program, so each completion time is accurate
+    while (!poll()) {
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+
+    bool ok = true;
+    for (const Entry& entry : m_entries) {
+        ok &= entry.program != (uint32_t)-3;
+    }
+    return ok;
+}
+
+void ProgramBuilder::addToTimeline(StartupTimeline& timeline) const {
+    for (const Entry& entry : m_entries) {
+        if (entry.done) {
+            timeline.add((entry.cached ? "cached " : "compile ") + entry.name, entry.submitted, entry.completed);
+        }
+    }
+}
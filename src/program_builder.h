@@ -0,0 +1,62 @@
+#ifndef PROGRAM_BUILDER_H
+#define PROGRAM_BUILDER_H
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class StartupTimeline;
+
+// Builds several compute programs at once.
+//
+// submit() only hands the source to the driver (glCompileShader + glLinkProgram, no status query),
+// so with GL_KHR_parallel_shader_compile (or the ARB version) all programs compile on the driver's
+// threads while the caller goes on with other startup work. poll() checks GL_COMPLETION_STATUS_KHR
+// without blocking, finish() waits for the rest. Without the extension the same calls work, the
+// driver just compiles synchronously somewhere between submit and finish.
+// Programs found in the program cache are ready at submit time.
+class ProgramBuilder {
+public:
+    ProgramBuilder();
+    ~ProgramBuilder();
+
+    ProgramBuilder(const ProgramBuilder&) = delete;
+    ProgramBuilder& operator=(const ProgramBuilder&) = delete;
+
+    // Returns a handle for program(), 'name' is for the logs and the timeline.
+    uint32_t submit(const std::string& name, const std::string& source);
+
+    // Collects every program that completed, true once all of them did. Never blocks when parallel().
+    bool poll();
+    // Waits for all programs, false if any failed to compile or link.
+    bool finish();
+
+    // The linked program, (uint32_t)-3 when it failed like the create*Program functions, 0 while pending.
+    uint32_t program(uint32_t handle) const { return m_entries[handle].program; }
+
+    // The driver compiles in the background.
+    bool parallel() const { return m_parallel; }
+
+    // One span per program, from submit to when it was seen completed.
+    void addToTimeline(StartupTimeline& timeline) const;
+
+private:
+    struct Entry {
+        std::string name;
+        std::string source;  // kept for the program cache until the binary is stored
+        uint32_t shader;
+        uint32_t program;
+        bool done;
+        bool cached;
+        std::chrono::steady_clock::time_point submitted;
+        std::chrono::steady_clock::time_point completed;
+    };
+
+    void complete(Entry& entry);
+
+    std::vector<Entry> m_entries;
+    bool m_parallel = false;
+};
+
+#endif /* PROGRAM_BUILDER_H */
@@ -0,0 +1,192 @@
+#include <glad/glad.h>
+
+#include "program_cache.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <vector>
+
+namespace {
+
+struct CacheHeader {
+    char magic[4];       // "FSRP"
+    uint32_t version;
+    uint64_t sourceHash;
+    uint64_t driverHash;
+    uint32_t binaryFormat;
+    uint32_t binarySize;
+};
+
+} // namespace
+
+static const uint32_t CACHE_VERSION = 1;
+
+static std::string& cacheDir() {
+    static std::string dir = [] {
+        const char* env = getenv("GLES_FSR_SHADER_CACHE");
+        return std::string(env ? env : "shader_cache");
+    }();
+    return dir;
+}
+
+static std::atomic<uint32_t> s_hits{0};
+static std::atomic<uint32_t> s_misses{0};
+static std::atomic<uint32_t> s_stores{0};
+
+// 64 bit FNV-1a
+static uint64_t hashBytes(const void* data, size_t size, uint64_t hash = 0xcbf29ce484222325ull) {
+    const uint8_t* bytes = (const uint8_t*)data;
+    for (size_t idx = 0; idx < size; idx++) {
+        hash ^= bytes[idx];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+static uint64_t driverHash() {
+    uint64_t hash = hashBytes(&CACHE_VERSION, sizeof(CACHE_VERSION));
+    const GLenum names[] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+    for (GLenum name : names) {
+        const char* value = (const char*)glGetString(name);
+        if (value) {
+            hash = hashBytes(value, strlen(value) + 1, hash);
+        }
+    }
+    return hash;
+}
+
+static std::string entryPath(uint64_t sourceHash, uint64_t driver) {
+    char name[48];
+    snprintf(name, sizeof(name), "%016llx_%08x.bin", (unsigned long long)sourceHash, (uint32_t)(driver ^ (driver >> 32)));
+    return (std::filesystem::path(cacheDir()) / name).string();
+}
+
+void setProgramCacheDir(const std::string& dir) {
+    cacheDir() = dir;
+}
+
+const std::string& getProgramCacheDir() {
+    return cacheDir();
+}
+
+bool isProgramCacheEnabled() {
+    if (cacheDir().empty()) {
+        return false;
+    }
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    return formats > 0;
+}
+
+ProgramCacheStats getProgramCacheStats() {
+    return { s_hits.load(), s_misses.load(), s_stores.load() };
+}
+
+uint32_t loadCachedProgram(const std::string& source) {
+    if (!isProgramCacheEnabled()) {
+        s_misses++;
+        return 0;
+    }
+
+    const uint64_t sourceHash = hashBytes(source.data(), source.size());
+    const uint64_t driver = driverHash();
+    const std::string path = entryPath(sourceHash, driver);
+
+    FILE* fp = fopen(path.c_str(), "rb");
+    if (fp == NULL) {
+        s_misses++;
+        return 0;
+    }
+
+    CacheHeader header;
+    std::vector<uint8_t> binary;
+    bool ok = fread(&header, sizeof(header), 1, fp) == 1
+        && memcmp(header.magic, "FSRP", 4) == 0 && header.version == CACHE_VERSION
+        && header.sourceHash == sourceHash && header.driverHash == driver;
+    if (ok) {
+        binary.resize(header.binarySize);
+        ok = fread(binary.data(), 1, binary.size(), fp) == binary.size();
+    }
+    fclose(fp);
+
+    uint32_t program = 0;
+    if (ok) {
+        program = glCreateProgram();
+        glProgramBinary(program, header.binaryFormat, binary.data(), (GLsizei)binary.size());
+
+        // drivers reject binaries of other versions here even if the strings matched
+        int success = 0;
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+        if (!success) {
+            glDeleteProgram(program);
+            program = 0;
+        }
+    }
+
+    if (program == 0) {
+        printf("Program cache: stale entry %s\n", path.c_str());
+        s_misses++;
+        return 0;
+    }
+
+    s_hits++;
+    return program;
+}
+
+void storeCachedProgram(const std::string& source, uint32_t program) {
+    if (!isProgramCacheEnabled()) {
+        return;
+    }
+
+    GLint size = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &size);
+    if (size <= 0) {
+        return;
+    }
+
+    CacheHeader header;
+    memcpy(header.magic, "FSRP", 4);
+    header.version = CACHE_VERSION;
+    header.sourceHash = hashBytes(source.data(), source.size());
+    header.driverHash = driverHash();
+
+    std::vector<uint8_t> binary(size);
+    GLenum format = 0;
+    GLsizei length = 0;
+    glGetProgramBinary(program, size, &length, &format, binary.data());
+    if (length <= 0) {
+        return;
+    }
+    header.binaryFormat = format;
+    header.binarySize = (uint32_t)length;
+
+    std::error_code error;
+    std::filesystem::create_directories(cacheDir(), error);
+
+    // written under a temporary name and renamed, so a concurrent launch never reads half an entry
+    const std::string path = entryPath(header.sourceHash, header.driverHash);
+    const std::string tmpPath = path + ".tmp" + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count());
+    FILE* fp = fopen(tmpPath.c_str(), "wb");
+    if (fp == NULL) {
+        printf("Program cache: unable to write %s\n", tmpPath.c_str());
+        return;
+    }
+    bool ok = fwrite(&header, sizeof(header), 1, fp) == 1
+        && fwrite(binary.data(), 1, length, fp) == (size_t)length;
+    ok &= fclose(fp) == 0;
+
+    if (ok) {
+        std::filesystem::rename(tmpPath, path, error);
+        ok = !error;
+    }
+    if (!ok) {
+        std::filesystem::remove(tmpPath, error);
+        printf("Program cache: unable to write %s\n", path.c_str());
+        return;
+    }
+    s_stores++;
+}
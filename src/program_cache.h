@@ -0,0 +1,36 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include <cstdint>
+#include <string>
+
+// On-disk cache of linked GL programs (glGetProgramBinary / glProgramBinary).
+//
+// An entry is keyed by a hash of the complete assembled shader source, which contains the
+// define map, and of GL_VENDOR, GL_RENDERER and GL_VERSION, so a driver update or another GPU
+// never picks up a stale binary. Anything that goes wrong with an entry (missing, truncated,
+// rejected by glProgramBinary) is a miss and the caller compiles from source as before.
+
+// Cache directory, created on the first store. Defaults to $GLES_FSR_SHADER_CACHE or "shader_cache"
+// in the working directory, an empty string disables the cache.
+void setProgramCacheDir(const std::string& dir);
+const std::string& getProgramCacheDir();
+
+// True when there is a directory and the driver supports at least one binary format.
+// Needs a current context.
+bool isProgramCacheEnabled();
+
+struct ProgramCacheStats {
+    uint32_t hits;
+    uint32_t misses; // every miss is a GLSL compile
+    uint32_t stores;
+};
+ProgramCacheStats getProgramCacheStats();
+
+// Returns the linked program for 'source' from the cache, 0 on a miss.
+uint32_t loadCachedProgram(const std::string& source);
+
+// Saves a linked program, which should have been linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT set.
+void storeCachedProgram(const std::string& source, uint32_t program);
+
+#endif /* PROGRAM_CACHE_H */
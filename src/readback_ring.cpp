@@ -0,0 +1,198 @@
+#include <glad/glad.h>
+
+#include "readback_ring.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+// glReadPixels format and type of a sized internal format, and the bytes per pixel.
+static void pixelTransfer(uint32_t format, GLenum* pixelFormat, GLenum* type, size_t* bytesPerPixel) {
+    *pixelFormat = GL_RGBA;
+    switch (format) {
+        case GL_RGBA32F: *type = GL_FLOAT; *bytesPerPixel = 16; break;
+        case GL_RGBA16F: *type = GL_HALF_FLOAT; *bytesPerPixel = 8; break;
+        case GL_RGB10_A2: *type = GL_UNSIGNED_INT_2_10_10_10_REV; *bytesPerPixel = 4; break;
+        default: *type = GL_UNSIGNED_BYTE; *bytesPerPixel = 4; break;
+    }
+}
+
+static double msBetween(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end) {
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+ReadbackRing::ReadbackRing(uint32_t slots, bool convertToRGBA8)
+    : m_slots(slots ? slots : 1)
+    , m_persistent(hasGLBufferStorage())
+    , m_convert(convertToRGBA8)
+{
+    glGenFramebuffers(1, &m_readFramebuffer);
+}
+
+ReadbackRing::~ReadbackRing() {
+    for (Slot& slot : m_slots) {
+        slot.fence = GpuFence();
+        if (slot.buffer) {
+            if (slot.mapped) {
+                glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+                glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            }
+            glDeleteBuffers(1, &slot.buffer);
+        }
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    glDeleteFramebuffers(1, &m_readFramebuffer);
+    if (m_stagingFramebuffer) {
+        glDeleteFramebuffers(1, &m_stagingFramebuffer);
+        glDeleteTextures(1, &m_stagingTexture);
+    }
+}
+
+// Makes the slot's buffer hold at least 'bytes', leaves it bound to GL_PIXEL_PACK_BUFFER.
+void ReadbackRing::reserve(Slot& slot, size_t bytes) {
+    if (slot.buffer && slot.capacity >= bytes) {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+        return;
+    }
+
+    if (slot.buffer) {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+        if (slot.mapped) {
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            slot.mapped = nullptr;
+        }
+        glDeleteBuffers(1, &slot.buffer);
+    }
+
+    slot.buffer = createMappedBuffer(GL_PIXEL_PACK_BUFFER, bytes, GL_MAP_READ_BIT, m_persistent ? &slot.mapped : nullptr);
+    slot.capacity = bytes;
+    if (m_persistent && slot.mapped == NULL) {
+        printf("Readback: persistent mapping failed, mapping per readback\n");
+        m_persistent = false;
+    }
+}
+
+// The RGBA8 staging texture as a framebuffer, grown to at least 'size'.
+uint32_t ReadbackRing::stagingFramebuffer(const Extent& size) {
+    if (m_stagingFramebuffer && m_stagingSize.width >= size.width && m_stagingSize.height >= size.height) {
+        return m_stagingFramebuffer;
+    }
+    if (m_stagingFramebuffer) {
+        glDeleteFramebuffers(1, &m_stagingFramebuffer);
+        glDeleteTextures(1, &m_stagingTexture);
+    }
+
+    m_stagingSize = { std::max(size.width, m_stagingSize.width), std::max(size.height, m_stagingSize.height) };
+    glGenTextures(1, &m_stagingTexture);
+    glBindTexture(GL_TEXTURE_2D, m_stagingTexture);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, m_stagingSize.width, m_stagingSize.height);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenFramebuffers(1, &m_stagingFramebuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_stagingFramebuffer);
+    glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_stagingTexture, 0);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    return m_stagingFramebuffer;
+}
+
+bool ReadbackRing::submit(uint32_t texture, uint32_t format, const Extent& size, uint64_t tag) {
+    if (full()) {
+        return false;
+    }
+
+    TRACE_ZONE("readbackSubmit");
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, m_readFramebuffer);
+    glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+    if (glCheckFramebufferStatus(GL_READ_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        printf("Texture %u is not readable as a framebuffer\n", texture);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+        return false;
+    }
+    // the passes only put up texture fetch barriers
+    glMemoryBarrier(GL_FRAMEBUFFER_BARRIER_BIT);
+
+    const bool convert = m_convert && format != GL_RGBA8;
+    if (convert) {
+        // the format conversion happens in the blit, on the GPU
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, stagingFramebuffer(size));
+        glBlitFramebuffer(0, 0, size.width, size.height, 0, 0, size.width, size.height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, m_stagingFramebuffer);
+    }
+
+    Slot& slot = m_slots[m_next];
+    slot.format = convert ? GL_RGBA8 : format;
+    GLenum pixelFormat, type;
+    size_t bytesPerPixel;
+    pixelTransfer(slot.format, &pixelFormat, &type, &bytesPerPixel);
+    slot.bytes = (size_t)size.width * size.height * bytesPerPixel;
+
+    reserve(slot, slot.bytes);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, size.width, size.height, pixelFormat, type, (void*)0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+
+    slot.fence = GpuFence::insert();
+    slot.tag = tag;
+    slot.size = size;
+    slot.submitted = std::chrono::steady_clock::now();
+
+    m_next = (m_next + 1) % (uint32_t)m_slots.size();
+    m_pending++;
+    m_stats.submitted++;
+    return true;
+}
+
+bool ReadbackRing::collect(uint64_t* tag, std::vector<uint8_t>* pixels, Extent* size, uint32_t* format, bool wait) {
+    if (m_pending == 0) {
+        return false;
+    }
+    Slot& slot = m_slots[(m_next + (uint32_t)m_slots.size() - m_pending) % (uint32_t)m_slots.size()];
+
+    if (!slot.fence.isSignaled()) {
+        if (!wait) {
+            return false;
+        }
+        TRACE_ZONE("readbackWait");
+        const auto waitStart = std::chrono::steady_clock::now();
+        slot.fence.wait();
+        m_stats.waitMs += msBetween(waitStart, std::chrono::steady_clock::now());
+    }
+    slot.fence = GpuFence();
+
+    TRACE_ZONE("readbackCopy");
+    const auto copyStart = std::chrono::steady_clock::now();
+    pixels->resize(slot.bytes);
+    bool ok = true;
+    if (slot.mapped) {
+        memcpy(pixels->data(), slot.mapped, slot.bytes);
+    } else {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+        const void* data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, slot.bytes, GL_MAP_READ_BIT);
+        ok = data != NULL;
+        if (ok) {
+            memcpy(pixels->data(), data, slot.bytes);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        } else {
+            printf("Readback: unable to map the buffer\n");
+            pixels->clear();
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+    const auto end = std::chrono::steady_clock::now();
+
+    *tag = slot.tag;
+    *size = slot.size;
+    *format = slot.format;
+    m_pending--;
+
+    m_stats.copyMs += msBetween(copyStart, end);
+    m_stats.latencyMs += msBetween(slot.submitted, end);
+    if (ok) {
+        m_stats.completed++;
+        m_stats.bytes += slot.bytes;
+    }
+    return true;
+}
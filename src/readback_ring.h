@@ -0,0 +1,83 @@
+#ifndef READBACK_RING_H
+#define READBACK_RING_H
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include "fsr_gl.h"
+#include "image_utils.h"
+
+// Asynchronous readback of output images through a ring of GL_PIXEL_PACK_BUFFERs.
+//
+// submit() records a glReadPixels into the next free buffer and a fence behind it, nothing waits
+// for the GPU there, so the copy of frame N runs while frame N+1 is computed. collect() hands out
+// the oldest readback once its fence signaled (or waits for it). With GL 4.4 / GL_ARB_buffer_storage
+// the buffers are mapped once, persistent and coherent, otherwise they are mapped per collect.
+//
+// With convertToRGBA8 the float, half and 10 bit images are blitted into an RGBA8 staging texture
+// first, the conversion runs on the GPU and a quarter of the RGBA32F bytes are transferred.
+// Requires a current GL context for every call, including the destructor.
+class ReadbackRing {
+public:
+    // Summed over all readbacks, divide by 'completed' for averages.
+    struct Stats {
+        uint64_t submitted = 0;
+        uint64_t completed = 0;
+        uint64_t bytes = 0;      // transferred to the CPU
+        double latencyMs = 0.0;  // submit() to the data being copied out by collect()
+        double waitMs = 0.0;     // collect() blocked on a fence
+        double copyMs = 0.0;     // copying (and mapping) the buffers on the CPU
+    };
+
+    explicit ReadbackRing(uint32_t slots = 3, bool convertToRGBA8 = true);
+    ~ReadbackRing();
+
+    ReadbackRing(const ReadbackRing&) = delete;
+    ReadbackRing& operator=(const ReadbackRing&) = delete;
+
+    // Queues a copy of the top left 'size' pixels of 'texture', of sized internal 'format'.
+    // Returns false if every slot is waiting to be collected or the texture can't be read.
+    bool submit(uint32_t texture, uint32_t format, const Extent& size, uint64_t tag);
+
+    // The oldest readback, tightly packed rows with the top row first. '*format' is GL_RGBA8 when
+    // converted, the texture format otherwise. Returns false if nothing is pending, or without
+    // 'wait' if the oldest one is not done yet. 'pixels' is left empty if the buffer couldn't be mapped.
+    bool collect(uint64_t* tag, std::vector<uint8_t>* pixels, Extent* size, uint32_t* format, bool wait);
+
+    uint32_t pending() const { return m_pending; }
+    bool full() const { return m_pending == (uint32_t)m_slots.size(); }
+    bool persistent() const { return m_persistent; }
+    const Stats& stats() const { return m_stats; }
+
+private:
+    struct Slot {
+        uint32_t buffer = 0;
+        size_t capacity = 0;
+        void* mapped = nullptr; // persistent mapping, null otherwise
+        GpuFence fence;
+        uint64_t tag = 0;
+        Extent size = {};
+        uint32_t format = 0;
+        size_t bytes = 0;
+        std::chrono::steady_clock::time_point submitted;
+    };
+
+    void reserve(Slot& slot, size_t bytes);
+    uint32_t stagingFramebuffer(const Extent& size);
+
+    std::vector<Slot> m_slots;
+    uint32_t m_next = 0;    // slot of the next submit
+    uint32_t m_pending = 0; // submitted and not collected, the oldest is m_next - m_pending
+    bool m_persistent = false;
+    bool m_convert = true;
+
+    uint32_t m_readFramebuffer = 0;
+    uint32_t m_stagingFramebuffer = 0;
+    uint32_t m_stagingTexture = 0;
+    Extent m_stagingSize = {};
+
+    Stats m_stats;
+};
+
+#endif /* READBACK_RING_H */
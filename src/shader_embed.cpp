@@ -0,0 +1,393 @@
+// Build time tool: turns the GLSL sources into a header of constexpr char arrays, so gles_fsr
+// assembles its programs without reading src/ at runtime.
+//
+//   shader_embed [--strip] -o <header> <file>...
+//
+// --strip removes comments, indentation and blank lines and resolves the preprocessor blocks
+// which only depend on the macros that are fixed for every GLSL permutation (A_GPU and A_GLSL
+// are set, the CPU and HLSL ones are not). Blocks on any other macro, SAMPLE_* or FSR_*_F for
+// example, are kept since they are decided per program by the define map.
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+static const std::map<std::string, bool> knownMacros = {
+    { "A_GPU", true },
+    { "A_GLSL", true },
+    { "A_CPU", false },
+    { "A_GCC", false },
+    { "A_HLSL", false },
+    { "A_HLSL_6_2", false },
+};
+
+static bool readText(const std::string& filename, std::string* text) {
+    std::ifstream in(filename, std::ios::binary);
+    if (!in) {
+        printf("Unable to open: %s\n", filename.c_str());
+        return false;
+    }
+    std::stringstream buffer;
+    buffer << in.rdbuf();
+    *text = buffer.str();
+    return true;
+}
+
+// Removes // and /* */ comments, a block comment becomes a single space (or its newlines, to keep
+// directives on their own lines). Line continuations are joined.
+static std::string stripComments(const std::string& text) {
+    std::string out;
+    out.reserve(text.size());
+    for (size_t idx = 0; idx < text.size(); idx++) {
+        char c = text[idx];
+        if (c == '\\' && idx + 1 < text.size() && (text[idx + 1] == '\n' || text[idx + 1] == '\r')) {
+            idx += text[idx + 1] == '\r' && idx + 2 < text.size() && text[idx + 2] == '\n' ? 2 : 1;
+        } else if (c == '"') {
+            size_t end = idx + 1;
+            while (end < text.size() && text[end] != '"' && text[end] != '\n') {
+                end += text[end] == '\\' ? 2 : 1;
+            }
+            out.append(text, idx, end + 1 - idx);
+            idx = end;
+        } else if (c == '/' && idx + 1 < text.size() && text[idx + 1] == '/') {
+            while (idx + 1 < text.size() && text[idx + 1] != '\n') {
+                idx++;
+            }
+        } else if (c == '/' && idx + 1 < text.size() && text[idx + 1] == '*') {
+            size_t end = text.find("*/", idx + 2);
+            end = end == std::string::npos ? text.size() : end + 2;
+            size_t newlines = 0;
+            for (size_t pos = idx; pos < end; pos++) {
+                newlines += text[pos] == '\n';
+            }
+            out += newlines ? std::string(newlines, '\n') : " ";
+            idx = end - 1;
+        } else if (c != '\r') {
+            out += c;
+        }
+    }
+    return out;
+}
+
+namespace {
+
+enum class Truth { False, True, Unknown };
+
+// Recursive descent over the #if expressions this code base uses: defined(X), defined X, integers,
+// known macros, !, &&, || and parentheses. Anything else makes the result Unknown.
+class ExprParser {
+public:
+    explicit ExprParser(const std::string& expr)
+        : m_expr(expr)
+    {
+    }
+
+    Truth parse() {
+        Truth value = parseOr();
+        skipSpace();
+        return m_pos == m_expr.size() ? value : Truth::Unknown;
+    }
+
+private:
+    Truth parseOr() {
+        Truth value = parseAnd();
+        while (accept("||")) {
+            Truth rhs = parseAnd();
+            if (value == Truth::True || rhs == Truth::True) {
+                value = Truth::True;
+            } else if (value == Truth::Unknown || rhs == Truth::Unknown) {
+                value = Truth::Unknown;
+            }
+        }
+        return value;
+    }
+
+    Truth parseAnd() {
+        Truth value = parseUnary();
+        while (accept("&&")) {
+            Truth rhs = parseUnary();
+            if (value == Truth::False || rhs == Truth::False) {
+                value = Truth::False;
+            } else if (value == Truth::Unknown || rhs == Truth::Unknown) {
+                value = Truth::Unknown;
+            }
+        }
+        return value;
+    }
+
+    Truth parseUnary() {
+        if (accept("!")) {
+            Truth value = parseUnary();
+            return value == Truth::Unknown ? value : (value == Truth::True ? Truth::False : Truth::True);
+        }
+        if (accept("(")) {
+            Truth value = parseOr();
+            return accept(")") ? value : Truth::Unknown;
+        }
+
+        std::string token = identifier();
+        if (token == "defined") {
+            bool paren = accept("(");
+            std::string name = identifier();
+            if (paren && !accept(")")) {
+                return Truth::Unknown;
+            }
+            auto known = knownMacros.find(name);
+            return known == knownMacros.end() ? Truth::Unknown : (known->second ? Truth::True : Truth::False);
+        }
+        if (!token.empty() && isdigit((unsigned char)token[0])) {
+            return strtol(token.c_str(), NULL, 0) ? Truth::True : Truth::False;
+        }
+        // a known macro used as a value, all of them are 1 when set
+        auto known = knownMacros.find(token);
+        if (known != knownMacros.end()) {
+            return known->second ? Truth::True : Truth::False;
+        }
+        m_pos = m_expr.size();
+        return Truth::Unknown;
+    }
+
+    void skipSpace() {
+        while (m_pos < m_expr.size() && isspace((unsigned char)m_expr[m_pos])) {
+            m_pos++;
+        }
+    }
+
+    bool accept(const char* token) {
+        skipSpace();
+        size_t length = strlen(token);
+        if (m_expr.compare(m_pos, length, token) != 0) {
+            return false;
+        }
+        // '!' must not eat the start of '!='
+        if (length == 1 && token[0] == '!' && m_pos + 1 < m_expr.size() && m_expr[m_pos + 1] == '=') {
+            return false;
+        }
+        m_pos += length;
+        return true;
+    }
+
+    std::string identifier() {
+        skipSpace();
+        size_t start = m_pos;
+        while (m_pos < m_expr.size() && (isalnum((unsigned char)m_expr[m_pos]) || m_expr[m_pos] == '_')) {
+            m_pos++;
+        }
+        return m_expr.substr(start, m_pos - start);
+    }
+
+    const std::string& m_expr;
+    size_t m_pos = 0;
+};
+
+// One open #if group while stripping.
+struct Group {
+    bool parentActive; // the text around the group is emitted
+    bool emitting;     // the current branch is emitted
+    bool resolved;     // a branch was taken for sure, all later ones are dropped
+    bool verbatim;     // an Unknown condition was seen, the directives are kept from there on
+};
+
+} // namespace
+
+static std::string trim(const std::string& line) {
+    size_t begin = line.find_first_not_of(" \t");
+    if (begin == std::string::npos) {
+        return "";
+    }
+    size_t end = line.find_last_not_of(" \t");
+    return line.substr(begin, end + 1 - begin);
+}
+
+// Splits "#  elif expr" into "elif" and "expr".
+static bool directive(const std::string& line, std::string* name, std::string* rest) {
+    if (line.empty() || line[0] != '#') {
+        return false;
+    }
+    size_t start = line.find_first_not_of(" \t", 1);
+    if (start == std::string::npos) {
+        return false;
+    }
+    size_t end = start;
+    while (end < line.size() && isalpha((unsigned char)line[end])) {
+        end++;
+    }
+    *name = line.substr(start, end - start);
+    *rest = trim(line.substr(end));
+    return true;
+}
+
+static std::string stripSource(const std::string& text) {
+    std::istringstream in(stripComments(text));
+    std::string out;
+    std::vector<Group> groups;
+    auto active = [&] { return groups.empty() || groups.back().emitting; };
+
+    std::string raw;
+    while (std::getline(in, raw)) {
+        std::string line = trim(raw);
+        if (line.empty()) {
+            continue;
+        }
+
+        std::string name, rest;
+        if (directive(line, &name, &rest)) {
+            if (name == "if" || name == "ifdef" || name == "ifndef") {
+                Truth value = Truth::Unknown;
+                if (name == "if") {
+                    value = ExprParser(rest).parse();
+                } else {
+                    auto known = knownMacros.find(rest);
+                    if (known != knownMacros.end()) {
+                        value = known->second == (name == "ifdef") ? Truth::True : Truth::False;
+                    }
+                }
+
+                const bool parentActive = active();
+                Group group = { parentActive, parentActive && value != Truth::False, value == Truth::True, value == Truth::Unknown };
+                if (parentActive && group.verbatim) {
+                    out += line + "\n";
+                }
+                groups.push_back(group);
+                continue;
+            }
+            if ((name == "elif" || name == "else" || name == "endif") && !groups.empty()) {
+                Group& group = groups.back();
+                if (name == "endif") {
+                    if (group.parentActive && group.verbatim) {
+                        out += line + "\n";
+                    }
+                    groups.pop_back();
+                    continue;
+                }
+
+                if (group.verbatim) {
+                    // once a condition was unknown the rest of the chain is left to the driver
+                    group.emitting = group.parentActive;
+                    if (group.parentActive) {
+                        out += line + "\n";
+                    }
+                    continue;
+                }
+
+                Truth value = name == "else" ? Truth::True : ExprParser(rest).parse();
+                if (group.resolved || value == Truth::False) {
+                    group.emitting = false;
+                } else if (value == Truth::True) {
+                    group.emitting = group.parentActive;
+                    group.resolved = true;
+                } else {
+                    // all earlier branches were false, this one becomes the #if of the kept chain
+                    group.emitting = group.parentActive;
+                    group.verbatim = true;
+                    if (group.parentActive) {
+                        out += "#if " + rest + "\n";
+                    }
+                }
+                continue;
+            }
+        }
+
+        if (active()) {
+            out += line + "\n";
+        }
+    }
+    return out;
+}
+
+static std::string baseName(const std::string& path) {
+    size_t slash = path.find_last_of("/\\");
+    return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+static std::string symbolName(const std::string& name) {
+    std::string symbol = "embedded_";
+    for (char c : name) {
+        symbol += isalnum((unsigned char)c) ? c : '_';
+    }
+    return symbol;
+}
+
+int main(int argc, char** argv) {
+    bool strip = false;
+    std::string output;
+    std::vector<std::string> inputs;
+    for (int idx = 1; idx < argc; idx++) {
+        if (strcmp(argv[idx], "--strip") == 0) {
+            strip = true;
+        } else if (strcmp(argv[idx], "-o") == 0 && idx + 1 < argc) {
+            output = argv[++idx];
+        } else {
+            inputs.push_back(argv[idx]);
+        }
+    }
+    if (output.empty() || inputs.empty()) {
+        printf("Usage: %s [--strip] -o <header> <file>...\n", argv[0]);
+        return -1;
+    }
+
+    std::ostringstream out;
+    out << "// Generated by shader_embed" << (strip ? " --strip" : "") << ", do not edit.\n"
+        << "#ifndef FSR_SHADERS_GEN_H\n"
+        << "#define FSR_SHADERS_GEN_H\n\n"
+        << "#include <cstddef>\n\n"
+        << "struct EmbeddedShaderFile {\n"
+        << "    const char* name;\n"
+        << "    const char* source;\n"
+        << "    size_t size;\n"
+        << "};\n\n";
+
+    std::vector<std::string> names;
+    for (const std::string& input : inputs) {
+        std::string text;
+        if (!readText(input, &text)) {
+            return 1;
+        }
+        const size_t originalSize = text.size();
+        if (strip) {
+            text = stripSource(text);
+        }
+
+        const std::string name = baseName(input);
+        names.push_back(name);
+        printf("shader_embed: %s %zu -> %zu bytes\n", name.c_str(), originalSize, text.size());
+
+        // a byte array instead of a string literal, MSVC limits literals to 64 KiB
+        out << "static constexpr char " << symbolName(name) << "[] = {";
+        for (size_t idx = 0; idx < text.size(); idx++) {
+            out << (idx % 24 ? " " : "\n    ") << (int)(unsigned char)text[idx] << ",";
+        }
+        out << "\n    0\n};\n\n";
+    }
+
+    out << "static constexpr EmbeddedShaderFile embeddedShaderFiles[] = {\n";
+    for (const std::string& name : names) {
+        out << "    { \"" << name << "\", " << symbolName(name) << ", sizeof(" << symbolName(name) << ") - 1 },\n";
+    }
+    out << "};\n\n#endif /* FSR_SHADERS_GEN_H */\n";
+
+    // only touch the header when it changed, everything including it would be rebuilt
+    const std::string generated = out.str();
+    std::string existing;
+    std::ifstream current(output, std::ios::binary);
+    if (current) {
+        std::stringstream buffer;
+        buffer << current.rdbuf();
+        existing = buffer.str();
+    }
+    if (existing == generated) {
+        return 0;
+    }
+
+    std::ofstream file(output, std::ios::binary);
+    file << generated;
+    if (!file) {
+        printf("Unable to write: %s\n", output.c_str());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,51 @@
+#include "startup_timeline.h"
+
+#include <cstdio>
+
+StartupTimeline::StartupTimeline()
+    : m_origin(now())
+{
+}
+
+void StartupTimeline::add(const std::string& name, TimePoint start, TimePoint end) {
+    Span span;
+    span.name = name;
+    span.startMs = std::chrono::duration<double, std::milli>(start - m_origin).count();
+    span.endMs = std::chrono::duration<double, std::milli>(end - m_origin).count();
+
+    std::lock_guard<std::mutex> guard(m_lock);
+    m_spans.push_back(span);
+}
+
+void StartupTimeline::print() const {
+    std::lock_guard<std::mutex> guard(m_lock);
+    if (m_spans.empty()) {
+        return;
+    }
+
+    double first = m_spans[0].startMs;
+    double last = m_spans[0].endMs;
+    double serialMs = 0.0;
+    for (const Span& span : m_spans) {
+        first = span.startMs < first ? span.startMs : first;
+        last = span.endMs > last ? span.endMs : last;
+        serialMs += span.endMs - span.startMs;
+    }
+
+    static const int columns = 50;
+    const double msPerColumn = (last > first ? last - first : 1.0) / columns;
+
+    printf("Startup timeline:\n");
+    for (const Span& span : m_spans) {
+        char bar[columns + 1];
+        int begin = (int)((span.startMs - first) / msPerColumn);
+        int end = (int)((span.endMs - first) / msPerColumn + 0.999);
+        for (int column = 0; column < columns; column++) {
+            bar[column] = column >= begin && (column < end || column == begin) ? '#' : '.';
+        }
+        bar[columns] = 0;
+        printf("  %-24s %8.1f %8.1f ms |%s|\n", span.name.c_str(), span.startMs, span.endMs - span.startMs, bar);
+    }
+    printf("  wall %.1f ms, serial %.1f ms, overlap saved %.1f ms\n", last - first, serialMs,
+           serialMs > last - first ? serialMs - (last - first) : 0.0);
+}
@@ -0,0 +1,40 @@
+#ifndef STARTUP_TIMELINE_H
+#define STARTUP_TIMELINE_H
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Wall clock spans of the startup steps, printed as a text gantt chart so overlapping work
+// (shader compiles in the driver vs decode and UI setup on the CPU) is visible at a glance.
+class StartupTimeline {
+public:
+    typedef std::chrono::steady_clock::time_point TimePoint;
+
+    StartupTimeline();
+
+    static TimePoint now() { return std::chrono::steady_clock::now(); }
+
+    // Thread safe, spans can come from worker threads.
+    void add(const std::string& name, TimePoint start, TimePoint end);
+    // Span from 'start' to now.
+    void add(const std::string& name, TimePoint start) { add(name, start, now()); }
+
+    // Prints the spans, the sum of their durations against the wall time they cover;
+    // the difference is what running them one after another would have cost extra.
+    void print() const;
+
+private:
+    struct Span {
+        std::string name;
+        double startMs;
+        double endMs;
+    };
+
+    TimePoint m_origin;
+    mutable std::mutex m_lock;
+    std::vector<Span> m_spans;
+};
+
+#endif /* STARTUP_TIMELINE_H */
@@ -0,0 +1,120 @@
+#include <glad/glad.h>
+
+#include "texture_pool.h"
+
+#include <cstdio>
+
+static uint32_t roundUp(uint32_t value, uint32_t granularity) {
+    return (value + (granularity - 1)) / granularity * granularity;
+}
+
+static uint32_t bytesPerPixel(uint32_t format) {
+    switch (format) {
+        case GL_RGBA32F: return 16;
+        case GL_RGBA16F: return 8;
+        default: return 4;
+    }
+}
+
+TexturePool::TexturePool(uint32_t granularity)
+    : m_granularity(granularity > 0 ? granularity : 1)
+{
+}
+
+TexturePool::~TexturePool() {
+    for (const Entry& entry : m_entries) {
+        glDeleteTextures(1, &entry.texture.id);
+    }
+}
+
+TexturePool::Texture TexturePool::acquire(const Extent& size, uint32_t format) {
+    // Smallest free texture which fits.
+    Entry* best = nullptr;
+    for (Entry& entry : m_entries) {
+        const Texture& texture = entry.texture;
+        if (entry.inUse || texture.format != format
+            || texture.allocated.width < size.width || texture.allocated.height < size.height) {
+            continue;
+        }
+        if (!best || (uint64_t)texture.allocated.width * texture.allocated.height
+                         < (uint64_t)best->texture.allocated.width * best->texture.allocated.height) {
+            best = &entry;
+        }
+    }
+    if (best) {
+        best->inUse = true;
+        return best->texture;
+    }
+
+    // Free textures of this format which are too small will never fit again before a trim, drop them now.
+    for (size_t idx = m_entries.size(); idx-- > 0;) {
+        if (!m_entries[idx].inUse && m_entries[idx].texture.format == format) {
+            glDeleteTextures(1, &m_entries[idx].texture.id);
+            m_entries.erase(m_entries.begin() + idx);
+        }
+    }
+
+    Texture texture;
+    texture.format = format;
+    texture.allocated = { roundUp(size.width, m_granularity), roundUp(size.height, m_granularity) };
+
+    glGenTextures(1, &texture.id);
+    glBindTexture(GL_TEXTURE_2D, texture.id);
+
+    // Setup filtering parameters for display
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    glTexStorage2D(GL_TEXTURE_2D, 1, format, texture.allocated.width, texture.allocated.height);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    printf("Texture pool: allocated %ux%u for %ux%u\n", texture.allocated.width, texture.allocated.height, size.width, size.height);
+
+    m_entries.push_back({ texture, true });
+    return texture;
+}
+
+void TexturePool::release(uint32_t id) {
+    for (Entry& entry : m_entries) {
+        if (entry.texture.id == id) {
+            entry.inUse = false;
+            return;
+        }
+    }
+}
+
+void TexturePool::trim() {
+    for (size_t idx = m_entries.size(); idx-- > 0;) {
+        if (!m_entries[idx].inUse) {
+            glDeleteTextures(1, &m_entries[idx].texture.id);
+            m_entries.erase(m_entries.begin() + idx);
+        }
+    }
+}
+
+size_t TexturePool::allocatedBytes() const {
+    size_t bytes = 0;
+    for (const Entry& entry : m_entries) {
+        const Texture& texture = entry.texture;
+        bytes += (size_t)texture.allocated.width * texture.allocated.height * bytesPerPixel(texture.format);
+    }
+    return bytes;
+}
+
+bool acquireFSRTargets(TexturePool& pool, const Extent& output, uint32_t intermediateFormat, uint32_t outputFormat, FSRTargets* targets) {
+    const FSRTargets previous = *targets;
+
+    if (previous.intermediate.id) {
+        pool.release(previous.intermediate.id);
+    }
+    if (previous.output.id) {
+        pool.release(previous.output.id);
+    }
+
+    targets->intermediate = pool.acquire(output, intermediateFormat);
+    targets->output = pool.acquire(output, outputFormat);
+
+    return targets->intermediate.id != previous.intermediate.id || targets->output.id != previous.output.id;
+}
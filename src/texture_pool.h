@@ -0,0 +1,63 @@
+#ifndef TEXTURE_POOL_H
+#define TEXTURE_POOL_H
+
+#include <cstdint>
+#include <vector>
+
+#include "image_utils.h"
+
+// Small pool of immutable 2D textures used as FSR pass targets.
+//
+// Textures are allocated with their size rounded up to 'granularity' and are handed out again
+// for any request that fits, so resizing the output (for example the resolution multiplier
+// slider) only allocates when it grows past the current textures. The used region of a pooled
+// texture is the requested size, the rest is padding which the passes never read.
+// Requires a current GL context for every call, including the destructor.
+class TexturePool {
+public:
+    struct Texture {
+        uint32_t id;
+        uint32_t format;  // sized internal format, for example GL_RGBA32F
+        Extent allocated; // the real size of the texture, at least the requested one
+    };
+
+    explicit TexturePool(uint32_t granularity = 128);
+    ~TexturePool();
+
+    TexturePool(const TexturePool&) = delete;
+    TexturePool& operator=(const TexturePool&) = delete;
+
+    // Returns an unused texture of at least size x format, creating one if needed.
+    Texture acquire(const Extent& size, uint32_t format);
+    // Gives the texture back to the pool, it stays allocated for the next acquire.
+    void release(uint32_t id);
+    // Deletes the textures which are not in use.
+    void trim();
+
+    size_t allocatedBytes() const;
+
+private:
+    struct Entry {
+        Texture texture;
+        bool inUse;
+    };
+
+    uint32_t m_granularity;
+    std::vector<Entry> m_entries;
+};
+
+// The two targets of the FSR passes: EASU writes 'intermediate', RCAS reads it and writes 'output'.
+// Keeping them separate removes the read/write hazard of RCAS working in place.
+struct FSRTargets {
+    TexturePool::Texture intermediate;
+    TexturePool::Texture output;
+};
+
+// Releases the current targets (if any) and acquires a pair for the given output size.
+// The intermediate is GL_RGBA32F, or GL_RGBA16F for the half precision programs which halves its
+// memory and bandwidth. The output can also be GL_RGBA8 or GL_RGB10_A2 when it is only displayed or
+// read back, a quarter of the GL_RGBA32F size.
+// Returns true if either texture changed, the views showing them have to be updated.
+bool acquireFSRTargets(TexturePool& pool, const Extent& output, uint32_t intermediateFormat, uint32_t outputFormat, FSRTargets* targets);
+
+#endif /* TEXTURE_POOL_H */
@@ -0,0 +1,151 @@
+#include "thread_pool.h"
+
+#include "trace.h"
+
+ThreadPool::ThreadPool(uint32_t threadCount)
+    : m_threadCount(threadCount)
+{
+    if (m_threadCount == 0) {
+        m_threadCount = std::thread::hardware_concurrency();
+    }
+    if (m_threadCount == 0) {
+        m_threadCount = 1;
+    }
+
+    m_ranges.reset(new Range[m_threadCount]);
+    for (uint32_t worker = 1; worker < m_threadCount; worker++) {
+        m_threads.emplace_back(&ThreadPool::workerMain, this, worker);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        m_quit = true;
+    }
+    m_wake.notify_all();
+
+    for (std::thread& thread : m_threads) {
+        thread.join();
+    }
+}
+
+void ThreadPool::parallelFor(uint32_t count, const std::function<void(uint32_t index, uint32_t worker)>& fn) {
+    m_steals.store(0, std::memory_order_relaxed);
+    if (count == 0) {
+        return;
+    }
+
+    // Contiguous initial split, the first 'count % threads' workers get one extra index.
+    const uint32_t base = count / m_threadCount;
+    const uint32_t extra = count % m_threadCount;
+    uint32_t begin = 0;
+    for (uint32_t worker = 0; worker < m_threadCount; worker++) {
+        const uint32_t size = base + (worker < extra ? 1 : 0);
+        std::lock_guard<std::mutex> guard(m_ranges[worker].lock);
+        m_ranges[worker].begin = begin;
+        m_ranges[worker].end = begin + size;
+        begin += size;
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        m_fn = &fn;
+        m_running = m_threadCount - 1;
+        m_generation++;
+    }
+    m_wake.notify_all();
+
+    runWorker(0);
+
+    std::unique_lock<std::mutex> guard(m_lock);
+    m_done.wait(guard, [this] { return m_running == 0; });
+    m_fn = nullptr;
+}
+
+void ThreadPool::workerMain(uint32_t worker) {
+    traceThreadName("pool");
+    uint64_t generation = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> guard(m_lock);
+            m_wake.wait(guard, [&] { return m_quit || m_generation != generation; });
+            if (m_quit) {
+                return;
+            }
+            generation = m_generation;
+        }
+
+        runWorker(worker);
+
+        std::lock_guard<std::mutex> guard(m_lock);
+        if (--m_running == 0) {
+            m_done.notify_one();
+        }
+    }
+}
+
+void ThreadPool::runWorker(uint32_t worker) {
+    const std::function<void(uint32_t, uint32_t)>& fn = *m_fn;
+
+    do {
+        uint32_t index;
+        while (popLocal(worker, &index)) {
+            fn(index, worker);
+        }
+    } while (steal(worker));
+}
+
+bool ThreadPool::popLocal(uint32_t worker, uint32_t* index) {
+    Range& range = m_ranges[worker];
+    std::lock_guard<std::mutex> guard(range.lock);
+    if (range.begin == range.end) {
+        return false;
+    }
+
+    *index = range.begin++;
+    return true;
+}
+
+bool ThreadPool::steal(uint32_t worker) {
+    // Ranges only ever shrink or move to the thief, so once every range is empty the loop is done.
+    while (true) {
+        uint32_t victim = worker;
+        uint32_t victimSize = 0;
+        for (uint32_t offset = 1; offset < m_threadCount; offset++) {
+            const uint32_t other = (worker + offset) % m_threadCount;
+            std::lock_guard<std::mutex> guard(m_ranges[other].lock);
+            const uint32_t size = m_ranges[other].end - m_ranges[other].begin;
+            if (size > victimSize) {
+                victim = other;
+                victimSize = size;
+            }
+        }
+        if (victimSize == 0) {
+            return false;
+        }
+
+        uint32_t begin;
+        uint32_t end;
+        {
+            std::lock_guard<std::mutex> guard(m_ranges[victim].lock);
+            const uint32_t size = m_ranges[victim].end - m_ranges[victim].begin;
+            if (size == 0) {
+                // Emptied in the meantime, look again.
+                continue;
+            }
+            // Take the back half, the owner keeps working on the front.
+            end = m_ranges[victim].end;
+            begin = end - (size + 1) / 2;
+            m_ranges[victim].end = begin;
+        }
+
+        {
+            std::lock_guard<std::mutex> guard(m_ranges[worker].lock);
+            m_ranges[worker].begin = begin;
+            m_ranges[worker].end = end;
+        }
+        m_steals.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+}
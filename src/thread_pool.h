@@ -0,0 +1,66 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed size work-stealing pool for data parallel loops.
+//
+// parallelFor splits [0, count) into one contiguous range per worker, so neighbouring indices
+// (neighbouring tiles) stay on the same core. A worker pops indices from the front of its own range
+// and, once empty, steals the back half of the largest remaining range of another worker.
+// The calling thread takes part as worker 0, so a pool of N threads starts N - 1 extra threads.
+class ThreadPool {
+public:
+    // 0 uses one thread per hardware thread.
+    explicit ThreadPool(uint32_t threadCount = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    uint32_t threadCount() const { return m_threadCount; }
+
+    // Runs fn(index, worker) for every index in [0, count) and waits for all of them.
+    // 'worker' is in [0, threadCount()), usable to index per thread scratch data.
+    // Not reentrant: fn must not call parallelFor on the same pool.
+    void parallelFor(uint32_t count, const std::function<void(uint32_t index, uint32_t worker)>& fn);
+
+    // Number of ranges stolen during the last parallelFor.
+    uint32_t lastStealCount() const { return m_steals.load(std::memory_order_relaxed); }
+
+private:
+    // Remaining indices of one worker, on its own cache line as every pop writes it.
+    struct alignas(64) Range {
+        std::mutex lock;
+        uint32_t begin = 0;
+        uint32_t end = 0;
+    };
+
+    void workerMain(uint32_t worker);
+    void runWorker(uint32_t worker);
+    bool popLocal(uint32_t worker, uint32_t* index);
+    bool steal(uint32_t worker);
+
+    uint32_t m_threadCount;
+    std::vector<std::thread> m_threads;
+    std::unique_ptr<Range[]> m_ranges;
+
+    std::mutex m_lock;
+    std::condition_variable m_wake;
+    std::condition_variable m_done;
+    uint64_t m_generation = 0;
+    uint32_t m_running = 0;
+    bool m_quit = false;
+
+    const std::function<void(uint32_t, uint32_t)>* m_fn = nullptr;
+    std::atomic<uint32_t> m_steals{0};
+};
+
+#endif /* THREAD_POOL_H */
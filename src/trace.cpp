@@ -0,0 +1,229 @@
+#include "trace.h"
+
+#include <cstdio>
+
+#ifdef FSR_TRACE
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define TRACE_TSC 1
+#elif defined(_M_X64) || defined(_M_IX86)
+#include <intrin.h>
+#define TRACE_TSC 1
+#else
+#define TRACE_TSC 0
+#endif
+
+std::atomic<bool> g_traceEnabled{false};
+
+namespace {
+
+struct TraceEvent {
+    const char* name;
+    uint64_t begin;
+    uint64_t end;
+    uint32_t track;   // 0 for the thread's own track
+    bool nanoseconds; // steady_clock nanoseconds instead of ticks
+};
+
+// Only ever touched by its thread while recording, owned by s_buffers so it outlives the thread.
+// Fixed size chunks, a full one is never copied, and the chunks are kept for the next recording.
+struct TraceBuffer {
+    static const uint32_t chunkEvents = 4096;
+
+    std::vector<std::unique_ptr<TraceEvent[]>> chunks;
+    uint32_t chunk = 0; // being filled
+    uint32_t used = 0;  // events in it
+    uint32_t tid = 0;
+    std::string name;
+
+    void push(const TraceEvent& event) {
+        if (used == chunkEvents || chunks.empty()) {
+            nextChunk();
+        }
+        chunks[chunk][used++] = event;
+    }
+
+    void nextChunk() {
+        if (!chunks.empty()) {
+            chunk++;
+        }
+        if (chunk == chunks.size()) {
+            chunks.emplace_back(new TraceEvent[chunkEvents]);
+        }
+        used = 0;
+    }
+
+    size_t size() const {
+        return chunks.empty() ? 0 : (size_t)chunk * chunkEvents + used;
+    }
+
+    const TraceEvent& operator[](size_t idx) const {
+        return chunks[idx / chunkEvents][idx % chunkEvents];
+    }
+
+    void clear() {
+        chunk = 0;
+        used = 0;
+    }
+};
+
+// tids of the tracks made by traceTrack, after the threads
+const uint32_t firstTrackId = 1000;
+
+std::mutex s_lock;
+std::vector<std::unique_ptr<TraceBuffer>> s_buffers;
+std::vector<std::string> s_tracks;
+uint64_t s_startTicks = 0;
+uint64_t s_startNs = 0;
+
+thread_local TraceBuffer* t_buffer = nullptr;
+
+TraceBuffer* threadBuffer() {
+    if (!t_buffer) {
+        std::unique_ptr<TraceBuffer> buffer(new TraceBuffer());
+        std::lock_guard<std::mutex> guard(s_lock);
+        buffer->tid = (uint32_t)s_buffers.size() + 1;
+        t_buffer = buffer.get();
+        s_buffers.push_back(std::move(buffer));
+    }
+    return t_buffer;
+}
+
+// JSON string contents, the names are ours but the thread names could be anything.
+void writeEscaped(FILE* fp, const char* text) {
+    for (; *text; text++) {
+        if (*text == '"' || *text == '\\') {
+            fputc('\\', fp);
+        }
+        fputc((unsigned char)*text < 0x20 ? ' ' : *text, fp);
+    }
+}
+
+} // namespace
+
+uint64_t traceTicks() {
+#if TRACE_TSC
+    return __rdtsc();
+#else
+    return traceNowNs();
+#endif
+}
+
+uint64_t traceNowNs() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void traceStart() {
+    std::lock_guard<std::mutex> guard(s_lock);
+    for (std::unique_ptr<TraceBuffer>& buffer : s_buffers) {
+        buffer->clear();
+    }
+    s_startNs = traceNowNs();
+    s_startTicks = traceTicks();
+    g_traceEnabled.store(true, std::memory_order_relaxed);
+}
+
+bool traceStop(const std::string& filename) {
+    g_traceEnabled.store(false, std::memory_order_relaxed);
+    const uint64_t stopNs = traceNowNs();
+    const uint64_t stopTicks = traceTicks();
+
+    std::lock_guard<std::mutex> guard(s_lock);
+    // ticks to nanoseconds from the two points in time, a no-op without a TSC
+    const double nsPerTick = stopTicks > s_startTicks ? (double)(stopNs - s_startNs) / (double)(stopTicks - s_startTicks) : 1.0;
+    auto toUs = [&](const TraceEvent& event, uint64_t value) {
+        if (event.nanoseconds) {
+            return ((double)value - (double)s_startNs) / 1000.0;
+        }
+        return ((double)value - (double)s_startTicks) * nsPerTick / 1000.0;
+    };
+
+    FILE* fp = fopen(filename.c_str(), "w");
+    if (fp == NULL) {
+        printf("Unable to open: %s\n", filename.c_str());
+        return false;
+    }
+
+    size_t count = 0;
+    fprintf(fp, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n");
+    fprintf(fp, "{\"ph\": \"M\", \"pid\": 1, \"name\": \"process_name\", \"args\": {\"name\": \"gles_fsr\"}}");
+    for (const std::unique_ptr<TraceBuffer>& buffer : s_buffers) {
+        fprintf(fp, ",\n{\"ph\": \"M\", \"pid\": 1, \"tid\": %u, \"name\": \"thread_name\", \"args\": {\"name\": \"", buffer->tid);
+        if (buffer->name.empty()) {
+            fprintf(fp, "thread %u", buffer->tid);
+        } else {
+            writeEscaped(fp, buffer->name.c_str());
+        }
+        fprintf(fp, "\"}}");
+    }
+    for (size_t track = 0; track < s_tracks.size(); track++) {
+        fprintf(fp, ",\n{\"ph\": \"M\", \"pid\": 1, \"tid\": %u, \"name\": \"thread_name\", \"args\": {\"name\": \"", firstTrackId + (uint32_t)track);
+        writeEscaped(fp, s_tracks[track].c_str());
+        fprintf(fp, "\"}}");
+    }
+
+    for (const std::unique_ptr<TraceBuffer>& buffer : s_buffers) {
+        for (size_t idx = 0; idx < buffer->size(); idx++) {
+            const TraceEvent& event = (*buffer)[idx];
+            const double beginUs = toUs(event, event.begin);
+            const double endUs = toUs(event, event.end);
+            fprintf(fp, ",\n{\"ph\": \"X\", \"pid\": 1, \"tid\": %u, \"name\": \"", event.track ? event.track : buffer->tid);
+            writeEscaped(fp, event.name);
+            fprintf(fp, "\", \"ts\": %.3f, \"dur\": %.3f}", beginUs, endUs > beginUs ? endUs - beginUs : 0.0);
+        }
+        count += buffer->size();
+        buffer->clear();
+    }
+    fprintf(fp, "\n]}\n");
+
+    if (fclose(fp) != 0) {
+        printf("Unable to write: %s\n", filename.c_str());
+        return false;
+    }
+    printf("Trace: %zu zones in %s\n", count, filename.c_str());
+    return true;
+}
+
+void traceThreadName(const char* name) {
+    if (!traceEnabled()) {
+        return;
+    }
+    TraceBuffer* buffer = threadBuffer();
+    std::lock_guard<std::mutex> guard(s_lock);
+    buffer->name = name;
+}
+
+uint32_t traceTrack(const char* name) {
+    std::lock_guard<std::mutex> guard(s_lock);
+    s_tracks.push_back(name);
+    return firstTrackId + (uint32_t)s_tracks.size() - 1;
+}
+
+void traceZone(const char* name, uint64_t beginTicks, uint64_t endTicks) {
+    threadBuffer()->push({ name, beginTicks, endTicks, 0, false });
+}
+
+void traceTrackSpan(uint32_t track, const char* name, uint64_t beginNs, uint64_t endNs) {
+    if (traceEnabled()) {
+        threadBuffer()->push({ name, beginNs, endNs, track, true });
+    }
+}
+
+#else
+
+void traceStart() {
+    printf("Built without FSR_TRACE, no trace is recorded\n");
+}
+
+bool traceStop(const std::string& filename) {
+    printf("Built without FSR_TRACE, %s is not written\n", filename.c_str());
+    return false;
+}
+
+#endif
@@ -0,0 +1,82 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Chrome trace (chrome://tracing, ui.perfetto.dev) of scoped zones, one track per thread plus
+// named tracks for work that doesn't happen on a CPU thread (GPU passes, driver shader compiles).
+//
+// TRACE_ZONE("name") times the rest of the enclosing scope. The name has to be a string literal,
+// only the pointer is kept. A zone costs two reads of the TSC (steady_clock elsewhere) and a
+// push into a buffer of the calling thread, no locks; while not recording it is a relaxed load.
+// Built without FSR_TRACE, the macro and the helpers below compile to nothing.
+//
+// traceStop() reads the buffers of every thread, the traced threads have to be done or idle by then.
+
+#ifdef FSR_TRACE
+
+extern std::atomic<bool> g_traceEnabled;
+
+inline bool traceEnabled() { return g_traceEnabled.load(std::memory_order_relaxed); }
+
+// Clears what was recorded before and starts recording.
+void traceStart();
+// Stops recording and writes the trace, prints and returns false on errors.
+bool traceStop(const std::string& filename);
+
+// Name of the calling thread's track, while recording.
+void traceThreadName(const char* name);
+// A track of its own, for spans that don't nest with the calling thread's zones. Call it once.
+uint32_t traceTrack(const char* name);
+
+// Raw clock of the zones and a steady_clock::now() in nanoseconds since its epoch.
+uint64_t traceTicks();
+uint64_t traceNowNs();
+
+// A zone timed by the caller, in traceTicks().
+void traceZone(const char* name, uint64_t beginTicks, uint64_t endTicks);
+// A span in steady_clock nanoseconds (traceNowNs) on 'track'.
+void traceTrackSpan(uint32_t track, const char* name, uint64_t beginNs, uint64_t endNs);
+
+class TraceZone {
+public:
+    explicit TraceZone(const char* name)
+        : m_name(name)
+        , m_begin(traceEnabled() ? traceTicks() : 0)
+    {
+    }
+    ~TraceZone() {
+        if (m_begin) {
+            traceZone(m_name, m_begin, traceTicks());
+        }
+    }
+
+    TraceZone(const TraceZone&) = delete;
+    TraceZone& operator=(const TraceZone&) = delete;
+
+private:
+    const char* m_name;
+    uint64_t m_begin;
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_ZONE(name) TraceZone TRACE_CONCAT(traceZone, __LINE__)(name)
+
+#else
+
+inline bool traceEnabled() { return false; }
+void traceStart();
+bool traceStop(const std::string& filename);
+inline void traceThreadName(const char*) {}
+inline uint32_t traceTrack(const char*) { return 0; }
+inline uint64_t traceNowNs() { return 0; }
+inline void traceTrackSpan(uint32_t, const char*, uint64_t, uint64_t) {}
+
+#define TRACE_ZONE(name) ((void)0)
+
+#endif
+
+#endif /* TRACE_H */
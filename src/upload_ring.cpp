@@ -0,0 +1,142 @@
+#include <glad/glad.h>
+
+#include "upload_ring.h"
+#include "trace.h"
+
+#include <cstdio>
+#include <cstring>
+
+UploadRing::UploadRing(uint32_t slots)
+    : m_slots(slots ? slots : 1)
+    , m_persistent(hasGLBufferStorage())
+{
+}
+
+UploadRing::~UploadRing() {
+    // a map() without upload(), only that slot is mapped when the mappings aren't persistent
+    discard();
+    for (Slot& slot : m_slots) {
+        slot.fence = GpuFence();
+        if (slot.buffer) {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer);
+            if (slot.mapped) {
+                glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+            }
+            glDeleteBuffers(1, &slot.buffer);
+        }
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+// Makes the slot's buffer hold at least 'bytes', leaves it bound to GL_PIXEL_UNPACK_BUFFER.
+void UploadRing::reserve(Slot& slot, size_t bytes) {
+    if (slot.buffer && slot.capacity >= bytes) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer);
+        return;
+    }
+
+    if (slot.buffer) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer);
+        if (slot.mapped) {
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+            slot.mapped = nullptr;
+        }
+        glDeleteBuffers(1, &slot.buffer);
+    }
+
+    slot.buffer = createMappedBuffer(GL_PIXEL_UNPACK_BUFFER, bytes, GL_MAP_WRITE_BIT, m_persistent ? &slot.mapped : nullptr);
+    slot.capacity = bytes;
+    if (m_persistent && slot.mapped == NULL) {
+        printf("Upload: persistent mapping failed, mapping per upload\n");
+        m_persistent = false;
+    }
+}
+
+uint8_t* UploadRing::map(size_t bytes) {
+    if (m_current) {
+        discard();
+    }
+    Slot& slot = m_slots[m_next];
+
+    // the GPU may still be reading the previous upload from this slot
+    if (!slot.fence.isSignaled()) {
+        const auto waitStart = std::chrono::steady_clock::now();
+        slot.fence.wait();
+        m_stats.waitMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - waitStart).count();
+    }
+    slot.fence = GpuFence();
+
+    reserve(slot, bytes);
+    if (slot.mapped) {
+        m_current = (uint8_t*)slot.mapped;
+    } else {
+        // the old contents are not needed, the driver can hand out fresh memory instead of syncing
+        m_current = (uint8_t*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        if (m_current == NULL) {
+            printf("Upload: unable to map the buffer\n");
+        }
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    m_currentBytes = m_current ? bytes : 0;
+    return m_current;
+}
+
+void UploadRing::discard() {
+    if (!m_current) {
+        return;
+    }
+    Slot& slot = m_slots[m_next];
+    if (!slot.mapped) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+    m_current = nullptr;
+    m_currentBytes = 0;
+}
+
+bool UploadRing::upload(uint32_t width, uint32_t height, uint32_t* out_texture) {
+    TRACE_ZONE("upload");
+    const size_t bytes = (size_t)width * height * 4;
+    if (!m_current || bytes > m_currentBytes) {
+        printf("Upload: %ux%u is not mapped\n", width, height);
+        discard();
+        return false;
+    }
+
+    Slot& slot = m_slots[m_next];
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer);
+    if (!slot.mapped && glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) == GL_FALSE) {
+        // the contents were lost (a display mode change on some platforms)
+        printf("Upload: buffer contents lost\n");
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        m_current = nullptr;
+        m_currentBytes = 0;
+        return false;
+    }
+    m_current = nullptr;
+    m_currentBytes = 0;
+
+    // the pixels come from offset 0 of the bound buffer
+    bool ok = LoadTextureFromMemory(nullptr, width, height, out_texture);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    slot.fence = GpuFence::insert();
+
+    m_next = (m_next + 1) % (uint32_t)m_slots.size();
+    m_stats.uploads++;
+    m_stats.bytes += bytes;
+    return ok;
+}
+
+bool UploadRing::upload(const uint8_t* rgba, uint32_t width, uint32_t height, uint32_t* out_texture) {
+    const size_t bytes = (size_t)width * height * 4;
+    uint8_t* dst = map(bytes);
+    if (!dst) {
+        return false;
+    }
+    {
+        TRACE_ZONE("uploadCopy");
+        memcpy(dst, rgba, bytes);
+    }
+    return upload(width, height, out_texture);
+}
@@ -0,0 +1,68 @@
+#ifndef UPLOAD_RING_H
+#define UPLOAD_RING_H
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include "fsr_gl.h"
+#include "image_utils.h"
+
+// Texture uploads through a ring of GL_PIXEL_UNPACK_BUFFERs, the counterpart of ReadbackRing.
+//
+// map() hands out the next buffer for the caller to copy the RGBA8 pixels into, upload() creates the
+// texture from it with glTexStorage2D + glTexSubImage2D and puts a fence behind, the GPU copies from
+// the buffer while the next image is decoded. The mapping is write-only and can be uncached
+// (write-combined) memory, so only write it once, front to back, and never read it.
+// A slot is only written again once its fence signaled. With GL 4.4 / GL_ARB_buffer_storage the
+// buffers are mapped once, persistent and coherent, otherwise they are mapped per map() call.
+// Requires a current GL context for every call, including the destructor.
+class UploadRing {
+public:
+    // Summed over all uploads.
+    struct Stats {
+        uint64_t uploads = 0;
+        uint64_t bytes = 0;
+        double waitMs = 0.0; // map() blocked on a fence, the GPU was still reading the slot
+    };
+
+    explicit UploadRing(uint32_t slots = 3);
+    ~UploadRing();
+
+    UploadRing(const UploadRing&) = delete;
+    UploadRing& operator=(const UploadRing&) = delete;
+
+    // Write-only memory for 'bytes' of pixels, valid until upload() or discard(). Null if the buffer
+    // couldn't be mapped.
+    uint8_t* map(size_t bytes);
+    // The mapped pixels as a new immutable RGBA8 texture of 'width' x 'height', then moves to the next slot.
+    bool upload(uint32_t width, uint32_t height, uint32_t* out_texture);
+    // Gives up the mapped slot, when decoding into it failed.
+    void discard();
+
+    // map(), a copy of 'rgba' and upload(), for pixels which are already in memory.
+    bool upload(const uint8_t* rgba, uint32_t width, uint32_t height, uint32_t* out_texture);
+
+    bool persistent() const { return m_persistent; }
+    const Stats& stats() const { return m_stats; }
+
+private:
+    struct Slot {
+        uint32_t buffer = 0;
+        size_t capacity = 0;
+        void* mapped = nullptr; // persistent mapping, null otherwise
+        GpuFence fence;
+    };
+
+    void reserve(Slot& slot, size_t bytes);
+
+    std::vector<Slot> m_slots;
+    uint32_t m_next = 0;       // slot of the next map
+    uint8_t* m_current = nullptr; // mapped by map(), not uploaded yet
+    size_t m_currentBytes = 0;
+    bool m_persistent = false;
+
+    Stats m_stats;
+};
+
+#endif /* UPLOAD_RING_H */
@@ -1,5 +1,8 @@
 add_rules("mode.debug", "mode.release")
 
+-- std::filesystem for the batch directory inputs
+set_languages("c++17")
+
 
 add_repositories("zeromake https://github.com/zeromake/xrepo.git")
 
@@ -16,8 +19,181 @@ add_requires("glfw", "glad")
 
 set_rundir("$(projectdir)")
 
+option("shader_strip")
+    set_default(true)
+    set_showmenu(true)
+    set_description("Strip comments and the #if blocks resolved for every program from the embedded shaders")
+option_end()
+
+option("trace")
+    set_default(true)
+    set_showmenu(true)
+    set_description("TRACE_ZONE instrumentation for --trace, compiled out when disabled")
+option_end()
+
+if has_config("trace") then
+    add_defines("FSR_TRACE")
+end
+
+-- Turns the GLSL sources into fsr_shaders.gen.h at build time, runs on the build machine.
+target("shader_embed")
+    set_kind("binary")
+    set_default(false)
+    set_plat(os.host())
+    set_arch(os.arch())
+    add_files("src/shader_embed.cpp")
+target_end()
+
+-- CPU kernels per instruction set, picked at runtime by CPUID.
+-- No fp contraction, the texel positions have to round the same way as the scalar code.
+function add_fsr_cpu_kernels()
+    if not is_arch("x86_64", "x64", "i386", "x86") then
+        add_files("src/fsr_cpu_sse41.cpp", "src/fsr_cpu_avx2.cpp", "src/fsr_cpu_avx512.cpp", "src/fsr_cpu_avx512fp16.cpp")
+    elseif is_plat("windows") then
+        add_files("src/fsr_cpu_sse41.cpp")
+        add_files("src/fsr_cpu_avx2.cpp", {cxflags = "/arch:AVX2"})
+        add_files("src/fsr_cpu_avx512.cpp", {cxflags = "/arch:AVX512"})
+        add_files("src/fsr_cpu_avx512fp16.cpp", {cxflags = "/arch:AVX512"})
+    else
+        add_files("src/fsr_cpu_sse41.cpp", {cxflags = {"-msse4.1", "-ffp-contract=off"}})
+        add_files("src/fsr_cpu_avx2.cpp", {cxflags = {"-mavx2", "-mfma", "-ffp-contract=off"}})
+        add_files("src/fsr_cpu_avx512.cpp", {cxflags = {"-mavx512f", "-mavx512bw", "-ffp-contract=off"}})
+        add_files("src/fsr_cpu_avx512fp16.cpp", {cxflags = {"-mavx512fp16", "-mavx512vl", "-mavx512dq", "-mavx512bw", "-mavx512f", "-mf16c", "-ffp-contract=off"}})
+    end
+end
+
+-- PSNR/SSIM/MS-SSIM, the AVX2 kernels are picked at runtime like the FSR ones.
+function add_image_metrics()
+    add_files("src/image_metrics.cpp")
+    if not is_arch("x86_64", "x64", "i386", "x86") then
+        add_files("src/image_metrics_avx2.cpp")
+    elseif is_plat("windows") then
+        add_files("src/image_metrics_avx2.cpp", {cxflags = "/arch:AVX2"})
+    else
+        add_files("src/image_metrics_avx2.cpp", {cxflags = {"-mavx2", "-mfma"}})
+    end
+end
+
 target("gles_fsr")
+    -- the shaders are compiled into the binary, it no longer reads src/ from the working directory
+    add_deps("shader_embed")
+    set_policy("build.across_targets_in_parallel", false)
+    add_defines("FSR_EMBEDDED_SHADERS")
+    on_load(function (target)
+        target:add("includedirs", target:autogendir())
+    end)
+    before_build(function (target)
+        local args = {"-o", path.join(target:autogendir(), "fsr_shaders.gen.h")}
+        if has_config("shader_strip") then
+            table.insert(args, "--strip")
+        end
+        for _, file in ipairs({"ffx_a.h", "ffx_fsr1.h", "fsr_easu.compute.base.glsl"}) do
+            table.insert(args, path.join(os.projectdir(), "src", file))
+        end
+        os.mkdir(target:autogendir())
+        os.vrunv(target:dep("shader_embed"):targetfile(), args)
+    end)
     add_files("src/main.cpp")
+    add_files("src/fsr_batch.cpp")
+    add_files("src/gl_headless.cpp")
     add_files("src/image_utils.cpp")
+    add_files("src/image_ingest.cpp")
+    add_files("src/image_writer.cpp")
+    add_files("src/mapped_file.cpp")
+    add_files("src/fsr_programs.cpp")
+    add_files("src/program_builder.cpp")
+    add_files("src/program_cache.cpp")
+    add_files("src/startup_timeline.cpp")
+    add_files("src/texture_pool.cpp")
+    add_files("src/readback_ring.cpp")
+    add_files("src/upload_ring.cpp")
+    add_files("src/fsr_gl.cpp")
+    add_files("src/dirty_tiles.cpp")
+    add_files("src/gpu_pass_timer.cpp")
+    add_files("src/fsr_cpu.cpp")
+    add_files("src/fsr_cpu_tiled.cpp")
+    add_files("src/thread_pool.cpp")
+    add_files("src/trace.cpp")
+    add_fsr_cpu_kernels()
+    add_image_metrics()
     add_packages("glfw", "imgui", "glad")
+    if is_plat("linux") then
+        -- --batch runs on a surfaceless EGL context
+        add_syslinks("pthread", "EGL")
+        add_defines("FSR_HAS_EGL=1")
+    end
     add_defines('GLSL_VERION="330 core"')
+
+-- Sync vs pipelined GL submission, headless (surfaceless EGL) so it also runs on llvmpipe.
+if is_plat("linux") then
+    target("fsr_gl_bench")
+        set_default(false)
+        add_files("src/fsr_gl_bench.cpp")
+        add_files("src/fsr_gl.cpp")
+        add_files("src/dirty_tiles.cpp")
+        add_files("src/gpu_pass_timer.cpp")
+        add_files("src/trace.cpp")
+        add_files("src/gl_headless.cpp")
+        add_files("src/image_utils.cpp")
+        add_files("src/mapped_file.cpp")
+        add_files("src/fsr_programs.cpp")
+        add_files("src/program_builder.cpp")
+        add_files("src/program_cache.cpp")
+        add_files("src/startup_timeline.cpp")
+        add_files("src/texture_pool.cpp")
+        add_packages("glad")
+        add_syslinks("EGL")
+        add_defines("FSR_HAS_EGL=1")
+        add_defines('GLSL_VERION="330 core"')
+    target_end()
+
+    -- FsrRcasF vs the x2 (FsrRcasHx2) RCAS dispatch, then the float vs FP16 AVX-512 CPU kernels.
+    target("fsr_rcas_bench")
+        set_default(false)
+        add_files("src/fsr_rcas_bench.cpp")
+        add_files("src/fsr_gl.cpp")
+        add_files("src/dirty_tiles.cpp")
+        add_files("src/gpu_pass_timer.cpp")
+        add_files("src/trace.cpp")
+        add_files("src/gl_headless.cpp")
+        add_files("src/image_utils.cpp")
+        add_files("src/mapped_file.cpp")
+        add_files("src/fsr_programs.cpp")
+        add_files("src/program_builder.cpp")
+        add_files("src/program_cache.cpp")
+        add_files("src/startup_timeline.cpp")
+        add_files("src/texture_pool.cpp")
+        add_files("src/fsr_cpu.cpp")
+        add_fsr_cpu_kernels()
+        add_packages("glad")
+        add_syslinks("EGL")
+        add_defines("FSR_HAS_EGL=1")
+        add_defines('GLSL_VERION="330 core"')
+    target_end()
+
+    target("fsr_bench")
+        set_default(false)
+        add_files("src/fsr_bench.cpp")
+        add_files("src/fsr_gl.cpp")
+        add_files("src/dirty_tiles.cpp")
+        add_files("src/gpu_pass_timer.cpp")
+        add_files("src/trace.cpp")
+        add_files("src/gl_headless.cpp")
+        add_files("src/image_utils.cpp")
+        add_files("src/mapped_file.cpp")
+        add_files("src/fsr_programs.cpp")
+        add_files("src/program_builder.cpp")
+        add_files("src/program_cache.cpp")
+        add_files("src/startup_timeline.cpp")
+        add_files("src/texture_pool.cpp")
+        add_files("src/fsr_cpu.cpp")
+        add_files("src/fsr_cpu_tiled.cpp")
+        add_files("src/thread_pool.cpp")
+        add_fsr_cpu_kernels()
+        add_image_metrics()
+        add_packages("glad")
+        add_syslinks("EGL")
+        add_defines("FSR_HAS_EGL=1")
+        add_defines('GLSL_VERION="330 core"')
+    target_end()
+end